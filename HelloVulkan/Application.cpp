@@ -1,8 +1,15 @@
 #include "Application.h"
+#include "Archive.h"
+#include "HostAllocator.h"
+#include "Ktx2TextureSource.h"
+#include "TextureSource.h"
+#include "VulkanCommon.h"
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <chrono>
 #include <iostream>
@@ -15,7 +22,13 @@
 #include <cstring>
 #include <set>
 #include <cstdint>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cctype>
 #include <fstream>
+#include <random>
+#include <thread>
 
 #ifdef NDEBUG
 #define ENABLE_VALIDATION_LAYERS false
@@ -23,12 +36,10 @@
 #define ENABLE_VALIDATION_LAYERS true
 #endif
 
-// If @result is not VK_SUCCESS, throw a std::runtime_error with description @text
-#define ThrowIfFailed(result, text) if(result != VK_SUCCESS){throw std::runtime_error(text);}
-
 struct Vertex{
     glm::vec2 Pos;
     glm::vec3 Color;
+    glm::vec2 TexCoord;
 
     static VkVertexInputBindingDescription GetBindingDescription(){
         VkVertexInputBindingDescription bindingDesc = {};
@@ -39,8 +50,8 @@ struct Vertex{
         return bindingDesc;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescription(){
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescs = {};
+    static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescription(){
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescs = {};
         // Position
         attributeDescs[0].binding = 0;
         attributeDescs[0].location = 0;
@@ -51,25 +62,36 @@ struct Vertex{
         attributeDescs[1].location = 1;
         attributeDescs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
         attributeDescs[1].offset = offsetof(Vertex, Color);
+        // Texture coordinate
+        attributeDescs[2].binding = 0;
+        attributeDescs[2].location = 2;
+        attributeDescs[2].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescs[2].offset = offsetof(Vertex, TexCoord);
 
         return attributeDescs;
     }
 };
 
-struct UniformBufferObject{
-    glm::mat4 model;
+// The matrices of each view, gl_ViewIndex picks them with multiview. A single view reads the first
+struct ViewUniforms{
     glm::mat4 view;
     glm::mat4 proj;
 };
 
-constexpr int WINDOW_WIDTH = 800;
-constexpr int WINDOW_HEIGHT = 600;
+struct UniformBufferObject{
+    ViewUniforms views[Multiview::MAX_VIEW_COUNT];
+};
+
 constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+// Frames a benchmark leaves out before it starts measuring, at most a quarter of the run
+constexpr uint64_t BENCHMARK_WARMUP_FRAMES = 10;
+// Scene time a benchmark frame advances by, whatever the frame actually took
+constexpr float BENCHMARK_FRAME_TIME = 1.0f / 60.0f;
 const std::vector<Vertex> g_vertices = {
-    {{-0.5f,-0.5f}, {1.0f,0.0f,0.0f}},
-    {{0.5f,-0.5f}, {0.0f,1.0f,0.0f}},
-    {{0.5f,0.5f}, {0.0f, 0.0f, 1.0f}},
-    {{-0.5f,0.5f}, {0.0f,1.0f,1.0f}},
+    {{-0.5f,-0.5f}, {1.0f,0.0f,0.0f}, {0.0f,0.0f}},
+    {{0.5f,-0.5f}, {0.0f,1.0f,0.0f}, {1.0f,0.0f}},
+    {{0.5f,0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f,1.0f}},
+    {{-0.5f,0.5f}, {0.0f,1.0f,1.0f}, {0.0f,1.0f}},
 };
 const std::vector<uint16_t> g_indices = {
     0, 1, 2,
@@ -77,48 +99,61 @@ const std::vector<uint16_t> g_indices = {
 };
 
 
-const std::vector<const char*> g_validationLayers = {
-    "VK_LAYER_KHRONOS_validation"
-};
-
-const std::vector<const char*> g_deviceEntensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
-};
-
-/////////////////////////////////////////////////////////////////////////////////
-// Static global functions //////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////
+namespace{
 
-// Be careful the file path which is relative to path of the execuable when you just run it,
-// and is relative to path of CMakeLists.txt when you debug using CMake Tool in Vs code. 
-std::vector<char> ReadFile(const std::string& filename){
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if(!file.is_open()){
-        throw std::runtime_error("Failed to open file: " + filename);
+// Poll @ready until it returns true or @stop is set, spinning briefly before giving the core away. Frame packets
+// arrive at most a frame apart, so there is nothing worth a kernel wait. Returns false when stopped
+template<typename Predicate>
+bool WaitUntil(const std::atomic<bool>& stop, Predicate ready){
+    for(uint32_t round = 0; !ready(); round++){
+        if(stop.load(std::memory_order_acquire)) return false;
+        if(round < 64) continue;
+        if(round < 1024) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
     }
+    return true;
+}
 
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-
-    file.close();
+// Rasterizer state of the scene pipeline, the meshlet pipeline draws the same triangles with it
+VkPipelineRasterizationStateCreateInfo GetSceneRasterizerInfo(){
+    VkPipelineRasterizationStateCreateInfo rasterizerInfo = {};
+    rasterizerInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizerInfo.depthClampEnable = VK_FALSE;
+    rasterizerInfo.rasterizerDiscardEnable = VK_FALSE;
+    rasterizerInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizerInfo.lineWidth = 1.0f;
+    rasterizerInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizerInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizerInfo.depthBiasEnable = VK_FALSE;
+    rasterizerInfo.depthBiasConstantFactor = 0.0f;
+    rasterizerInfo.depthBiasClamp = 0.0f;
+    rasterizerInfo.depthBiasSlopeFactor = 0.0f;
+    return rasterizerInfo;
+}
 
-    return buffer;
+// Depth state of the scene pipeline, nearer fragments win
+VkPipelineDepthStencilStateCreateInfo GetSceneDepthStencilInfo(){
+    VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {};
+    depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilInfo.depthTestEnable = VK_TRUE;
+    depthStencilInfo.depthWriteEnable = VK_TRUE;
+    depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilInfo.stencilTestEnable = VK_FALSE;
+    depthStencilInfo.minDepthBounds = 0.0f;
+    depthStencilInfo.maxDepthBounds = 1.0f;
+    return depthStencilInfo;
 }
 
-template<typename T>
-T Clamp(T value, T minValue, T maxValue){
-    if(value > maxValue){
-        return maxValue;
-    }else if(value < minValue){
-        return minValue;
-    }else{
-        return value;
-    }
 }
 
+const std::vector<const char*> g_validationLayers = {
+    "VK_LAYER_KHRONOS_validation"
+};
+
+const std::vector<const char*> g_deviceEntensions = {
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME
+};
 
 /////////////////////////////////////////////////////////////////////////////////
 // Static member functions //////////////////////////////////////////////////////
@@ -191,36 +226,115 @@ bool Application::CheckGLFWExtensionSupport()
     return true;
 }
 
-bool Application::CheckDeviceExtensionSupport(VkPhysicalDevice device){
+bool Application::CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& requiredExtensions,
+    std::set<std::string>& missingExtensions)
+{
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,nullptr);
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(g_deviceEntensions.begin(),g_deviceEntensions.end());
+    missingExtensions = std::set<std::string>(requiredExtensions.begin(),requiredExtensions.end());
 
     for(const auto& extension: availableExtensions){
-        requiredExtensions.erase(extension.extensionName);
+        missingExtensions.erase(extension.extensionName);
     }
     
-    return requiredExtensions.empty();
+    return missingExtensions.empty();
+}
+
+bool Application::IsDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName){
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device,nullptr,&extensionCount,availableExtensions.data());
+
+    for(const auto& extension: availableExtensions){
+        if(strcmp(extension.extensionName, extensionName) == 0) return true;
+    }
+
+    return false;
+}
+
+std::string Application::GetPhysicalDeviceUUID(VkPhysicalDevice device){
+    // The UUID is only reachable through the Vulkan 1.1 properties chain, which a 1.0 device must not be asked for
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if(deviceProperties.apiVersion < VK_API_VERSION_1_1) return "";
+
+    VkPhysicalDeviceIDProperties idProperties = {};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties);
+
+    static const char* hexDigits = "0123456789abcdef";
+    std::string uuid;
+    for(uint32_t i = 0; i < VK_UUID_SIZE; i++){
+        if(i == 4 || i == 6 || i == 8 || i == 10) uuid += '-';
+        uuid += hexDigits[idProperties.deviceUUID[i] >> 4];
+        uuid += hexDigits[idProperties.deviceUUID[i] & 0xF];
+    }
+
+    return uuid;
+}
+
+bool Application::MatchesPreferredDevice(VkPhysicalDevice device, const std::string& preferred){
+    auto toLower = [](std::string text){
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+        return text;
+    };
+    auto stripDashes = [](std::string text){
+        text.erase(std::remove(text.begin(), text.end(), '-'), text.end());
+        return text;
+    };
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+    std::string wanted = toLower(preferred);
+    if(toLower(deviceProperties.deviceName).find(wanted) != std::string::npos){
+        return true;
+    }
+
+    // Devices without a UUID only match by name
+    std::string uuid = GetPhysicalDeviceUUID(device);
+    return !uuid.empty() && stripDashes(uuid) == stripDashes(wanted);
 }
 
-std::vector<const char*> Application::GetRequiredExtensions()
+std::vector<const char*> Application::GetRequiredExtensions(bool headless, bool debugUtils)
 {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char *> extensions;
 
-    std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    // Without a window there is no surface to create, and GLFW is not even initialized
+    if(!headless){
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     #if ENABLE_VALIDATION_LAYERS
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    #else
+        if(debugUtils){
+            uint32_t extensionCount = 0;
+            vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> available(extensionCount);
+            vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, available.data());
+            for(const auto& extension: available){
+                if(strcmp(extension.extensionName, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0){
+                    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+                    break;
+                }
+            }
+        }
     #endif
 
     return extensions;
 }
 
-void Application::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo){
+void Application::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo, Logger* logger){
     createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
     createInfo.messageSeverity =
@@ -232,7 +346,7 @@ void Application::PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateIn
         VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
         VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
     createInfo.pfnUserCallback = DebugCallback;
-    createInfo.pUserData = nullptr;
+    createInfo.pUserData = logger;
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL Application::DebugCallback(
@@ -241,22 +355,22 @@ VKAPI_ATTR VkBool32 VKAPI_CALL Application::DebugCallback(
     const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
     void *pUserData)
 {
-    std::string severityStr = "Unknown"; 
-    switch (messageSeverity)
+    LogSeverity severity = LogSeverity::Info;
+    if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) severity = LogSeverity::Error;
+    else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) severity = LogSeverity::Warning;
+    else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT) severity = LogSeverity::Verbose;
+
+    LogCategory category = LogCategory::General;
+    if (messageType & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) category = LogCategory::Validation;
+    else if (messageType & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT) category = LogCategory::Performance;
+
+    // Called on whichever thread made the Vulkan call, often the render thread, so only queue the message. The
+    // message ID number is a hash of the VUID, repeats of one check are rate limited by it
+    auto logger = static_cast<Logger*>(pUserData);
+    if (logger->IsEnabled(severity, category))
     {
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
-        severityStr = "[ Diagnostic ]";
-        break;
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
-        severityStr = "[ Warning ]";
-        break;
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
-        severityStr = "[ ERROR ]";
-        break;
-    default:
-        break;
-    }
-    std::cerr << "Validation layer" << severityStr << ": " << pCallbackData->pMessage << std::endl;
+        logger->Write(severity, category, static_cast<uint32_t>(pCallbackData->messageIdNumber), pCallbackData->pMessage);
+    }
 
     return VK_FALSE;
 }
@@ -315,16 +429,62 @@ void DebugVulkanExtensios()
 /////////////////////////////////////////////////////////////////////////////////
 // Non-static member functions //////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
+Application::Application(const ApplicationOptions& options)
+    : m_options(options)
+    , m_jobScheduler(options.jobThreads)
+{
+    GetHostAllocator().SetTelemetry(&m_telemetry);
+    SetMemoryTelemetry(&m_telemetry);
+}
+
 void Application::Run()
 {
+    m_startTime = std::chrono::steady_clock::now();
+    m_logger.Open(m_options.logFile, m_options.logFormat);
+    m_logger.SetMinimumSeverity(m_options.logSeverity);
+    m_logger.SetRateLimit(m_options.logRateLimit);
+    // Benchmarks report the time spent per zone
+    m_profiler.SetEnabled(!m_options.profileFile.empty() || !m_options.benchmarkFile.empty());
+    m_profiler.SetThreadName("Render");
+    if(!m_options.telemetryFile.empty()){
+        m_telemetry.Open(m_options.telemetryFile, m_options.telemetryFormat, m_options.telemetryInterval);
+    }
+    if(!m_options.replayFile.empty()){
+        m_captureReader.Open(m_options.replayFile);
+        // The capture decides what is drawn, offscreen at the size it was recorded with
+        const CaptureResources& resources = m_captureReader.GetResources();
+        m_options.headless = true;
+        m_options.width = resources.width;
+        m_options.height = resources.height;
+        m_options.texture = resources.texture;
+        m_options.textureBudgetMB = resources.textureBudgetMB;
+        m_options.replayIterations = std::max(m_options.replayIterations, 1u);
+        // The geometry comes from the capture, the rest of a stress scene is recreated
+        m_options.stress.objectCount = resources.stressObjectCount;
+        m_options.stress.pipelineCount = resources.stressPipelineCount;
+        m_options.stress.uploadKB = resources.stressUploadKB;
+        m_options.frameCount = static_cast<uint64_t>(m_captureReader.GetFrameCount()) * m_options.replayIterations;
+        m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0, "Replaying %u frames of %s %u times at %ux%u",
+            m_captureReader.GetFrameCount(), m_options.replayFile.c_str(), m_options.replayIterations, resources.width, resources.height);
+    }
+
+    if(m_options.stress.pipelineCount == 0 || m_options.stress.pipelineCount > MAX_STRESS_PIPELINES){
+        throw std::runtime_error("Stress scenes need 1 to " + std::to_string(MAX_STRESS_PIPELINES) + " pipelines!");
+    }
+    if(m_options.stress.objectCount > 0 && !IsReplaying()) BuildStressGeometry();
+
     InitWindow();
     InitVulkan();
     MainLoop();
     Cleanup();
+
+    m_logger.Close();
 }
 
 void Application::InitWindow()
 {
+    if(m_options.headless) return;
+
     // Initialize GLFW library
     glfwInit();
 
@@ -337,7 +497,7 @@ void Application::InitWindow()
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
     // Create main window
-    m_window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan", nullptr, nullptr);
+    m_window = glfwCreateWindow(static_cast<int>(m_options.width), static_cast<int>(m_options.height), "Vulkan", nullptr, nullptr);
     // Set user pointer for the window in order to access other class members from GLFW custom callback functions
     glfwSetWindowUserPointer(m_window, this);
 
@@ -351,98 +511,343 @@ void Application::InitWindow()
 
 void Application::InitVulkan()
 {
+    PROFILE_ZONE(m_profiler, "InitVulkan");
     #if ENABLE_VALIDATION_LAYERS
         if(!CheckValidationLayerSupport()) { throw std::runtime_error("Validation layers requested, but not available!"); }
     #endif
 
-    CreateInstance();
-    SetupDebugMassenger();
-    CreateSurface();
-    PickPhysicalDevice();
-    CreateLogicalDevice();
-    CreateSwapChain();
-    CreateImageViews();// Using images as 2D textures
-    CreateRenderPass();
-    CreateGraphicsPipeline();
-    CreateFramebuffers();
-    CreateCommandPool();
-    CreateVertexBuffer();
-    CreateIndexBuffer();
-    CreateCommandBuffers();
-    CreateSyncObjects();
+    // GLFW only answers this on the main thread, the swap chain may be created on any
+    if(!m_options.headless) UpdateFramebufferSize();
+
+    // Startup runs as a graph on the job scheduler, each step waiting only for the objects it uses. Shaders are read
+    // while the instance and device come up, and the pipelines, buffers and descriptors are created side by side
+    auto mount = AddStartupStep("MountAssets", [this](){ MountAssets(); });
+    auto shaders = AddStartupStep("LoadShaders", [this](){ LoadShaders(); }, {mount});
+    auto instance = AddStartupStep("CreateInstance", [this](){ CreateInstance(); });
+    AddStartupStep("SetupDebugMessenger", [this](){ SetupDebugMassenger(); }, {instance});
+    auto surface = AddStartupStep("CreateSurface", [this](){ CreateSurface(); }, {instance});
+    auto physicalDevice = AddStartupStep("PickPhysicalDevice", [this](){ PickPhysicalDevice(); }, {surface});
+    auto device = AddStartupStep("CreateLogicalDevice", [this](){ CreateLogicalDevice(); }, {physicalDevice});
+    auto pipelineCache = AddStartupStep("CreatePipelineCache", [this](){ CreatePipelineCache(); }, {device});
+
+    auto swapChain = AddStartupStep("CreateSwapChain", [this](){ CreateSwapChain(); }, {device});
+    auto imageViews = AddStartupStep("CreateImageViews", [this](){ CreateImageViews(); }, {swapChain});
+    auto readback = AddStartupStep("CreateFrameReadback", [this](){ CreateFrameReadback(); }, {swapChain});
+    auto depthResources = AddStartupStep("CreateDepthResources", [this](){ CreateDepthResources(); }, {swapChain});
+    auto sceneColor = AddStartupStep("CreateSceneColorResources", [this](){ CreateSceneColorResources(); }, {swapChain});
+    auto renderPass = AddStartupStep("CreateRenderPass", [this](){ CreateRenderPass(); }, {swapChain, depthResources});
+    AddStartupStep("CreateFramebuffers", [this](){ CreateFramebuffers(); }, {renderPass, imageViews, depthResources, sceneColor});
+    AddStartupStep("CreateSyncObjects", [this](){ CreateSyncObjects(); }, {swapChain});
+    AddStartupStep("CreateFramePacer", [this](){
+        if(m_framePacingEnabled) CreateFramePacer();
+    }, {swapChain});
+
+    auto descriptorSetLayout = AddStartupStep("CreateDescriptorSetLayout", [this](){ CreateDescriptorSetLayout(); }, {device});
+    AddStartupStep("CreateGraphicsPipeline", [this](){ CreateGraphicsPipeline(); },
+        {shaders, renderPass, descriptorSetLayout, pipelineCache});
+    auto particleSystem = AddStartupStep("CreateParticleSystem", [this](){
+        auto indices = FindQueueFamilies(m_physicalDevice);
+        m_particleSystem.Create(m_physicalDevice, m_device, indices.graphicsFamily.value(), indices.computeFamily.value(),
+            m_computeQueue, MAX_FRAMES_IN_FLIGHT, m_fileSystem, m_pipelineCache);
+    }, {pipelineCache, mount});
+    AddStartupStep("CreateParticlePipeline", [this](){
+        m_particleSystem.CreateGraphicsPipeline(GetMainPassTarget());
+    }, {particleSystem, renderPass});
+    auto dynamicResolution = AddStartupStep("CreateDynamicResolution", [this](){
+        if(m_dynamicResolutionEnabled) CreateDynamicResolution();
+    }, {pipelineCache, mount});
+
+    // The command pool and the graphics queue are externally synchronized, their users go one after another
+    auto commandPool = AddStartupStep("CreateCommandPool", [this](){ CreateCommandPool(); }, {device});
+    auto gpuProfiler = AddStartupStep("CreateGpuProfiler", [this](){
+        m_profiler.CreateGpu(m_vkInstance, m_debugUtilsEnabled, m_physicalDevice, m_device,
+            FindQueueFamilies(m_physicalDevice).graphicsFamily.value(), m_graphicsQueue, m_commandPool, MAX_FRAMES_IN_FLIGHT);
+    }, {commandPool});
+    // The meshlet and occlusion buffers go up with the geometry they are built from, sized for every object of the scene
+    auto scene = AddStartupStep("CreateScene", [this](){ CreateScene(); });
+    auto geometry = AddStartupStep("UploadGeometry", [this](){
+        CreateVertexBuffer();
+        CreateIndexBuffer();
+        if(m_meshletsEnabled) CreateMeshletRenderer();
+        if(m_occlusionCullingEnabled) CreateOcclusionCuller();
+        SubmitStagedUploads();
+    }, {gpuProfiler, scene, descriptorSetLayout, pipelineCache, mount});
+    AddStartupStep("CreateCommandBuffers", [this](){ CreateCommandBuffers(); }, {geometry});
+    AddStartupStep("CreateMeshletPipeline", [this](){
+        if(m_meshletsEnabled){
+            m_meshletRenderer.CreateGraphicsPipeline(GetMainPassTarget(), GetSceneRasterizerInfo(), GetSceneDepthStencilInfo(),
+                m_fragShaderCode.GetBytes());
+        }
+    }, {geometry, renderPass, shaders});
+
+    // The texture only starts streaming here, frames are drawn with whatever is resident until it is complete
+    AddStartupStep("CreateTextures", [this](){ CreateTextures(); }, {device, mount});
+    auto framePacketBuffers = AddStartupStep("CreateFramePacketBuffers", [this](){ CreateFramePacketBuffers(); }, {scene, device});
+    AddStartupStep("CreateStressUploadBuffers", [this](){ CreateStressUploadBuffers(); }, {device});
+    auto uniformBuffers = AddStartupStep("CreateUniformBuffers", [this](){ CreateUniformBuffers(); }, {swapChain});
+    auto descriptorPool = AddStartupStep("CreateDescriptorPool", [this](){ CreateDescriptorPool(); }, {swapChain});
+    AddStartupStep("CreateDescriptorSets", [this](){ CreateDescriptorSets(); },
+        {descriptorPool, descriptorSetLayout, uniformBuffers, framePacketBuffers});
+
+    // The depth pyramid and the upscaled image live in the graph, their users are pointed at them once compiled
+    AddStartupStep("BuildRenderGraph", [this](){
+        m_renderGraph.Init(m_physicalDevice, m_device);
+        BuildRenderGraph();
+    }, {swapChain, readback, depthResources, sceneColor, dynamicResolution, geometry});
+
+    // Everything the first frame draws with, the loop starts as soon as the last of it is there
+    m_jobScheduler.Run();
+    ReportStartupTimes();
+    if(IsReplaying()) LoadReplayTextures();
+
+    // Kick off the simulation step of the first frame, every later step is submitted one frame ahead
+    m_lastSimulationTime = std::chrono::high_resolution_clock::now();
+    m_particleSystem.SubmitSimulation(0, 0.0f, true, &m_telemetry);
+}
+
+JobScheduler::JobHandle Application::AddStartupStep(const char* name, std::function<void()> step,
+    const std::vector<JobScheduler::JobHandle>& dependencies)
+{
+    size_t index = m_startupSteps.size();
+    m_startupSteps.push_back({name});
+    return m_jobScheduler.AddJob([this, index, step = std::move(step)](){
+        // Successors of a failed step would only find its objects missing
+        if(m_startupFailed.load(std::memory_order_relaxed)) return;
+
+        // Steps are added before the graph runs, the vector does not move anymore
+        StartupStep& entry = m_startupSteps[index];
+        entry.begin = GetMillisecondsSinceStart();
+        try{
+            step();
+        }catch(...){
+            m_startupFailed.store(true, std::memory_order_relaxed);
+            throw;
+        }
+        entry.end = GetMillisecondsSinceStart();
+        entry.ran = true;
+    }, dependencies);
+}
+
+void Application::ReportStartupTimes(){
+    std::vector<StartupStep> steps = m_startupSteps;
+    std::sort(steps.begin(), steps.end(), [](const StartupStep& a, const StartupStep& b){ return a.begin < b.begin; });
+
+    double busy = 0.0;
+    double end = 0.0;
+    const StartupStep* longest = nullptr;
+    for(const auto& step: steps){
+        if(!step.ran) continue;
+        m_logger.Print(LogSeverity::Verbose, LogCategory::Performance, 0, "Startup step %-26s %8.2f ms to %8.2f ms, took %7.2f ms",
+            step.name, step.begin, step.end, step.end - step.begin);
+        busy += step.end - step.begin;
+        end = std::max(end, step.end);
+        if(longest == nullptr || step.end - step.begin > longest->end - longest->begin) longest = &step;
+    }
+    if(longest == nullptr) return;
+
+    m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0,
+        "Vulkan ready %.2f ms after start, %.2f ms of steps on %u threads, the longest was %s with %.2f ms",
+        end, busy, m_jobScheduler.GetThreadCount(), longest->name, longest->end - longest->begin);
+}
+
+double Application::GetMillisecondsSinceStart() const{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
 }
 
 void Application::MainLoop()
 {
-    while (!glfwWindowShouldClose(m_window))
+    if (!m_options.captureFile.empty()) OpenCapture();
+
+    // This thread renders and presents, the scene is simulated on another one a frame ahead
+    StartSimulation();
+    bool firstFrameReported = false;
+    bool benchmarkStarted = false;
+    const uint64_t warmupFrames = m_options.frameCount == 0 ? BENCHMARK_WARMUP_FRAMES :
+        std::min(BENCHMARK_WARMUP_FRAMES, m_options.frameCount / 4);
+    try
+    {
+        // Run until the window is closed or, when a frame count is given, until that many frames are submitted
+        while (m_options.frameCount == 0 || m_frameNumber < m_options.frameCount)
+        {
+            if (!m_options.headless)
+            {
+                if (glfwWindowShouldClose(m_window)) break;
+                glfwPollEvents();
+            }
+            if (!m_options.benchmarkFile.empty() && !benchmarkStarted && m_frameNumber == warmupFrames)
+            {
+                benchmarkStarted = true;
+                m_benchmarkStartFrame = m_frameTimes.size();
+                m_benchmarkStartTelemetry = m_telemetry.GetSnapshot();
+                m_benchmarkStartTime = m_profiler.Now();
+            }
+            auto frameStart = std::chrono::steady_clock::now();
+            DrawFrame();
+            if (IsFrameTimingRequested())
+            {
+                m_frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+            }
+            m_telemetry.EndFrame();
+            if (m_frameNumber == 1 && !firstFrameReported)
+            {
+                firstFrameReported = true;
+                m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0, "First frame %s %.2f ms after start",
+                    m_options.headless ? "submitted" : "presented", GetMillisecondsSinceStart());
+            }
+        }
+    }
+    catch (...)
     {
-        glfwPollEvents();
-        DrawFrame();
+        StopSimulation();
+        throw;
     }
+    StopSimulation();
 
     vkDeviceWaitIdle(m_device);
+    m_frameReadback.Flush();
+    if (m_captureWriter.IsOpen())
+    {
+        m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0, "Captured %u frames to %s",
+            m_captureWriter.GetFrameCount(), m_options.captureFile.c_str());
+        m_captureWriter.Close();
+    }
+    if (IsReplaying()) ReportReplayTimes();
+    if (m_framePacingEnabled) ReportFramePacing();
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) m_profiler.CollectGpuFrame(i);
+    if (!m_options.profileFile.empty())
+    {
+        m_profiler.WriteChromeTrace(m_options.profileFile);
+        m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0, "Wrote profile to %s", m_options.profileFile.c_str());
+    }
+    if (!m_options.benchmarkFile.empty())
+    {
+        WriteBenchmarkResults();
+        m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0, "Wrote benchmark results to %s", m_options.benchmarkFile.c_str());
+    }
 }
 
 void Application::Cleanup()
 {
     CleanupSwapChain();
 
-    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
-
-    vkDestroyBuffer(m_device, m_indexBuffer, nullptr);
-    vkFreeMemory(m_device, m_indexBufferMemory, nullptr);
-
-    vkDestroyBuffer(m_device, m_vertexBuffer, nullptr);
-    vkFreeMemory(m_device, m_vertexBufferMemory, nullptr);
+    m_particleSystem.Destroy();
+    if(m_meshletsEnabled) m_meshletRenderer.Destroy();
+    if(m_occlusionCullingEnabled) m_occlusionCuller.Destroy();
+    if(m_dynamicResolutionEnabled) m_dynamicResolution.Destroy();
+    m_frameReadback.Destroy();
+    m_textureStreamer.Destroy();
+    SavePipelineCache();
+    vkDestroyPipelineCache(m_device, m_pipelineCache, GetAllocationCallbacks());
+
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, GetAllocationCallbacks());
+
+    vkDestroyBuffer(m_device, m_indexBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_indexBufferMemory);
+
+    vkDestroyBuffer(m_device, m_vertexBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_vertexBufferMemory);
+
+    vkDestroyBuffer(m_device, m_objectBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_objectBufferMemory);
+    vkDestroyBuffer(m_device, m_drawListBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_drawListBufferMemory);
+    if(m_stressUploadBuffer != VK_NULL_HANDLE){
+        vkDestroyBuffer(m_device, m_stressStagingBuffer, GetAllocationCallbacks());
+        FreeMemory(m_device, m_stressStagingBufferMemory);
+        vkDestroyBuffer(m_device, m_stressUploadBuffer, GetAllocationCallbacks());
+        FreeMemory(m_device, m_stressUploadBufferMemory);
+    }
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(m_device, m_imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(m_device, m_inflightFences[i], nullptr);
+        vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], GetAllocationCallbacks());
+        vkDestroySemaphore(m_device, m_imageAvailableSemaphores[i], GetAllocationCallbacks());
+        vkDestroyFence(m_device, m_inflightFences[i], GetAllocationCallbacks());
     }
 
-    vkDestroyCommandPool(m_device, m_commandPool, nullptr);
-    vkDestroyDevice(m_device,nullptr);
+    ReleaseStagedUploads(true);
+    vkDestroyCommandPool(m_device, m_commandPool, GetAllocationCallbacks());
+    m_profiler.DestroyGpu();
+    // The last report, with every free of this application counted
+    m_telemetry.Close();
+    vkDestroyDevice(m_device,GetAllocationCallbacks());
 
     #if ENABLE_VALIDATION_LAYERS
-        DestroyDebugUtilsMessengerEXT(m_vkInstance, m_debugMessenger, nullptr);
+        DestroyDebugUtilsMessengerEXT(m_vkInstance, m_debugMessenger, GetAllocationCallbacks());
     #endif
 
-    vkDestroySurfaceKHR(m_vkInstance, m_surface, nullptr);
-    vkDestroyInstance(m_vkInstance, nullptr);
+    if(!m_options.headless) vkDestroySurfaceKHR(m_vkInstance, m_surface, GetAllocationCallbacks());
+    vkDestroyInstance(m_vkInstance, GetAllocationCallbacks());
+    ReportHostMemory();
+    GetHostAllocator().SetTelemetry(nullptr);
+    SetMemoryTelemetry(nullptr);
 
-    glfwDestroyWindow(m_window);
-    glfwTerminate();
+    if(!m_options.headless){
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+    }
 }
 
 void Application::CleanupSwapChain(){
-    for(auto& framebuffer: m_swapChainFramebuffers) vkDestroyFramebuffer(m_device, framebuffer, nullptr);
-    vkFreeCommandBuffers(m_device, m_commandPool, static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
-    vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
-    vkDestroyRenderPass(m_device, m_renderPass, nullptr);
-    for(auto& imageView: m_swapChainImageViews) vkDestroyImageView(m_device, imageView, nullptr);
-    vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
+    if(m_occlusionCullingEnabled) m_occlusionCuller.ReleasePyramid();
+    if(m_dynamicResolutionEnabled) m_dynamicResolution.ReleaseTargets();
+    m_renderGraph.Reset();
+    for(auto& framebuffer: m_swapChainFramebuffers) vkDestroyFramebuffer(m_device, framebuffer, GetAllocationCallbacks());
+    m_particleSystem.DestroyGraphicsPipeline();
+    if(m_meshletsEnabled) m_meshletRenderer.DestroyGraphicsPipeline();
+    for(auto& pipeline: m_graphicsPipelines) vkDestroyPipeline(m_device, pipeline, GetAllocationCallbacks());
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, GetAllocationCallbacks());
+    vkDestroyRenderPass(m_device, m_renderPass, GetAllocationCallbacks());
+    vkDestroyRenderPass(m_device, m_loadRenderPass, GetAllocationCallbacks());
+    m_loadRenderPass = VK_NULL_HANDLE;
+    for(size_t i = 0; i < m_depthImages.size(); i++){
+        vkDestroyImageView(m_device, m_depthImageViews[i], GetAllocationCallbacks());
+        vkDestroyImage(m_device, m_depthImages[i], GetAllocationCallbacks());
+        FreeMemory(m_device, m_depthImagesMemory[i]);
+    }
+    m_depthImages.clear();
+    m_depthImagesMemory.clear();
+    m_depthImageViews.clear();
+    for(size_t i = 0; i < m_sceneColorImages.size(); i++){
+        vkDestroyImageView(m_device, m_sceneColorImageViews[i], GetAllocationCallbacks());
+        vkDestroyImage(m_device, m_sceneColorImages[i], GetAllocationCallbacks());
+        FreeMemory(m_device, m_sceneColorImagesMemory[i]);
+    }
+    m_sceneColorImages.clear();
+    m_sceneColorImagesMemory.clear();
+    m_sceneColorImageViews.clear();
+    for(auto& imageView: m_swapChainImageViews) vkDestroyImageView(m_device, imageView, GetAllocationCallbacks());
+    if(m_options.headless){
+        for(auto& image: m_swapChainImages) vkDestroyImage(m_device, image, GetAllocationCallbacks());
+        for(auto& memory: m_offscreenImagesMemory) FreeMemory(m_device, memory);
+        m_offscreenImagesMemory.clear();
+    }else{
+        vkDestroySwapchainKHR(m_device, m_swapChain, GetAllocationCallbacks());
+    }
 
     for(size_t i = 0;i < m_swapChainImages.size(); i++){
-        vkDestroyBuffer(m_device, m_uniformBuffers[i], nullptr);
-        vkFreeMemory(m_device, m_uniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(m_device, m_uniformBuffers[i], GetAllocationCallbacks());
+        FreeMemory(m_device, m_uniformBuffersMemory[i]);
     }
+
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, GetAllocationCallbacks());
 }
 
 void Application::SetupDebugMassenger()
 {
+    PROFILE_ZONE(m_profiler, "SetupDebugMassenger");
     #if ENABLE_VALIDATION_LAYERS
         VkDebugUtilsMessengerCreateInfoEXT createInfo;
-        PopulateDebugMessengerCreateInfo(createInfo);
+        PopulateDebugMessengerCreateInfo(createInfo, &m_logger);
 
-        ThrowIfFailed(CreateDebugUtilsMessengerEXT(m_vkInstance, &createInfo, nullptr, &m_debugMessenger),
+        ThrowIfFailed(CreateDebugUtilsMessengerEXT(m_vkInstance, &createInfo, GetAllocationCallbacks(), &m_debugMessenger),
             "Failed to set up debug messenger!");
     #endif
 }
 
 void Application::CreateInstance()
 {
+    PROFILE_ZONE(m_profiler, "CreateInstance");
     // Informations about this application
     VkApplicationInfo appInfo = {};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -450,7 +855,7 @@ void Application::CreateInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_1;
+    appInfo.apiVersion = VK_API_VERSION_1_3;// Devices still need only 1.1, newer features are picked up when present
 
     // Informations about global extensions and validation layers we want to use
     VkInstanceCreateInfo createInfo = {};
@@ -464,18 +869,22 @@ void Application::CreateInstance()
         createInfo.ppEnabledLayerNames = g_validationLayers.data();
 
         // Create an additional debug messenger for vkCreateInstance and vkDestroyInstance and clean up after that
-        PopulateDebugMessengerCreateInfo(debugCreateInfo);
+        PopulateDebugMessengerCreateInfo(debugCreateInfo, &m_logger);
         createInfo.pNext = static_cast<VkDebugUtilsMessengerCreateInfoEXT*>(&debugCreateInfo);
     #endif
-    auto extensions = GetRequiredExtensions();
+    // Profiling labels the command buffers for captures taken with other tools as well
+    auto extensions = GetRequiredExtensions(m_options.headless, m_profiler.IsEnabled());
+    m_debugUtilsEnabled = std::find_if(extensions.begin(), extensions.end(),
+        [](const char* name){ return strcmp(name, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) == 0; }) != extensions.end();
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
     createInfo.ppEnabledExtensionNames = extensions.data();
 
     // Create Vulkan instance
-    ThrowIfFailed(vkCreateInstance(&createInfo, nullptr, &m_vkInstance), "Failed to create instance!");
+    ThrowIfFailed(vkCreateInstance(&createInfo, GetAllocationCallbacks(), &m_vkInstance), "Failed to create instance!");
 }
 
 void Application::PickPhysicalDevice(){
+    PROFILE_ZONE(m_profiler, "PickPhysicalDevice");
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(m_vkInstance, &deviceCount, nullptr);
     if(deviceCount == 0){
@@ -485,44 +894,156 @@ void Application::PickPhysicalDevice(){
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(m_vkInstance, &deviceCount, devices.data());
 
+    // An explicit option wins over the environment
+    std::string preferred = m_options.preferredDevice;
+    if(preferred.empty()){
+        const char* env = std::getenv("HELLOVULKAN_DEVICE");
+        if(env != nullptr) preferred = env;
+    }
+
+    uint64_t bestScore = 0;
     for(const auto& device:devices){
-        if(IsPhysicalDeviceSuitable(device)){
-            m_physicalDevice = device;
-            break;
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+        std::string rejectReason;
+        if(!preferred.empty() && !MatchesPreferredDevice(device, preferred)){
+            rejectReason = "does not match requested device \"" + preferred + "\"";
+        }else if(IsPhysicalDeviceSuitable(device, rejectReason)){
+            uint64_t score = RatePhysicalDevice(device);
+            m_logger.Print(LogSeverity::Info, LogCategory::Device, 0, "Candidate GPU: %s (score %llu)", deviceProperties.deviceName,
+                static_cast<unsigned long long>(score));
+
+            // Keep the first device on ties so the enumeration order breaks them
+            if(m_physicalDevice == VK_NULL_HANDLE || score > bestScore){
+                m_physicalDevice = device;
+                bestScore = score;
+            }
+            continue;
         }
+
+        m_logger.Print(LogSeverity::Info, LogCategory::Device, 0, "Rejected GPU: %s - %s", deviceProperties.deviceName, rejectReason.c_str());
     }
 
     if(m_physicalDevice == VK_NULL_HANDLE){
+        if(!preferred.empty()){
+            throw std::runtime_error("Requested GPU \"" + preferred + "\" was not found or is not suitable!");
+        }
         throw std::runtime_error("Failed to find a suitable GPU!");
     }
+
+    VkPhysicalDeviceProperties chosenProperties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &chosenProperties);
+    m_logger.Print(LogSeverity::Info, LogCategory::Device, 0, "Choose GPU: %s [%s]", chosenProperties.deviceName,
+        GetPhysicalDeviceUUID(m_physicalDevice).c_str());
+}
+
+bool Application::IsPhysicalDeviceSuitable(VkPhysicalDevice device, std::string& rejectReason){
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+    // vkGetPhysicalDeviceProperties2 and the rest of the 1.1 core are used unconditionally
+    if(deviceProperties.apiVersion < VK_API_VERSION_1_1){
+        rejectReason = "Vulkan 1.1 is not supported";
+        return false;
+    }
+
+    std::set<std::string> missingExtensions;
+    if(!CheckDeviceExtensionSupport(device, GetRequiredDeviceExtensions(), missingExtensions)){
+        rejectReason = "missing device extensions:";
+        for(const auto& extension: missingExtensions) rejectReason += " " + extension;
+        return false;
+    }
+
+    // The render graph records its barriers with vkCmdPipelineBarrier2
+    VkPhysicalDeviceSynchronization2Features synchronization2Features = {};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    if(deviceProperties.apiVersion >= VK_API_VERSION_1_3 || IsDeviceExtensionSupported(device, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)){
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &synchronization2Features;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+    }
+    if(!synchronization2Features.synchronization2){
+        rejectReason = "synchronization2 is not supported";
+        return false;
+    }
+
+    if(!m_options.headless){
+        auto swapChainDetails = QuerySwapChainSupport(device);
+        if(swapChainDetails.formats.empty() || swapChainDetails.presentModes.empty()){
+            rejectReason = "no surface formats or present modes for the window surface";
+            return false;
+        }
+    }
+
+    auto indices = FindQueueFamilies(device);
+    if(!indices.graphicsFamily.has_value()){
+        rejectReason = "no graphics queue family";
+        return false;
+    }
+    if(!indices.presentFamily.has_value()){
+        rejectReason = "no queue family can present to the window surface";
+        return false;
+    }
+
+    return true;
 }
 
-bool Application ::IsPhysicalDeviceSuitable(VkPhysicalDevice device){
+uint64_t Application::RatePhysicalDevice(VkPhysicalDevice device){
     VkPhysicalDeviceProperties deviceProperties;
     VkPhysicalDeviceFeatures deviceFeatures;
+    VkPhysicalDeviceMemoryProperties memProperties;
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
     vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
 
-    bool extensionSupported = CheckDeviceExtensionSupport(device);
+    uint64_t score = 0;
 
-    bool swapchainAdequate = false;
-    if(extensionSupported){
-        auto swapChainDetails = QuerySwapChainSupport(device);
-        swapchainAdequate = !swapChainDetails.formats.empty() && !swapChainDetails.presentModes.empty();
+    // Device type dominates: any real GPU beats a software rasterizer
+    switch(deviceProperties.deviceType){
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   score += 100000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 50000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    score += 25000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:            score += 10000; break;
+    default: break;
     }
 
-    bool result = 
-            deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-            deviceFeatures.geometryShader &&
-            FindQueueFamilies(device).IsComplete() &&
-            extensionSupported &&
-            swapchainAdequate;
+    // One point per 64 MiB of the largest device-local heap, capped at 256 GiB
+    VkDeviceSize largestLocalHeap = 0;
+    for(uint32_t i = 0; i < memProperties.memoryHeapCount; i++){
+        if(memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT){
+            largestLocalHeap = std::max(largestLocalHeap, memProperties.memoryHeaps[i].size);
+        }
+    }
+    score += std::min<uint64_t>(largestLocalHeap / (64ull << 20), 4096);
 
-    if(result){
-        std::cout << "Choose GPU: " << deviceProperties.deviceName << std::endl;
+    // Dedicated compute and transfer families let async work overlap graphics
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+    bool hasDedicatedCompute = false;
+    bool hasDedicatedTransfer = false;
+    for(const auto& queueFamily: queueFamilies){
+        auto flags = queueFamily.queueFlags;
+        if((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)){
+            hasDedicatedCompute = true;
+        }
+        if((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))){
+            hasDedicatedTransfer = true;
+        }
     }
+    if(hasDedicatedCompute) score += 2000;
+    if(hasDedicatedTransfer) score += 1000;
+
+    // Optional features we make use of when present
+    if(deviceFeatures.samplerAnisotropy) score += 500;
+    if(deviceFeatures.textureCompressionBC || deviceFeatures.textureCompressionASTC_LDR || deviceFeatures.textureCompressionETC2) score += 500;
+    if(deviceFeatures.multiDrawIndirect) score += 250;
+    if(deviceProperties.limits.timestampComputeAndGraphics) score += 250;
 
-    return result;
+    return score;
 }
 
 Application::QueueFamilyIndices Application::FindQueueFamilies(VkPhysicalDevice device){
@@ -533,38 +1054,70 @@ Application::QueueFamilyIndices Application::FindQueueFamilies(VkPhysicalDevice
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-    int i = 0;
-    for (const auto& queueFamily : queueFamilies) {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        const auto& queueFamily = queueFamilies[i];
+
+        if (!indices.graphicsFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
             indices.graphicsFamily = i;
         }
 
+        // Headless frames are never presented, the graphics family stands in for the present family
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+        if(m_options.headless){
+            presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+        }else{
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+        }
 
-        if(presentSupport){
+        // Presenting from the graphics family avoids sharing swap chain images between families
+        if(presentSupport && (!indices.presentFamily.has_value() || indices.graphicsFamily == i)){
             indices.presentFamily = i;
         }
 
-        if(indices.IsComplete()) break;
-        i++;
+        if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+            bool isDedicated = !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+            bool hasDedicated = indices.computeFamily.has_value() &&
+                !(queueFamilies[indices.computeFamily.value()].queueFlags & VK_QUEUE_GRAPHICS_BIT);
+            if (!indices.computeFamily.has_value() || (isDedicated && !hasDedicated)) {
+                indices.computeFamily = i;
+            }
+        }
     }
 
     return indices;
 }
 
 void Application::CreateLogicalDevice(){
+    PROFILE_ZONE(m_profiler, "CreateLogicalDevice");
+    SelectMeshletPath();
+    SelectOcclusionCulling();
+    SelectDynamicResolution();
+    SelectMultiview();
+    SelectRenderingPath();
+    SelectFramePacing();
     // Specify the queue information we actually need
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     QueueFamilyIndices indices = FindQueueFamilies(m_physicalDevice);
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
-    float queuePriority = 1.0;
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value()};
+
+    // Without a dedicated compute family, ask the graphics family for a second queue so compute work can still
+    // be scheduled independently. Devices exposing a single queue (e.g. lavapipe) share the graphics queue
+    uint32_t computeQueueIndex = 0;
+    if(indices.computeFamily == indices.graphicsFamily){
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+        if(queueFamilies[indices.computeFamily.value()].queueCount > 1) computeQueueIndex = 1;
+    }
+
+    float queuePriorities[] = {1.0f, 1.0f};
     for(uint32_t queueFamily: uniqueQueueFamilies){
         VkDeviceQueueCreateInfo queueCreateInfo = {};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount = queueFamily == indices.computeFamily.value() ? computeQueueIndex + 1 : 1;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
@@ -574,11 +1127,88 @@ void Application::CreateLogicalDevice(){
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     // Require features
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    deviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;// The texture sampler uses it when available
+    // Block-compressed textures are only sampled in formats the device reports support for
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+    deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+    // Meshlets culled by compute are drawn many to a call, each draw starting at the instance it belongs to
+    bool computeMeshlets = m_meshletsEnabled && m_meshletPath == MeshletRenderer::Path::Compute;
+    deviceFeatures.multiDrawIndirect = computeMeshlets;
+    // So do the draws of occlusion culling, at the list of their phase
+    deviceFeatures.drawIndirectFirstInstance = computeMeshlets || m_occlusionCullingEnabled;
     createInfo.pEnabledFeatures = &deviceFeatures;
-    // Require extensions
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(g_deviceEntensions.size());
-    createInfo.ppEnabledExtensionNames = g_deviceEntensions.data();
+    VkPhysicalDeviceSynchronization2Features synchronization2Features = {};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    synchronization2Features.synchronization2 = VK_TRUE;
+    createInfo.pNext = &synchronization2Features;
+    void** featuresChainEnd = &synchronization2Features.pNext;
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.drawIndirectCount = VK_TRUE;
+    if(m_drawIndirectCount){
+        *featuresChainEnd = &vulkan12Features;
+        featuresChainEnd = &vulkan12Features.pNext;
+    }
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures = {};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+    if(m_dynamicRenderingEnabled){
+        *featuresChainEnd = &dynamicRenderingFeatures;
+        featuresChainEnd = &dynamicRenderingFeatures.pNext;
+    }
+    VkPhysicalDeviceMultiviewFeatures multiviewFeatures = {};
+    multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+    multiviewFeatures.multiview = VK_TRUE;
+    if(m_multiviewEnabled){
+        *featuresChainEnd = &multiviewFeatures;
+        featuresChainEnd = &multiviewFeatures.pNext;
+    }
+    bool meshShaders = m_meshletsEnabled && m_meshletPath == MeshletRenderer::Path::MeshShader;
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    meshShaderFeatures.taskShader = VK_TRUE;
+    meshShaderFeatures.meshShader = VK_TRUE;
+    if(meshShaders){
+        *featuresChainEnd = &meshShaderFeatures;
+        featuresChainEnd = &meshShaderFeatures.pNext;
+    }
+    bool presentWait = m_framePacingEnabled && m_presentTimingSource == PresentTimingSource::PresentWait;
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.presentId = VK_TRUE;
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.presentWait = VK_TRUE;
+    if(presentWait){
+        *featuresChainEnd = &presentIdFeatures;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        featuresChainEnd = &presentWaitFeatures.pNext;
+    }
+    // Require extensions, synchronization2 and dynamic rendering are only extensions before Vulkan 1.3
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+    std::vector<const char*> extensions = GetRequiredDeviceExtensions();
+    if(deviceProperties.apiVersion < VK_API_VERSION_1_3){
+        extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        if(m_dynamicRenderingEnabled) extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    }
+    // Heap budget and usage for the telemetry when the driver reports them
+    bool memoryBudget = IsDeviceExtensionSupported(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if(memoryBudget) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if(meshShaders) extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    if(presentWait){
+        extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+    if(m_framePacingEnabled && m_presentTimingSource == PresentTimingSource::DisplayTiming){
+        extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
     // Require validation layers
     // Note: enabledLayerCount and ppEnabledLayerNames are deprecated by up-to-date implementations
     createInfo.enabledLayerCount = 0;
@@ -588,17 +1218,106 @@ void Application::CreateLogicalDevice(){
     #endif
 
     // Create logical device
-    ThrowIfFailed(vkCreateDevice(m_physicalDevice,&createInfo,nullptr,&m_device), 
+    ThrowIfFailed(vkCreateDevice(m_physicalDevice,&createInfo,GetAllocationCallbacks(),&m_device), 
         "Failed to create logical device!");
 
     // Retrieve queue handles
-    // Note: For each queue family, we only need one queue
     vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
+    vkGetDeviceQueue(m_device, indices.computeFamily.value(), computeQueueIndex, &m_computeQueue);
+
+    if(m_dynamicRenderingEnabled){
+        m_cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(vkGetDeviceProcAddr(m_device, "vkCmdBeginRendering"));
+        m_cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRendering>(vkGetDeviceProcAddr(m_device, "vkCmdEndRendering"));
+        if(m_cmdBeginRendering == nullptr || m_cmdEndRendering == nullptr){
+            m_cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(vkGetDeviceProcAddr(m_device, "vkCmdBeginRenderingKHR"));
+            m_cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRendering>(vkGetDeviceProcAddr(m_device, "vkCmdEndRenderingKHR"));
+        }
+        if(m_cmdBeginRendering == nullptr || m_cmdEndRendering == nullptr){
+            throw std::runtime_error("Failed to load vkCmdBeginRendering!");
+        }
+    }
+
+    m_telemetry.Create(m_physicalDevice, memoryBudget);
+}
+
+void Application::MountAssets(){
+    PROFILE_ZONE(m_profiler, "MountAssets");
+    // Be careful the working directory is the folder of the executable when you just run it, and the
+    // folder of CMakeLists.txt when you debug using CMake Tool in Vs code
+    m_fileSystem.MountDirectory(".");
+    // Later mounts shadow earlier ones
+    const std::string archiveExtension = ".pak";
+    for(const auto& mount: m_options.assetMounts){
+        if(mount.size() > archiveExtension.size() &&
+            mount.compare(mount.size() - archiveExtension.size(), archiveExtension.size(), archiveExtension) == 0){
+            m_fileSystem.Mount(std::make_unique<ArchiveMount>(mount, &m_ioThreadPool));
+        }else{
+            m_fileSystem.MountDirectory(mount);
+        }
+    }
+}
+
+void Application::CreatePipelineCache(){
+    PROFILE_ZONE(m_profiler, "CreatePipelineCache");
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    // The cache is written by this program rather than shipped, so it is mapped from its real path instead of
+    // being looked up through the mounts. It is dropped when another driver or device wrote it
+    std::unique_ptr<MappedFile> cacheFile;
+    if(!m_options.pipelineCacheFile.empty()){
+        try{
+            cacheFile = std::make_unique<MappedFile>(m_options.pipelineCacheFile);
+        }catch(const std::runtime_error&){
+            // No cache yet
+        }
+    }
+    if(cacheFile != nullptr && IsPipelineCacheCompatible(cacheFile->GetBytes())){
+        cacheInfo.initialDataSize = cacheFile->GetBytes().size;
+        cacheInfo.pInitialData = cacheFile->GetBytes().data;
+    }
+
+    ThrowIfFailed(vkCreatePipelineCache(m_device, &cacheInfo, GetAllocationCallbacks(), &m_pipelineCache),
+        "Failed to create pipeline cache!");
+}
+
+bool Application::IsPipelineCacheCompatible(ByteSpan data){
+    VkPipelineCacheHeaderVersionOne header;
+    if(data.size < sizeof(header)) return false;
+    memcpy(&header, data.data, sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+    return header.headerSize >= sizeof(header) &&
+        header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendorID == properties.vendorID &&
+        header.deviceID == properties.deviceID &&
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void Application::SavePipelineCache(){
+    if(m_options.pipelineCacheFile.empty()) return;
+
+    size_t dataSize = 0;
+    if(vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) return;
+    std::vector<char> data(dataSize);
+    if(vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data()) != VK_SUCCESS) return;
+
+    // A missing cache only costs startup time, so failing to write one is not an error
+    std::ofstream file(m_options.pipelineCacheFile, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(dataSize));
+    if(!file){
+        m_logger.Print(LogSeverity::Warning, LogCategory::General, 0, "Failed to write pipeline cache: %s", m_options.pipelineCacheFile.c_str());
+    }
 }
 
 void Application::CreateSurface(){
-    ThrowIfFailed(glfwCreateWindowSurface(m_vkInstance, m_window, nullptr, &m_surface),
+    PROFILE_ZONE(m_profiler, "CreateSurface");
+    if(m_options.headless) return;
+
+    ThrowIfFailed(glfwCreateWindowSurface(m_vkInstance, m_window, GetAllocationCallbacks(), &m_surface),
         "Failed to create window surface!");
 }
 
@@ -650,17 +1369,17 @@ VkPresentModeKHR Application::ChooseSwapChainPresentMode(const std::vector<VkPre
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+void Application::UpdateFramebufferSize(){
+    int width, height;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    m_framebufferSize = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+}
+
 VkExtent2D Application::ChooseSwapChainExtent(const VkSurfaceCapabilitiesKHR& capabilities){
     if(capabilities.currentExtent.width != UINT32_MAX){
         return capabilities.currentExtent;
     }else{
-        int width, height;
-        glfwGetFramebufferSize(m_window, &width, &height);
-
-        VkExtent2D actualExtent = {
-            static_cast<uint32_t>(width),
-            static_cast<uint32_t>(height)
-        };
+        VkExtent2D actualExtent = m_framebufferSize;
 
         actualExtent.width = Clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
         actualExtent.height = Clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
@@ -670,6 +1389,12 @@ VkExtent2D Application::ChooseSwapChainExtent(const VkSurfaceCapabilitiesKHR& ca
 }
 
 void Application::CreateSwapChain(){
+    PROFILE_ZONE(m_profiler, "CreateSwapChain");
+    if(m_options.headless){
+        CreateOffscreenImages();
+        return;
+    }
+
     auto swapChainDetails = QuerySwapChainSupport(m_physicalDevice);
 
     auto surfaceFormat = ChooseSwapChainSurfaceFormat(swapChainDetails.formats);
@@ -691,6 +1416,15 @@ void Application::CreateSwapChain(){
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;// Always 1 unless stereoscopic 3D application
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;// Directly render to these images
+    if(IsReadbackRequested()){
+        // Finished frames are copied out for the readback
+        if(!(swapChainDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)){
+            throw std::runtime_error("Swap chain images can not be copied from, frame readback is not available!");
+        }
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    // The scene color is upscaled or copied into them, SelectDynamicResolution and SelectMultiview made sure they can be
+    if(IsSceneColorUsed()) createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
     // We'll be drawing on the images in the swap chain from the graphics queue and then submitting 
     // them on the presentation queue
@@ -718,7 +1452,7 @@ void Application::CreateSwapChain(){
     // Stop all rendering before a new swap chain is created
     createInfo.oldSwapchain = VK_NULL_HANDLE;
 
-    ThrowIfFailed(vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapChain),
+    ThrowIfFailed(vkCreateSwapchainKHR(m_device, &createInfo, GetAllocationCallbacks(), &m_swapChain),
         "Failed to create swap chain!");
 
     // Access these images in the swap chain
@@ -728,9 +1462,81 @@ void Application::CreateSwapChain(){
 
     m_swapChainImageFormat = surfaceFormat.format;
     m_swapChainExtent = extent;
+    m_mainPassExtent = m_multiview.GetViewExtent(extent);
+    m_viewExtent.store(m_mainPassExtent);
+}
+
+void Application::CreateOffscreenImages(){
+    PROFILE_ZONE(m_profiler, "CreateOffscreenImages");
+    // Stand-ins for the swap chain images, one per frame in flight
+    m_swapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    m_swapChainExtent = {m_options.width, m_options.height};
+    m_mainPassExtent = m_multiview.GetViewExtent(m_swapChainExtent);
+    m_viewExtent.store(m_mainPassExtent);
+    m_swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+    m_offscreenImagesMemory.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for(size_t i = 0; i < m_swapChainImages.size(); i++){
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = m_swapChainImageFormat;
+        imageInfo.extent = {m_swapChainExtent.width, m_swapChainExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        if(IsSceneColorUsed()) imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        ThrowIfFailed(vkCreateImage(m_device, &imageInfo, GetAllocationCallbacks(), &m_swapChainImages[i]),
+            "Failed to create offscreen image!");
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_device, m_swapChainImages[i], &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        ThrowIfFailed(AllocateMemory(m_device, allocInfo, m_offscreenImagesMemory[i]),
+            "Failed to allocate offscreen image memory!");
+
+        vkBindImageMemory(m_device, m_swapChainImages[i], m_offscreenImagesMemory[i], 0);
+    }
+}
+
+std::vector<const char*> Application::GetRequiredDeviceExtensions() const{
+    if(m_options.headless) return {};// Nothing is presented
+    return std::vector<const char*>(g_deviceEntensions.begin(), g_deviceEntensions.end());
+}
+
+bool Application::IsReadbackRequested() const{
+    return m_options.readbackFormat != ReadbackFormat::None || m_readbackCallback != nullptr;
+}
+
+void Application::CreateFrameReadback(){
+    PROFILE_ZONE(m_profiler, "CreateFrameReadback");
+    if(!IsReadbackRequested()) return;
+
+    std::unique_ptr<ReadbackSink> sink;
+    if(m_readbackCallback != nullptr){
+        sink = std::make_unique<CallbackSink>(m_readbackCallback);
+    }else if(m_options.readbackFormat == ReadbackFormat::Png){
+        sink = std::make_unique<PngFileSink>(m_options.readbackDirectory);
+    }else{
+        sink = std::make_unique<RawFileSink>(m_options.readbackDirectory);
+    }
+
+    m_frameReadback.Create(m_physicalDevice, m_device, m_swapChainExtent, m_swapChainImageFormat,
+        m_options.readbackRingSize, std::move(sink));
 }
 
 void Application::CreateImageViews(){
+    PROFILE_ZONE(m_profiler, "CreateImageViews");
     m_swapChainImageViews.resize(m_swapChainImages.size());
 
     for(size_t i = 0; i < m_swapChainImages.size(); i++){
@@ -749,12 +1555,138 @@ void Application::CreateImageViews(){
         createInfo.subresourceRange.baseArrayLayer = 0;// Without any multiple layers
         createInfo.subresourceRange.layerCount = 1;
 
-        ThrowIfFailed(vkCreateImageView(m_device, &createInfo, nullptr, &m_swapChainImageViews[i]),
+        ThrowIfFailed(vkCreateImageView(m_device, &createInfo, GetAllocationCallbacks(), &m_swapChainImageViews[i]),
             "Failed to create image views!");
     }
 }
 
+VkFormat Application::FindDepthFormat(){
+    // Depth only, the depth pyramid is reduced from the sampled depth
+    const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM};
+    const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    for(VkFormat format: candidates){
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+        if((properties.optimalTilingFeatures & features) == features) return format;
+    }
+    throw std::runtime_error("Failed to find a supported depth format!");
+}
+
+void Application::CreateDepthResources(){
+    PROFILE_ZONE(m_profiler, "CreateDepthResources");
+    m_depthFormat = FindDepthFormat();
+    m_depthImages.resize(m_swapChainImages.size());
+    m_depthImagesMemory.resize(m_swapChainImages.size());
+    m_depthImageViews.resize(m_swapChainImages.size());
+
+    // One per swap chain image like the framebuffers, so frames in flight never share one. A layer per view
+    const uint32_t layerCount = m_multiview.GetViewCount();
+    for(size_t i = 0; i < m_depthImages.size(); i++){
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = m_depthFormat;
+        imageInfo.extent = {m_mainPassExtent.width, m_mainPassExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = layerCount;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        ThrowIfFailed(vkCreateImage(m_device, &imageInfo, GetAllocationCallbacks(), &m_depthImages[i]),
+            "Failed to create depth image!");
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_device, m_depthImages[i], &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        ThrowIfFailed(AllocateMemory(m_device, allocInfo, m_depthImagesMemory[i]),
+            "Failed to allocate depth image memory!");
+
+        vkBindImageMemory(m_device, m_depthImages[i], m_depthImagesMemory[i], 0);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_depthImages[i];
+        viewInfo.viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = m_depthFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = layerCount;
+
+        ThrowIfFailed(vkCreateImageView(m_device, &viewInfo, GetAllocationCallbacks(), &m_depthImageViews[i]),
+            "Failed to create depth image view!");
+    }
+}
+
+void Application::CreateSceneColorResources(){
+    PROFILE_ZONE(m_profiler, "CreateSceneColorResources");
+    if(!IsSceneColorUsed()) return;
+    m_sceneColorImages.resize(m_swapChainImages.size());
+    m_sceneColorImagesMemory.resize(m_swapChainImages.size());
+    m_sceneColorImageViews.resize(m_swapChainImages.size());
+
+    // Drawn into, then blitted from or sampled by the upscale pass, or copied from tile by tile with multiview. Of the
+    // full main pass extent so a change of scale never recreates them
+    const uint32_t layerCount = m_multiview.GetViewCount();
+    for(size_t i = 0; i < m_sceneColorImages.size(); i++){
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = m_swapChainImageFormat;
+        imageInfo.extent = {m_mainPassExtent.width, m_mainPassExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = layerCount;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        ThrowIfFailed(vkCreateImage(m_device, &imageInfo, GetAllocationCallbacks(), &m_sceneColorImages[i]),
+            "Failed to create scene color image!");
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_device, m_sceneColorImages[i], &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        ThrowIfFailed(AllocateMemory(m_device, allocInfo, m_sceneColorImagesMemory[i]),
+            "Failed to allocate scene color image memory!");
+
+        vkBindImageMemory(m_device, m_sceneColorImages[i], m_sceneColorImagesMemory[i], 0);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_sceneColorImages[i];
+        viewInfo.viewType = layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = m_swapChainImageFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = layerCount;
+
+        ThrowIfFailed(vkCreateImageView(m_device, &viewInfo, GetAllocationCallbacks(), &m_sceneColorImageViews[i]),
+            "Failed to create scene color image view!");
+    }
+}
+
 void Application::CreateRenderPass(){
+    PROFILE_ZONE(m_profiler, "CreateRenderPass");
+    // The attachments are described when the pass begins instead, see RecordMainPass
+    if(m_dynamicRenderingEnabled) return;
     // A render pass could be considerd as a wrapper of resources and operations, where resources are attachments 
     // and operations are subpass
     VkAttachmentDescription colorAttachment = {};
@@ -764,40 +1696,68 @@ void Application::CreateRenderPass(){
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // The render graph moves the image in and out of the attachment layout with its own barriers
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // Cleared every frame. It is only read back within the frame, by the depth pyramid
+    VkAttachmentDescription depthAttachment = {};
+    depthAttachment.format = m_depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = m_occlusionCullingEnabled ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef = {};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkAttachmentReference depthAttachmentRef = {};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkSubpassDescription subPass = {};
     subPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subPass.colorAttachmentCount = 1;
     subPass.pColorAttachments = &colorAttachmentRef;
+    subPass.pDepthStencilAttachment = &depthAttachmentRef;
 
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
+    VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = 2;
+    renderPassInfo.pAttachments = attachments;
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subPass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = 0;// Synchronization with the rest of the frame comes from the render graph
+    // With multiview the subpass draws every view, each into the attachment layer of its index. The eyes of stereo
+    // see nearly the same, implementations may render them together
+    uint32_t viewMask = m_multiview.GetViewMask();
+    VkRenderPassMultiviewCreateInfo multiviewInfo = {};
+    multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+    multiviewInfo.subpassCount = 1;
+    multiviewInfo.pViewMasks = &viewMask;
+    multiviewInfo.correlationMaskCount = m_multiview.GetMode() == MultiviewMode::Stereo ? 1 : 0;
+    multiviewInfo.pCorrelationMasks = &viewMask;
+    if(m_multiviewEnabled) renderPassInfo.pNext = &multiviewInfo;
+
+    ThrowIfFailed(vkCreateRenderPass(m_device, &renderPassInfo, GetAllocationCallbacks(), &m_renderPass),
+        "Failed to create render pass!");
 
-    ThrowIfFailed(vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass),
+    // The late phase of occlusion culling draws on top of the early one. Only the load operations differ, so the
+    // pipelines and framebuffers of m_renderPass are compatible with it
+    if(!m_occlusionCullingEnabled) return;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    ThrowIfFailed(vkCreateRenderPass(m_device, &renderPassInfo, GetAllocationCallbacks(), &m_loadRenderPass),
         "Failed to create render pass!");
 }
 
 void Application::CreateDescriptorSetLayout(){
+    PROFILE_ZONE(m_profiler, "CreateDescriptorSetLayout");
     VkDescriptorSetLayoutBinding uboLayoutBinding = {};
     uboLayoutBinding.binding = 0;
     uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -805,25 +1765,181 @@ void Application::CreateDescriptorSetLayout(){
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
 
+    // Meshlets and occluded objects are culled against the matrices and draw list before the vertex stage, and mesh
+    // shaders transform the vertices themselves
+    VkShaderStageFlags cullingStages = 0;
+    if((m_meshletsEnabled && m_meshletPath == MeshletRenderer::Path::Compute) || m_occlusionCullingEnabled){
+        cullingStages = VK_SHADER_STAGE_COMPUTE_BIT;
+    }else if(m_meshletsEnabled){
+        cullingStages = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+        uboLayoutBinding.stageFlags |= VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+
+    VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
+    samplerLayoutBinding.binding = 1;
+    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    samplerLayoutBinding.pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+    objectLayoutBinding.binding = 2;
+    objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    objectLayoutBinding.descriptorCount = 1;
+    objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | cullingStages;
+    objectLayoutBinding.pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutBinding drawListLayoutBinding = objectLayoutBinding;
+    drawListLayoutBinding.binding = 3;
+
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings = {uboLayoutBinding, samplerLayoutBinding, objectLayoutBinding, drawListLayoutBinding};
     VkDescriptorSetLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
 
-    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout),
+    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &layoutInfo, GetAllocationCallbacks(), &m_descriptorSetLayout),
         "Failed to create descriptor set layout!");
 }
 
-void Application::CreateGraphicsPipeline(){
-    // Programmable shader stages
-    auto vertShaderCode = ReadFile("shaders/vert.spv");
-    auto fragShaderCode = ReadFile("shaders/frag.spv");
+void Application::CreateDescriptorPool(){
+    PROFILE_ZONE(m_profiler, "CreateDescriptorPool");
+    std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(m_swapChainImages.size());
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(m_swapChainImages.size());
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[2].descriptorCount = static_cast<uint32_t>(m_swapChainImages.size()) * 2;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = static_cast<uint32_t>(m_swapChainImages.size());
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_descriptorPool),
+        "Failed to create descriptor pool!");
+}
 
-    VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+void Application::CreateDescriptorSets(){
+    PROFILE_ZONE(m_profiler, "CreateDescriptorSets");
+    // One set per swap chain image, each pointing at the uniform buffer of that image
+    std::vector<VkDescriptorSetLayout> layouts(m_swapChainImages.size(), m_descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(m_swapChainImages.size());
+    allocInfo.pSetLayouts = layouts.data();
 
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    m_descriptorSets.resize(m_swapChainImages.size());
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()),
+        "Failed to allocate descriptor sets!");
+
+    for(size_t i = 0; i < m_swapChainImages.size(); i++){
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer = m_uniformBuffers[i];
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(UniformBufferObject);
+
+        // The region of one frame packet, the dynamic offset picks which
+        VkDescriptorBufferInfo objectBufferInfo = {};
+        objectBufferInfo.buffer = m_objectBuffer;
+        objectBufferInfo.offset = 0;
+        objectBufferInfo.range = sizeof(glm::mat4) * m_scene.GetObjectCount();
+
+        VkDescriptorBufferInfo drawListBufferInfo = {};
+        drawListBufferInfo.buffer = m_drawListBuffer;
+        drawListBufferInfo.offset = 0;
+        drawListBufferInfo.range = sizeof(uint32_t) * m_scene.GetObjectCount() * (m_occlusionCullingEnabled ? 3 : 1);
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = m_descriptorSets[i];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = m_descriptorSets[i];
+        descriptorWrites[1].dstBinding = 2;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pBufferInfo = &objectBufferInfo;
+
+        descriptorWrites[2] = descriptorWrites[1];
+        descriptorWrites[2].dstBinding = 3;
+        descriptorWrites[2].pBufferInfo = &drawListBufferInfo;
+
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        m_telemetry.Count(TelemetryCounter::DescriptorWrites, descriptorWrites.size());
+    }
+
+    // The texture binding is written when the set is first used, see UpdateTextureDescriptor
+    m_descriptorTextureGenerations.assign(m_swapChainImages.size(), UINT64_MAX);
+}
+
+void Application::UpdateTextureDescriptor(uint32_t imageIndex){
+    // Only called once the fence of the last frame using this set was waited on
+    if(m_descriptorTextureGenerations[imageIndex] == m_textureStreamer.GetGeneration()) return;
+
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = m_textureStreamer.GetImageView(m_texture);
+    imageInfo.sampler = m_textureStreamer.GetSampler();
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_descriptorSets[imageIndex];
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+    m_telemetry.Count(TelemetryCounter::DescriptorWrites);
+    m_descriptorTextureGenerations[imageIndex] = m_textureStreamer.GetGeneration();
+}
+
+void Application::CreateTextures(){
+    PROFILE_ZONE(m_profiler, "CreateTextures");
+    m_textureStreamer.Create(m_physicalDevice, m_device, MAX_FRAMES_IN_FLIGHT,
+        static_cast<VkDeviceSize>(m_options.textureBudgetMB) * 1024 * 1024);
+    std::shared_ptr<TextureSource> source;
+    if(m_options.texture.empty()){
+        source = std::make_shared<CheckerboardTextureSource>(4096, 16);
+    }else if(IsReplaying()){
+        // The reader keeps the captured file alive until the application is destroyed
+        const std::vector<uint8_t>& data = m_captureReader.GetResources().textureData;
+        source = std::make_shared<Ktx2TextureSource>(Asset({data.data(), data.size()}, nullptr), m_physicalDevice, m_ioThreadPool);
+    }else{
+        // Supercompressed levels decode on the I/O threads while the first frames render
+        source = std::make_shared<Ktx2TextureSource>(m_fileSystem.Open(m_options.texture), m_physicalDevice, m_ioThreadPool);
+    }
+    m_texture = m_textureStreamer.AddTexture(source);
+}
+
+void Application::LoadShaders(){
+    PROFILE_ZONE(m_profiler, "LoadShaders");
+    m_vertShaderCode = m_fileSystem.Open("shaders/vert.spv");
+    m_fragShaderCode = m_fileSystem.Open("shaders/frag.spv");
+    // Whether the device supports multiview is not known yet
+    if(m_options.multiview != MultiviewMode::Off) m_multiviewVertShaderCode = m_fileSystem.Open("shaders/vert_multiview.spv");
+}
+
+void Application::CreateGraphicsPipeline(){
+    PROFILE_ZONE(m_profiler, "CreateGraphicsPipeline");
+    // Programmable shader stages
+    VkShaderModule vertShaderModule = CreateShaderModule(m_multiviewEnabled ? m_multiviewVertShaderCode.GetBytes() :
+        m_vertShaderCode.GetBytes());
+    VkShaderModule fragShaderModule = CreateShaderModule(m_fragShaderCode.GetBytes());
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertShaderStageInfo.module = vertShaderModule;
     vertShaderStageInfo.pName = "main";
@@ -852,37 +1968,17 @@ void Application::CreateGraphicsPipeline(){
     inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-    // Viewport and scissors
-    VkViewport viewport = {};// Scale after everything is projected
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(m_swapChainExtent.width);
-    viewport.height = static_cast<float>(m_swapChainExtent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    VkRect2D scissor = {};// Clip a rectangle(pixels) inside the viewport
-    scissor.offset = {0, 0};
-    scissor.extent = m_swapChainExtent;
+    // Viewport and scissors, set when the main pass begins since the size it draws at may change every frame
     VkPipelineViewportStateCreateInfo viewportInfo = {};
     viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportInfo.viewportCount = 1;
-    viewportInfo.pViewports = &viewport;
     viewportInfo.scissorCount = 1;
-    viewportInfo.pScissors = &scissor;
 
     // Rasterizer
-    VkPipelineRasterizationStateCreateInfo rasterizerInfo = {};
-    rasterizerInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizerInfo.depthClampEnable = VK_FALSE;
-    rasterizerInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterizerInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizerInfo.lineWidth = 1.0f;
-    rasterizerInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizerInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizerInfo.depthBiasEnable = VK_FALSE;
-    rasterizerInfo.depthBiasConstantFactor = 0.0f;
-    rasterizerInfo.depthBiasClamp = 0.0f;
-    rasterizerInfo.depthBiasSlopeFactor = 0.0f;
+    VkPipelineRasterizationStateCreateInfo rasterizerInfo = GetSceneRasterizerInfo();
+
+    // Depth test
+    VkPipelineDepthStencilStateCreateInfo depthStencilInfo = GetSceneDepthStencilInfo();
 
     // Multisampling
     VkPipelineMultisampleStateCreateInfo multisamplingInfo = {};
@@ -928,7 +2024,7 @@ void Application::CreateGraphicsPipeline(){
     pipelineLayoutInfo.pushConstantRangeCount = 0;
     pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
-    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout),
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, GetAllocationCallbacks(), &m_pipelineLayout),
         "Failed to create pipeline layout!");
 
     // Finally, the graphics pipeline itself
@@ -941,131 +2037,355 @@ void Application::CreateGraphicsPipeline(){
     pipelineInfo.pViewportState = &viewportInfo;
     pipelineInfo.pRasterizationState = &rasterizerInfo;
     pipelineInfo.pMultisampleState = &multisamplingInfo;
-    pipelineInfo.pDepthStencilState = nullptr;
+    pipelineInfo.pDepthStencilState = &depthStencilInfo;
     pipelineInfo.pColorBlendState = &colorBlendInfo;
-    pipelineInfo.pDynamicState = nullptr;
+    pipelineInfo.pDynamicState = &GetViewportDynamicState();
     pipelineInfo.layout = m_pipelineLayout;
-    pipelineInfo.renderPass = m_renderPass;
-    pipelineInfo.subpass = 0;
+    RenderTarget target = GetMainPassTarget();
+    VkPipelineRenderingCreateInfo renderingInfo;
+    SetPipelineTarget(pipelineInfo, target, renderingInfo);
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex = -1;
 
-    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline),
-        "Failed to create graphics pipelines!");
+    // Stress scenes spread their objects over copies of the pipeline, each one a separate object to bind
+    std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos(m_options.stress.pipelineCount, pipelineInfo);
+    m_graphicsPipelines.resize(pipelineInfos.size());
+    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, m_pipelineCache, static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(),
+        GetAllocationCallbacks(), m_graphicsPipelines.data()), "Failed to create graphics pipelines!");
+    m_drawPipelines.clear();
+    for(VkPipeline pipeline: m_graphicsPipelines) m_drawPipelines.push_back({pipeline, m_pipelineLayout});
 
-    vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
+    vkDestroyShaderModule(m_device, fragShaderModule, GetAllocationCallbacks());
+    vkDestroyShaderModule(m_device, vertShaderModule, GetAllocationCallbacks());
 }
 
-VkShaderModule Application::CreateShaderModule(const std::vector<char>& code){
-    VkShaderModuleCreateInfo createInfo = {};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-    VkShaderModule shaderModule;
-    ThrowIfFailed(vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule),
-        "Failed to create shader module!");
-
-    return shaderModule;
+VkShaderModule Application::CreateShaderModule(ByteSpan code){
+    return ::CreateShaderModule(m_device, code);
 }
 
 void Application::CreateFramebuffers(){
+    PROFILE_ZONE(m_profiler, "CreateFramebuffers");
+    m_swapChainFramebuffers.clear();
+    if(m_dynamicRenderingEnabled) return;
     m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
 
     for(size_t i = 0; i < m_swapChainImageViews.size(); i++){
-        VkImageView attachments[] = { m_swapChainImageViews[i]};
+        VkImageView colorView = IsSceneColorUsed() ? m_sceneColorImageViews[i] : m_swapChainImageViews[i];
+        VkImageView attachments[] = { colorView, m_depthImageViews[i]};
 
         VkFramebufferCreateInfo framebufferInfo = {};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferInfo.renderPass = m_renderPass;
-        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.attachmentCount = 2;
         framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = m_swapChainExtent.width;
-        framebufferInfo.height = m_swapChainExtent.height;
-        framebufferInfo.layers = 1;
+        framebufferInfo.width = m_mainPassExtent.width;
+        framebufferInfo.height = m_mainPassExtent.height;
+        framebufferInfo.layers = 1;// Multiview picks the layers by the view masks of the render pass
 
-        ThrowIfFailed(vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &m_swapChainFramebuffers[i]),
+        ThrowIfFailed(vkCreateFramebuffer(m_device, &framebufferInfo, GetAllocationCallbacks(), &m_swapChainFramebuffers[i]),
             "Failed to create framebuffer!");
     }
 }
 
+void Application::SelectRenderingPath(){
+    if(!m_options.dynamicRendering) return;
+    if(!IsDynamicRenderingSupported(m_physicalDevice)){
+        m_logger.Print(LogSeverity::Info, LogCategory::General, 0, "Dynamic rendering is not supported, drawing with render passes");
+        return;
+    }
+    m_dynamicRenderingEnabled = true;
+}
+
+bool Application::IsDynamicRenderingSupported(VkPhysicalDevice device){
+    // Core in Vulkan 1.3. The extension depends on depth stencil resolves and render pass 2, both core in 1.2
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if(deviceProperties.apiVersion < VK_API_VERSION_1_3){
+        if(deviceProperties.apiVersion < VK_API_VERSION_1_2) return false;
+        if(!IsDeviceExtensionSupported(device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) return false;
+    }
+
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures = {};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &dynamicRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    return dynamicRenderingFeatures.dynamicRendering;
+}
+
+RenderTarget Application::GetMainPassTarget() const{
+    RenderTarget target;
+    target.renderPass = m_renderPass;
+    target.colorFormat = m_swapChainImageFormat;
+    target.depthFormat = m_depthFormat;
+    if(m_multiviewEnabled) target.viewMask = m_multiview.GetViewMask();
+    return target;
+}
+
 void Application::CreateCommandPool(){
+    PROFILE_ZONE(m_profiler, "CreateCommandPool");
     auto queueFamilyIndices = FindQueueFamilies(m_physicalDevice);
 
     VkCommandPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-    poolInfo.flags = 0;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;// Command buffers are re-recorded every frame
 
-    ThrowIfFailed(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool),
+    ThrowIfFailed(vkCreateCommandPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_commandPool),
         "Failed to create command pool!");
 }
 
 uint32_t Application::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertices){
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+    return ::FindMemoryType(m_physicalDevice, typeFilter, propertices);
+}
+
+void Application::CreateVertexBuffer(){
+    PROFILE_ZONE(m_profiler, "CreateVertexBuffer");
+    ByteSpan vertexData = GetVertexData();
+    VkDeviceSize bufferSize = vertexData.size;
+
+    // Mesh shaders fetch the vertices themselves
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    if(m_meshletsEnabled && m_meshletPath == MeshletRenderer::Path::MeshShader) usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    CreateBuffer(bufferSize, usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_vertexBuffer, m_vertexBufferMemory);
+    StageBufferUpload(vertexData.data, bufferSize, m_vertexBuffer);
+}
 
-    // typeFilter is a bitfield of which a bit represents a MemoryType that is supported by this resource
-    for(uint32_t i = 0; i < memProperties.memoryTypeCount; i++){
-        if((typeFilter & (1 << i)) && // So we first check if the MemoryType is supported
-            (memProperties.memoryTypes[i].propertyFlags & propertices) == propertices){// And then check there are our wanted properties
-            return i;
+void Application::CreateIndexBuffer(){
+    PROFILE_ZONE(m_profiler, "CreateIndexBuffer");
+    ByteSpan indexData = GetIndexData();
+    VkDeviceSize bufferSize = indexData.size;
+    m_indexCount = static_cast<uint32_t>(indexData.size / sizeof(uint16_t));
+
+    // Meshlets are drawn as ranges of the index buffer, so it holds the triangles one meshlet after another. The
+    // whole mesh draws the same either way
+    std::vector<uint16_t> meshletIndices;
+    if(m_meshletsEnabled){
+        ByteSpan vertexData = GetVertexData();
+        std::vector<glm::vec3> positions(vertexData.size / sizeof(Vertex));
+        for(size_t i = 0; i < positions.size(); i++){
+            Vertex vertex;
+            memcpy(&vertex, vertexData.data + sizeof(Vertex) * i, sizeof(Vertex));
+            positions[i] = glm::vec3(vertex.Pos, 0.0f);
         }
+        std::vector<uint32_t> indices(m_indexCount);
+        for(uint32_t i = 0; i < m_indexCount; i++){
+            uint16_t index;
+            memcpy(&index, indexData.data + sizeof(uint16_t) * i, sizeof(uint16_t));
+            indices[i] = index;
+        }
+        m_meshletMesh = BuildMeshlets(&positions[0].x, sizeof(glm::vec3), positions.size(), indices.data(), indices.size());
+        for(uint32_t index: m_meshletMesh.GetIndices()) meshletIndices.push_back(static_cast<uint16_t>(index));
+        indexData = {reinterpret_cast<const uint8_t*>(meshletIndices.data()), sizeof(uint16_t) * meshletIndices.size()};
     }
 
-    throw std::runtime_error("Failed to find suitable memory type!");
+    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_indexBuffer, m_indexBufferMemory);
+    StageBufferUpload(indexData.data, bufferSize, m_indexBuffer);
 }
 
-void Application::CreateVertexBuffer(){
-    VkDeviceSize bufferSize = sizeof(g_vertices[0]) * g_vertices.size();
-    
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
+void Application::SelectMeshletPath(){
+    if(m_options.meshlets == MeshletMode::Off) return;
+    bool meshShader = MeshletRenderer::IsSupported(m_physicalDevice, MeshletRenderer::Path::MeshShader);
+    bool compute = MeshletRenderer::IsSupported(m_physicalDevice, MeshletRenderer::Path::Compute);
+    if(m_options.meshlets != MeshletMode::Compute && meshShader){
+        m_meshletPath = MeshletRenderer::Path::MeshShader;
+    }else if(compute){
+        m_meshletPath = MeshletRenderer::Path::Compute;
+        if(m_options.meshlets == MeshletMode::MeshShader){
+            m_logger.Print(LogSeverity::Warning, LogCategory::General, 0, "Mesh shaders are not supported, culling meshlets in a compute pass");
+        }
+    }else{
+        if(m_options.meshlets != MeshletMode::Auto){
+            m_logger.Print(LogSeverity::Warning, LogCategory::General, 0, "Meshlets are not supported, drawing whole meshes");
+        }
+        return;
+    }
+    m_meshletsEnabled = true;
+    m_drawIndirectCount = m_meshletPath == MeshletRenderer::Path::Compute && MeshletRenderer::IsDrawIndirectCountSupported(m_physicalDevice);
+}
 
-    void* data;
-    vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, g_vertices.data(), static_cast<size_t>(bufferSize));
-    vkUnmapMemory(m_device, stagingBufferMemory);
+void Application::CreateMeshletRenderer(){
+    PROFILE_ZONE(m_profiler, "CreateMeshletRenderer");
+    m_meshletRenderer.Create(m_physicalDevice, m_device, m_meshletPath, m_drawIndirectCount, m_meshletMesh, m_vertexBuffer,
+        sizeof(Vertex), m_descriptorSetLayout, m_scene.GetObjectCount(), MAX_FRAMES_IN_FLIGHT, GetSceneRasterizerInfo().frontFace,
+        m_fileSystem, m_pipelineCache, [this](const void* data, VkDeviceSize size, VkBuffer buffer){
+            StageBufferUpload(data, size, buffer);
+        });
+}
 
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_vertexBuffer, m_vertexBufferMemory);
-    
-    CopyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
+MeshletRenderer::View Application::GetMeshletView() const{
+    const FramePacket& packet = m_framePackets[m_currentFramePacket];
+    MeshletRenderer::View view;
+    view.viewProjection = packet.projection * packet.view;
+    view.cameraPosition = glm::vec3(glm::inverse(packet.view)[3]);
+    return view;
+}
 
-    vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-    vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+uint32_t Application::GetDrawListInstanceCount() const{
+    const DrawListBuilder::Result& drawList = m_framePackets[m_currentFramePacket].drawList;
+    uint32_t count = 0;
+    for(uint32_t lod = 0; lod < DrawListBuilder::MAX_LOD_COUNT; lod++){
+        if(drawList.lodCount[lod] > 0) count = std::max(count, drawList.lodFirst[lod] + drawList.lodCount[lod]);
+    }
+    return count;
 }
 
-void Application::CreateIndexBuffer(){
-    VkDeviceSize bufferSize = sizeof(g_indices[0]) * g_indices.size();
+void Application::SelectOcclusionCulling(){
+    if(!m_options.occlusionCulling) return;
+    if(m_meshletsEnabled){
+        m_logger.Print(LogSeverity::Warning, LogCategory::General, 0, "Occlusion culling is not combined with meshlets, drawing without it");
+        return;
+    }
+    if(!OcclusionCuller::IsSupported(m_physicalDevice)){
+        m_logger.Print(LogSeverity::Warning, LogCategory::General, 0, "Occlusion culling is not supported, drawing without it");
+        return;
+    }
+    m_occlusionCullingEnabled = true;
+}
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-        stagingBuffer, stagingBufferMemory);
+void Application::CreateOcclusionCuller(){
+    PROFILE_ZONE(m_profiler, "CreateOcclusionCuller");
+    m_occlusionCuller.Create(m_physicalDevice, m_device, m_descriptorSetLayout, m_scene.GetBoundingRadii(), m_scene.GetObjectCount(),
+        m_indexCount, MAX_FRAMES_IN_FLIGHT, m_fileSystem, m_pipelineCache, [this](const void* data, VkDeviceSize size, VkBuffer buffer){
+            StageBufferUpload(data, size, buffer);
+        });
+}
 
-    void* data;
-    vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, g_indices.data(), static_cast<size_t>(bufferSize));
-    vkUnmapMemory(m_device, stagingBufferMemory);
+void Application::SelectDynamicResolution(){
+    if(m_options.gpuBudgetMs <= 0.0f) return;
+    // The depth pyramid covers the whole depth buffer, not the part drawn at a lower resolution
+    if(m_occlusionCullingEnabled){
+        m_logger.Print(LogSeverity::Warning, LogCategory::General, 0,
+            "Dynamic resolution is not combined with occlusion culling, drawing at the window size");
+        return;
+    }
+    // The format CreateOffscreenImages picks when headless
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    if(!m_options.headless){
+        auto swapChainDetails = QuerySwapChainSupport(m_physicalDevice);
+        if(!(swapChainDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)){
+            m_logger.Print(LogSeverity::Warning, LogCategory::General, 0,
+                "Swap chain images can not be blitted into, drawing at the window size");
+            return;
+        }
+        format = ChooseSwapChainSurfaceFormat(swapChainDetails.formats).format;
+    }
+    if(!DynamicResolution::IsSupported(m_physicalDevice, FindQueueFamilies(m_physicalDevice).graphicsFamily.value(), format)){
+        m_logger.Print(LogSeverity::Warning, LogCategory::General, 0, "Dynamic resolution is not supported, drawing at the window size");
+        return;
+    }
+    m_dynamicResolutionEnabled = true;
+}
 
-    CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_indexBuffer, m_indexBufferMemory);
-    
-    CopyBuffer(stagingBuffer, m_indexBuffer, bufferSize);
+void Application::CreateDynamicResolution(){
+    PROFILE_ZONE(m_profiler, "CreateDynamicResolution");
+    m_dynamicResolution.Create(m_physicalDevice, m_device, FindQueueFamilies(m_physicalDevice).graphicsFamily.value(),
+        MAX_FRAMES_IN_FLIGHT, m_options.gpuBudgetMs, m_options.minResolutionPercent / 100.0f,
+        m_options.maxResolutionPercent / 100.0f, m_options.upscaleFilter, m_fileSystem, m_pipelineCache);
+}
 
-    vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-    vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+void Application::SelectMultiview(){
+    if(m_options.multiview == MultiviewMode::Off) return;
+    // Each of them follows a single camera, which multiview would need a view of its own for
+    if(m_meshletsEnabled || m_occlusionCullingEnabled || m_dynamicResolutionEnabled){
+        m_logger.Print(LogSeverity::Warning, LogCategory::General, 0,
+            "Multiview is not combined with meshlets, occlusion culling or dynamic resolution, drawing a single view");
+        return;
+    }
+    if(!m_options.headless){
+        auto swapChainDetails = QuerySwapChainSupport(m_physicalDevice);
+        if(!(swapChainDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)){
+            m_logger.Print(LogSeverity::Warning, LogCategory::General, 0,
+                "Swap chain images can not be copied into, drawing a single view");
+            return;
+        }
+    }
+    if(!Multiview::IsSupported(m_physicalDevice, Multiview::GetViewCount(m_options.multiview))){
+        m_logger.Print(LogSeverity::Warning, LogCategory::General, 0, "Multiview is not supported, drawing a single view");
+        return;
+    }
+    m_multiviewEnabled = true;
+    m_multiview.Create(m_options.multiview);
+}
+
+void Application::BuildMultiviewPasses(){
+    uint32_t compositePass = m_renderGraph.AddPass("MultiviewComposite", [this](VkCommandBuffer commandBuffer){
+        m_multiview.RecordComposite(commandBuffer, m_sceneColorImages[m_currentImageIndex], m_mainPassExtent,
+            m_swapChainImages[m_currentImageIndex], m_swapChainExtent);
+    });
+    m_renderGraph.Read(compositePass, m_sceneColor, ResourceUsage::TransferSrc);
+    m_renderGraph.Write(compositePass, m_backbuffer, ResourceUsage::TransferDst);
+}
+
+void Application::SelectFramePacing(){
+    if(m_options.framePacing == FramePacingMode::Off) return;
+    m_framePacingEnabled = true;
+    m_presentTimingSource = FramePacer::SelectSource(m_physicalDevice, m_options.framePacing, m_options.headless);
+    if(m_options.framePacing == FramePacingMode::Auto && !m_options.headless &&
+        m_presentTimingSource == PresentTimingSource::CpuTimer)
+    {
+        m_logger.Print(LogSeverity::Warning, LogCategory::General, 0,
+            "Neither present wait nor display timing is supported, pacing frames with the CPU timer");
+    }
+}
+
+void Application::CreateFramePacer(){
+    PROFILE_ZONE(m_profiler, "CreateFramePacer");
+    // Without a display to follow, headless runs pace to 60 frames per second unless told otherwise
+    double targetIntervalMs = m_options.targetFrameRate > 0 ? 1000.0 / m_options.targetFrameRate : 0.0;
+    m_framePacer.Create(m_device, m_presentTimingSource, m_options.headless ? VK_NULL_HANDLE : m_swapChain, targetIntervalMs);
+}
+
+void Application::ReportFramePacing(){
+    FramePacingStats stats = m_framePacer.GetStats();
+    m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0,
+        "Frame pacing with the %s: %llu present intervals, mean %.3f ms, jitter %.3f ms, max %.3f ms, %llu presents missed",
+        GetPresentTimingSourceName(m_framePacer.GetSource()), static_cast<unsigned long long>(stats.intervals),
+        stats.meanIntervalMs, stats.jitterMs, stats.maxIntervalMs, static_cast<unsigned long long>(stats.missed));
+}
+
+void Application::ReportHostMemory(){
+    HostAllocatorStats stats = GetHostAllocator().GetStats();
+    m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0,
+        "Host memory: peak %.1f KB, %zu bytes not freed, %llu allocations, %llu of them pooled in %.1f KB",
+        stats.peakBytes / 1024.0, stats.currentBytes, static_cast<unsigned long long>(stats.GetAllocations()),
+        static_cast<unsigned long long>(stats.pooledAllocations), stats.pooledBytes / 1024.0);
+    for(uint32_t i = 0; i < HOST_ALLOCATION_SCOPE_COUNT; i++){
+        const HostAllocationScopeStats& scope = stats.scopes[i];
+        if(scope.allocations == 0 && scope.internalAllocations == 0) continue;
+        m_logger.Print(LogSeverity::Verbose, LogCategory::Performance, 0,
+            "Host memory of %s scope: %llu allocations, %llu frees, peak %.1f KB, %llu internal allocations",
+            GetAllocationScopeName(static_cast<VkSystemAllocationScope>(i)), static_cast<unsigned long long>(scope.allocations),
+            static_cast<unsigned long long>(scope.frees), scope.peakBytes / 1024.0,
+            static_cast<unsigned long long>(scope.internalAllocations));
+    }
+}
+
+ByteSpan Application::GetVertexData() const{
+    if(IsReplaying()){
+        const std::vector<uint8_t>& data = m_captureReader.GetResources().vertexData;
+        return {data.data(), data.size()};
+    }
+    if(!m_stressVertexData.empty()) return {m_stressVertexData.data(), m_stressVertexData.size()};
+    return {reinterpret_cast<const uint8_t*>(g_vertices.data()), sizeof(g_vertices[0]) * g_vertices.size()};
+}
+
+ByteSpan Application::GetIndexData() const{
+    if(IsReplaying()){
+        const std::vector<uint8_t>& data = m_captureReader.GetResources().indexData;
+        return {data.data(), data.size()};
+    }
+    if(!m_stressIndexData.empty()) return {m_stressIndexData.data(), m_stressIndexData.size()};
+    return {reinterpret_cast<const uint8_t*>(g_indices.data()), sizeof(g_indices[0]) * g_indices.size()};
 }
 
 void Application::CreateUniformBuffers(){
+    PROFILE_ZONE(m_profiler, "CreateUniformBuffers");
     VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
     m_uniformBuffers.resize(m_swapChainImages.size());
@@ -1078,67 +2398,587 @@ void Application::CreateUniformBuffers(){
     }
 }
 
-void Application::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory){
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+void Application::CreateScene(){
+    PROFILE_ZONE(m_profiler, "CreateScene");
+    if(m_options.stress.objectCount > 0){
+        CreateStressScene();
+    }else{
+        // A spinning quad with smaller ones orbiting it, each carrying one more
+        const uint32_t satellites = 6;
+        m_scene.Reserve(1 + satellites * 2);
+        Scene::ObjectHandle root = m_scene.AddObject(Scene::NO_PARENT, glm::vec3(0.0f));
+        for(uint32_t i = 0; i < satellites; i++){
+            float angle = glm::two_pi<float>() * i / satellites;
+            Scene::ObjectHandle satellite = m_scene.AddObject(root, glm::vec3(0.7f * std::cos(angle), 0.7f * std::sin(angle), 0.1f),
+                glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.25f));
+            m_scene.AddObject(satellite, glm::vec3(0.0f, 1.2f, 0.1f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+        }
+    }
+
+    // Every object is the unit quad
+    for(Scene::ObjectHandle object = 0; object < m_scene.GetObjectCount(); object++){
+        m_scene.SetBoundingRadius(object, std::sqrt(0.5f));
+    }
+
+    // Replayed matrices and draw lists are copied into buffers sized for this scene
+    if(IsReplaying()){
+        bool matches = m_captureReader.GetResources().objectCount == m_scene.GetObjectCount();
+        for(uint32_t frame = 0; matches && frame < m_captureReader.GetFrameCount(); frame++){
+            matches = m_captureReader.GetFrame(frame).drawListIndices.size() <= m_scene.GetObjectCount();
+        }
+        if(!matches) throw std::runtime_error("Capture was recorded with a different scene!");
+    }
+}
+
+void Application::CreateStressScene(){
+    // Seeded by the count, so every run of a stress scene draws the same objects
+    const uint32_t count = m_options.stress.objectCount;
+    std::mt19937 random(count);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    // Every object hangs off the spinning root, so UpdateScene spins each of them like a satellite
+    m_scene.Reserve(count);
+    Scene::ObjectHandle root = m_scene.AddObject(Scene::NO_PARENT, glm::vec3(0.0f));
+    for(uint32_t i = 1; i < count; i++){
+        m_scene.AddObject(root, glm::vec3(unit(random), unit(random), 0.5f * unit(random)),
+            glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.1f));
+    }
+}
+
+void Application::BuildStressGeometry(){
+    // A grid of cells over the unit quad, two triangles each wound like the default quad
+    uint32_t triangles = std::min(m_options.stress.trianglesPerObject, MAX_STRESS_TRIANGLES);
+    uint32_t cells = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(triangles / 2.0))));
+
+    std::vector<Vertex> vertices;
+    vertices.reserve((cells + 1) * (cells + 1));
+    for(uint32_t y = 0; y <= cells; y++){
+        for(uint32_t x = 0; x <= cells; x++){
+            float u = static_cast<float>(x) / cells;
+            float v = static_cast<float>(y) / cells;
+            vertices.push_back({{u - 0.5f, v - 0.5f}, {u, v, 1.0f - u}, {u, v}});
+        }
+    }
+    std::vector<uint16_t> indices;
+    indices.reserve(cells * cells * 6);
+    for(uint32_t y = 0; y < cells; y++){
+        for(uint32_t x = 0; x < cells; x++){
+            uint16_t a = static_cast<uint16_t>(y * (cells + 1) + x);
+            uint16_t b = static_cast<uint16_t>(a + 1);
+            uint16_t c = static_cast<uint16_t>(b + cells + 1);
+            uint16_t d = static_cast<uint16_t>(a + cells + 1);
+            indices.insert(indices.end(), {a, b, c, c, d, a});
+        }
+    }
+
+    const uint8_t* vertexBytes = reinterpret_cast<const uint8_t*>(vertices.data());
+    m_stressVertexData.assign(vertexBytes, vertexBytes + vertices.size() * sizeof(Vertex));
+    const uint8_t* indexBytes = reinterpret_cast<const uint8_t*>(indices.data());
+    m_stressIndexData.assign(indexBytes, indexBytes + indices.size() * sizeof(uint16_t));
+}
+
+void Application::CreateStressUploadBuffers(){
+    if(m_options.stress.uploadKB == 0) return;
+    PROFILE_ZONE(m_profiler, "CreateStressUploadBuffers");
+    VkDeviceSize size = static_cast<VkDeviceSize>(m_options.stress.uploadKB) * 1024;
+
+    CreateBuffer(size * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_stressStagingBuffer, m_stressStagingBufferMemory);
+    void* mapped;
+    ThrowIfFailed(vkMapMemory(m_device, m_stressStagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &mapped),
+        "Failed to map stress staging buffer!");
+    m_stressStagingBufferMapped = static_cast<uint8_t*>(mapped);
+
+    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_stressUploadBuffer, m_stressUploadBufferMemory);
+}
+
+void Application::RecordStressUpload(VkCommandBuffer commandBuffer){
+    PROFILE_ZONE(m_profiler, "RecordStressUpload");
+    VkDeviceSize size = static_cast<VkDeviceSize>(m_options.stress.uploadKB) * 1024;
+    VkDeviceSize offset = m_currentFrame * size;
+
+    // The fence of this frame was waited on, so its region is free. Different bytes every frame, like real uploads
+    memset(m_stressStagingBufferMapped + offset, static_cast<int>(m_frameNumber & 0xff), static_cast<size_t>(size));
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset = offset;
+    copyRegion.dstOffset = 0;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(commandBuffer, m_stressStagingBuffer, m_stressUploadBuffer, 1, &copyRegion);
+}
+
+void Application::CreateFramePacketBuffers(){
+    PROFILE_ZONE(m_profiler, "CreateFramePacketBuffers");
+    // Dynamic offsets must be multiples of the device's alignment, and the matrices are written 16 bytes at a time
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 16);
+    auto alignUp = [alignment](VkDeviceSize size){ return (size + alignment - 1) / alignment * alignment; };
+
+    m_objectBufferStride = alignUp(sizeof(glm::mat4) * m_scene.GetObjectCount());
+    CreateBuffer(m_objectBufferStride * FRAME_PACKET_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_objectBuffer, m_objectBufferMemory);
+    void* mapped;
+    ThrowIfFailed(vkMapMemory(m_device, m_objectBufferMemory, 0, VK_WHOLE_SIZE, 0, &mapped),
+        "Failed to map object buffer!");
+    m_objectBufferMapped = static_cast<uint8_t*>(mapped);
+
+    // Occlusion culling writes its early and late list after the one of the host
+    m_drawListBufferStride = alignUp(sizeof(uint32_t) * m_scene.GetObjectCount() * (m_occlusionCullingEnabled ? 3 : 1));
+    CreateBuffer(m_drawListBufferStride * FRAME_PACKET_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_drawListBuffer, m_drawListBufferMemory);
+    ThrowIfFailed(vkMapMemory(m_device, m_drawListBufferMemory, 0, VK_WHOLE_SIZE, 0, &mapped),
+        "Failed to map draw list buffer!");
+    m_drawListBufferMapped = static_cast<uint8_t*>(mapped);
 
-    ThrowIfFailed(vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer),
-        "Failed to create buffer!");
+    for(FramePacket& framePacket: m_framePackets) framePacket.drawQueue.Create(MAX_DRAW_PACKETS);
+}
+
+void Application::StartSimulation(){
+    static_assert(FRAME_PACKET_COUNT > MAX_FRAMES_IN_FLIGHT, "The simulation needs a packet no frame in flight holds");
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+    m_framePacketsInFlight.assign(MAX_FRAMES_IN_FLIGHT, NO_FRAME_PACKET);
+    for(uint32_t packet = 0; packet < FRAME_PACKET_COUNT; packet++) m_freeFramePackets.TryPush(packet);
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+    m_simulationStartTime = std::chrono::high_resolution_clock::now();
+    m_simulationStopping.store(false);
+    m_simulationFailed.store(false);
+    m_simulationThread = std::thread([this](){ SimulationLoop(); });
+}
 
-    ThrowIfFailed(vkAllocateMemory(m_device, &allocInfo, nullptr, &bufferMemory),
-        "Failed to allocate buffer memory!");
+void Application::StopSimulation(){
+    m_simulationStopping.store(true, std::memory_order_release);
+    if(m_simulationThread.joinable()) m_simulationThread.join();
+}
 
-    vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
+void Application::SimulationLoop(){
+    m_profiler.SetThreadName("Simulation");
+    try{
+        while(true){
+            uint32_t packet;
+            if(!WaitUntil(m_simulationStopping, [&](){ return m_freeFramePackets.TryPop(packet); })) return;
+            if(IsReplaying()) ReplayScene(packet);
+            else UpdateScene(packet);
+            // Never full, the queue has room for every packet
+            m_readyFramePackets.TryPush(packet);
+        }
+    }catch(...){
+        m_simulationException = std::current_exception();
+        m_simulationFailed.store(true, std::memory_order_release);
+    }
 }
 
-void Application::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size){
+uint32_t Application::AcquireFramePacket(){
+    PROFILE_ZONE(m_profiler, "AcquireFramePacket");
+    uint32_t packet = NO_FRAME_PACKET;
+    if(!WaitUntil(m_simulationFailed, [&](){ return m_readyFramePackets.TryPop(packet); })){
+        std::rethrow_exception(m_simulationException);
+    }
+    return packet;
+}
+
+void Application::UpdateScene(uint32_t packet){
+    PROFILE_ZONE(m_profiler, "UpdateScene");
+    FramePacket& framePacket = m_framePackets[packet];
+    VkExtent2D extent = m_viewExtent.load();
+
+    // Benchmarks animate on a fixed step, so every run sees the same frames and counts the same draws however fast
+    // the device is
+    if(!m_options.benchmarkFile.empty()){
+        framePacket.time = static_cast<float>(m_benchmarkSceneFrame++) * BENCHMARK_FRAME_TIME;
+    }else{
+        framePacket.time = std::chrono::duration<float, std::chrono::seconds::period>(
+            std::chrono::high_resolution_clock::now() - m_simulationStartTime).count();
+    }
+    framePacket.view = glm::lookAt(glm::vec3(2.0f,2.0f,2.0f), glm::vec3(0.0f,0.0f,0.0f), glm::vec3(0.0f,0.0f,1.0f));
+    // Every view shares the projection, cube faces cover a quarter turn each
+    framePacket.projection = glm::perspective(m_multiview.GetFieldOfView(glm::radians(45.0f)),
+        static_cast<float>(extent.width) / extent.height, 0.1f, 100.0f);
+    framePacket.projection[1][1] *= -1;
+
+    float time = framePacket.time;
+    m_scene.SetRotation(0, glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f)));
+    glm::quat satelliteRotation = glm::angleAxis(-time * glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    for(Scene::ObjectHandle object = 1; object < m_scene.GetObjectCount(); object++){
+        if(m_scene.GetParent(object) == 0) m_scene.SetRotation(object, satelliteRotation);
+    }
+
+    // The packet came back through the free queue, so no frame in flight reads its regions anymore
+    DrawListBuilder::View drawListView = {};
+    drawListView.viewProjection = framePacket.projection * framePacket.view;
+    drawListView.projectionScale = std::abs(framePacket.projection[1][1]) * extent.height / 2.0f;
+    m_multiview.SetCullingView(framePacket.view, framePacket.projection, drawListView);
+    m_drawListBuilder.AddJobs(m_jobScheduler, m_scene, drawListView, m_objectBufferMapped + packet * m_objectBufferStride,
+        reinterpret_cast<uint32_t*>(m_drawListBufferMapped + packet * m_drawListBufferStride));
+    m_jobScheduler.Run();
+    framePacket.drawList = m_drawListBuilder.GetResult();
+
+    // One instanced draw per LOD, the instance index picks the object from the draw list. Lower LODs are closer,
+    // so they go first. Stress scenes split each LOD evenly over their pipelines
+    framePacket.drawQueue.Reset();
+    const uint32_t pipelineCount = m_options.stress.pipelineCount;
+    for(uint32_t lod = 0; lod < DrawListBuilder::MAX_LOD_COUNT; lod++){
+        uint32_t first = framePacket.drawList.lodFirst[lod];
+        uint32_t count = framePacket.drawList.lodCount[lod];
+        for(uint32_t pipeline = 0; pipeline < pipelineCount; pipeline++){
+            uint32_t begin = first + static_cast<uint32_t>(static_cast<uint64_t>(count) * pipeline / pipelineCount);
+            uint32_t end = first + static_cast<uint32_t>(static_cast<uint64_t>(count) * (pipeline + 1) / pipelineCount);
+            if(begin == end) continue;
+            DrawPacket drawPacket = {};
+            drawPacket.key = DrawQueue::MakeSortKey(0, SCENE_PIPELINE + pipeline, SCENE_MATERIAL, QUAD_MESH,
+                static_cast<float>(lod) / DrawListBuilder::MAX_LOD_COUNT);
+            // Every object is the same mesh, so all LODs share its indices
+            drawPacket.indexCount = m_indexCount;
+            drawPacket.instanceCount = end - begin;
+            drawPacket.firstInstance = begin;
+            framePacket.drawQueue.Push(drawPacket);
+        }
+    }
+    framePacket.drawQueue.Sort(&m_jobScheduler);
+
+    // The screen area the largest quad covers decides how fine a texture level it needs
+    glm::mat4 rootWorld = m_scene.GetWorldMatrix(0);
+    glm::vec2 minPixel(FLT_MAX), maxPixel(-FLT_MAX);
+    bool behindCamera = false;
+    for(const auto& vertex: g_vertices){
+        glm::vec4 clip = drawListView.viewProjection * rootWorld * glm::vec4(vertex.Pos, 0.0f, 1.0f);
+        if(clip.w <= 0.0f){
+            behindCamera = true;
+            break;
+        }
+        glm::vec2 pixel = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2(extent.width, extent.height);
+        minPixel = glm::min(minPixel, pixel);
+        maxPixel = glm::max(maxPixel, pixel);
+    }
+    framePacket.textureCoverage = behindCamera ? glm::vec2(extent.width, extent.height) : maxPixel - minPixel;
+}
+
+void Application::ReplayScene(uint32_t packet){
+    PROFILE_ZONE(m_profiler, "ReplayScene");
+    const CaptureFrame& frame = m_captureReader.GetFrame(static_cast<uint32_t>(m_replayFrame++ % m_captureReader.GetFrameCount()));
+    FramePacket& framePacket = m_framePackets[packet];
+
+    framePacket.time = frame.time;
+    framePacket.view = frame.view;
+    framePacket.projection = frame.projection;
+    framePacket.textureCoverage = frame.textureCoverage;
+    framePacket.drawList = frame.drawList;
+    // CreateScene checked that both fit
+    memcpy(m_objectBufferMapped + packet * m_objectBufferStride, frame.objectMatrices.data(),
+        frame.objectMatrices.size() * sizeof(glm::mat4));
+    if(!frame.drawListIndices.empty()){
+        memcpy(m_drawListBufferMapped + packet * m_drawListBufferStride, frame.drawListIndices.data(),
+            frame.drawListIndices.size() * sizeof(uint32_t));
+    }
+
+    // Sorted again, so replays time the sort as well
+    framePacket.drawQueue.Reset();
+    for(const DrawPacket& drawPacket: frame.drawPackets) framePacket.drawQueue.Push(drawPacket);
+    framePacket.drawQueue.Sort(&m_jobScheduler);
+}
+
+void Application::OpenCapture(){
+    ByteSpan vertexData = GetVertexData();
+    ByteSpan indexData = GetIndexData();
+
+    CaptureResources resources = {};
+    resources.width = m_swapChainExtent.width;
+    resources.height = m_swapChainExtent.height;
+    resources.objectCount = m_scene.GetObjectCount();
+    resources.textureBudgetMB = m_options.textureBudgetMB;
+    resources.stressObjectCount = m_options.stress.objectCount;
+    resources.stressPipelineCount = m_options.stress.pipelineCount;
+    resources.stressUploadKB = m_options.stress.uploadKB;
+    resources.texture = m_options.texture;
+    if(!m_options.texture.empty()){
+        Asset texture = m_fileSystem.Open(m_options.texture);
+        resources.textureData.assign(texture.GetBytes().begin(), texture.GetBytes().end());
+    }
+    resources.vertexData.assign(vertexData.begin(), vertexData.end());
+    resources.indexData.assign(indexData.begin(), indexData.end());
+    m_captureWriter.Open(m_options.captureFile, resources);
+}
+
+void Application::WriteCaptureFrame(float particleDeltaTime){
+    PROFILE_ZONE(m_profiler, "WriteCaptureFrame");
+    // Still in flight, so the simulation can not overwrite the packet or its buffer regions meanwhile
+    const FramePacket& framePacket = m_framePackets[m_currentFramePacket];
+
+    CaptureFrame frame = {};
+    frame.time = framePacket.time;
+    frame.particleDeltaTime = particleDeltaTime;
+    frame.view = framePacket.view;
+    frame.projection = framePacket.projection;
+    frame.textureCoverage = framePacket.textureCoverage;
+    frame.drawList = framePacket.drawList;
+
+    const glm::mat4* matrices = reinterpret_cast<const glm::mat4*>(m_objectBufferMapped + m_currentFramePacket * m_objectBufferStride);
+    frame.objectMatrices.assign(matrices, matrices + m_scene.GetObjectCount());
+    uint32_t drawListSize = 0;
+    for(uint32_t lod = 0; lod < DrawListBuilder::MAX_LOD_COUNT; lod++){
+        drawListSize = std::max(drawListSize, framePacket.drawList.lodFirst[lod] + framePacket.drawList.lodCount[lod]);
+    }
+    const uint32_t* drawList = reinterpret_cast<const uint32_t*>(m_drawListBufferMapped + m_currentFramePacket * m_drawListBufferStride);
+    frame.drawListIndices.assign(drawList, drawList + drawListSize);
+    const DrawPacket* drawPackets = framePacket.drawQueue.GetPackets();
+    frame.drawPackets.assign(drawPackets, drawPackets + framePacket.drawQueue.GetPacketCount());
+
+    m_captureWriter.WriteFrame(frame);
+}
+
+void Application::ReportReplayTimes(){
+    const uint32_t framesPerIteration = m_captureReader.GetFrameCount();
+    for(size_t first = 0; first < m_frameTimes.size(); first += framesPerIteration){
+        size_t last = std::min(first + framesPerIteration, m_frameTimes.size());
+        double total = 0.0;
+        for(size_t i = first; i < last; i++) total += m_frameTimes[i];
+        m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0, "Replay iteration %zu: %zu frames in %.2f ms, %.3f ms a frame",
+            first / framesPerIteration + 1, last - first, total, total / (last - first));
+    }
+    if(m_frameTimes.empty()) return;
+
+    std::vector<double> sorted(m_frameTimes.begin(), m_frameTimes.end());
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for(double time: sorted) total += time;
+    m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0,
+        "Replayed %zu frames: mean %.3f ms, median %.3f ms, 95th percentile %.3f ms, min %.3f ms, max %.3f ms",
+        sorted.size(), total / sorted.size(), sorted[sorted.size() / 2], sorted[sorted.size() * 95 / 100], sorted.front(), sorted.back());
+}
+
+void Application::LoadReplayTextures(){
+    PROFILE_ZONE(m_profiler, "LoadReplayTextures");
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandPool = m_commandPool;
     allocInfo.commandBufferCount = 1;
-
     VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer);
+    ThrowIfFailed(vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer),
+        "Failed to allocate texture load command buffer!");
 
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence;
+    ThrowIfFailed(vkCreateFence(m_device, &fenceInfo, GetAllocationCallbacks(), &fence),
+        "Failed to create texture load fence!");
+
+    // One level per texture and round, as frames would stream them. Each round waits for the last, so all of
+    // them can use the staging memory of the first frame, and those still decoding get the time to finish
+    do{
+        m_textureStreamer.BeginFrame(0, 0);
+        m_textureStreamer.RequestAllLevels(m_texture);
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        m_textureStreamer.RecordUploads(commandBuffer);
+        ThrowIfFailed(vkEndCommandBuffer(commandBuffer),
+            "Failed to record texture load command buffer!");
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        ThrowIfFailed(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, fence),
+            "Failed to submit texture load command buffer!");
+        vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(m_device, 1, &fence);
+    }while(!m_textureStreamer.IsSettled());
+
+    vkDestroyFence(m_device, fence, GetAllocationCallbacks());
+    vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+    m_logger.Print(LogSeverity::Info, LogCategory::Performance, 0, "Replay textures loaded, %.1f MB resident",
+        m_textureStreamer.GetResidentBytes() / (1024.0 * 1024.0));
+}
+
+void Application::WriteBenchmarkResults(){
+    // Everything is per measured frame, so runs of different lengths compare. Lower is better for every number
+    // outside "scene", which PerfCompare relies on
+    const size_t measuredFrames = m_frameTimes.size() - std::min(static_cast<size_t>(m_benchmarkStartFrame), m_frameTimes.size());
+    const double perFrame = measuredFrames > 0 ? 1.0 / measuredFrames : 0.0;
+    std::vector<double> sorted(m_frameTimes.begin() + (m_frameTimes.size() - measuredFrames), m_frameTimes.end());
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for(double time: sorted) total += time;
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+    std::string deviceName;
+    for(const char* c = deviceProperties.deviceName; *c != '\0'; c++){
+        if(*c == '"' || *c == '\\') deviceName += '\\';
+        deviceName += *c;
+    }
 
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    char buffer[512];
+    std::string json = "{\n";
+    snprintf(buffer, sizeof(buffer), "  \"scene\": {\"objects\": %u, \"trianglesPerObject\": %u, \"pipelines\": %u, \"uploadKB\": %u, "
+        "\"width\": %u, \"height\": %u, \"views\": %u},\n", m_scene.GetObjectCount(), m_indexCount / 3,
+        m_options.stress.pipelineCount, m_options.stress.uploadKB, m_swapChainExtent.width, m_swapChainExtent.height,
+        m_multiview.GetViewCount());
+    json += buffer;
+    snprintf(buffer, sizeof(buffer), "  \"device\": \"%s\",\n  \"frames\": %zu,\n  \"measuredFrames\": %zu,\n",
+        deviceName.c_str(), m_frameTimes.size(), measuredFrames);
+    json += buffer;
+    if(!sorted.empty()){
+        snprintf(buffer, sizeof(buffer), "  \"frameTime\": {\"meanMs\": %.4f, \"medianMs\": %.4f, \"p95Ms\": %.4f, \"maxMs\": %.4f},\n",
+            total / sorted.size(), sorted[sorted.size() / 2], sorted[sorted.size() * 95 / 100], sorted.back());
+        json += buffer;
+    }
+    // Over the whole run, the pacer does not know about the warmup
+    if(m_framePacingEnabled){
+        FramePacingStats pacing = m_framePacer.GetStats();
+        snprintf(buffer, sizeof(buffer), "  \"presentInterval\": {\"jitterMs\": %.4f, \"maxMs\": %.4f, \"missed\": %llu},\n",
+            pacing.jitterMs, pacing.maxIntervalMs, static_cast<unsigned long long>(pacing.missed));
+        json += buffer;
+    }
+
+    // Zones of the warmup frames are left out
+    std::vector<ProfileZoneStats> zones = m_profiler.GetZoneStats(m_benchmarkStartTime);
+    for(bool gpu: {false, true}){
+        json += gpu ? "  \"gpu\": {" : "  \"cpu\": {";
+        bool first = true;
+        for(const ProfileZoneStats& zone: zones){
+            if(zone.gpu != gpu) continue;
+            snprintf(buffer, sizeof(buffer), "%s\n    \"%s\": {\"calls\": %.2f, \"msPerFrame\": %.4f}", first ? "" : ",",
+                zone.name.c_str(), zone.count * perFrame, zone.totalMs * perFrame);
+            json += buffer;
+            first = false;
+        }
+        json += first ? "},\n" : "\n  },\n";
+    }
+
+    TelemetrySnapshot telemetry = m_telemetry.GetSnapshot();
+    VkDeviceSize deviceLocalUsage = 0;
+    VkDeviceSize hostUsage = 0;
+    for(const TelemetryHeap& heap: telemetry.heaps){
+        (heap.deviceLocal ? deviceLocalUsage : hostUsage) += heap.usage;
+    }
+    snprintf(buffer, sizeof(buffer), "  \"memory\": {\"liveAllocations\": %llu, \"hostPeakKB\": %.1f",
+        static_cast<unsigned long long>(telemetry.GetLiveAllocations()), GetHostAllocator().GetStats().peakBytes / 1024.0);
+    json += buffer;
+    if(telemetry.hasBudget){
+        snprintf(buffer, sizeof(buffer), ", \"deviceLocalUsageMB\": %.2f, \"hostUsageMB\": %.2f",
+            deviceLocalUsage / (1024.0 * 1024.0), hostUsage / (1024.0 * 1024.0));
+        json += buffer;
+    }
+    json += "},\n  \"callsPerFrame\": {";
+    for(uint32_t i = 0; i < TELEMETRY_COUNTER_COUNT; i++){
+        TelemetryCounter counter = static_cast<TelemetryCounter>(i);
+        snprintf(buffer, sizeof(buffer), "%s\"%s\": %.2f", i == 0 ? "" : ", ", GetTelemetryCounterName(counter),
+            (telemetry.Get(counter) - m_benchmarkStartTelemetry.Get(counter)) * perFrame);
+        json += buffer;
+    }
+    json += "}\n}\n";
+
+    std::ofstream file(m_options.benchmarkFile, std::ios::binary | std::ios::trunc);
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+    if(!file) throw std::runtime_error("Failed to write benchmark results: " + m_options.benchmarkFile + "!");
+}
+
+void Application::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory){
+    ::CreateBuffer(m_physicalDevice, m_device, size, usage, properties, buffer, bufferMemory);
+}
+
+void Application::StageBufferUpload(const void* data, VkDeviceSize size, VkBuffer dstBuffer){
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer, stagingBufferMemory);
+    m_stagingBuffers.push_back(stagingBuffer);
+    m_stagingBuffersMemory.push_back(stagingBufferMemory);
+
+    void* mapped;
+    vkMapMemory(m_device, stagingBufferMemory, 0, size, 0, &mapped);
+    memcpy(mapped, data, static_cast<size_t>(size));
+    vkUnmapMemory(m_device, stagingBufferMemory);
+
+    if(m_uploadCommandBuffer == VK_NULL_HANDLE){
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandBufferCount = 1;
+        ThrowIfFailed(vkAllocateCommandBuffers(m_device, &allocInfo, &m_uploadCommandBuffer),
+            "Failed to allocate upload command buffer!");
+        m_telemetry.Count(TelemetryCounter::CommandBufferAllocations);
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(m_uploadCommandBuffer, &beginInfo);
+    }
 
     VkBufferCopy copyRegion = {};
     copyRegion.srcOffset = 0;
     copyRegion.dstOffset = 0;
     copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+    vkCmdCopyBuffer(m_uploadCommandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+}
 
-    vkEndCommandBuffer(commandBuffer);
+void Application::SubmitStagedUploads(){
+    if(m_uploadCommandBuffer == VK_NULL_HANDLE) return;
+
+    // The barrier's second scope reaches into every later submission on the queue, so the frames need no
+    // semaphore to read the geometry and startup never waits for the copies. Besides vertex input, the meshlet
+    // buffers are read as storage buffers by the cull compute shader, or by the task and mesh shaders, and the
+    // occlusion culler's cull dispatches read the bounding radii and read and write the visibility
+    VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if(m_meshletsEnabled && m_meshletPath == MeshletRenderer::Path::MeshShader){
+        dstStages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+    }
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+        VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(m_uploadCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0,
+        1, &barrier, 0, nullptr, 0, nullptr);
+    ThrowIfFailed(vkEndCommandBuffer(m_uploadCommandBuffer),
+        "Failed to record upload command buffer!");
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    ThrowIfFailed(vkCreateFence(m_device, &fenceInfo, GetAllocationCallbacks(), &m_uploadFence),
+        "Failed to create upload fence!");
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.pCommandBuffers = &m_uploadCommandBuffer;
+    ThrowIfFailed(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_uploadFence),
+        "Failed to submit upload command buffer!");
+    m_telemetry.Count(TelemetryCounter::QueueSubmits);
+}
 
-    vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(m_graphicsQueue);
+void Application::ReleaseStagedUploads(bool wait){
+    if(m_uploadFence == VK_NULL_HANDLE) return;
+    if(wait){
+        vkWaitForFences(m_device, 1, &m_uploadFence, VK_TRUE, UINT64_MAX);
+    }else if(vkGetFenceStatus(m_device, m_uploadFence) != VK_SUCCESS){
+        return;
+    }
 
-    vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+    for(size_t i = 0; i < m_stagingBuffers.size(); i++){
+        vkDestroyBuffer(m_device, m_stagingBuffers[i], GetAllocationCallbacks());
+        FreeMemory(m_device, m_stagingBuffersMemory[i]);
+    }
+    m_stagingBuffers.clear();
+    m_stagingBuffersMemory.clear();
+    vkFreeCommandBuffers(m_device, m_commandPool, 1, &m_uploadCommandBuffer);
+    m_uploadCommandBuffer = VK_NULL_HANDLE;
+    vkDestroyFence(m_device, m_uploadFence, GetAllocationCallbacks());
+    m_uploadFence = VK_NULL_HANDLE;
 }
 
 void Application::CreateCommandBuffers(){
-    m_commandBuffers.resize(m_swapChainFramebuffers.size());
+    PROFILE_ZONE(m_profiler, "CreateCommandBuffers");
+    m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1148,45 +2988,361 @@ void Application::CreateCommandBuffers(){
 
     ThrowIfFailed(vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data()),
         "Failed to allocate command buffers!");
+    m_telemetry.Count(TelemetryCounter::CommandBufferAllocations, m_commandBuffers.size());
+}
 
-    for (size_t i = 0; i < m_commandBuffers.size(); i++) {
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0;
-        beginInfo.pInheritanceInfo = nullptr;
-        ThrowIfFailed(vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo), 
-            "Failed to begin recording command buffer!");
+void Application::BuildRenderGraph(){
+    PROFILE_ZONE(m_profiler, "BuildRenderGraph");
+    m_renderGraph.Reset();
+
+    // Swap chain images arrive through the acquire semaphore and leave for presentation. Offscreen images of
+    // headless runs are simply reused once the fence of their last frame was waited on
+    ResourceUsage present = ResourceUsage::Present;
+    if(m_options.headless){
+        m_backbuffer = m_renderGraph.ImportImage("Backbuffer", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+    }else{
+        m_backbuffer = m_renderGraph.ImportImage("Backbuffer", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, &present);
+    }
+    m_particleBuffer = m_renderGraph.ImportBuffer("Particles");
+    // Cleared by the first pass drawing into it, so its contents from the last frame do not matter
+    m_depth = m_renderGraph.ImportImage("Depth", VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+    // With dynamic resolution the main pass draws into the scene color instead, upscaled into the back buffer after.
+    // With multiview the views drawn into its layers are copied into their tiles
+    RenderGraph::ResourceHandle mainColor = m_backbuffer;
+    if(IsSceneColorUsed()){
+        m_sceneColor = m_renderGraph.ImportImage("SceneColor", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false);
+        mainColor = m_sceneColor;
+    }
 
+    // Stress scenes copy their upload ahead of drawing, nothing reads it afterwards
+    if(m_options.stress.uploadKB > 0){
+        m_stressUpload = m_renderGraph.ImportBuffer("StressUpload");
+        uint32_t uploadPass = m_renderGraph.AddPass("StressUpload", [this](VkCommandBuffer commandBuffer){
+            RecordStressUpload(commandBuffer);
+        }, true);
+        m_renderGraph.Write(uploadPass, m_stressUpload, ResourceUsage::TransferDst);
+    }
+
+    // Meshlets culled by compute leave their draws for the main pass
+    bool meshletCull = m_meshletsEnabled && m_meshletPath == MeshletRenderer::Path::Compute;
+    if(meshletCull){
+        m_meshletDraws = m_renderGraph.ImportBuffer("MeshletDraws");
+        uint32_t cullPass = m_renderGraph.AddPass("MeshletCull", [this](VkCommandBuffer commandBuffer){
+            RecordMeshletCull(commandBuffer);
+        });
+        m_renderGraph.Write(cullPass, m_meshletDraws, ResourceUsage::StorageWriteCompute);
+    }
+
+    if(m_occlusionCullingEnabled){
+        BuildOcclusionPasses();
+    }else{
+        uint32_t mainPass = m_renderGraph.AddPass("Main", [this](VkCommandBuffer commandBuffer){
+            RecordMainPass(commandBuffer, MainPassPhase::Full);
+        });
+        m_renderGraph.Write(mainPass, mainColor, ResourceUsage::ColorAttachment);
+        m_renderGraph.Write(mainPass, m_depth, ResourceUsage::DepthStencilAttachment);
+        // Produced on the compute queue, the semaphore wait in DrawFrame already makes it visible
+        m_renderGraph.Read(mainPass, m_particleBuffer, ResourceUsage::VertexBuffer);
+        if(meshletCull) m_renderGraph.Read(mainPass, m_meshletDraws, ResourceUsage::IndirectBuffer);
+    }
+    if(m_dynamicResolutionEnabled) BuildUpscalePasses();
+    if(m_multiviewEnabled) BuildMultiviewPasses();
+
+    if(m_frameReadback.IsEnabled()){
+        uint32_t readbackPass = m_renderGraph.AddPass("Readback", [this](VkCommandBuffer commandBuffer){
+            m_frameReadback.RecordCopy(commandBuffer, m_swapChainImages[m_currentImageIndex], m_currentReadbackSlot);
+        }, true);
+        m_renderGraph.Read(readbackPass, m_backbuffer, ResourceUsage::TransferSrc);
+    }
+
+    m_renderGraph.Compile();
+    if(m_occlusionCullingEnabled){
+        m_occlusionCuller.SetPyramid(m_renderGraph.GetImage(m_depthPyramid), m_renderGraph.GetImageView(m_depthPyramid),
+            m_swapChainExtent, m_depthImageViews);
+    }
+    if(m_dynamicResolutionEnabled && m_dynamicResolution.GetFilter() == UpscaleFilter::Sharpen){
+        m_dynamicResolution.SetTargets(m_sceneColorImageViews, m_renderGraph.GetImageView(m_upscaled));
+    }
+}
+
+void Application::BuildUpscalePasses(){
+    if(m_dynamicResolution.GetFilter() == UpscaleFilter::Bilinear){
+        uint32_t upscalePass = m_renderGraph.AddPass("Upscale", [this](VkCommandBuffer commandBuffer){
+            m_dynamicResolution.RecordBlit(commandBuffer, m_sceneColorImages[m_currentImageIndex], m_renderExtent,
+                m_swapChainImages[m_currentImageIndex], m_swapChainExtent);
+        });
+        m_renderGraph.Read(upscalePass, m_sceneColor, ResourceUsage::TransferSrc);
+        m_renderGraph.Write(upscalePass, m_backbuffer, ResourceUsage::TransferDst);
+        return;
+    }
+
+    // Swap chain images are rarely storage images, the sharpened result is blitted over at the same size
+    RenderGraph::ImageDesc upscaledDesc;
+    upscaledDesc.format = DynamicResolution::UPSCALED_FORMAT;
+    upscaledDesc.extent = m_swapChainExtent;
+    upscaledDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    m_upscaled = m_renderGraph.CreateTransientImage("Upscaled", upscaledDesc);
+
+    uint32_t upscalePass = m_renderGraph.AddPass("Upscale", [this](VkCommandBuffer commandBuffer){
+        m_dynamicResolution.RecordSharpen(commandBuffer, m_currentImageIndex, m_renderExtent, m_swapChainExtent, m_swapChainExtent,
+            &m_telemetry);
+    });
+    m_renderGraph.Read(upscalePass, m_sceneColor, ResourceUsage::SampledCompute);
+    m_renderGraph.Write(upscalePass, m_upscaled, ResourceUsage::StorageWriteCompute);
+
+    uint32_t copyPass = m_renderGraph.AddPass("UpscaleCopy", [this](VkCommandBuffer commandBuffer){
+        m_dynamicResolution.RecordBlit(commandBuffer, m_renderGraph.GetImage(m_upscaled), m_swapChainExtent,
+            m_swapChainImages[m_currentImageIndex], m_swapChainExtent);
+    });
+    m_renderGraph.Read(copyPass, m_upscaled, ResourceUsage::TransferSrc);
+    m_renderGraph.Write(copyPass, m_backbuffer, ResourceUsage::TransferDst);
+}
+
+void Application::BuildOcclusionPasses(){
+    // The draw list region and the visibility are written by the culling passes on the GPU. The visibility carries
+    // over to the next frame, the culler orders that itself
+    m_drawList = m_renderGraph.ImportBuffer("DrawList");
+    m_occlusionDraws = m_renderGraph.ImportBuffer("OcclusionDraws");
+    m_visibility = m_renderGraph.ImportBuffer("Visibility");
+    RenderGraph::ImageDesc pyramidDesc;
+    pyramidDesc.format = OcclusionCuller::PYRAMID_FORMAT;
+    pyramidDesc.extent = OcclusionCuller::GetPyramidExtent(m_swapChainExtent);
+    pyramidDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    pyramidDesc.mipLevels = OcclusionCuller::GetPyramidLevelCount(m_swapChainExtent);
+    m_depthPyramid = m_renderGraph.CreateTransientImage("DepthPyramid", pyramidDesc);
+
+    uint32_t earlyCullPass = m_renderGraph.AddPass("OcclusionEarlyCull", [this](VkCommandBuffer commandBuffer){
+        RecordOcclusionCull(commandBuffer, false);
+    });
+    m_renderGraph.Read(earlyCullPass, m_visibility, ResourceUsage::StorageReadCompute);
+    m_renderGraph.Write(earlyCullPass, m_occlusionDraws, ResourceUsage::StorageWriteCompute);
+    m_renderGraph.Write(earlyCullPass, m_drawList, ResourceUsage::StorageWriteCompute);
+
+    uint32_t earlyPass = m_renderGraph.AddPass("MainEarly", [this](VkCommandBuffer commandBuffer){
+        RecordMainPass(commandBuffer, MainPassPhase::OcclusionEarly);
+    });
+    m_renderGraph.Write(earlyPass, m_backbuffer, ResourceUsage::ColorAttachment);
+    m_renderGraph.Write(earlyPass, m_depth, ResourceUsage::DepthStencilAttachment);
+    m_renderGraph.Read(earlyPass, m_occlusionDraws, ResourceUsage::IndirectBuffer);
+    m_renderGraph.Read(earlyPass, m_drawList, ResourceUsage::StorageReadVertex);
+
+    uint32_t pyramidPass = m_renderGraph.AddPass("DepthPyramid", [this](VkCommandBuffer commandBuffer){
+        m_occlusionCuller.RecordPyramid(commandBuffer, m_currentImageIndex, &m_telemetry);
+    });
+    m_renderGraph.Read(pyramidPass, m_depth, ResourceUsage::DepthStencilRead);
+    m_renderGraph.Write(pyramidPass, m_depthPyramid, ResourceUsage::StorageWriteCompute);
+
+    uint32_t lateCullPass = m_renderGraph.AddPass("OcclusionLateCull", [this](VkCommandBuffer commandBuffer){
+        RecordOcclusionCull(commandBuffer, true);
+    });
+    m_renderGraph.Read(lateCullPass, m_depthPyramid, ResourceUsage::SampledCompute);
+    m_renderGraph.Write(lateCullPass, m_visibility, ResourceUsage::StorageWriteCompute);
+    m_renderGraph.Write(lateCullPass, m_occlusionDraws, ResourceUsage::StorageWriteCompute);
+    m_renderGraph.Write(lateCullPass, m_drawList, ResourceUsage::StorageWriteCompute);
+
+    uint32_t latePass = m_renderGraph.AddPass("MainLate", [this](VkCommandBuffer commandBuffer){
+        RecordMainPass(commandBuffer, MainPassPhase::OcclusionLate);
+    });
+    m_renderGraph.Write(latePass, m_backbuffer, ResourceUsage::ColorAttachment);
+    m_renderGraph.Write(latePass, m_depth, ResourceUsage::DepthStencilAttachment);
+    m_renderGraph.Read(latePass, m_occlusionDraws, ResourceUsage::IndirectBuffer);
+    m_renderGraph.Read(latePass, m_drawList, ResourceUsage::StorageReadVertex);
+    // Produced on the compute queue, the semaphore wait in DrawFrame already makes it visible
+    m_renderGraph.Read(latePass, m_particleBuffer, ResourceUsage::VertexBuffer);
+}
+
+void Application::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex){
+    PROFILE_ZONE(m_profiler, "RecordCommandBuffer");
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+    ThrowIfFailed(vkBeginCommandBuffer(commandBuffer, &beginInfo), 
+        "Failed to begin recording command buffer!");
+
+    m_currentImageIndex = imageIndex;
+    m_profiler.BeginGpuFrame(commandBuffer, static_cast<uint32_t>(m_currentFrame));
+    m_renderExtent = m_mainPassExtent;
+    if(m_dynamicResolutionEnabled){
+        m_dynamicResolution.BeginFrame(commandBuffer, static_cast<uint32_t>(m_currentFrame));
+        m_renderExtent = m_dynamicResolution.GetRenderExtent(m_swapChainExtent);
+    }
+    {
+        PROFILE_GPU_ZONE(m_profiler, commandBuffer, "Frame");
+
+        // Texture uploads go first, the descriptor can then point at the views they produced
+        {
+            PROFILE_GPU_ZONE(m_profiler, commandBuffer, "TextureUploads");
+            m_textureStreamer.RecordUploads(commandBuffer);
+        }
+        UpdateTextureDescriptor(imageIndex);
+
+        m_renderGraph.SetImportedImage(m_backbuffer, m_swapChainImages[imageIndex], m_swapChainImageViews[imageIndex]);
+        m_renderGraph.SetImportedBuffer(m_particleBuffer, m_particleSystem.GetParticleBuffer(m_frameNumber));
+        m_renderGraph.SetImportedImage(m_depth, m_depthImages[imageIndex], m_depthImageViews[imageIndex]);
+        if(IsSceneColorUsed()){
+            m_renderGraph.SetImportedImage(m_sceneColor, m_sceneColorImages[imageIndex], m_sceneColorImageViews[imageIndex]);
+        }
+        if(m_occlusionCullingEnabled){
+            m_renderGraph.SetImportedBuffer(m_drawList, m_drawListBuffer);
+            m_renderGraph.SetImportedBuffer(m_occlusionDraws, m_occlusionCuller.GetDrawBuffer(static_cast<uint32_t>(m_currentFrame)));
+            m_renderGraph.SetImportedBuffer(m_visibility, m_occlusionCuller.GetVisibilityBuffer());
+        }
+        if(m_options.stress.uploadKB > 0) m_renderGraph.SetImportedBuffer(m_stressUpload, m_stressUploadBuffer);
+        if(m_meshletsEnabled && m_meshletPath == MeshletRenderer::Path::Compute){
+            m_renderGraph.SetImportedBuffer(m_meshletDraws, m_meshletRenderer.GetDrawBuffer(static_cast<uint32_t>(m_currentFrame)));
+        }
+        m_renderGraph.Execute(commandBuffer, &m_profiler);
+    }
+    if(m_dynamicResolutionEnabled) m_dynamicResolution.EndFrame(commandBuffer, static_cast<uint32_t>(m_currentFrame));
+
+    ThrowIfFailed(vkEndCommandBuffer(commandBuffer), 
+        "Failed to record command buffer!");
+}
+
+void Application::RecordMainPass(VkCommandBuffer commandBuffer, MainPassPhase phase){
+    std::array<VkClearValue, 2> clearValues = {};
+    clearValues[0].color = {{0.2f, 0.3f, 0.4f, 1.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+    bool load = phase == MainPassPhase::OcclusionLate;
+    if(m_dynamicRenderingEnabled){
+        // The same attachments and operations as the render passes, the render graph moves the images in and out
+        // of the attachment layouts around it
+        VkRenderingAttachmentInfo colorAttachment = {};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = IsSceneColorUsed() ? m_sceneColorImageViews[m_currentImageIndex] :
+            m_swapChainImageViews[m_currentImageIndex];
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = clearValues[0];
+        // Only the depth pyramid reads the depth back, after the early phase
+        VkRenderingAttachmentInfo depthAttachment = {};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = m_depthImageViews[m_currentImageIndex];
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = phase == MainPassPhase::OcclusionEarly ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.clearValue = clearValues[1];
+
+        VkRenderingInfo renderingInfo = {};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset = {0, 0};
+        renderingInfo.renderArea.extent = m_renderExtent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.viewMask = m_multiviewEnabled ? m_multiview.GetViewMask() : 0;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        m_cmdBeginRendering(commandBuffer, &renderingInfo);
+    }else{
         VkRenderPassBeginInfo renderPassInfo = {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = m_renderPass;
-        renderPassInfo.framebuffer = m_swapChainFramebuffers[i];
+        renderPassInfo.renderPass = load ? m_loadRenderPass : m_renderPass;
+        renderPassInfo.framebuffer = m_swapChainFramebuffers[m_currentImageIndex];
         renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = m_swapChainExtent;
-        VkClearValue clearColor = {0.2f, 0.3f, 0.4f, 1.0f};
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
-        vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    
-        vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
-        
-        VkBuffer vertexBuffer[] = {m_vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(m_commandBuffers[i],0,1,vertexBuffer,offsets);
-        
-        vkCmdBindIndexBuffer(m_commandBuffers[i], m_indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+        renderPassInfo.renderArea.extent = m_renderExtent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
 
-        vkCmdDrawIndexed(m_commandBuffers[i], static_cast<uint32_t>(g_indices.size()), 1, 0, 0, 0);
+    // Every pipeline of the main pass takes its viewport from here, the part of the targets drawn this frame
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(m_renderExtent.width);
+    viewport.height = static_cast<float>(m_renderExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor = {};
+    scissor.offset = {0, 0};
+    scissor.extent = m_renderExtent;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // The matrices and draw list of the current frame packet, in binding order
+    DrawMaterial materials[DRAW_MATERIAL_COUNT] = {};
+    materials[SCENE_MATERIAL].descriptorSet = m_descriptorSets[m_currentImageIndex];
+    materials[SCENE_MATERIAL].dynamicOffsetCount = 2;
+    materials[SCENE_MATERIAL].dynamicOffsets[0] = static_cast<uint32_t>(m_currentFramePacket * m_objectBufferStride);
+    materials[SCENE_MATERIAL].dynamicOffsets[1] = static_cast<uint32_t>(m_currentFramePacket * m_drawListBufferStride);
+
+    DrawMesh meshes[DRAW_MESH_COUNT] = {};
+    meshes[QUAD_MESH] = {m_vertexBuffer, 0, m_indexBuffer, VK_INDEX_TYPE_UINT16};
+
+    DrawBindings bindings = {m_drawPipelines.data(), static_cast<uint32_t>(m_drawPipelines.size()), materials, DRAW_MATERIAL_COUNT,
+        meshes, DRAW_MESH_COUNT};
+    if(phase != MainPassPhase::Full){
+        // The list of this phase with the scene pipeline, every object on its first copy
+        const DrawMaterial& scene = materials[SCENE_MATERIAL];
+        VkDeviceSize offset = 0;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipelines[SCENE_PIPELINE]);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &scene.descriptorSet,
+            scene.dynamicOffsetCount, scene.dynamicOffsets);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+        m_telemetry.Count(TelemetryCounter::PipelineBinds);
+        if(phase == MainPassPhase::OcclusionEarly){
+            m_occlusionCuller.RecordEarlyDraw(commandBuffer, static_cast<uint32_t>(m_currentFrame), &m_telemetry);
+        }else{
+            m_occlusionCuller.RecordLateDraw(commandBuffer, static_cast<uint32_t>(m_currentFrame), &m_telemetry);
+        }
+    }else if(!m_meshletsEnabled){
+        m_framePackets[m_currentFramePacket].drawQueue.Record(commandBuffer, bindings, &m_telemetry);
+    }else{
+        const DrawMaterial& scene = materials[SCENE_MATERIAL];
+        if(m_meshletPath == MeshletRenderer::Path::Compute){
+            // The culled draws index into the scene mesh with the scene pipeline, every object on its first copy
+            VkDeviceSize offset = 0;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipelines[SCENE_PIPELINE]);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &scene.descriptorSet,
+                scene.dynamicOffsetCount, scene.dynamicOffsets);
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer, &offset);
+            vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+            m_telemetry.Count(TelemetryCounter::PipelineBinds);
+        }
+        m_meshletRenderer.RecordDraw(commandBuffer, static_cast<uint32_t>(m_currentFrame), scene.descriptorSet, scene.dynamicOffsets,
+            scene.dynamicOffsetCount, GetMeshletView(), GetDrawListInstanceCount(), &m_telemetry);
+    }
 
-        vkCmdEndRenderPass(m_commandBuffers[i]);
+    // Particles simulated on the compute queue for this frame, on top of the whole scene
+    if(phase != MainPassPhase::OcclusionEarly) m_particleSystem.RecordDraw(commandBuffer, m_frameNumber, &m_telemetry);
 
-        ThrowIfFailed(vkEndCommandBuffer(m_commandBuffers[i]), 
-            "Failed to record command buffer!");
+    if(m_dynamicRenderingEnabled){
+        m_cmdEndRendering(commandBuffer);
+    }else{
+        vkCmdEndRenderPass(commandBuffer);
     }
+}
+
+void Application::RecordMeshletCull(VkCommandBuffer commandBuffer){
+    uint32_t dynamicOffsets[] = {
+        static_cast<uint32_t>(m_currentFramePacket * m_objectBufferStride),
+        static_cast<uint32_t>(m_currentFramePacket * m_drawListBufferStride)
+    };
+    m_meshletRenderer.RecordCull(commandBuffer, static_cast<uint32_t>(m_currentFrame), m_descriptorSets[m_currentImageIndex],
+        dynamicOffsets, 2, GetMeshletView(), GetDrawListInstanceCount(), &m_telemetry);
+}
 
+void Application::RecordOcclusionCull(VkCommandBuffer commandBuffer, bool late){
+    uint32_t dynamicOffsets[] = {
+        static_cast<uint32_t>(m_currentFramePacket * m_objectBufferStride),
+        static_cast<uint32_t>(m_currentFramePacket * m_drawListBufferStride)
+    };
+    uint32_t frame = static_cast<uint32_t>(m_currentFrame);
+    if(late){
+        const FramePacket& packet = m_framePackets[m_currentFramePacket];
+        m_occlusionCuller.RecordLateCull(commandBuffer, frame, m_descriptorSets[m_currentImageIndex], dynamicOffsets, 2,
+            packet.projection * packet.view, GetDrawListInstanceCount(), &m_telemetry);
+    }else{
+        m_occlusionCuller.RecordEarlyCull(commandBuffer, frame, m_descriptorSets[m_currentImageIndex], dynamicOffsets, 2,
+            GetDrawListInstanceCount(), &m_telemetry);
+    }
 }
 
 void Application::CreateSyncObjects(){
+    PROFILE_ZONE(m_profiler, "CreateSyncObjects");
     m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     m_inflightFences.resize(MAX_FRAMES_IN_FLIGHT);
@@ -1200,9 +3356,9 @@ void Application::CreateSyncObjects(){
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     
     for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
-        if(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(m_device, &fenceInfo, nullptr, &m_inflightFences[i]) != VK_SUCCESS)
+        if(vkCreateSemaphore(m_device, &semaphoreInfo, GetAllocationCallbacks(), &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(m_device, &semaphoreInfo, GetAllocationCallbacks(), &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
+            vkCreateFence(m_device, &fenceInfo, GetAllocationCallbacks(), &m_inflightFences[i]) != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to create synchronization objects for a frame!");
         }
@@ -1210,17 +3366,52 @@ void Application::CreateSyncObjects(){
 }
 
 void Application::DrawFrame(){
+    PROFILE_ZONE(m_profiler, "DrawFrame");
+    // Nothing of the frame is done before the pacer lets it start, so it is as recent as possible when shown
+    if(m_framePacingEnabled){
+        PROFILE_ZONE(m_profiler, "FramePacing");
+        m_framePacer.WaitForFrameStart();
+    }
     // Wait for the n-th frame(specified by m_currentFrame) finishing
-    vkWaitForFences(m_device, 1, &m_inflightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+    if(m_framePacingEnabled) m_framePacer.BeginBlockingWait();
+    {
+        PROFILE_ZONE(m_profiler, "WaitForFrameFence");
+        vkWaitForFences(m_device, 1, &m_inflightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    if(m_framePacingEnabled) m_framePacer.EndBlockingWait();
+    m_profiler.CollectGpuFrame(static_cast<uint32_t>(m_currentFrame));
+    if(m_dynamicResolutionEnabled) m_dynamicResolution.Update(static_cast<uint32_t>(m_currentFrame));
+    ReleaseStagedUploads(false);
+    // So is the frame packet it drew, the simulation can refill it
+    if(m_framePacketsInFlight[m_currentFrame] != NO_FRAME_PACKET){
+        m_freeFramePackets.TryPush(m_framePacketsInFlight[m_currentFrame]);
+        m_framePacketsInFlight[m_currentFrame] = NO_FRAME_PACKET;
+    }
+    // The copies of that frame are complete too, hand them to the readback worker
+    m_frameReadback.Retire(static_cast<uint32_t>(m_currentFrame));
+    m_textureStreamer.BeginFrame(m_frameNumber, static_cast<uint32_t>(m_currentFrame));
+    // What the GPU drew and culled in that frame, counted towards the one starting here
+    if(m_occlusionCullingEnabled){
+        OcclusionStats occlusion = m_occlusionCuller.BeginFrame(static_cast<uint32_t>(m_currentFrame));
+        m_telemetry.Count(TelemetryCounter::ObjectsDrawn, occlusion.drawn);
+        m_telemetry.Count(TelemetryCounter::ObjectsOccluded, occlusion.occluded);
+    }
 
-    // Acquire an image from the swap chain
+    // Acquire an image from the swap chain, headless runs own one image per frame in flight
+    if(m_framePacingEnabled) m_framePacer.BeginBlockingWait();
     uint32_t imageIndex;
-    auto result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
-    if(result == VK_ERROR_OUT_OF_DATE_KHR){
-        RecreateSwapChain();
-        return;
-    }else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR){
-        throw std::runtime_error("Failed to acquire swap chain image!");
+    VkResult result = VK_SUCCESS;
+    if(m_options.headless){
+        imageIndex = static_cast<uint32_t>(m_currentFrame);
+    }else{
+        PROFILE_ZONE(m_profiler, "AcquireNextImage");
+        result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if(result == VK_ERROR_OUT_OF_DATE_KHR){
+            RecreateSwapChain();
+            return;
+        }else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR){
+            throw std::runtime_error("Failed to acquire swap chain image!");
+        }
     }
 
     // Check if a previous frame is using this image 
@@ -1229,31 +3420,83 @@ void Application::DrawFrame(){
     }
     // Mark the image as now being in use by this frame
     m_imagesInFlight[imageIndex] = m_inflightFences[m_currentFrame];
+    if(m_framePacingEnabled) m_framePacer.EndBlockingWait();
 
+    // Usually ready already, the simulation of this frame overlapped the waits above
+    m_currentFramePacket = AcquireFramePacket();
+    m_framePacketsInFlight[m_currentFrame] = m_currentFramePacket;
     UpdateUniformBuffer(imageIndex);
 
+    if(m_frameReadback.IsEnabled()){
+        m_currentReadbackSlot = m_frameReadback.AcquireSlot(m_frameNumber);
+    }
+
+    // The fence wait above guarantees the GPU is done with this frame's command buffer
+    vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
+    RecordCommandBuffer(m_commandBuffers[m_currentFrame], imageIndex);
+
     // Submitting the command buffer
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;// Specify which semaphores to wait on before execution
+    // Particles are only consumed as vertices, so the graphics work before vertex input is not held back
+    // The swap chain image wait blocks whatever stage the render graph touches it first in. The legacy stage
+    // bits share their values with the synchronization2 ones
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStages[2];
+    uint32_t waitCount = 0;
+    if(!m_options.headless){
+        waitSemaphores[waitCount] = m_imageAvailableSemaphores[m_currentFrame];
+        waitStages[waitCount++] = static_cast<VkPipelineStageFlags>(m_renderGraph.GetSemaphoreWaitStage(m_backbuffer));
+    }
+    waitSemaphores[waitCount] = m_particleSystem.GetSimulationFinishedSemaphore(m_frameNumber);
+    waitStages[waitCount++] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    submitInfo.waitSemaphoreCount = waitCount;// Specify which semaphores to wait on before execution
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;// And in which stages of the pipeline to wait
     submitInfo.commandBufferCount = 1;// Specify which command buffers to actually submit for execution
-    submitInfo.pCommandBuffers = &m_commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &m_commandBuffers[m_currentFrame];
     VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;// Specify which semaphores to signal once the command buffers have finished execution
+    submitInfo.signalSemaphoreCount = m_options.headless ? 0 : 1;// Specify which semaphores to signal once the command buffers have finished execution
     submitInfo.pSignalSemaphores = signalSemaphores;
     
     // We manually need to restore the fence to the unsignaled state before actually using the fance
     vkResetFences(m_device, 1, &m_inflightFences[m_currentFrame]);
     
     // Submit the command buffer to the graphics queue and the fence will be signaled once the command buffer finished executing
-    ThrowIfFailed(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inflightFences[m_currentFrame]),
-        "Failed to submit draw command buffer!");
+    {
+        PROFILE_ZONE(m_profiler, "QueueSubmit");
+        ThrowIfFailed(vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inflightFences[m_currentFrame]),
+            "Failed to submit draw command buffer!");
+        m_telemetry.Count(TelemetryCounter::QueueSubmits);
+    }
+    if(m_framePacingEnabled) m_framePacer.FrameSubmitted();
+    if(m_frameReadback.IsEnabled()){
+        m_frameReadback.Submitted(m_currentReadbackSlot, static_cast<uint32_t>(m_currentFrame));
+    }
+
+    // Simulate the particles of the next frame on the compute queue while this frame renders
+    auto now = std::chrono::high_resolution_clock::now();
+    float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(now - m_lastSimulationTime).count();
+    m_lastSimulationTime = now;
+    // Packets come out of the simulation in order, so this frame drew captured frame m_frameNumber too. The step
+    // drawn with the first captured frame seeds the particles again, so every replay iteration draws the same ones
+    bool resetParticles = false;
+    if(IsReplaying()){
+        const uint32_t capturedFrames = m_captureReader.GetFrameCount();
+        deltaTime = m_captureReader.GetFrame(m_frameNumber % capturedFrames).particleDeltaTime;
+        resetParticles = (m_frameNumber + 1) % capturedFrames == 0;
+    }
+    m_particleSystem.SubmitSimulation(m_frameNumber + 1, deltaTime, resetParticles, &m_telemetry);
+    if(m_captureWriter.IsOpen()) WriteCaptureFrame(deltaTime);
+
+    // Presentation, headless frames leave through the readback only
+    if(m_options.headless){
+        if(m_framePacingEnabled) m_framePacer.FramePresented();
+        m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        m_frameNumber++;
+        return;
+    }
 
-    // Presentation
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;// Specify which semaphores to wait on before presentation can happen
@@ -1263,7 +3506,12 @@ void Application::DrawFrame(){
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
-    result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    if(m_framePacingEnabled) m_framePacer.PreparePresent(presentInfo);
+    {
+        PROFILE_ZONE(m_profiler, "QueuePresent");
+        result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    }
+    if(m_framePacingEnabled) m_framePacer.FramePresented();
     if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_frameBufferResized){
         m_frameBufferResized = false;
         RecreateSwapChain();
@@ -1273,19 +3521,25 @@ void Application::DrawFrame(){
 
     // Advance to the next frame
     m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    m_frameNumber++;
 }
 
 void Application::UpdateUniformBuffer(uint32_t currentImage){
-    static auto startTime = std::chrono::high_resolution_clock::now();
-
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+    PROFILE_ZONE(m_profiler, "UpdateUniformBuffer");
+    const FramePacket& packet = m_framePackets[m_currentFramePacket];
 
     UniformBufferObject ubo = {};
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f,0.0f,1.0f));
-    ubo.view = glm::lookAt(glm::vec3(2.0f,2.0f,2.0f), glm::vec3(0.0f,0.0f,0.0f), glm::vec3(0.0f,0.0f,1.0f));
-    ubo.proj = glm::perspective(glm::radians(45.0f), static_cast<float>(m_swapChainExtent.width) / m_swapChainExtent.height, 0.1f, 100.0f);
-    ubo.proj[1][1] *= -1;
+    glm::mat4 views[Multiview::MAX_VIEW_COUNT];
+    m_multiview.GetViewMatrices(packet.view, views);
+    for(uint32_t i = 0; i < m_multiview.GetViewCount(); i++){
+        ubo.views[i].view = views[i];
+        ubo.views[i].proj = packet.projection;
+    }
+
+    // The streamer is only touched on this thread, the simulation just measured how large the texture appears.
+    // Replays keep what LoadReplayTextures made resident, whatever the captured coverage asks for
+    if(IsReplaying()) m_textureStreamer.RequestAllLevels(m_texture);
+    else m_textureStreamer.RequestCoverage(m_texture, packet.textureCoverage.x, packet.textureCoverage.y);
 
     void* data;
     vkMapMemory(m_device, m_uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
@@ -1294,13 +3548,13 @@ void Application::UpdateUniformBuffer(uint32_t currentImage){
 }
 
 void Application::RecreateSwapChain(){
+    PROFILE_ZONE(m_profiler, "RecreateSwapChain");
     // Pause the app when minimized
-    int width = 0, height = 0;
-    glfwGetFramebufferSize(m_window, &width, &height);
-    while (width ==0 || height == 0)
+    UpdateFramebufferSize();
+    while (m_framebufferSize.width == 0 || m_framebufferSize.height == 0)
     {
-        glfwGetFramebufferSize(m_window, &width, &height);
         glfwWaitEvents();
+        UpdateFramebufferSize();
     }
     
 
@@ -1312,13 +3566,26 @@ void Application::RecreateSwapChain(){
 
     // Recreate the swapchain itself
     CreateSwapChain();
+    if(m_framePacingEnabled) m_framePacer.SetSwapChain(m_swapChain);
+    m_frameReadback.Resize(m_swapChainExtent, m_swapChainImageFormat);
     // Recreate image views and render pass because they are based on the format of the swapchain images
     CreateImageViews();
+    CreateDepthResources();
+    CreateSceneColorResources();
     CreateRenderPass();
-    // Recreate graphics pipeline because viewport and scissor retangle size are specified during its creation
+    // Recreate graphics pipelines because they are created against the render pass or the attachment formats
     CreateGraphicsPipeline();
-    // Recreate frame buffers and command buffers because they directly depend on the swap chain images
+    m_particleSystem.CreateGraphicsPipeline(GetMainPassTarget());
+    if(m_meshletsEnabled){
+        m_meshletRenderer.CreateGraphicsPipeline(GetMainPassTarget(), GetSceneRasterizerInfo(), GetSceneDepthStencilInfo(),
+            m_fragShaderCode.GetBytes());
+    }
+    // Recreate frame buffers and per-image uniforms because they directly depend on the swap chain images. Without a
+    // render pass there are no framebuffers, the image views are handed to vkCmdBeginRendering each frame
     CreateFramebuffers();
     CreateUniformBuffers();
-    CreateCommandBuffers();
+    CreateDescriptorPool();
+    CreateDescriptorSets();
+    BuildRenderGraph();
+    m_imagesInFlight.assign(m_swapChainImages.size(), VK_NULL_HANDLE);
 }
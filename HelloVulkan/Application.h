@@ -1,9 +1,138 @@
-#define GLFW_INCLUDE_VULKAN
-#include <GLFW/glfw3.h>
+#include "DrawListBuilder.h"
+#include "DrawQueue.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "FrameReadback.h"
+#include "JobScheduler.h"
+#include "Logger.h"
+#include "MeshletRenderer.h"
+#include "Multiview.h"
+#include "OcclusionCuller.h"
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "Scene.h"
+#include "SpscQueue.h"
+#include "Telemetry.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include "VulkanCommon.h"
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
 #include <optional>
+#include <set>
+#include <string>
+#include <thread>
 #include <vector>
 
+// A procedurally generated scene to measure with, in place of the default one
+struct StressSceneOptions{
+    // Zero draws the default scene
+    uint32_t objectCount = 0;
+    // Every object is a grid over the unit quad with about this many triangles, at most MAX_STRESS_TRIANGLES
+    uint32_t trianglesPerObject = 2;
+    // Copies of the scene pipeline the objects are spread over, so every frame binds each of them
+    uint32_t pipelineCount = 1;
+    // Copied from host memory into a device-local buffer every frame
+    uint32_t uploadKB = 0;
+};
+
+// How the scene mesh is drawn
+enum class MeshletMode{
+    Off,// Whole meshes through the draw queue
+    Auto,// Meshlets on the best path the device supports, whole meshes without one
+    Compute,// Meshlets culled by a compute pass into indirect draws
+    MeshShader// Meshlets culled by task shaders and emitted by mesh shaders
+};
+
+// Settings supplied from the command line or the environment
+struct ApplicationOptions{
+    // Substring of the device name or the device UUID of the GPU to use. Falls back to the
+    // HELLOVULKAN_DEVICE environment variable when empty
+    std::string preferredDevice;
+
+    // Render into offscreen images without a window or swap chain
+    bool headless = false;
+    // Size of the window, or of the offscreen images when headless
+    uint32_t width = 800;
+    uint32_t height = 600;
+    // Stop after this many frames, 0 runs until the window is closed
+    uint64_t frameCount = 0;
+
+    // Copy every finished frame back to the host and write it into @readbackDirectory
+    ReadbackFormat readbackFormat = ReadbackFormat::None;
+    std::string readbackDirectory = ".";
+    // Number of host buffers frames can be queued in while the writer catches up
+    uint32_t readbackRingSize = 4;
+
+    // Directories or .pak archives searched for assets before the working directory, the last one first
+    std::vector<std::string> assetMounts;
+    // Where compiled pipelines are kept between runs, empty disables the on-disk cache
+    std::string pipelineCacheFile = "pipeline_cache.bin";
+
+    // Device memory textures may occupy in MiB, levels beyond it are streamed out
+    uint32_t textureBudgetMB = 256;
+    // KTX2 file loaded through the mounts and drawn on the quad, a procedural checkerboard when empty
+    std::string texture;
+
+    // Threads the per-frame scene work is spread over, zero uses every core
+    uint32_t jobThreads = 0;
+
+    // Where log messages go, stderr when empty
+    std::string logFile;
+    LogFormat logFormat = LogFormat::Text;
+    // Less severe messages are discarded before they are formatted
+    LogSeverity logSeverity = LogSeverity::Info;
+    // Messages accepted per second for each validation message ID, zero for no limit
+    uint32_t logRateLimit = 20;
+
+    // Chrome trace of CPU and GPU zones written on exit, profiling stays off when empty
+    std::string profileFile;
+
+    // Vulkan call counts and memory heap usage are written here every telemetryInterval frames, nowhere when empty
+    std::string telemetryFile;
+    TelemetryFormat telemetryFormat = TelemetryFormat::Csv;
+    uint32_t telemetryInterval = 60;
+
+    // Every frame drawn is recorded into this file, nothing when empty
+    std::string captureFile;
+    // Draw the frames of this capture instead of simulating, headless at the size it was recorded with, replayIterations
+    // times over. Window size, texture and frame count come from the capture
+    std::string replayFile;
+    uint32_t replayIterations = 1;
+
+    StressSceneOptions stress;
+    // Frame times, CPU and GPU time per zone, memory use and Vulkan call counts are written here as JSON on exit,
+    // nowhere when empty. The first frames are left out as warm-up
+    std::string benchmarkFile;
+
+    // Draw the scene mesh as meshlets culled on the GPU, a path the device cannot take falls back to the next one
+    MeshletMode meshlets = MeshletMode::Off;
+    // Skip objects hidden behind what was drawn, tested on the GPU against a depth pyramid. Not combined with meshlets
+    bool occlusionCulling = false;
+    // Begin the main pass on the attachment views with VK_KHR_dynamic_rendering where the device supports it, render
+    // pass and framebuffer objects otherwise or when false
+    bool dynamicRendering = true;
+    // GPU time in milliseconds a frame is kept within by drawing the scene at a lower resolution and upscaling it,
+    // zero draws at the window size. Not combined with occlusion culling
+    float gpuBudgetMs = 0.0f;
+    // Bounds of the render scale per axis, in percent of the window size
+    uint32_t minResolutionPercent = 50;
+    uint32_t maxResolutionPercent = 100;
+    UpscaleFilter upscaleFilter = UpscaleFilter::Bilinear;
+    // Start frames just in time for the display instead of as soon as the fences allow, and report the jitter of
+    // the present-to-present intervals
+    FramePacingMode framePacing = FramePacingMode::Off;
+    // Frames per second paced to, zero follows the display, 60 when headless
+    uint32_t targetFrameRate = 0;
+    // Draw the scene from every view of the mode in a single pass, each into its own tile of the window. Not combined
+    // with meshlets, occlusion culling or dynamic resolution
+    MultiviewMode multiview = MultiviewMode::Off;
+};
 
 class Application
 {
@@ -11,6 +140,8 @@ private:
     struct QueueFamilyIndices{
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        // Prefers a family without graphics support so compute work can run asynchronously
+        std::optional<uint32_t> computeFamily;
 
         bool IsComplete() {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -23,10 +154,52 @@ private:
         std::vector<VkPresentModeKHR> presentModes;
     };
 
+    // Everything the simulation thread hands the render thread for one frame. The world matrices and draw list
+    // are in the packet's region of the object and draw-list buffers
+    struct FramePacket{
+        float time;
+        glm::mat4 view;
+        glm::mat4 projection;
+        // Screen area of the largest quad in pixels
+        glm::vec2 textureCoverage;
+        DrawListBuilder::Result drawList;
+        // Sorted by the simulation thread, recorded by the render thread
+        DrawQueue drawQueue;
+    };
+
+    // Draw packets name their state by these IDs, RecordMainPass resolves them to the current handles
+    // Stress scenes add copies of the scene pipeline after it
+    enum DrawPipelineId : uint32_t{ SCENE_PIPELINE };
+    enum DrawMaterialId : uint32_t{ SCENE_MATERIAL, DRAW_MATERIAL_COUNT };
+    enum DrawMeshId : uint32_t{ QUAD_MESH, DRAW_MESH_COUNT };
+    static constexpr uint32_t MAX_DRAW_PACKETS = 1024;
+    static constexpr uint32_t MAX_STRESS_PIPELINES = 64;
+    // The grid of a stress object must be indexable with 16 bits
+    static constexpr uint32_t MAX_STRESS_TRIANGLES = 2 * 254 * 254;
+
+    // Triple buffered: while the render thread draws one packet and the GPU may still read the one before, the
+    // simulation fills the third. One more than the frames in flight
+    static constexpr uint32_t FRAME_PACKET_COUNT = 3;
+    static constexpr uint32_t NO_FRAME_PACKET = UINT32_MAX;
+
+    // The main pass draws the whole frame, or is split around the depth pyramid when occlusion culling
+    enum class MainPassPhase{
+        Full,
+        OcclusionEarly,// Clears, then draws what was visible last frame
+        OcclusionLate// Loads, then draws what became visible and the particles
+    };
+
 public:
+    explicit Application(const ApplicationOptions& options = ApplicationOptions());
+
     // Call this function to run the program
     void Run();
 
+    // Receive every finished frame on the readback worker thread instead of writing files. Call before Run
+    void SetReadbackCallback(std::function<void(const ReadbackFrame&)> callback) { m_readbackCallback = std::move(callback); }
+    // Call counts of the last frame and so far, with the memory heaps' budget and usage. Callable from any thread
+    TelemetrySnapshot GetTelemetrySnapshot() const { return m_telemetry.GetSnapshot(); }
+
 private:
     // Main loop
     void MainLoop();
@@ -35,6 +208,14 @@ private:
     void InitWindow();
     // Initialize Vulank staffs
     void InitVulkan();
+    // Add a step of the startup graph, run on the job scheduler once every step in @dependencies has. @name must
+    // be a string literal
+    JobScheduler::JobHandle AddStartupStep(const char* name, std::function<void()> step,
+        const std::vector<JobScheduler::JobHandle>& dependencies = {});
+    // Log how long each startup step took and when it ran
+    void ReportStartupTimes();
+    // Milliseconds since Run was called
+    double GetMillisecondsSinceStart() const;
 
     // Clean up all resources using by Vulkan and GLFW
     void Cleanup();
@@ -44,11 +225,15 @@ private:
     // Create a Vulkan instance
     void CreateInstance();
 
-    // Look up all suitable pyhsical devices(GPUs) and pick up the first one
+    // Look up all suitable pyhsical devices(GPUs) and pick up the one with the highest score,
+    // unless a specific device is requested by name or UUID
     void PickPhysicalDevice();
-    bool IsPhysicalDeviceSuitable(VkPhysicalDevice device);
+    // Check the hard requirements of @device, filling @rejectReason when it can not be used
+    bool IsPhysicalDeviceSuitable(VkPhysicalDevice device, std::string& rejectReason);
+    // Rank a suitable @device by type, device-local memory, queue topology and optional features
+    uint64_t RatePhysicalDevice(VkPhysicalDevice device);
 
-    // Loop up all queue fanilies of the @device and pick up the first suitable one
+    // Loop up all queue fanilies of the @device and pick up the most suitable ones
     QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
 
     // Setup debug messenger through validation layers
@@ -57,27 +242,141 @@ private:
     SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device);
     void CreateLogicalDevice();
     void CreateSurface();
+    // Mount the asset directories every file is loaded through
+    void MountAssets();
+    // Seed the pipeline cache from the file the last run saved, and save it back on exit
+    void CreatePipelineCache();
+    bool IsPipelineCacheCompatible(ByteSpan data);
+    void SavePipelineCache();
     VkSurfaceFormatKHR ChooseSwapChainSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
     VkPresentModeKHR ChooseSwapChainPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
+    // Query the window's framebuffer size, on the main thread only
+    void UpdateFramebufferSize();
     VkExtent2D ChooseSwapChainExtent(const VkSurfaceCapabilitiesKHR& capabilities);
     void CreateSwapChain();
+    // Create the images rendered into instead of the swap chain when headless
+    void CreateOffscreenImages();
+    bool IsReadbackRequested() const;
+    void CreateFrameReadback();
+    // Device extensions this run can not do without
+    std::vector<const char*> GetRequiredDeviceExtensions() const;
     void CreateImageViews();
+    // A depth buffer per swap chain image, in the first format the device can both render to and sample
+    void CreateDepthResources();
+    VkFormat FindDepthFormat();
     void CreateDescriptorSetLayout();
+    void CreateDescriptorPool();
+    void CreateDescriptorSets();
+    // Point the texture binding of set @imageIndex at the current image views if residency changed
+    void UpdateTextureDescriptor(uint32_t imageIndex);
+    void CreateTextures();
+    // Read the SPIR-V of the graphics pipeline, kept for when the swap chain is recreated
+    void LoadShaders();
     void CreateGraphicsPipeline();
-    VkShaderModule CreateShaderModule(const std::vector<char>& code);
+    VkShaderModule CreateShaderModule(ByteSpan code);
+    // Neither creates anything with dynamic rendering
     void CreateRenderPass();
     void CreateFramebuffers();
+    // Use dynamic rendering when asked for and supported, before the device is created
+    void SelectRenderingPath();
+    static bool IsDynamicRenderingSupported(VkPhysicalDevice device);
+    // What the scene, particle and meshlet pipelines draw into
+    RenderTarget GetMainPassTarget() const;
     void CreateCommandPool();
     void CreateCommandBuffers();
+    // Declare the passes of a frame and the resources they use, then compile the graph. Follows the swap chain
+    void BuildRenderGraph();
+    // The culling passes of both occlusion phases, each followed by the part of the main pass it drew
+    void BuildOcclusionPasses();
+    // Record the render graph of the current frame targeting swap chain image @imageIndex
+    void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void RecordMainPass(VkCommandBuffer commandBuffer, MainPassPhase phase);
+    // Cull the meshlets of every instance in the current frame packet, compute path only
+    void RecordMeshletCull(VkCommandBuffer commandBuffer);
+    // Pick the meshlet path from the options and what the device supports, before the device is created
+    void SelectMeshletPath();
+    void CreateMeshletRenderer();
+    MeshletRenderer::View GetMeshletView() const;
+    // Every instance of the current frame packet's draw list
+    uint32_t GetDrawListInstanceCount() const;
+    // Turn occlusion culling on when asked for and possible, before the device is created
+    void SelectOcclusionCulling();
+    void CreateOcclusionCuller();
+    // One phase of occlusion culling over the current frame packet's draw list
+    void RecordOcclusionCull(VkCommandBuffer commandBuffer, bool late);
+    // Turn dynamic resolution on when a budget is given and the device can upscale, before the device is created
+    void SelectDynamicResolution();
+    void CreateDynamicResolution();
+    // A target per swap chain image the scene is drawn into before it is upscaled
+    void CreateSceneColorResources();
+    // Bring the scene color of the current frame to the size of the back buffer
+    void BuildUpscalePasses();
+    // Turn multiview on when asked for and supported, before the device is created
+    void SelectMultiview();
+    // Copy the views drawn into the layers of the scene color into their tiles of the back buffer
+    void BuildMultiviewPasses();
+    // The main pass draws into the scene color instead of the back buffer
+    bool IsSceneColorUsed() const { return m_dynamicResolutionEnabled || m_multiviewEnabled; }
+    // Pick where the frame pacer measures presents, before the device is created
+    void SelectFramePacing();
+    void CreateFramePacer();
+    // Log the present intervals the frame pacer measured
+    void ReportFramePacing();
+    // Log the host memory the driver allocated through the allocation callbacks, once everything was destroyed
+    void ReportHostMemory();
     void CreateVertexBuffer();
     void CreateIndexBuffer();
     void CreateUniformBuffers();
+    // A hierarchy of quads, each drawn as an instance
+    void CreateScene();
+    // Objects scattered around the origin, for the stress scene
+    void CreateStressScene();
+    // The grid every object of the stress scene is drawn with
+    void BuildStressGeometry();
+    // The buffers the stress scene uploads through every frame
+    void CreateStressUploadBuffers();
+    // Fill this frame's region of the staging buffer and copy it over
+    void RecordStressUpload(VkCommandBuffer commandBuffer);
+    // Write the results of a benchmark run to the benchmark file
+    void WriteBenchmarkResults();
+    // The buffers the scene writes its world matrices and draw list into, a region for each frame packet
+    void CreateFramePacketBuffers();
+
+    // The simulation thread runs ahead of the render thread by up to the free frame packets
+    void StartSimulation();
+    void StopSimulation();
+    void SimulationLoop();
+    // Animate the scene, then build its matrices and draw list into frame packet @packet on the job scheduler
+    void UpdateScene(uint32_t packet);
+    // Fill frame packet @packet from the next captured frame instead of simulating, on the simulation thread
+    void ReplayScene(uint32_t packet);
+    // Wait for the next packet the simulation finished, rethrowing whatever stopped it
+    uint32_t AcquireFramePacket();
+    bool IsReplaying() const { return m_captureReader.IsOpen(); }
+    // The geometry uploaded at startup, from the capture when replaying
+    ByteSpan GetVertexData() const;
+    ByteSpan GetIndexData() const;
+    // Start recording frames into the capture file
+    void OpenCapture();
+    // Record what the current frame packet drew, with the time step of the particle simulation submitted with it
+    void WriteCaptureFrame(float particleDeltaTime);
+    // Log how long each replay iteration and the frames in it took
+    void ReportReplayTimes();
+    // Upload every texture level the budget holds before the first replayed frame, so no timed frame streams
+    void LoadReplayTextures();
+    bool IsFrameTimingRequested() const { return IsReplaying() || !m_options.benchmarkFile.empty(); }
     void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-    void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    // Record a copy of @size bytes from @data into @dstBuffer, through a staging buffer, into the startup upload
+    void StageBufferUpload(const void* data, VkDeviceSize size, VkBuffer dstBuffer);
+    // Submit the staged copies without waiting for them, later submissions on the graphics queue see their results
+    void SubmitStagedUploads();
+    // Free the staging buffers once the upload has finished, or wait for it to when @wait
+    void ReleaseStagedUploads(bool wait);
     void CreateSyncObjects();
     void DrawFrame();
     void RecreateSwapChain();
     uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertices);
+    // Write the camera of the current frame packet into the uniform buffer of @currentImage
     void UpdateUniformBuffer(uint32_t currentImage);
 
 private:
@@ -86,11 +385,19 @@ private:
     // Check if the Vulkan extensions required by GLFW are supported by local Vulkan 
     static bool CheckGLFWExtensionSupport();
     // Check if the extensions we need for specific physical device are supported by that device 
-    static bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
-    // Fill @createInfo with necessary debug messenger creation infomations
-    static void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
-    // Return all extensions that are actually needed for this application
-    static std::vector<const char*> GetRequiredExtensions();
+    static bool CheckDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& requiredExtensions,
+        std::set<std::string>& missingExtensions);
+    // Check if a single, optional @extensionName is supported by @device
+    static bool IsDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
+    // Format the UUID of @device as xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx, empty when it supports only Vulkan 1.0
+    static std::string GetPhysicalDeviceUUID(VkPhysicalDevice device);
+    // Check if @device is the one named by @preferred, either by a case-insensitive substring of its name or by its UUID
+    static bool MatchesPreferredDevice(VkPhysicalDevice device, const std::string& preferred);
+    // Fill @createInfo with necessary debug messenger creation infomations, the messages go to @logger
+    static void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo, Logger* logger);
+    // Return all extensions that are actually needed for this application, GLFW's are left out when @headless
+    // @debugUtils asks for VK_EXT_debug_utils even without validation layers, when the implementation has it
+    static std::vector<const char*> GetRequiredExtensions(bool headless, bool debugUtils);
     // Callback function that handles messages from Validation layers
     static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -99,6 +406,23 @@ private:
         void *pUserData);
 
 private:
+    ApplicationOptions m_options;
+    // Declared early so it outlives everything that may log
+    Logger m_logger;
+    Profiler m_profiler;
+    Telemetry m_telemetry;
+    std::chrono::steady_clock::time_point m_startTime;
+
+    // When each startup step began and ended, in milliseconds since Run was called. Written by the step only
+    struct StartupStep{
+        const char* name;
+        double begin = 0.0;
+        double end = 0.0;
+        bool ran = false;
+    };
+    std::vector<StartupStep> m_startupSteps;
+    // Set by the first step that throws, the steps after it are skipped
+    std::atomic<bool> m_startupFailed{false};
 
     GLFWwindow* m_window;
     VkInstance m_vkInstance;
@@ -106,18 +430,45 @@ private:
     VkDevice m_device;
     VkQueue m_graphicsQueue;
     VkQueue m_presentQueue;
+    VkQueue m_computeQueue;
     VkDebugUtilsMessengerEXT m_debugMessenger;
+    // Enabled with validation layers, or for the profiler's labels when available
+    bool m_debugUtilsEnabled = false;
     VkSurfaceKHR m_surface;
     VkSwapchainKHR m_swapChain;
     std::vector<VkImage> m_swapChainImages;
+    std::vector<VkDeviceMemory> m_offscreenImagesMemory;// Backs m_swapChainImages when headless
     std::vector<VkImageView> m_swapChainImageViews;// Describes how to access the image and which part image to access
     VkFormat m_swapChainImageFormat;
     VkExtent2D m_swapChainExtent;
-    VkRenderPass m_renderPass;
+    // Of the window when last queried, the extent surfaces without a fixed one get
+    VkExtent2D m_framebufferSize = {0, 0};
+    // Both stay null with dynamic rendering
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+    // Like m_renderPass but loading the attachments, for the late phase of occlusion culling
+    VkRenderPass m_loadRenderPass = VK_NULL_HANDLE;
+    bool m_dynamicRenderingEnabled = false;
+    // The core entry points, or those of the extension before Vulkan 1.3
+    PFN_vkCmdBeginRendering m_cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRendering m_cmdEndRendering = nullptr;
+    VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+    std::vector<VkImage> m_depthImages;
+    std::vector<VkDeviceMemory> m_depthImagesMemory;
+    std::vector<VkImageView> m_depthImageViews;
+    // Only with dynamic resolution or multiview, in the swap chain format and of the main pass extent, a layer per view
+    std::vector<VkImage> m_sceneColorImages;
+    std::vector<VkDeviceMemory> m_sceneColorImagesMemory;
+    std::vector<VkImageView> m_sceneColorImageViews;
+    // Of the color and depth targets of the main pass, the swap chain extent unless multiview gives each view a tile of it
+    VkExtent2D m_mainPassExtent = {0, 0};
+    // The top left part of the color and depth targets the main pass draws into this frame
+    VkExtent2D m_renderExtent = {0, 0};
     VkDescriptorSetLayout m_descriptorSetLayout;
     VkPipelineLayout m_pipelineLayout;
-    VkPipeline m_graphicsPipeline;
-    std::vector<VkFramebuffer> m_swapChainFramebuffers;
+    // The scene pipeline and the copies a stress scene asks for, indexed by draw pipeline ID
+    std::vector<VkPipeline> m_graphicsPipelines;
+    std::vector<DrawPipeline> m_drawPipelines;
+    std::vector<VkFramebuffer> m_swapChainFramebuffers;// Empty with dynamic rendering
     VkCommandPool m_commandPool;
     std::vector<VkCommandBuffer> m_commandBuffers;
     std::vector<VkSemaphore> m_imageAvailableSemaphores;
@@ -129,8 +480,128 @@ private:
     VkDeviceMemory m_vertexBufferMemory;
     VkBuffer m_indexBuffer;
     VkDeviceMemory m_indexBufferMemory;
+    uint32_t m_indexCount = 0;
+    // Generated for the stress scene, the default quad is used when empty
+    std::vector<uint8_t> m_stressVertexData;
+    std::vector<uint8_t> m_stressIndexData;
+    // A region of the staging buffer per frame in flight, persistently mapped
+    VkBuffer m_stressStagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_stressStagingBufferMemory = VK_NULL_HANDLE;
+    uint8_t* m_stressStagingBufferMapped = nullptr;
+    VkBuffer m_stressUploadBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_stressUploadBufferMemory = VK_NULL_HANDLE;
+    // The startup upload, released by the first frame that finds its fence signaled
+    VkCommandBuffer m_uploadCommandBuffer = VK_NULL_HANDLE;
+    VkFence m_uploadFence = VK_NULL_HANDLE;
+    std::vector<VkBuffer> m_stagingBuffers;
+    std::vector<VkDeviceMemory> m_stagingBuffersMemory;
+    Asset m_vertShaderCode;
+    Asset m_fragShaderCode;
+    // The vertex shader picking its matrices by gl_ViewIndex, only loaded when multiview is asked for
+    Asset m_multiviewVertShaderCode;
     std::vector<VkBuffer> m_uniformBuffers;
     std::vector<VkDeviceMemory> m_uniformBuffersMemory;
+    // Persistently mapped, UpdateScene writes the matrices straight into them. Bound as dynamic storage buffers,
+    // the offsets select the region of the packet being drawn
+    VkBuffer m_objectBuffer;
+    VkDeviceMemory m_objectBufferMemory;
+    uint8_t* m_objectBufferMapped = nullptr;
+    VkDeviceSize m_objectBufferStride = 0;
+    // Indices of the visible objects, grouped by LOD. With occlusion culling the early and the late list follow in
+    // the region of each packet
+    VkBuffer m_drawListBuffer;
+    VkDeviceMemory m_drawListBufferMemory;
+    uint8_t* m_drawListBufferMapped = nullptr;
+    VkDeviceSize m_drawListBufferStride = 0;
+
+    // Owned by the simulation thread while it runs
+    Scene m_scene;
+    JobScheduler m_jobScheduler;
+    DrawListBuilder m_drawListBuilder;
+
+    // Packets move from the free queue to the simulation thread, through the ready queue to the render thread and
+    // back to the free queue once the frame drawing them has finished on the GPU
+    FramePacket m_framePackets[FRAME_PACKET_COUNT];
+    SpscQueue<uint32_t, 4> m_freeFramePackets;
+    SpscQueue<uint32_t, 4> m_readyFramePackets;
+    // The packet each frame in flight draws from
+    std::vector<uint32_t> m_framePacketsInFlight;
+    uint32_t m_currentFramePacket = NO_FRAME_PACKET;
+    std::thread m_simulationThread;
+    std::atomic<bool> m_simulationStopping{false};
+    std::atomic<bool> m_simulationFailed{false};
+    std::exception_ptr m_simulationException;
+    std::chrono::high_resolution_clock::time_point m_simulationStartTime;
+    // The main pass extent as the simulation thread sees it, the aspect ratio of every view
+    std::atomic<VkExtent2D> m_viewExtent{VkExtent2D{1, 1}};
+    VkDescriptorPool m_descriptorPool;
+    std::vector<VkDescriptorSet> m_descriptorSets;
+    // Texture generation each descriptor set was last written for
+    std::vector<uint64_t> m_descriptorTextureGenerations;
+
+    TextureStreamer m_textureStreamer;
+    TextureStreamer::TextureHandle m_texture = 0;
+
+    ParticleSystem m_particleSystem;
+
+    // Built from the scene mesh when meshlets are on, the index buffer holds its triangles in meshlet order
+    bool m_meshletsEnabled = false;
+    MeshletRenderer::Path m_meshletPath = MeshletRenderer::Path::Compute;
+    bool m_drawIndirectCount = false;
+    MeshletMesh m_meshletMesh;
+    MeshletRenderer m_meshletRenderer;
+
+    bool m_occlusionCullingEnabled = false;
+    OcclusionCuller m_occlusionCuller;
+
+    bool m_dynamicResolutionEnabled = false;
+    DynamicResolution m_dynamicResolution;
+
+    bool m_multiviewEnabled = false;
+    Multiview m_multiview;
+
+    bool m_framePacingEnabled = false;
+    PresentTimingSource m_presentTimingSource = PresentTimingSource::CpuTimer;
+    FramePacer m_framePacer;
+
+    VirtualFileSystem m_fileSystem;
+    // Unpacks archive chunks in parallel. Declared after the file system so it is joined before the mounts go away
+    ThreadPool m_ioThreadPool;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+
+    RenderGraph m_renderGraph;
+    RenderGraph::ResourceHandle m_backbuffer;
+    RenderGraph::ResourceHandle m_particleBuffer;
+    RenderGraph::ResourceHandle m_stressUpload;
+    RenderGraph::ResourceHandle m_meshletDraws;
+    RenderGraph::ResourceHandle m_depth;
+    RenderGraph::ResourceHandle m_drawList;
+    RenderGraph::ResourceHandle m_occlusionDraws;
+    RenderGraph::ResourceHandle m_visibility;
+    RenderGraph::ResourceHandle m_depthPyramid;
+    RenderGraph::ResourceHandle m_sceneColor;
+    RenderGraph::ResourceHandle m_upscaled;
+    uint32_t m_currentImageIndex = 0;
+    // Number of frames submitted so far, the simulation for frame N+1 is in flight while frame N renders
+    uint64_t m_frameNumber = 0;
+    std::chrono::high_resolution_clock::time_point m_lastSimulationTime;
+
+    FrameReadback m_frameReadback;
+    std::function<void(const ReadbackFrame&)> m_readbackCallback;
+    uint32_t m_currentReadbackSlot = 0;
+
+    FrameCaptureWriter m_captureWriter;
+    FrameCaptureReader m_captureReader;
+    // Captured frames replayed so far, simulation thread only
+    uint64_t m_replayFrame = 0;
+    // Scenes simulated so far when benchmarking, simulation thread only
+    uint64_t m_benchmarkSceneFrame = 0;
+    // How long DrawFrame took for every frame in milliseconds when replaying or benchmarking, render thread only
+    std::vector<double> m_frameTimes;
+    // Taken when the benchmark warm-up ended
+    uint64_t m_benchmarkStartFrame = 0;
+    TelemetrySnapshot m_benchmarkStartTelemetry = {};
+    uint64_t m_benchmarkStartTime = 0;// Profiler time
 
     bool m_frameBufferResized = false;
 };
\ No newline at end of file
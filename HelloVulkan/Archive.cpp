@@ -0,0 +1,310 @@
+#include "Archive.h"
+#include "Checksum.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+// Progress of one entry being unpacked by the calling thread and pool helpers. Helpers that only start once
+// every chunk has been claimed find nothing left to do, so the caller just waits for the claimed chunks
+struct UnpackJob{
+    uint32_t chunkCount = 0;
+    std::atomic<uint32_t> nextChunk{0};
+    std::atomic<bool> failed{false};
+    std::mutex mutex;
+    std::condition_variable finished;
+    uint32_t finishedChunks = 0;
+};
+
+uint32_t GetChunkSize(const ArchiveEntry& entry, uint32_t chunkIndex){
+    uint64_t offset = static_cast<uint64_t>(chunkIndex) * ARCHIVE_CHUNK_SIZE;
+    return static_cast<uint32_t>(std::min<uint64_t>(ARCHIVE_CHUNK_SIZE, entry.size - offset));
+}
+
+int ComparePath(ByteSpan a, const std::string& b){
+    int result = memcmp(a.data, b.data(), std::min(a.size, b.size()));
+    if(result != 0) return result;
+    return a.size < b.size() ? -1 : (a.size > b.size() ? 1 : 0);
+}
+
+}
+
+ArchiveMount::ArchiveMount(const std::string& filename, ThreadPool* threadPool)
+    : m_filename(filename), m_threadPool(threadPool)
+{
+    m_file = std::make_shared<MappedFile>(filename);
+    m_data = m_file->GetBytes();
+
+    ArchiveHeader header;
+    if(m_data.size < sizeof(header)){
+        throw std::runtime_error("Not an asset archive: " + filename);
+    }
+    memcpy(&header, m_data.data, sizeof(header));
+    if(memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0 || header.version != ARCHIVE_VERSION){
+        throw std::runtime_error("Not an asset archive or unsupported version: " + filename);
+    }
+
+    // Validate the table of contents once, lookups then trust it
+    ByteSpan toc = m_data.SubSpan(header.tocOffset, header.tocSize);
+    if(Crc32(toc.data, toc.size) != header.tocChecksum){
+        throw std::runtime_error("Corrupt asset archive table of contents: " + filename);
+    }
+    uint64_t tablesSize = static_cast<uint64_t>(header.entryCount) * sizeof(ArchiveEntry) +
+        static_cast<uint64_t>(header.chunkCount) * sizeof(ArchiveChunk);
+    if(tablesSize > toc.size || header.tocOffset % alignof(ArchiveEntry) != 0){
+        throw std::runtime_error("Corrupt asset archive table of contents: " + filename);
+    }
+
+    m_entryCount = header.entryCount;
+    m_chunkCount = header.chunkCount;
+    m_entries = reinterpret_cast<const ArchiveEntry*>(toc.data);
+    m_chunks = reinterpret_cast<const ArchiveChunk*>(toc.data + header.entryCount * sizeof(ArchiveEntry));
+    m_paths = toc.SubSpan(static_cast<size_t>(tablesSize), toc.size - static_cast<size_t>(tablesSize));
+
+    for(uint32_t i = 0; i < m_entryCount; i++){
+        const ArchiveEntry& entry = m_entries[i];
+        uint64_t expectedChunks = (entry.size + ARCHIVE_CHUNK_SIZE - 1) / ARCHIVE_CHUNK_SIZE;
+        if(static_cast<uint64_t>(entry.pathOffset) + entry.pathLength > m_paths.size ||
+            entry.chunkCount != expectedChunks ||
+            static_cast<uint64_t>(entry.firstChunk) + entry.chunkCount > m_chunkCount){
+            throw std::runtime_error("Corrupt asset archive entry: " + filename);
+        }
+        for(uint32_t c = 0; c < entry.chunkCount; c++){
+            const ArchiveChunk& chunk = m_chunks[entry.firstChunk + c];
+            if(chunk.offset > m_data.size || chunk.compressedSize > m_data.size - chunk.offset){
+                throw std::runtime_error("Corrupt asset archive chunk: " + filename);
+            }
+        }
+    }
+}
+
+ByteSpan ArchiveMount::GetPath(const ArchiveEntry& entry) const{
+    return m_paths.SubSpan(entry.pathOffset, entry.pathLength);
+}
+
+const ArchiveEntry* ArchiveMount::Find(const std::string& path) const{
+    // Binary search over the sorted entries, no index needs to be built at mount time
+    uint32_t first = 0;
+    uint32_t count = m_entryCount;
+    while(count > 0){
+        uint32_t step = count / 2;
+        uint32_t middle = first + step;
+        if(ComparePath(GetPath(m_entries[middle]), path) < 0){
+            first = middle + 1;
+            count -= step + 1;
+        }else{
+            count = step;
+        }
+    }
+    if(first < m_entryCount && ComparePath(GetPath(m_entries[first]), path) == 0) return &m_entries[first];
+    return nullptr;
+}
+
+bool ArchiveMount::Exists(const std::string& path) const{
+    return Find(path) != nullptr;
+}
+
+bool ArchiveMount::GetSize(const std::string& path, size_t& size) const{
+    const ArchiveEntry* entry = Find(path);
+    if(entry == nullptr) return false;
+    size = static_cast<size_t>(entry->size);
+    return true;
+}
+
+bool ArchiveMount::Open(const std::string& path, Asset& asset) const{
+    const ArchiveEntry* entry = Find(path);
+    if(entry == nullptr) return false;
+
+    // The chunks of an entry are written back to back, so a fully stored entry is one contiguous view
+    bool stored = true;
+    for(uint32_t c = 0; c < entry->chunkCount && stored; c++){
+        stored = m_chunks[entry->firstChunk + c].compressedSize == GetChunkSize(*entry, c);
+    }
+    if(stored){
+        if(entry->size == 0){
+            asset = Asset();
+            return true;
+        }
+        for(uint32_t c = 0; c < entry->chunkCount; c++){
+            const ArchiveChunk& chunk = m_chunks[entry->firstChunk + c];
+            if(Crc32(m_data.data + chunk.offset, chunk.compressedSize) != chunk.checksum){
+                throw std::runtime_error("Corrupt asset " + path + " in archive " + m_filename);
+            }
+        }
+        asset = Asset(m_data.SubSpan(m_chunks[entry->firstChunk].offset, static_cast<size_t>(entry->size)), m_file);
+        return true;
+    }
+
+    // new[] returns memory aligned for any basic type
+    size_t size = static_cast<size_t>(entry->size);
+    std::shared_ptr<uint8_t> buffer(new uint8_t[size], std::default_delete<uint8_t[]>());
+    Unpack(*entry, buffer.get());
+    asset = Asset({buffer.get(), size}, buffer);
+    return true;
+}
+
+bool ArchiveMount::ReadInto(const std::string& path, uint8_t* destination) const{
+    const ArchiveEntry* entry = Find(path);
+    if(entry == nullptr) return false;
+
+    Unpack(*entry, destination);
+    return true;
+}
+
+bool ArchiveMount::UnpackChunk(const ArchiveEntry& entry, uint32_t chunkIndex, uint8_t* destination) const{
+    const ArchiveChunk& chunk = m_chunks[entry.firstChunk + chunkIndex];
+    const uint8_t* source = m_data.data + chunk.offset;
+    if(Crc32(source, chunk.compressedSize) != chunk.checksum) return false;
+
+    uint32_t size = GetChunkSize(entry, chunkIndex);
+    Compression compression = chunk.compressedSize == size ? Compression::None : static_cast<Compression>(entry.compression);
+    return Decompress(compression, source, chunk.compressedSize,
+        destination + static_cast<size_t>(chunkIndex) * ARCHIVE_CHUNK_SIZE, size);
+}
+
+void ArchiveMount::Unpack(const ArchiveEntry& entry, uint8_t* destination) const{
+    if(!IsCompressionSupported(static_cast<Compression>(entry.compression))){
+        throw std::runtime_error("Archive " + m_filename + " uses a compression this build does not support");
+    }
+
+    auto job = std::make_shared<UnpackJob>();
+    job->chunkCount = entry.chunkCount;
+    auto work = [this, &entry, destination](UnpackJob& job){
+        uint32_t chunkIndex;
+        uint32_t done = 0;
+        while((chunkIndex = job.nextChunk++) < job.chunkCount){
+            if(!UnpackChunk(entry, chunkIndex, destination)) job.failed = true;
+            done++;
+        }
+        if(done > 0){
+            std::lock_guard<std::mutex> lock(job.mutex);
+            job.finishedChunks += done;
+            if(job.finishedChunks == job.chunkCount) job.finished.notify_all();
+        }
+    };
+
+    // Chunks are independent, let pool threads help with the ones this thread has not claimed yet. Helpers
+    // only touch @entry and @destination after claiming a chunk, which can not happen once this call returns
+    if(m_threadPool != nullptr && entry.chunkCount > 1){
+        uint32_t helpers = std::min(m_threadPool->GetThreadCount(), entry.chunkCount - 1);
+        for(uint32_t i = 0; i < helpers; i++){
+            m_threadPool->Submit([job, work](){ work(*job); });
+        }
+    }
+    work(*job);
+
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&](){ return job->finishedChunks == job->chunkCount; });
+    }
+    if(job->failed){
+        throw std::runtime_error("Corrupt asset in archive " + m_filename);
+    }
+}
+
+void WriteArchive(const std::string& filename, std::vector<ArchiveInput> inputs, Compression compression, int level,
+    ThreadPool& threadPool)
+{
+    if(!IsCompressionSupported(compression)){
+        throw std::runtime_error("This build does not support the requested compression");
+    }
+
+    std::sort(inputs.begin(), inputs.end(), [](const ArchiveInput& a, const ArchiveInput& b){ return a.path < b.path; });
+    for(size_t i = 0; i < inputs.size(); i++){
+        if(!IsValidAssetPath(inputs[i].path)) throw std::runtime_error("Invalid asset path: " + inputs[i].path);
+        if(i > 0 && inputs[i].path == inputs[i - 1].path) throw std::runtime_error("Duplicate asset path: " + inputs[i].path);
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if(!file.is_open()){
+        throw std::runtime_error("Failed to create archive: " + filename);
+    }
+
+    uint64_t offset = 0;
+    auto write = [&](const void* data, size_t size){
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        offset += size;
+    };
+    auto pad = [&](){
+        static const char zeros[ARCHIVE_DATA_ALIGNMENT] = {};
+        write(zeros, static_cast<size_t>((ARCHIVE_DATA_ALIGNMENT - offset % ARCHIVE_DATA_ALIGNMENT) % ARCHIVE_DATA_ALIGNMENT));
+    };
+
+    // The header is rewritten once the table of contents is known
+    ArchiveHeader header = {};
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ARCHIVE_VERSION;
+    write(&header, sizeof(header));
+
+    std::vector<ArchiveEntry> entries;
+    std::vector<ArchiveChunk> chunks;
+    std::string paths;
+
+    for(const auto& input: inputs){
+        MappedFile source(input.filename);
+        ByteSpan bytes = source.GetBytes();
+
+        ArchiveEntry entry = {};
+        entry.size = bytes.size;
+        entry.pathOffset = static_cast<uint32_t>(paths.size());
+        entry.pathLength = static_cast<uint32_t>(input.path.size());
+        entry.firstChunk = static_cast<uint32_t>(chunks.size());
+        entry.chunkCount = static_cast<uint32_t>((bytes.size + ARCHIVE_CHUNK_SIZE - 1) / ARCHIVE_CHUNK_SIZE);
+        entry.compression = static_cast<uint32_t>(compression);
+        paths += input.path;
+
+        // Compress the chunks of this file in parallel, then write them in order
+        std::vector<std::vector<uint8_t>> packed(entry.chunkCount);
+        for(uint32_t c = 0; c < entry.chunkCount; c++){
+            threadPool.Submit([&, c](){
+                ByteSpan chunk = bytes.SubSpan(static_cast<size_t>(c) * ARCHIVE_CHUNK_SIZE, GetChunkSize(entry, c));
+                std::vector<uint8_t>& out = packed[c];
+                out.resize(CompressBound(compression, chunk.size));
+                out.resize(Compress(compression, chunk.data, chunk.size, out.data(), out.size(), level));
+                // Keep the chunk stored when compressing did not pay off
+                if(out.size() >= chunk.size) out.assign(chunk.begin(), chunk.end());
+            });
+        }
+        threadPool.WaitIdle();
+
+        pad();
+        for(uint32_t c = 0; c < entry.chunkCount; c++){
+            ArchiveChunk chunk = {};
+            chunk.offset = offset;
+            chunk.compressedSize = static_cast<uint32_t>(packed[c].size());
+            chunk.checksum = Crc32(packed[c].data(), packed[c].size());
+            chunks.push_back(chunk);
+            write(packed[c].data(), packed[c].size());
+        }
+        entries.push_back(entry);
+    }
+
+    pad();
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.chunkCount = static_cast<uint32_t>(chunks.size());
+    header.tocOffset = offset;
+
+    std::vector<uint8_t> toc(entries.size() * sizeof(ArchiveEntry) + chunks.size() * sizeof(ArchiveChunk) + paths.size());
+    uint8_t* tocData = toc.data();
+    if(!entries.empty()) memcpy(tocData, entries.data(), entries.size() * sizeof(ArchiveEntry));
+    tocData += entries.size() * sizeof(ArchiveEntry);
+    if(!chunks.empty()) memcpy(tocData, chunks.data(), chunks.size() * sizeof(ArchiveChunk));
+    tocData += chunks.size() * sizeof(ArchiveChunk);
+    if(!paths.empty()) memcpy(tocData, paths.data(), paths.size());
+
+    header.tocSize = toc.size();
+    header.tocChecksum = Crc32(toc.data(), toc.size());
+    write(toc.data(), toc.size());
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if(!file){
+        throw std::runtime_error("Failed to write archive: " + filename);
+    }
+}
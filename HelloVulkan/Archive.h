@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Compression.h"
+#include "FileSystem.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Packed asset archive (.pak), one file holding many assets so loading them costs a single open and mapping:
+//
+//   ArchiveHeader | chunk data ... | ArchiveEntry[entryCount] | ArchiveChunk[chunkCount] | path strings
+//
+// Entries are sorted by path. Each entry is split into chunks of ARCHIVE_CHUNK_SIZE bytes (the last one may be
+// shorter) that are compressed independently, so they can be unpacked in parallel. A chunk that did not shrink
+// is stored as it is. Integers are in host order, every supported target is little-endian
+constexpr char ARCHIVE_MAGIC[4] = {'H', 'V', 'P', 'K'};
+constexpr uint32_t ARCHIVE_VERSION = 1;
+constexpr uint32_t ARCHIVE_CHUNK_SIZE = 64 * 1024;
+// Chunk data starts on this boundary, so stored entries can be viewed in place as any basic type
+constexpr uint32_t ARCHIVE_DATA_ALIGNMENT = 16;
+
+struct ArchiveHeader{
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t chunkCount;
+    uint64_t tocOffset;
+    uint64_t tocSize;
+    uint32_t tocChecksum;// CRC-32 of the whole table of contents
+    uint32_t reserved;
+};
+
+struct ArchiveEntry{
+    uint64_t size;// Unpacked size
+    uint32_t pathOffset;// Into the path strings
+    uint32_t pathLength;
+    uint32_t firstChunk;
+    uint32_t chunkCount;
+    uint32_t compression;// A Compression value
+    uint32_t reserved;
+};
+
+struct ArchiveChunk{
+    uint64_t offset;// From the start of the archive
+    uint32_t compressedSize;// Equal to the unpacked size when the chunk is stored
+    uint32_t checksum;// CRC-32 of the bytes in the archive
+};
+
+static_assert(sizeof(ArchiveHeader) == 40 && sizeof(ArchiveEntry) == 32 && sizeof(ArchiveChunk) == 16,
+    "Archive structures must not contain padding");
+
+// Mounts a packed archive. Stored entries are served straight from the mapping; compressed ones are unpacked
+// chunk by chunk, in parallel on @threadPool when one is given, into a new buffer or a caller's staging memory
+class ArchiveMount : public MountPoint
+{
+public:
+    // Throws when @filename is not a valid archive. @threadPool must outlive the mount
+    explicit ArchiveMount(const std::string& filename, ThreadPool* threadPool = nullptr);
+
+    bool Exists(const std::string& path) const override;
+    bool Open(const std::string& path, Asset& asset) const override;
+    bool GetSize(const std::string& path, size_t& size) const override;
+    bool ReadInto(const std::string& path, uint8_t* destination) const override;
+
+private:
+    const ArchiveEntry* Find(const std::string& path) const;
+    ByteSpan GetPath(const ArchiveEntry& entry) const;
+    // Unpack every chunk of @entry into @destination, throws on corrupt data
+    void Unpack(const ArchiveEntry& entry, uint8_t* destination) const;
+    bool UnpackChunk(const ArchiveEntry& entry, uint32_t chunkIndex, uint8_t* destination) const;
+
+private:
+    std::string m_filename;
+    std::shared_ptr<MappedFile> m_file;
+    ByteSpan m_data;
+    const ArchiveEntry* m_entries = nullptr;
+    const ArchiveChunk* m_chunks = nullptr;
+    ByteSpan m_paths;
+    uint32_t m_entryCount = 0;
+    uint32_t m_chunkCount = 0;
+    ThreadPool* m_threadPool = nullptr;
+};
+
+struct ArchiveInput{
+    std::string path;// Path inside the archive, forward-slash separated
+    std::string filename;// File to read it from
+};
+
+// Pack @inputs into the archive @filename, compressing the chunks of each file in parallel on @threadPool
+void WriteArchive(const std::string& filename, std::vector<ArchiveInput> inputs, Compression compression, int level,
+    ThreadPool& threadPool);
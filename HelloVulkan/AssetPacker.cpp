@@ -0,0 +1,75 @@
+// Packs a directory tree into an asset archive that HelloVulkan can mount with --mount <archive>.pak
+#include "Archive.h"
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static const char* USAGE =
+    "Usage: AssetPacker <input directory> <output archive> [--compression none|lz4|zstd] [--level <zstd level>]";
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        if (argc < 3)
+        {
+            throw std::runtime_error(USAGE);
+        }
+        std::string inputDirectory = argv[1];
+        std::string outputFile = argv[2];
+
+        Compression compression = Compression::Lz4;
+        int level = 19;// Packing happens once, unpacking speed does not depend on the level
+        for (int i = 3; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--compression" && i + 1 < argc)
+            {
+                std::string value = argv[++i];
+                if (value == "none") compression = Compression::None;
+                else if (value == "lz4") compression = Compression::Lz4;
+                else if (value == "zstd") compression = Compression::Zstd;
+                else throw std::runtime_error("Unknown compression: " + value + "\n" + USAGE);
+            }
+            else if (arg == "--level" && i + 1 < argc)
+            {
+                level = std::stoi(argv[++i]);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown or incomplete argument: " + arg + "\n" + USAGE);
+            }
+        }
+        if (!IsCompressionSupported(compression))
+        {
+            throw std::runtime_error("AssetPacker was built without zstd support");
+        }
+
+        // Archive paths are relative to the input directory and always use forward slashes
+        std::vector<ArchiveInput> inputs;
+        for (const auto& item : std::filesystem::recursive_directory_iterator(inputDirectory))
+        {
+            if (!item.is_regular_file()) continue;
+            ArchiveInput input;
+            input.path = std::filesystem::relative(item.path(), inputDirectory).generic_string();
+            input.filename = item.path().string();
+            inputs.push_back(input);
+        }
+
+        ThreadPool threadPool;
+        WriteArchive(outputFile, inputs, compression, level, threadPool);
+
+        std::cout << "Packed " << inputs.size() << " files into " << outputFile << " ("
+            << std::filesystem::file_size(outputFile) << " bytes)" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#include "Checksum.h"
+
+#include <array>
+
+namespace {
+
+// Slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k zero bytes
+std::array<std::array<uint32_t, 256>, 8> MakeCrcTables(){
+    std::array<std::array<uint32_t, 256>, 8> tables = {};
+    for(uint32_t i = 0; i < 256; i++){
+        uint32_t c = i;
+        for(int k = 0; k < 8; k++){
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        tables[0][i] = c;
+    }
+    for(uint32_t i = 0; i < 256; i++){
+        for(size_t k = 1; k < 8; k++){
+            tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+        }
+    }
+    return tables;
+}
+
+}
+
+uint32_t Crc32(const void* data, size_t size, uint32_t crc){
+    static const std::array<std::array<uint32_t, 256>, 8> tables = MakeCrcTables();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+
+    // Eight bytes per step, assembled byte by byte so neither alignment nor endianness matter
+    for(; size >= 8; size -= 8, bytes += 8){
+        uint32_t low = crc ^ (static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+            static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24);
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24] ^
+            tables[3][bytes[4]] ^ tables[2][bytes[5]] ^ tables[1][bytes[6]] ^ tables[0][bytes[7]];
+    }
+    for(; size > 0; size--, bytes++){
+        crc = tables[0][(crc ^ *bytes) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
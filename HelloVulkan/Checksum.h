@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 as used by PNG, zlib and gzip. Pass the previous result as @crc to continue a running checksum
+uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0);
@@ -0,0 +1,240 @@
+#include "Compression.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef HELLOVULKAN_HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// LZ4 block format: a sequence is a token (literal length in the high nibble, match length - 4 in the low one),
+// extra length bytes when a nibble is 15, the literals, then a 16-bit little-endian offset and more match length
+// bytes. The last sequence carries literals only
+constexpr size_t LZ4_MIN_MATCH = 4;
+// The format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+constexpr size_t LZ4_LAST_LITERALS = 5;
+constexpr size_t LZ4_MF_LIMIT = 12;
+constexpr size_t LZ4_MAX_OFFSET = 65535;
+constexpr uint32_t LZ4_HASH_BITS = 12;
+
+uint32_t Read32(const uint8_t* p){
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t HashLz4(uint32_t sequence){
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+uint8_t* WriteLength(uint8_t* out, size_t length){
+    for(; length >= 255; length -= 255) *out++ = 255;
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+size_t CompressLz4(const uint8_t* source, size_t size, uint8_t* destination){
+    uint8_t* out = destination;
+    const uint8_t* anchor = source;
+    const uint8_t* end = source + size;
+
+    if(size >= LZ4_MF_LIMIT + 1){
+        // Positions of the last occurrence of each hashed 4-byte sequence, relative to @source
+        std::vector<uint32_t> table(size_t(1) << LZ4_HASH_BITS, 0);
+        const uint8_t* matchLimit = end - LZ4_LAST_LITERALS;
+        const uint8_t* searchLimit = end - LZ4_MF_LIMIT;
+
+        const uint8_t* ip = source + 1;
+        table[HashLz4(Read32(source))] = 0;
+        while(ip < searchLimit){
+            uint32_t sequence = Read32(ip);
+            uint32_t hash = HashLz4(sequence);
+            const uint8_t* match = source + table[hash];
+            table[hash] = static_cast<uint32_t>(ip - source);
+
+            if(match >= ip || static_cast<size_t>(ip - match) > LZ4_MAX_OFFSET || Read32(match) != sequence){
+                ip++;
+                continue;
+            }
+
+            // Extend the match backwards over pending literals, then forwards
+            while(ip > anchor && match > source && ip[-1] == match[-1]){
+                ip--;
+                match--;
+            }
+            const uint8_t* matchEnd = ip + LZ4_MIN_MATCH;
+            const uint8_t* ref = match + LZ4_MIN_MATCH;
+            while(matchEnd < matchLimit && *matchEnd == *ref){
+                matchEnd++;
+                ref++;
+            }
+
+            size_t literalLength = static_cast<size_t>(ip - anchor);
+            size_t matchLength = static_cast<size_t>(matchEnd - ip) - LZ4_MIN_MATCH;
+            uint8_t* token = out++;
+            *token = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+            if(literalLength >= 15) out = WriteLength(out, literalLength - 15);
+            memcpy(out, anchor, literalLength);
+            out += literalLength;
+
+            uint16_t offset = static_cast<uint16_t>(ip - match);
+            *out++ = static_cast<uint8_t>(offset);
+            *out++ = static_cast<uint8_t>(offset >> 8);
+
+            *token |= static_cast<uint8_t>(matchLength >= 15 ? 15 : matchLength);
+            if(matchLength >= 15) out = WriteLength(out, matchLength - 15);
+
+            ip = matchEnd;
+            anchor = ip;
+            if(ip - 2 >= source) table[HashLz4(Read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - source);
+        }
+    }
+
+    // Trailing literals
+    size_t literalLength = static_cast<size_t>(end - anchor);
+    *out++ = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+    if(literalLength >= 15) out = WriteLength(out, literalLength - 15);
+    if(literalLength > 0) memcpy(out, anchor, literalLength);
+    out += literalLength;
+
+    return static_cast<size_t>(out - destination);
+}
+
+bool DecompressLz4(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size){
+    const uint8_t* ip = source;
+    const uint8_t* inEnd = source + sourceSize;
+    uint8_t* op = destination;
+    uint8_t* outEnd = destination + size;
+
+    // Read the 255-continued extension of a length nibble
+    auto readLength = [&](size_t& length){
+        uint8_t byte;
+        do{
+            if(ip >= inEnd) return false;
+            byte = *ip++;
+            length += byte;
+        }while(byte == 255);
+        return true;
+    };
+
+    while(ip < inEnd){
+        uint8_t token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if(literalLength == 15 && !readLength(literalLength)) return false;
+        if(literalLength > static_cast<size_t>(inEnd - ip) || literalLength > static_cast<size_t>(outEnd - op)) return false;
+        if(literalLength > 0) memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        // Only the last sequence ends after its literals
+        if(ip == inEnd) break;
+
+        if(inEnd - ip < 2) return false;
+        size_t offset = static_cast<size_t>(ip[0]) | static_cast<size_t>(ip[1]) << 8;
+        ip += 2;
+        if(offset == 0 || offset > static_cast<size_t>(op - destination)) return false;
+
+        size_t matchLength = token & 15;
+        if(matchLength == 15 && !readLength(matchLength)) return false;
+        matchLength += LZ4_MIN_MATCH;
+        if(matchLength > static_cast<size_t>(outEnd - op)) return false;
+
+        // Matches may overlap their own output, a byte-wise copy repeats the pattern as the format intends
+        const uint8_t* match = op - offset;
+        if(offset >= matchLength){
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        }else{
+            for(size_t i = 0; i < matchLength; i++) *op++ = match[i];
+        }
+    }
+
+    return op == outEnd;
+}
+
+}
+
+bool IsCompressionSupported(Compression compression){
+    switch(compression){
+    case Compression::None:
+    case Compression::Lz4:
+        return true;
+    case Compression::Zstd:
+#ifdef HELLOVULKAN_HAS_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+size_t CompressBound(Compression compression, size_t size){
+    switch(compression){
+    case Compression::None:
+        return size;
+    case Compression::Lz4:
+        return size + size / 255 + 16;
+    case Compression::Zstd:
+#ifdef HELLOVULKAN_HAS_ZSTD
+        return ZSTD_compressBound(size);
+#else
+        break;
+#endif
+    }
+    throw std::runtime_error("Unsupported compression!");
+}
+
+size_t Compress(Compression compression, const uint8_t* source, size_t size, uint8_t* destination, size_t capacity, int level){
+    if(capacity < CompressBound(compression, size)){
+        throw std::runtime_error("Compression output buffer is too small!");
+    }
+
+    switch(compression){
+    case Compression::None:
+        memcpy(destination, source, size);
+        return size;
+    case Compression::Lz4:
+        (void)level;
+        return CompressLz4(source, size, destination);
+    case Compression::Zstd:
+#ifdef HELLOVULKAN_HAS_ZSTD
+    {
+        size_t result = ZSTD_compress(destination, capacity, source, size, level);
+        if(ZSTD_isError(result)){
+            throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(result));
+        }
+        return result;
+    }
+#else
+        break;
+#endif
+    }
+    throw std::runtime_error("Unsupported compression!");
+}
+
+bool Decompress(Compression compression, const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size){
+    switch(compression){
+    case Compression::None:
+        if(sourceSize != size) return false;
+        memcpy(destination, source, size);
+        return true;
+    case Compression::Lz4:
+        return DecompressLz4(source, sourceSize, destination, size);
+    case Compression::Zstd:
+#ifdef HELLOVULKAN_HAS_ZSTD
+    {
+        size_t result = ZSTD_decompress(destination, size, source, sourceSize);
+        return !ZSTD_isError(result) && result == size;
+    }
+#else
+        break;
+#endif
+    }
+    return false;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Stored in the archive table of contents, so the values must never change
+enum class Compression : uint32_t{
+    None = 0,
+    Lz4 = 1,// LZ4 block format, always available
+    Zstd = 2// Only when built against libzstd, see IsCompressionSupported
+};
+
+bool IsCompressionSupported(Compression compression);
+
+// Largest size Compress may produce for @size input bytes
+size_t CompressBound(Compression compression, size_t size);
+
+// Compress @size bytes of @source into @destination, which must hold CompressBound bytes. Returns the compressed
+// size. @level only applies to zstd
+size_t Compress(Compression compression, const uint8_t* source, size_t size, uint8_t* destination, size_t capacity, int level = 3);
+
+// Decompress exactly @size bytes into @destination. Returns false on corrupt input instead of reading or
+// writing out of bounds
+bool Decompress(Compression compression, const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size);
@@ -0,0 +1,120 @@
+#include "DrawListBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+JobScheduler::JobHandle DrawListBuilder::AddJobs(JobScheduler& scheduler, Scene& scene, const View& view, void* matrices, uint32_t* drawList){
+    m_view = view;
+
+    // Planes from the rows of the view projection, the clip volume being -w <= x, y <= w and 0 <= z <= w
+    const glm::mat4& m = view.viewProjection;
+    glm::vec4 rows[4];
+    for(int i = 0; i < 4; i++) rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    m_planes[0] = rows[3] + rows[0];
+    m_planes[1] = rows[3] - rows[0];
+    m_planes[2] = rows[3] + rows[1];
+    m_planes[3] = rows[3] - rows[1];
+    m_planes[4] = rows[2];
+    m_planes[5] = rows[3] - rows[2];
+    for(auto& plane: m_planes) plane /= glm::length(glm::vec3(plane));
+
+    uint32_t chunkCount = scene.GetTransformChunkCount();
+    m_chunks.resize(chunkCount);
+
+    // Transforms follow the hierarchy, culling a chunk only needs its own transforms
+    std::vector<JobScheduler::JobHandle> transformJobs(chunkCount);
+    std::vector<JobScheduler::JobHandle> cullJobs(chunkCount);
+    for(uint32_t chunk = 0; chunk < chunkCount; chunk++){
+        std::vector<JobScheduler::JobHandle> dependencies;
+        for(uint32_t parentChunk: scene.GetTransformChunkDependencies(chunk)) dependencies.push_back(transformJobs[parentChunk]);
+        transformJobs[chunk] = scheduler.AddJob([&scene, chunk, matrices](){ scene.UpdateTransformChunk(chunk, matrices); }, dependencies);
+        cullJobs[chunk] = scheduler.AddJob([this, &scene, chunk](){ CullChunk(scene, chunk); }, {transformJobs[chunk]});
+    }
+
+    JobScheduler::JobHandle offsetsJob = scheduler.AddJob([this](){ ComputeOffsets(); }, cullJobs);
+
+    return scheduler.AddParallelFor(chunkCount, 8, [this, drawList](uint32_t begin, uint32_t end){
+        for(uint32_t chunk = begin; chunk < end; chunk++){
+            const ChunkResult& result = m_chunks[chunk];
+            for(uint32_t lod = 0; lod < MAX_LOD_COUNT; lod++){
+                const std::vector<uint32_t>& objects = result.objects[lod];
+                if(!objects.empty()) memcpy(drawList + result.offsets[lod], objects.data(), objects.size() * sizeof(uint32_t));
+            }
+        }
+    }, {offsetsJob});
+}
+
+void DrawListBuilder::CullChunk(const Scene& scene, uint32_t chunk){
+    ChunkResult& result = m_chunks[chunk];
+    for(auto& objects: result.objects) objects.clear();
+    result.frustumCulled = 0;
+    result.detailCulled = 0;
+
+    const float* world[12];
+    for(uint32_t i = 0; i < 12; i++) world[i] = scene.GetWorldElements(i);
+    const float* radii = scene.GetBoundingRadii();
+
+    uint32_t begin = chunk * Scene::TRANSFORM_CHUNK_SIZE;
+    uint32_t end = std::min(scene.GetObjectCount(), begin + Scene::TRANSFORM_CHUNK_SIZE);
+    for(uint32_t object = begin; object < end; object++){
+        glm::vec3 center(world[3][object], world[7][object], world[11][object]);
+        // The longest axis of the world matrix scales the sphere
+        float scale = std::sqrt(std::max({
+            world[0][object] * world[0][object] + world[4][object] * world[4][object] + world[8][object] * world[8][object],
+            world[1][object] * world[1][object] + world[5][object] * world[5][object] + world[9][object] * world[9][object],
+            world[2][object] * world[2][object] + world[6][object] * world[6][object] + world[10][object] * world[10][object]}));
+        float radius = radii[object] * scale;
+
+        bool outside = false;
+        for(uint32_t plane = 0; plane < 6 && !m_view.omnidirectional; plane++){
+            if(glm::dot(glm::vec3(m_planes[plane]), center) + m_planes[plane].w < -radius){
+                outside = true;
+                break;
+            }
+        }
+        if(outside){
+            result.frustumCulled++;
+            continue;
+        }
+
+        // The clip space w is the distance along the view direction. Spheres reaching behind the camera are close
+        // enough for the finest LOD
+        const glm::mat4& m = m_view.viewProjection;
+        float distance = m[0][3] * center.x + m[1][3] * center.y + m[2][3] * center.z + m[3][3];
+        if(m_view.omnidirectional) distance = glm::length(center - m_view.eye);
+        uint32_t lod = 0;
+        if(distance > radius){
+            float pixels = 2.0f * radius * m_view.projectionScale / distance;
+            if(pixels < m_view.minimumPixels){
+                result.detailCulled++;
+                continue;
+            }
+            if(pixels < m_view.lod0Pixels){
+                lod = std::min(MAX_LOD_COUNT - 1, static_cast<uint32_t>(std::log2(m_view.lod0Pixels / pixels)));
+            }
+        }
+        result.objects[lod].push_back(object);
+    }
+}
+
+void DrawListBuilder::ComputeOffsets(){
+    m_result = {};
+    for(const auto& chunk: m_chunks){
+        m_result.frustumCulled += chunk.frustumCulled;
+        m_result.detailCulled += chunk.detailCulled;
+        for(uint32_t lod = 0; lod < MAX_LOD_COUNT; lod++) m_result.lodCount[lod] += static_cast<uint32_t>(chunk.objects[lod].size());
+    }
+
+    // All objects of one LOD are contiguous, in chunk order
+    uint32_t first = 0;
+    for(uint32_t lod = 0; lod < MAX_LOD_COUNT; lod++){
+        m_result.lodFirst[lod] = first;
+        uint32_t offset = first;
+        for(auto& chunk: m_chunks){
+            chunk.offsets[lod] = offset;
+            offset += static_cast<uint32_t>(chunk.objects[lod].size());
+        }
+        first += m_result.lodCount[lod];
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "JobScheduler.h"
+#include "Scene.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// The CPU side of drawing a scene, built as jobs: world matrices, frustum culling, LOD selection and the draw
+// list. Each chunk of objects is culled as soon as its transforms are done, then the visible objects of all
+// chunks are gathered into one list grouped by LOD, so every LOD is a single instanced draw
+class DrawListBuilder
+{
+public:
+    static constexpr uint32_t MAX_LOD_COUNT = 4;
+
+    struct View{
+        glm::mat4 viewProjection;
+        // Pixels covered by something one unit tall at a distance of one, |projection[1][1]| * viewport height / 2
+        float projectionScale;
+        // Objects at least this many pixels tall use LOD 0, each following LOD covers half as many
+        float lod0Pixels = 256.0f;
+        // Objects smaller than this are not drawn at all
+        float minimumPixels = 1.0f;
+        // Every direction around @eye is in view, as for the faces of a cube map: nothing is frustum culled and the
+        // LOD follows the distance to @eye
+        bool omnidirectional = false;
+        glm::vec3 eye = glm::vec3(0.0f);
+    };
+
+    struct Result{
+        // Instances [first, first + count) of the draw list are drawn at each LOD
+        uint32_t lodFirst[MAX_LOD_COUNT];
+        uint32_t lodCount[MAX_LOD_COUNT];
+        uint32_t frustumCulled;
+        uint32_t detailCulled;
+    };
+
+public:
+    // Add this frame's jobs to @scheduler and return the one finishing last. World matrices are written to
+    // @matrices and the indices of the visible objects to @drawList, both with room for every object
+    JobScheduler::JobHandle AddJobs(JobScheduler& scheduler, Scene& scene, const View& view, void* matrices, uint32_t* drawList);
+
+    // Of the jobs that ran last
+    const Result& GetResult() const { return m_result; }
+
+private:
+    struct ChunkResult{
+        std::vector<uint32_t> objects[MAX_LOD_COUNT];
+        uint32_t frustumCulled = 0;
+        uint32_t detailCulled = 0;
+        uint32_t offsets[MAX_LOD_COUNT] = {};// Where the objects go in the draw list
+    };
+
+    void CullChunk(const Scene& scene, uint32_t chunk);
+    void ComputeOffsets();
+
+private:
+    View m_view = {};
+    // Left, right, bottom, top, near and far, pointing inwards
+    glm::vec4 m_planes[6];
+    std::vector<ChunkResult> m_chunks;
+    Result m_result = {};
+};
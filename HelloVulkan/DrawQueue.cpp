@@ -0,0 +1,226 @@
+#include "DrawQueue.h"
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace{
+    constexpr uint32_t RADIX_BITS = 8;
+    constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+    constexpr uint32_t DIGIT_COUNT = 64 / RADIX_BITS;
+    // Every block of the parallel sort keeps a histogram, more blocks than this only adds prefix work
+    constexpr uint32_t MAX_SORT_BLOCKS = 16;
+
+    constexpr uint32_t DEPTH_SHIFT = 0;
+    constexpr uint32_t MESH_SHIFT = DEPTH_SHIFT + DrawQueue::DEPTH_BITS;
+    constexpr uint32_t MATERIAL_SHIFT = MESH_SHIFT + DrawQueue::MESH_BITS;
+    constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + DrawQueue::MATERIAL_BITS;
+    constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + DrawQueue::PIPELINE_BITS;
+    static_assert(PASS_SHIFT + DrawQueue::PASS_BITS == 64, "The key fields must fill 64 bits");
+
+    uint32_t GetField(uint64_t key, uint32_t shift, uint32_t bits){
+        return static_cast<uint32_t>((key >> shift) & ((uint64_t(1) << bits) - 1));
+    }
+
+    uint32_t GetDigit(uint64_t key, uint32_t digit){
+        return static_cast<uint32_t>(key >> (digit * RADIX_BITS)) & (RADIX_SIZE - 1);
+    }
+}
+
+void DrawQueue::Create(uint32_t maxPackets){
+    m_maxPackets = maxPackets;
+    // The packets, both sort buffers and the block histograms, plus slack for aligning each of them
+    size_t capacity = sizeof(DrawPacket) * maxPackets + 2 * sizeof(SortEntry) * maxPackets +
+        sizeof(uint32_t) * MAX_SORT_BLOCKS * RADIX_SIZE + 4 * alignof(std::max_align_t);
+    m_arena.Create(capacity);
+    m_droppedCount = 0;
+    Reset();
+}
+
+void DrawQueue::Reset(){
+    m_arena.Reset();
+    m_packets = m_arena.Allocate<DrawPacket>(m_maxPackets);
+    m_packetCount = 0;
+    m_order = nullptr;
+}
+
+bool DrawQueue::Push(const DrawPacket& packet){
+    if(m_packetCount == m_maxPackets){
+        m_droppedCount++;
+        return false;
+    }
+    m_packets[m_packetCount++] = packet;
+    return true;
+}
+
+void DrawQueue::Sort(JobScheduler* scheduler){
+    // The sort buffers and histograms come after the packets, so sorting twice a frame would run out of room
+    if(m_order != nullptr) return;
+
+    SortEntry* source = m_arena.Allocate<SortEntry>(m_maxPackets);
+    SortEntry* destination = m_arena.Allocate<SortEntry>(m_maxPackets);
+    uint32_t* histograms = m_arena.Allocate<uint32_t>(MAX_SORT_BLOCKS * RADIX_SIZE);
+    if(source == nullptr || destination == nullptr || histograms == nullptr){
+        throw std::runtime_error("Draw queue arena is too small!");
+    }
+
+    const uint32_t count = m_packetCount;
+    if(count == 0){
+        m_order = source;
+        return;
+    }
+
+    // Digits where every key matches the first one would only copy the entries around
+    uint64_t varyingBits = 0;
+    for(uint32_t i = 0; i < count; i++){
+        source[i].key = m_packets[i].key;
+        source[i].packet = i;
+        varyingBits |= source[i].key ^ source[0].key;
+    }
+    uint32_t activeDigits[DIGIT_COUNT];
+    uint32_t activeDigitCount = 0;
+    for(uint32_t digit = 0; digit < DIGIT_COUNT; digit++){
+        if(GetDigit(varyingBits, digit) != 0) activeDigits[activeDigitCount++] = digit;
+    }
+
+    // Each pass is a stable counting sort on one digit, least significant first
+    if(scheduler == nullptr || count < PARALLEL_SORT_THRESHOLD){
+        for(uint32_t pass = 0; pass < activeDigitCount; pass++){
+            uint32_t digit = activeDigits[pass];
+            std::memset(histograms, 0, sizeof(uint32_t) * RADIX_SIZE);
+            for(uint32_t i = 0; i < count; i++) histograms[GetDigit(source[i].key, digit)]++;
+            uint32_t offset = 0;
+            for(uint32_t value = 0; value < RADIX_SIZE; value++){
+                uint32_t valueCount = histograms[value];
+                histograms[value] = offset;
+                offset += valueCount;
+            }
+            for(uint32_t i = 0; i < count; i++) destination[histograms[GetDigit(source[i].key, digit)]++] = source[i];
+            std::swap(source, destination);
+        }
+        m_order = source;
+        return;
+    }
+
+    // Blocks count their digits in parallel, one job turns the counts into where each block writes every digit
+    // value, and the blocks scatter in parallel. Block order follows entry order, which keeps the sort stable
+    const uint32_t blockCount = std::min(MAX_SORT_BLOCKS, scheduler->GetThreadCount() * 2);
+    const uint32_t blockSize = (count + blockCount - 1) / blockCount;
+    std::vector<JobScheduler::JobHandle> dependencies;
+    for(uint32_t pass = 0; pass < activeDigitCount; pass++){
+        const uint32_t digit = activeDigits[pass];
+        const SortEntry* from = source;
+        SortEntry* to = destination;
+
+        JobScheduler::JobHandle histogram = scheduler->AddParallelFor(blockCount, 1, [=](uint32_t begin, uint32_t end){
+            for(uint32_t block = begin; block < end; block++){
+                uint32_t* blockHistogram = histograms + block * RADIX_SIZE;
+                std::memset(blockHistogram, 0, sizeof(uint32_t) * RADIX_SIZE);
+                uint32_t last = std::min(count, (block + 1) * blockSize);
+                for(uint32_t i = block * blockSize; i < last; i++) blockHistogram[GetDigit(from[i].key, digit)]++;
+            }
+        }, dependencies);
+        JobScheduler::JobHandle prefix = scheduler->AddJob([=](){
+            uint32_t offset = 0;
+            for(uint32_t value = 0; value < RADIX_SIZE; value++){
+                for(uint32_t block = 0; block < blockCount; block++){
+                    uint32_t valueCount = histograms[block * RADIX_SIZE + value];
+                    histograms[block * RADIX_SIZE + value] = offset;
+                    offset += valueCount;
+                }
+            }
+        }, {histogram});
+        JobScheduler::JobHandle scatter = scheduler->AddParallelFor(blockCount, 1, [=](uint32_t begin, uint32_t end){
+            for(uint32_t block = begin; block < end; block++){
+                uint32_t* blockOffsets = histograms + block * RADIX_SIZE;
+                uint32_t last = std::min(count, (block + 1) * blockSize);
+                for(uint32_t i = block * blockSize; i < last; i++) to[blockOffsets[GetDigit(from[i].key, digit)]++] = from[i];
+            }
+        }, {prefix});
+
+        dependencies = {scatter};
+        std::swap(source, destination);
+    }
+    scheduler->Run();
+    m_order = source;
+}
+
+void DrawQueue::Record(VkCommandBuffer commandBuffer, const DrawBindings& bindings, Telemetry* telemetry) const{
+    if(m_order == nullptr && m_packetCount > 0) throw std::runtime_error("Draw queue recorded before it was sorted!");
+
+    // Everything starts out unbound, IDs past the ranges below can never match
+    uint32_t boundPipeline = UINT32_MAX;
+    uint32_t boundMaterial = UINT32_MAX;
+    uint32_t boundMesh = UINT32_MAX;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkDeviceSize boundVertexBufferOffset = 0;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    VkIndexType boundIndexType = VK_INDEX_TYPE_UINT16;
+
+    for(uint32_t i = 0; i < m_packetCount; i++){
+        const DrawPacket& packet = GetSortedPacket(i);
+        uint32_t pipelineId = GetField(packet.key, PIPELINE_SHIFT, PIPELINE_BITS);
+        uint32_t materialId = GetField(packet.key, MATERIAL_SHIFT, MATERIAL_BITS);
+        uint32_t meshId = GetField(packet.key, MESH_SHIFT, MESH_BITS);
+
+        if(pipelineId != boundPipeline){
+            if(pipelineId >= bindings.pipelineCount) throw std::runtime_error("Draw packet uses an unknown pipeline!");
+            const DrawPipeline& pipeline = bindings.pipelines[pipelineId];
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+            if(telemetry != nullptr) telemetry->Count(TelemetryCounter::PipelineBinds);
+            boundPipeline = pipelineId;
+            // Sets bound for another layout are not guaranteed to survive the switch
+            if(pipeline.layout != boundLayout){
+                boundLayout = pipeline.layout;
+                boundMaterial = UINT32_MAX;
+            }
+        }
+
+        if(materialId != boundMaterial){
+            if(materialId >= bindings.materialCount) throw std::runtime_error("Draw packet uses an unknown material!");
+            const DrawMaterial& material = bindings.materials[materialId];
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundLayout, 0, 1, &material.descriptorSet,
+                material.dynamicOffsetCount, material.dynamicOffsets);
+            boundMaterial = materialId;
+        }
+
+        if(meshId != boundMesh){
+            if(meshId >= bindings.meshCount) throw std::runtime_error("Draw packet uses an unknown mesh!");
+            const DrawMesh& mesh = bindings.meshes[meshId];
+            // Meshes may share their buffers, only what actually differs gets bound again
+            if(mesh.vertexBuffer != boundVertexBuffer || mesh.vertexBufferOffset != boundVertexBufferOffset){
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &mesh.vertexBufferOffset);
+                boundVertexBuffer = mesh.vertexBuffer;
+                boundVertexBufferOffset = mesh.vertexBufferOffset;
+            }
+            if(mesh.indexBuffer != VK_NULL_HANDLE && (mesh.indexBuffer != boundIndexBuffer || mesh.indexType != boundIndexType)){
+                vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+                boundIndexBuffer = mesh.indexBuffer;
+                boundIndexType = mesh.indexType;
+            }
+            boundMesh = meshId;
+        }
+
+        if(packet.indexCount > 0){
+            if(bindings.meshes[meshId].indexBuffer == VK_NULL_HANDLE) throw std::runtime_error("Indexed draw packet uses a mesh without indices!");
+            vkCmdDrawIndexed(commandBuffer, packet.indexCount, packet.instanceCount, packet.firstIndex, packet.vertexOffset, packet.firstInstance);
+        }
+        else{
+            vkCmdDraw(commandBuffer, packet.vertexCount, packet.instanceCount, static_cast<uint32_t>(packet.vertexOffset), packet.firstInstance);
+        }
+        if(telemetry != nullptr) telemetry->Count(TelemetryCounter::DrawCalls);
+    }
+}
+
+uint64_t DrawQueue::MakeSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth){
+    if(pass >= (1u << PASS_BITS) || pipeline >= (1u << PIPELINE_BITS) || material >= (1u << MATERIAL_BITS) || mesh >= (1u << MESH_BITS)){
+        throw std::runtime_error("Draw sort key field out of range!");
+    }
+    const uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+    uint32_t quantizedDepth = static_cast<uint32_t>(std::min(std::max(depth, 0.0f), 1.0f) * maxDepth);
+
+    return (uint64_t(pass) << PASS_SHIFT) | (uint64_t(pipeline) << PIPELINE_SHIFT) | (uint64_t(material) << MATERIAL_SHIFT) |
+        (uint64_t(mesh) << MESH_SHIFT) | (uint64_t(quantizedDepth) << DEPTH_SHIFT);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "JobScheduler.h"
+#include "LinearArena.h"
+#include "VulkanCommon.h"
+
+#include <cstdint>
+
+class Telemetry;
+
+// The state a draw packet refers to by ID, resolved when the queue is recorded. IDs index the arrays of DrawBindings
+struct DrawPipeline{
+    VkPipeline pipeline;
+    VkPipelineLayout layout;
+};
+
+// A descriptor set bound to set 0 of the pipeline layout
+struct DrawMaterial{
+    static constexpr uint32_t MAX_DYNAMIC_OFFSETS = 4;
+
+    VkDescriptorSet descriptorSet;
+    uint32_t dynamicOffsetCount;
+    uint32_t dynamicOffsets[MAX_DYNAMIC_OFFSETS];
+};
+
+struct DrawMesh{
+    VkBuffer vertexBuffer;
+    VkDeviceSize vertexBufferOffset;
+    VkBuffer indexBuffer;// VK_NULL_HANDLE for meshes only drawn without indices
+    VkIndexType indexType;
+};
+
+struct DrawBindings{
+    const DrawPipeline* pipelines;
+    uint32_t pipelineCount;
+    const DrawMaterial* materials;
+    uint32_t materialCount;
+    const DrawMesh* meshes;
+    uint32_t meshCount;
+};
+
+struct DrawPacket{
+    // From DrawQueue::MakeSortKey, which also carries the pipeline, material and mesh IDs
+    uint64_t key;
+    // Indexed when non-zero, otherwise vertexCount vertices are drawn
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;// The first vertex of non-indexed draws
+    uint32_t firstInstance;
+};
+
+// Draws pushed in any order during a frame, sorted by key and recorded with every bind that would not change
+// anything left out. The key orders by pass first, then pipeline, material and mesh, so draws sharing state end up
+// next to each other, and by depth last.
+//
+// All memory of a frame comes from a linear arena sized at Create, Reset drops it in one go
+class DrawQueue
+{
+public:
+    // Bits of each key field, from the most significant one
+    static constexpr uint32_t PASS_BITS = 4;
+    static constexpr uint32_t PIPELINE_BITS = 10;
+    static constexpr uint32_t MATERIAL_BITS = 14;
+    static constexpr uint32_t MESH_BITS = 12;
+    static constexpr uint32_t DEPTH_BITS = 24;
+
+    // Below this many packets sorting on one thread is faster than handing the work out
+    static constexpr uint32_t PARALLEL_SORT_THRESHOLD = 4096;
+
+public:
+    // Room for @maxPackets draws a frame
+    void Create(uint32_t maxPackets);
+
+    // Drop the packets of the last frame
+    void Reset();
+    // Returns false and counts the packet as dropped when the queue is full
+    bool Push(const DrawPacket& packet);
+    // Radix sort the packets by key, in parallel on @scheduler when given and worth it. The scheduler must not run
+    // another graph meanwhile. Packets with equal keys stay in the order they were pushed
+    void Sort(JobScheduler* scheduler);
+    // Record the sorted packets into @commandBuffer inside a render pass. Pipeline binds and draws are counted in
+    // @telemetry when given
+    void Record(VkCommandBuffer commandBuffer, const DrawBindings& bindings, Telemetry* telemetry = nullptr) const;
+
+    // @depth in [0, 1], packets of one pass and state are drawn front to back
+    static uint64_t MakeSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+    // In the order they were pushed
+    const DrawPacket* GetPackets() const { return m_packets; }
+    uint32_t GetPacketCount() const { return m_packetCount; }
+    // The @index-th packet in key order, valid after Sort
+    const DrawPacket& GetSortedPacket(uint32_t index) const { return m_packets[m_order[index].packet]; }
+    uint64_t GetDroppedCount() const { return m_droppedCount; }
+
+private:
+    struct SortEntry{
+        uint64_t key;
+        uint32_t packet;
+    };
+
+private:
+    LinearArena m_arena;
+    uint32_t m_maxPackets = 0;
+    DrawPacket* m_packets = nullptr;
+    uint32_t m_packetCount = 0;
+    // The packets in key order, valid after Sort
+    SortEntry* m_order = nullptr;
+    uint64_t m_droppedCount = 0;
+};
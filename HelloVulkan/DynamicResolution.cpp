@@ -0,0 +1,302 @@
+#include "DynamicResolution.h"
+
+#include "HostAllocator.h"
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace {
+
+// Matches the UpscaleParams push constants of upscale.comp
+struct UpscaleParams{
+    uint32_t renderSize[2];
+    uint32_t sceneSize[2];
+    uint32_t outputSize[2];
+    float sharpness;
+};
+
+// Halfway between the mildest and the strongest sharpening upscale.comp does
+constexpr float SHARPNESS = 0.5f;
+// How much of the difference to a new frame time the smoothed one takes up
+constexpr double GPU_TIME_SMOOTHING = 0.2;
+// How far the scale moves toward the one meeting the budget per frame. A change only shows in the frame times
+// frames in flight later, moving all the way would overshoot
+constexpr float SCALE_RESPONSE = 0.25f;
+
+uint32_t ScaleAxis(uint32_t size, float scale){
+    if(scale >= 1.0f) return size;
+    uint32_t scaled = static_cast<uint32_t>(static_cast<float>(size) * scale);
+    scaled -= scaled % DynamicResolution::EXTENT_GRANULARITY;
+    return Clamp(scaled, std::min(size, DynamicResolution::EXTENT_GRANULARITY), size);
+}
+
+}
+
+bool DynamicResolution::IsSupported(VkPhysicalDevice physicalDevice, uint32_t queueFamily, VkFormat format){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    if(families[queueFamily].timestampValidBits == 0 || properties.limits.timestampPeriod <= 0.0f) return false;
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+    const VkFormatFeatureFlags sceneFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if((formatProperties.optimalTilingFeatures & sceneFeatures) != sceneFeatures) return false;
+
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, UPSCALED_FORMAT, &formatProperties);
+    const VkFormatFeatureFlags upscaledFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT;
+    return (formatProperties.optimalTilingFeatures & upscaledFeatures) == upscaledFeatures;
+}
+
+void DynamicResolution::Create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t framesInFlight,
+    float budgetMs, float minScale, float maxScale, UpscaleFilter filter, const VirtualFileSystem& fileSystem,
+    VkPipelineCache pipelineCache)
+{
+    m_device = device;
+    m_frameCount = framesInFlight;
+    m_filter = filter;
+    m_fileSystem = &fileSystem;
+    m_pipelineCache = pipelineCache;
+    m_budgetMs = budgetMs;
+    m_maxScale = Clamp(maxScale, 0.0f, 1.0f);
+    m_minScale = Clamp(minScale, 0.0f, m_maxScale);
+    m_scale = m_maxScale;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    m_timestampPeriod = properties.limits.timestampPeriod;
+    m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * m_frameCount;
+    ThrowIfFailed(vkCreateQueryPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_queryPool),
+        "Failed to create frame time query pool!");
+    m_frameScales.assign(m_frameCount, m_scale);
+    m_frameRecorded.assign(m_frameCount, false);
+
+    if(m_filter == UpscaleFilter::Sharpen) CreatePipeline();
+}
+
+void DynamicResolution::Destroy(){
+    ReleaseTargets();
+
+    vkDestroyPipeline(m_device, m_pipeline, GetAllocationCallbacks());
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, GetAllocationCallbacks());
+    vkDestroyDescriptorSetLayout(m_device, m_setLayout, GetAllocationCallbacks());
+    vkDestroySampler(m_device, m_sampler, GetAllocationCallbacks());
+    vkDestroyQueryPool(m_device, m_queryPool, GetAllocationCallbacks());
+
+    m_pipeline = VK_NULL_HANDLE;
+    m_pipelineLayout = VK_NULL_HANDLE;
+    m_setLayout = VK_NULL_HANDLE;
+    m_sampler = VK_NULL_HANDLE;
+    m_queryPool = VK_NULL_HANDLE;
+    m_frameScales.clear();
+    m_frameRecorded.clear();
+}
+
+void DynamicResolution::CreatePipeline(){
+    // Filtered across the drawn part only, the shader keeps its coordinates inside
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    ThrowIfFailed(vkCreateSampler(m_device, &samplerInfo, GetAllocationCallbacks(), &m_sampler),
+        "Failed to create upscale sampler!");
+
+    // 0: the scene target, 1: the upscaled image
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1] = bindings[0];
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &layoutInfo, GetAllocationCallbacks(), &m_setLayout),
+        "Failed to create upscale descriptor set layout!");
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(UpscaleParams);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, GetAllocationCallbacks(), &m_pipelineLayout),
+        "Failed to create upscale pipeline layout!");
+
+    Asset shaderCode = m_fileSystem->Open("shaders/upscale_comp.spv");
+    VkShaderModule shaderModule = CreateShaderModule(m_device, shaderCode.GetBytes());
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    ThrowIfFailed(vkCreateComputePipelines(m_device, m_pipelineCache, 1, &pipelineInfo, GetAllocationCallbacks(), &m_pipeline),
+        "Failed to create upscale pipeline!");
+
+    vkDestroyShaderModule(m_device, shaderModule, GetAllocationCallbacks());
+}
+
+void DynamicResolution::SetTargets(const std::vector<VkImageView>& sceneViews, VkImageView upscaledView){
+    ReleaseTargets();
+    if(m_filter != UpscaleFilter::Sharpen) return;
+
+    uint32_t setCount = static_cast<uint32_t>(sceneViews.size());
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_descriptorPool),
+        "Failed to create upscale descriptor pool!");
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, m_setLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_descriptorSets.resize(setCount);
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()),
+        "Failed to allocate upscale descriptor sets!");
+
+    for(uint32_t i = 0; i < setCount; i++){
+        VkDescriptorImageInfo sceneInfo = {};
+        sceneInfo.sampler = m_sampler;
+        sceneInfo.imageView = sceneViews[i];
+        sceneInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VkDescriptorImageInfo upscaledInfo = {};
+        upscaledInfo.imageView = upscaledView;
+        upscaledInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> writes = {};
+        for(uint32_t j = 0; j < writes.size(); j++){
+            writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[j].dstSet = m_descriptorSets[i];
+            writes[j].dstBinding = j;
+            writes[j].dstArrayElement = 0;
+            writes[j].descriptorCount = 1;
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &sceneInfo;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &upscaledInfo;
+
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void DynamicResolution::ReleaseTargets(){
+    if(m_device == VK_NULL_HANDLE) return;
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, GetAllocationCallbacks());
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSets.clear();
+}
+
+VkExtent2D DynamicResolution::GetRenderExtent(VkExtent2D outputExtent) const{
+    return {ScaleAxis(outputExtent.width, m_scale), ScaleAxis(outputExtent.height, m_scale)};
+}
+
+void DynamicResolution::Update(uint32_t frame){
+    if(!m_frameRecorded[frame]) return;
+    m_frameRecorded[frame] = false;
+
+    uint64_t ticks[2];
+    VkResult result = vkGetQueryPoolResults(m_device, m_queryPool, 2 * frame, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if(result != VK_SUCCESS) return;
+    m_lastGpuMs = static_cast<double>((ticks[1] - ticks[0]) & m_timestampMask) * m_timestampPeriod / 1e6;
+
+    // What the frame would have taken at full resolution, smoothed so one slow frame does not drop the scale
+    float frameScale = std::max(m_frameScales[frame], 0.01f);
+    double fullResolutionMs = m_lastGpuMs / (static_cast<double>(frameScale) * frameScale);
+    if(m_fullResolutionMs <= 0.0){
+        m_fullResolutionMs = fullResolutionMs;
+    }else{
+        m_fullResolutionMs += (fullResolutionMs - m_fullResolutionMs) * GPU_TIME_SMOOTHING;
+    }
+
+    float target = static_cast<float>(std::sqrt(m_budgetMs / std::max(m_fullResolutionMs, 1e-3)));
+    m_scale = Clamp(m_scale + (target - m_scale) * SCALE_RESPONSE, m_minScale, m_maxScale);
+}
+
+void DynamicResolution::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frame){
+    vkCmdResetQueryPool(commandBuffer, m_queryPool, 2 * frame, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, 2 * frame);
+    m_frameScales[frame] = m_scale;
+}
+
+void DynamicResolution::EndFrame(VkCommandBuffer commandBuffer, uint32_t frame){
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2 * frame + 1);
+    m_frameRecorded[frame] = true;
+}
+
+void DynamicResolution::RecordBlit(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D sourceExtent, VkImage destination,
+    VkExtent2D destinationExtent) const
+{
+    VkImageBlit region = {};
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.srcOffsets[1] = {static_cast<int32_t>(sourceExtent.width), static_cast<int32_t>(sourceExtent.height), 1};
+    region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.dstOffsets[1] = {static_cast<int32_t>(destinationExtent.width), static_cast<int32_t>(destinationExtent.height), 1};
+    bool sameSize = sourceExtent.width == destinationExtent.width && sourceExtent.height == destinationExtent.height;
+    vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region, sameSize ? VK_FILTER_NEAREST : VK_FILTER_LINEAR);
+}
+
+void DynamicResolution::RecordSharpen(VkCommandBuffer commandBuffer, uint32_t sceneIndex, VkExtent2D renderExtent,
+    VkExtent2D sceneExtent, VkExtent2D outputExtent, Telemetry* telemetry) const
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSets[sceneIndex],
+        0, nullptr);
+
+    UpscaleParams params = {{renderExtent.width, renderExtent.height}, {sceneExtent.width, sceneExtent.height},
+        {outputExtent.width, outputExtent.height}, SHARPNESS};
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(commandBuffer, (outputExtent.width + UPSCALE_WORKGROUP_SIZE - 1) / UPSCALE_WORKGROUP_SIZE,
+        (outputExtent.height + UPSCALE_WORKGROUP_SIZE - 1) / UPSCALE_WORKGROUP_SIZE, 1);
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::PipelineBinds);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <vector>
+
+class Telemetry;
+
+// How the scene drawn at a lower resolution is brought to the size of the window
+enum class UpscaleFilter{
+    Bilinear,// A linear blit
+    Sharpen// Bilinear in a compute pass, followed by contrast adaptive sharpening
+};
+
+// Keeps the GPU time of a frame within a budget by drawing the scene at a lower resolution. Every frame in flight
+// brackets its command buffer with two timestamps. Once its fence was waited on, the time between them moves the
+// render scale toward the one that would have met the budget, taking the cost of a frame to grow with its pixel
+// count. The scene is drawn into the top left of a target of the window size and upscaled into the window image
+//
+// Render extents are rounded down to multiples of EXTENT_GRANULARITY, so noise in the frame times does not resize
+// every frame. Both axes are scaled alike and the projection keeps the aspect ratio of the window
+class DynamicResolution
+{
+public:
+    static constexpr uint32_t UPSCALE_WORKGROUP_SIZE = 8;// upscale.comp, in both dimensions
+    static constexpr VkFormat UPSCALED_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+    static constexpr uint32_t EXTENT_GRANULARITY = 8;
+
+public:
+    // Timestamps on @queueFamily, scene targets of @format that can be drawn into, sampled and blitted from, window
+    // images of @format that can be blitted into and an upscaled image the compute pass can write
+    static bool IsSupported(VkPhysicalDevice physicalDevice, uint32_t queueFamily, VkFormat format);
+
+    // Scale each axis between @minScale and @maxScale, at most 1, to keep a frame within @budgetMs on the GPU.
+    // Shaders are loaded from @fileSystem
+    void Create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, float budgetMs,
+        float minScale, float maxScale, UpscaleFilter filter, const VirtualFileSystem& fileSystem, VkPipelineCache pipelineCache);
+    void Destroy();
+
+    // Sharpen only: upscale from the scene targets behind @sceneViews into @upscaledView, an image of UPSCALED_FORMAT.
+    // Both follow the swap chain, call again once they were recreated
+    void SetTargets(const std::vector<VkImageView>& sceneViews, VkImageView upscaledView);
+    void ReleaseTargets();
+
+    UpscaleFilter GetFilter() const { return m_filter; }
+    // Per axis, of the window size
+    float GetScale() const { return m_scale; }
+    // GPU time of the last frame read back
+    double GetLastGpuMs() const { return m_lastGpuMs; }
+    // The top left part of a target of @outputExtent the scene is drawn into at the current scale
+    VkExtent2D GetRenderExtent(VkExtent2D outputExtent) const;
+
+    // Once the fence of the last frame in slot @frame was waited on: read back how long it took and adjust the scale
+    void Update(uint32_t frame);
+    // First and last thing in the command buffer of @frame, outside any render pass
+    void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+    void EndFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    // Blit @sourceExtent from the top left of @source, in the transfer source layout, over @destinationExtent of
+    // @destination in the transfer destination layout. Linear unless the extents match
+    void RecordBlit(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D sourceExtent, VkImage destination,
+        VkExtent2D destinationExtent) const;
+    // Sharpen only: filter @renderExtent of the scene target behind scene view @sceneIndex, of @sceneExtent and in the
+    // shader read-only layout, into @outputExtent of the upscaled image in the general layout
+    void RecordSharpen(VkCommandBuffer commandBuffer, uint32_t sceneIndex, VkExtent2D renderExtent, VkExtent2D sceneExtent,
+        VkExtent2D outputExtent, Telemetry* telemetry = nullptr) const;
+
+private:
+    void CreatePipeline();
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_frameCount = 0;
+    UpscaleFilter m_filter = UpscaleFilter::Bilinear;
+    const VirtualFileSystem* m_fileSystem = nullptr;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+
+    // Two timestamps per frame in flight, and the scale each of them was recorded with. A slot that was not recorded
+    // since it was last read holds nothing to read
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    double m_timestampPeriod = 1.0;// Nanoseconds per tick
+    uint64_t m_timestampMask = ~0ull;
+    std::vector<float> m_frameScales;
+    std::vector<bool> m_frameRecorded;
+
+    float m_budgetMs = 0.0f;
+    float m_minScale = 1.0f;
+    float m_maxScale = 1.0f;
+    float m_scale = 1.0f;
+    // Smoothed GPU time a frame would take at full resolution
+    double m_fullResolutionMs = 0.0;
+    double m_lastGpuMs = 0.0;
+
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    // One set per scene target, follow the swap chain
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_descriptorSets;
+};
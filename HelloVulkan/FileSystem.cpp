@@ -0,0 +1,226 @@
+#include "FileSystem.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ByteSpan ByteSpan::SubSpan(size_t offset, size_t count) const{
+    if(offset > size || count > size - offset){
+        throw std::runtime_error("Byte range is out of bounds!");
+    }
+    return {data + offset, count};
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename){
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE){
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    m_file = file;
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize)){
+        CloseHandle(file);
+        throw std::runtime_error("Failed to get the size of file: " + filename);
+    }
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    // Empty files can not be mapped, but there is nothing to view either
+    if(m_size == 0) return;
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(m_mapping != nullptr){
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if(m_data == nullptr){
+        if(m_mapping != nullptr) CloseHandle(m_mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Failed to map file: " + filename);
+    }
+}
+
+MappedFile::~MappedFile(){
+    if(m_data != nullptr) UnmapViewOfFile(m_data);
+    if(m_mapping != nullptr) CloseHandle(m_mapping);
+    if(m_file != nullptr) CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename){
+    int file = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if(file < 0){
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+
+    struct stat fileStat;
+    if(fstat(file, &fileStat) != 0){
+        close(file);
+        throw std::runtime_error("Failed to get the size of file: " + filename);
+    }
+    m_size = static_cast<size_t>(fileStat.st_size);
+    // Empty files can not be mapped, but there is nothing to view either
+    if(m_size == 0){
+        close(file);
+        return;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping keeps its own reference to the file
+    close(file);
+    if(data == MAP_FAILED){
+        throw std::runtime_error("Failed to map file: " + filename);
+    }
+    m_data = static_cast<const uint8_t*>(data);
+
+    // Assets are read front to back right after loading, start paging them in now
+    posix_madvise(data, m_size, POSIX_MADV_WILLNEED);
+}
+
+MappedFile::~MappedFile(){
+    if(m_data != nullptr) munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+#endif
+
+void Asset::CheckLayout(size_t alignment, size_t elementSize) const{
+    if(reinterpret_cast<uintptr_t>(m_bytes.data) % alignment != 0){
+        throw std::runtime_error("Asset data is not aligned for the requested type!");
+    }
+    if(m_bytes.size % elementSize != 0){
+        throw std::runtime_error("Asset size is not a multiple of the requested type!");
+    }
+}
+
+bool IsValidAssetPath(const std::string& path){
+    if(path.empty() || path.front() == '/' || path.front() == '\\' || path.find(':') != std::string::npos){
+        return false;
+    }
+
+    // Reject every ".." component
+    size_t start = 0;
+    while(start <= path.size()){
+        size_t end = path.find_first_of("/\\", start);
+        if(end == std::string::npos) end = path.size();
+        if(path.compare(start, end - start, "..") == 0) return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+bool MountPoint::ReadInto(const std::string& path, uint8_t* destination) const{
+    Asset asset;
+    if(!Open(path, asset)) return false;
+    if(asset.GetSize() > 0) memcpy(destination, asset.GetData(), asset.GetSize());
+    return true;
+}
+
+DirectoryMount::DirectoryMount(const std::string& root) : m_root(root){
+    if(!m_root.empty() && m_root.back() != '/' && m_root.back() != '\\') m_root += '/';
+}
+
+bool DirectoryMount::Exists(const std::string& path) const{
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA((m_root + path).c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat fileStat;
+    return stat((m_root + path).c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode);
+#endif
+}
+
+bool DirectoryMount::Open(const std::string& path, Asset& asset) const{
+    if(!Exists(path)) return false;
+
+    auto file = std::make_shared<MappedFile>(m_root + path);
+    asset = Asset(file->GetBytes(), file);
+    return true;
+}
+
+bool DirectoryMount::GetSize(const std::string& path, size_t& size) const{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if(!GetFileAttributesExA((m_root + path).c_str(), GetFileExInfoStandard, &attributes) ||
+        (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)){
+        return false;
+    }
+    size = static_cast<size_t>((static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow);
+    return true;
+#else
+    struct stat fileStat;
+    if(stat((m_root + path).c_str(), &fileStat) != 0 || !S_ISREG(fileStat.st_mode)) return false;
+    size = static_cast<size_t>(fileStat.st_size);
+    return true;
+#endif
+}
+
+void VirtualFileSystem::Mount(std::unique_ptr<MountPoint> mountPoint){
+    m_mounts.push_back(std::move(mountPoint));
+}
+
+void VirtualFileSystem::MountDirectory(const std::string& directory){
+    Mount(std::make_unique<DirectoryMount>(directory));
+}
+
+bool VirtualFileSystem::Exists(const std::string& path) const{
+    if(!IsValidAssetPath(path)) return false;
+
+    for(auto mount = m_mounts.rbegin(); mount != m_mounts.rend(); ++mount){
+        if((*mount)->Exists(path)) return true;
+    }
+    return false;
+}
+
+Asset VirtualFileSystem::Open(const std::string& path) const{
+    if(!IsValidAssetPath(path)){
+        throw std::runtime_error("Invalid asset path: " + path);
+    }
+
+    Asset asset;
+    for(auto mount = m_mounts.rbegin(); mount != m_mounts.rend(); ++mount){
+        if((*mount)->Open(path, asset)) return asset;
+    }
+    throw std::runtime_error("Failed to find asset: " + path);
+}
+
+size_t VirtualFileSystem::GetSize(const std::string& path) const{
+    if(!IsValidAssetPath(path)){
+        throw std::runtime_error("Invalid asset path: " + path);
+    }
+
+    size_t size = 0;
+    for(auto mount = m_mounts.rbegin(); mount != m_mounts.rend(); ++mount){
+        if((*mount)->GetSize(path, size)) return size;
+    }
+    throw std::runtime_error("Failed to find asset: " + path);
+}
+
+void VirtualFileSystem::ReadInto(const std::string& path, void* destination, size_t capacity) const{
+    if(!IsValidAssetPath(path)){
+        throw std::runtime_error("Invalid asset path: " + path);
+    }
+
+    // Ask the mounts in the same order as Open, so size and contents come from the same file
+    size_t size = 0;
+    for(auto mount = m_mounts.rbegin(); mount != m_mounts.rend(); ++mount){
+        if(!(*mount)->GetSize(path, size)) continue;
+        if(size > capacity){
+            throw std::runtime_error("Asset does not fit the destination buffer: " + path);
+        }
+        if((*mount)->ReadInto(path, static_cast<uint8_t*>(destination))) return;
+    }
+    throw std::runtime_error("Failed to find asset: " + path);
+}
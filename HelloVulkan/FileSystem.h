@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A read-only view of contiguous bytes. Does not own them
+struct ByteSpan{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    bool Empty() const { return size == 0; }
+    const uint8_t* begin() const { return data; }
+    const uint8_t* end() const { return data + size; }
+    // The @count bytes starting at @offset, throws when they are not all inside this span
+    ByteSpan SubSpan(size_t offset, size_t count) const;
+};
+
+// A whole file mapped read-only into the address space. The mapping starts on a page boundary, so the
+// data is suitably aligned for any type
+class MappedFile
+{
+public:
+    // Throws when @filename can not be opened or mapped
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ByteSpan GetBytes() const { return {m_data, m_size}; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+// The bytes of a loaded asset together with whatever keeps them alive, a file mapping or a buffer an archive
+// was unpacked into. Copying an Asset only copies the reference
+class Asset
+{
+public:
+    Asset() = default;
+    Asset(ByteSpan bytes, std::shared_ptr<const void> owner) : m_bytes(bytes), m_owner(std::move(owner)) {}
+
+    ByteSpan GetBytes() const { return m_bytes; }
+    const uint8_t* GetData() const { return m_bytes.data; }
+    size_t GetSize() const { return m_bytes.size; }
+
+    // Reinterpret the bytes as an array of T, throws if they are not aligned for T or not a whole number of them
+    template<typename T>
+    const T* As() const{
+        CheckLayout(alignof(T), sizeof(T));
+        return reinterpret_cast<const T*>(m_bytes.data);
+    }
+
+private:
+    void CheckLayout(size_t alignment, size_t elementSize) const;
+
+private:
+    ByteSpan m_bytes;
+    std::shared_ptr<const void> m_owner;
+};
+
+// Something files can be looked up in: a directory, an archive, ...
+class MountPoint
+{
+public:
+    virtual ~MountPoint() = default;
+
+    virtual bool Exists(const std::string& path) const = 0;
+    // Fill @asset and return true when @path is in this mount. Must be safe to call from several threads at once
+    virtual bool Open(const std::string& path, Asset& asset) const = 0;
+    // Size of @path in bytes, false when it is not in this mount
+    virtual bool GetSize(const std::string& path, size_t& size) const = 0;
+    // Copy @path into @destination, which holds at least GetSize bytes. Mounts that have to unpack data write it
+    // there directly, so loading into mapped staging memory needs no intermediate buffer
+    virtual bool ReadInto(const std::string& path, uint8_t* destination) const;
+};
+
+// Serves the files below a directory of the real file system through memory mappings
+class DirectoryMount : public MountPoint
+{
+public:
+    explicit DirectoryMount(const std::string& root);
+
+    bool Exists(const std::string& path) const override;
+    bool Open(const std::string& path, Asset& asset) const override;
+    bool GetSize(const std::string& path, size_t& size) const override;
+
+private:
+    std::string m_root;
+};
+
+// Resolves forward-slash separated paths such as "shaders/vert.spv" against a stack of mounts, the most
+// recently mounted first. Mount everything before loading, Open may then be called from any thread
+class VirtualFileSystem
+{
+public:
+    void Mount(std::unique_ptr<MountPoint> mountPoint);
+    void MountDirectory(const std::string& directory);
+
+    bool Exists(const std::string& path) const;
+    // These throw when no mount has @path
+    Asset Open(const std::string& path) const;
+    size_t GetSize(const std::string& path) const;
+    // Copy @path into @destination of @capacity bytes, throws when it does not fit
+    void ReadInto(const std::string& path, void* destination, size_t capacity) const;
+
+private:
+    std::vector<std::unique_ptr<MountPoint>> m_mounts;
+};
+
+// Check that @path is relative and stays inside its mount, so it can not reach outside through ".."
+bool IsValidAssetPath(const std::string& path);
@@ -0,0 +1,206 @@
+#include "FrameCapture.h"
+#include "Checksum.h"
+#include "Compression.h"
+#include "FileSystem.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace{
+
+// Leads every record, the variable-sized arrays follow in this order: object matrices, draw list indices, draw packets
+struct FrameFields{
+    float time;
+    float particleDeltaTime;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec2 textureCoverage;
+    DrawListBuilder::Result drawList;
+    uint32_t drawListIndexCount;
+    uint32_t drawPacketCount;
+};
+
+static_assert(sizeof(FrameFields) == 192 && sizeof(DrawPacket) == 32, "Capture records must not contain padding");
+
+}
+
+FrameCaptureWriter::~FrameCaptureWriter(){
+    Close();
+}
+
+void FrameCaptureWriter::Open(const std::string& path, const CaptureResources& resources){
+    Close();
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if(m_file == nullptr) throw std::runtime_error("Failed to create capture: " + path);
+    m_objectCount = resources.objectCount;
+    m_frameCount = 0;
+
+    // The frame count stays zero until Close rewrites the header
+    CaptureHeader header = {};
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_VERSION;
+    header.width = resources.width;
+    header.height = resources.height;
+    header.objectCount = resources.objectCount;
+    header.textureBudgetMB = resources.textureBudgetMB;
+    header.stressObjectCount = resources.stressObjectCount;
+    header.stressPipelineCount = resources.stressPipelineCount;
+    header.stressUploadKB = resources.stressUploadKB;
+    header.textureNameLength = static_cast<uint32_t>(resources.texture.size());
+    header.vertexDataSize = resources.vertexData.size();
+    header.indexDataSize = resources.indexData.size();
+    header.textureDataSize = resources.textureData.size();
+    std::fwrite(&header, sizeof(header), 1, m_file);
+    std::fwrite(resources.vertexData.data(), 1, resources.vertexData.size(), m_file);
+    std::fwrite(resources.indexData.data(), 1, resources.indexData.size(), m_file);
+    std::fwrite(resources.texture.data(), 1, resources.texture.size(), m_file);
+    std::fwrite(resources.textureData.data(), 1, resources.textureData.size(), m_file);
+}
+
+void FrameCaptureWriter::WriteFrame(const CaptureFrame& frame){
+    if(frame.objectMatrices.size() != m_objectCount){
+        throw std::runtime_error("Captured frame has a matrix count different from the scene!");
+    }
+
+    FrameFields fields = {};
+    fields.time = frame.time;
+    fields.particleDeltaTime = frame.particleDeltaTime;
+    fields.view = frame.view;
+    fields.projection = frame.projection;
+    fields.textureCoverage = frame.textureCoverage;
+    fields.drawList = frame.drawList;
+    fields.drawListIndexCount = static_cast<uint32_t>(frame.drawListIndices.size());
+    fields.drawPacketCount = static_cast<uint32_t>(frame.drawPackets.size());
+
+    size_t matricesSize = frame.objectMatrices.size() * sizeof(glm::mat4);
+    size_t indicesSize = frame.drawListIndices.size() * sizeof(uint32_t);
+    size_t packetsSize = frame.drawPackets.size() * sizeof(DrawPacket);
+    m_record.resize(sizeof(fields) + matricesSize + indicesSize + packetsSize);
+    uint8_t* data = m_record.data();
+    memcpy(data, &fields, sizeof(fields));
+    data += sizeof(fields);
+    if(matricesSize > 0) memcpy(data, frame.objectMatrices.data(), matricesSize);
+    data += matricesSize;
+    if(indicesSize > 0) memcpy(data, frame.drawListIndices.data(), indicesSize);
+    data += indicesSize;
+    if(packetsSize > 0) memcpy(data, frame.drawPackets.data(), packetsSize);
+
+    // Keep the record stored when compressing did not pay off
+    m_compressed.resize(CompressBound(Compression::Lz4, m_record.size()));
+    m_compressed.resize(Compress(Compression::Lz4, m_record.data(), m_record.size(), m_compressed.data(), m_compressed.size()));
+    bool stored = m_compressed.size() >= m_record.size();
+    const std::vector<uint8_t>& bytes = stored ? m_record : m_compressed;
+
+    CaptureRecord record = {};
+    record.size = static_cast<uint32_t>(m_record.size());
+    record.storedSize = static_cast<uint32_t>(bytes.size());
+    record.checksum = Crc32(bytes.data(), bytes.size());
+    record.compression = static_cast<uint32_t>(stored ? Compression::None : Compression::Lz4);
+    std::fwrite(&record, sizeof(record), 1, m_file);
+    std::fwrite(bytes.data(), 1, bytes.size(), m_file);
+    m_frameCount++;
+}
+
+void FrameCaptureWriter::Close(){
+    if(m_file == nullptr) return;
+
+    uint32_t frameCount = m_frameCount;
+    std::fseek(m_file, offsetof(CaptureHeader, frameCount), SEEK_SET);
+    std::fwrite(&frameCount, sizeof(frameCount), 1, m_file);
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void FrameCaptureReader::Open(const std::string& path){
+    MappedFile file(path);
+    ByteSpan bytes = file.GetBytes();
+
+    CaptureHeader header;
+    if(bytes.size < sizeof(header)){
+        throw std::runtime_error("Not a frame capture: " + path);
+    }
+    memcpy(&header, bytes.data, sizeof(header));
+    if(memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != CAPTURE_VERSION){
+        throw std::runtime_error("Not a frame capture or unsupported version: " + path);
+    }
+    if(header.frameCount == 0){
+        throw std::runtime_error("Frame capture was not closed or holds no frames: " + path);
+    }
+
+    // SubSpan throws once anything points past the end of the file
+    size_t offset = sizeof(header);
+    auto take = [&](size_t size){
+        ByteSpan span = bytes.SubSpan(offset, size);
+        offset += size;
+        return span;
+    };
+    ByteSpan vertexData = take(static_cast<size_t>(header.vertexDataSize));
+    ByteSpan indexData = take(static_cast<size_t>(header.indexDataSize));
+    ByteSpan texture = take(header.textureNameLength);
+    ByteSpan textureData = take(static_cast<size_t>(header.textureDataSize));
+    m_resources.width = header.width;
+    m_resources.height = header.height;
+    m_resources.objectCount = header.objectCount;
+    m_resources.textureBudgetMB = header.textureBudgetMB;
+    m_resources.stressObjectCount = header.stressObjectCount;
+    m_resources.stressPipelineCount = header.stressPipelineCount;
+    m_resources.stressUploadKB = header.stressUploadKB;
+    m_resources.texture.assign(texture.begin(), texture.end());
+    m_resources.textureData.assign(textureData.begin(), textureData.end());
+    m_resources.vertexData.assign(vertexData.begin(), vertexData.end());
+    m_resources.indexData.assign(indexData.begin(), indexData.end());
+
+    m_frames.clear();
+    m_frames.resize(header.frameCount);
+    std::vector<uint8_t> unpacked;
+    for(CaptureFrame& frame: m_frames){
+        CaptureRecord record;
+        memcpy(&record, take(sizeof(record)).data, sizeof(record));
+        ByteSpan stored = take(record.storedSize);
+        if(Crc32(stored.data, stored.size) != record.checksum){
+            throw std::runtime_error("Corrupt frame capture record: " + path);
+        }
+
+        const uint8_t* data = stored.data;
+        if(record.compression != static_cast<uint32_t>(Compression::None)){
+            unpacked.resize(record.size);
+            if(!Decompress(static_cast<Compression>(record.compression), stored.data, stored.size, unpacked.data(), unpacked.size())){
+                throw std::runtime_error("Corrupt frame capture record: " + path);
+            }
+            data = unpacked.data();
+        }else if(record.storedSize != record.size){
+            throw std::runtime_error("Corrupt frame capture record: " + path);
+        }
+
+        FrameFields fields;
+        uint64_t expectedSize = sizeof(fields);
+        if(record.size >= sizeof(fields)){
+            memcpy(&fields, data, sizeof(fields));
+            expectedSize += static_cast<uint64_t>(header.objectCount) * sizeof(glm::mat4) +
+                static_cast<uint64_t>(fields.drawListIndexCount) * sizeof(uint32_t) +
+                static_cast<uint64_t>(fields.drawPacketCount) * sizeof(DrawPacket);
+        }
+        if(record.size != expectedSize){
+            throw std::runtime_error("Corrupt frame capture record: " + path);
+        }
+        data += sizeof(fields);
+
+        frame.time = fields.time;
+        frame.particleDeltaTime = fields.particleDeltaTime;
+        frame.view = fields.view;
+        frame.projection = fields.projection;
+        frame.textureCoverage = fields.textureCoverage;
+        frame.drawList = fields.drawList;
+        frame.objectMatrices.resize(header.objectCount);
+        frame.drawListIndices.resize(fields.drawListIndexCount);
+        frame.drawPackets.resize(fields.drawPacketCount);
+        auto read = [&](void* destination, size_t size){
+            if(size > 0) memcpy(destination, data, size);
+            data += size;
+        };
+        read(frame.objectMatrices.data(), frame.objectMatrices.size() * sizeof(glm::mat4));
+        read(frame.drawListIndices.data(), frame.drawListIndices.size() * sizeof(uint32_t));
+        read(frame.drawPackets.data(), frame.drawPackets.size() * sizeof(DrawPacket));
+    }
+}
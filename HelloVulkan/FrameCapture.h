@@ -0,0 +1,122 @@
+#pragma once
+
+#include "DrawListBuilder.h"
+#include "DrawQueue.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Everything DrawFrame consumes, recorded so a frame can be replayed without the simulation that produced it:
+//
+//   CaptureHeader | vertex data | index data | texture name | texture data | (CaptureRecord | record data)...
+//
+// The header describes the resources created at startup, the records follow one per frame. The texture file is
+// stored whole, so a replay draws the same texels even when the file changed or is missing since. Record data is
+// compressed with LZ4 unless that did not shrink it. Integers and floats are in host order, every supported target
+// is little-endian
+constexpr char CAPTURE_MAGIC[4] = {'H', 'V', 'C', 'P'};
+constexpr uint32_t CAPTURE_VERSION = 3;
+
+struct CaptureHeader{
+    char magic[4];
+    uint32_t version;
+    uint32_t frameCount;// Written on Close, zero when the capture did not finish
+    uint32_t width;
+    uint32_t height;
+    uint32_t objectCount;
+    uint32_t textureBudgetMB;
+    uint32_t stressObjectCount;
+    uint32_t stressPipelineCount;
+    uint32_t stressUploadKB;
+    uint32_t textureNameLength;
+    uint32_t reserved;
+    uint64_t vertexDataSize;
+    uint64_t indexDataSize;
+    uint64_t textureDataSize;
+};
+
+struct CaptureRecord{
+    uint32_t size;// Unpacked size
+    uint32_t storedSize;// Equal to size when the record is stored
+    uint32_t checksum;// CRC-32 of the stored bytes
+    uint32_t compression;// A Compression value
+};
+
+static_assert(sizeof(CaptureHeader) == 72 && sizeof(CaptureRecord) == 16, "Capture structures must not contain padding");
+
+// The startup parameters and uploads a replay has to recreate
+struct CaptureResources{
+    uint32_t width;
+    uint32_t height;
+    uint32_t objectCount;
+    uint32_t textureBudgetMB;
+    // The stress scene options, a zero object count for the default scene
+    uint32_t stressObjectCount;
+    uint32_t stressPipelineCount;
+    uint32_t stressUploadKB;
+    // Empty texture name and data for the generated checkerboard
+    std::string texture;
+    std::vector<uint8_t> textureData;
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+};
+
+// One frame packet as the render thread drew it
+struct CaptureFrame{
+    float time;
+    // Time step of the particle simulation submitted during this frame
+    float particleDeltaTime;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec2 textureCoverage;
+    DrawListBuilder::Result drawList;
+    // A world matrix per object
+    std::vector<glm::mat4> objectMatrices;
+    // The visible objects, as far as the LODs of drawList reach
+    std::vector<uint32_t> drawListIndices;
+    // In the order they were pushed
+    std::vector<DrawPacket> drawPackets;
+};
+
+// Appends frames to a capture file as they are drawn
+class FrameCaptureWriter
+{
+public:
+    ~FrameCaptureWriter();
+
+    void Open(const std::string& path, const CaptureResources& resources);
+    void WriteFrame(const CaptureFrame& frame);
+    // Finish the header, the capture can not be replayed without it
+    void Close();
+
+    bool IsOpen() const { return m_file != nullptr; }
+    uint32_t GetFrameCount() const { return m_frameCount; }
+
+private:
+    std::FILE* m_file = nullptr;
+    uint32_t m_objectCount = 0;
+    uint32_t m_frameCount = 0;
+    std::vector<uint8_t> m_record;
+    std::vector<uint8_t> m_compressed;
+};
+
+// Reads a whole capture up front, so replaying it costs no IO or decompression
+class FrameCaptureReader
+{
+public:
+    // Throws when @path is not a complete capture
+    void Open(const std::string& path);
+
+    const CaptureResources& GetResources() const { return m_resources; }
+    uint32_t GetFrameCount() const { return static_cast<uint32_t>(m_frames.size()); }
+    const CaptureFrame& GetFrame(uint32_t index) const { return m_frames[index]; }
+    bool IsOpen() const { return !m_frames.empty(); }
+
+private:
+    CaptureResources m_resources;
+    std::vector<CaptureFrame> m_frames;
+};
@@ -0,0 +1,263 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+// The margin never shrinks below this, the wake-up from a sleep alone can take that long
+constexpr double MIN_MARGIN_MS = 1.0;
+// How much of the difference to the floor the margin gives up per frame that was on time
+constexpr double MARGIN_DECAY = 0.02;
+// How much of the difference to a new sample the smoothed present interval and CPU time take up
+constexpr double INTERVAL_SMOOTHING = 0.1;
+constexpr double CPU_WORK_SMOOTHING = 0.1;
+// Sleeping is only trusted up to this close to the start of a frame, the rest is spun away
+constexpr std::chrono::microseconds SPIN_TIME(1000);
+// Reported present times further than this from the clock of the pacer are taken to be on another clock
+constexpr double MAX_CLOCK_DISTANCE_MS = 1000.0;
+
+bool HasExtension(const std::vector<VkExtensionProperties>& extensions, const char* name){
+    return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& extension){
+        return strcmp(extension.extensionName, name) == 0;
+    });
+}
+
+std::vector<VkExtensionProperties> GetDeviceExtensions(VkPhysicalDevice physicalDevice){
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    return extensions;
+}
+
+double MillisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to){
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+std::chrono::steady_clock::duration Milliseconds(double milliseconds){
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(milliseconds));
+}
+
+}
+
+const char* GetPresentTimingSourceName(PresentTimingSource source){
+    switch(source){
+    case PresentTimingSource::PresentWait: return "present wait";
+    case PresentTimingSource::DisplayTiming: return "display timing";
+    case PresentTimingSource::CpuTimer: return "CPU timer";
+    default: return "unknown";
+    }
+}
+
+PresentTimingSource FramePacer::SelectSource(VkPhysicalDevice physicalDevice, FramePacingMode mode, bool headless){
+    if(headless || mode != FramePacingMode::Auto) return PresentTimingSource::CpuTimer;
+    if(IsPresentWaitSupported(physicalDevice)) return PresentTimingSource::PresentWait;
+    if(HasExtension(GetDeviceExtensions(physicalDevice), VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME)){
+        return PresentTimingSource::DisplayTiming;
+    }
+    return PresentTimingSource::CpuTimer;
+}
+
+bool FramePacer::IsPresentWaitSupported(VkPhysicalDevice physicalDevice){
+    std::vector<VkExtensionProperties> extensions = GetDeviceExtensions(physicalDevice);
+    if(!HasExtension(extensions, VK_KHR_PRESENT_ID_EXTENSION_NAME) || !HasExtension(extensions, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)){
+        return false;
+    }
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.pNext = &presentWaitFeatures;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &presentIdFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+}
+
+void FramePacer::Create(VkDevice device, PresentTimingSource source, VkSwapchainKHR swapChain, double targetIntervalMs){
+    m_device = device;
+    m_source = source;
+    m_targetIntervalMs = targetIntervalMs;
+    m_stats = {};
+    m_intervalM2 = 0.0;
+
+    if(m_source == PresentTimingSource::PresentWait){
+        m_waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR"));
+        if(m_waitForPresent == nullptr) throw std::runtime_error("Failed to load vkWaitForPresentKHR!");
+    }else if(m_source == PresentTimingSource::DisplayTiming){
+        m_getRefreshCycleDuration = reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>(
+            vkGetDeviceProcAddr(m_device, "vkGetRefreshCycleDurationGOOGLE"));
+        m_getPastPresentationTiming = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(
+            vkGetDeviceProcAddr(m_device, "vkGetPastPresentationTimingGOOGLE"));
+        if(m_getRefreshCycleDuration == nullptr || m_getPastPresentationTiming == nullptr){
+            throw std::runtime_error("Failed to load the display timing functions!");
+        }
+    }
+
+    m_presentIntervalMs = m_targetIntervalMs > 0.0 ? m_targetIntervalMs : 1000.0 / 60.0;
+    m_marginMs = std::max(MIN_MARGIN_MS, m_presentIntervalMs * 0.25);
+    m_frameStart = Clock::now();
+    m_scheduledPresent = m_frameStart;
+    SetSwapChain(swapChain);
+}
+
+void FramePacer::SetSwapChain(VkSwapchainKHR swapChain){
+    m_swapChain = swapChain;
+    // Presents to the old swap chain are not waited on or reported anymore
+    m_lastWaitedPresentId = m_presentId;
+    m_hasLastPresent = false;
+
+    if(m_source == PresentTimingSource::DisplayTiming){
+        VkRefreshCycleDurationGOOGLE refreshCycle = {};
+        if(m_getRefreshCycleDuration(m_device, m_swapChain, &refreshCycle) == VK_SUCCESS && refreshCycle.refreshDuration > 0){
+            m_presentIntervalMs = static_cast<double>(refreshCycle.refreshDuration) / 1e6;
+        }
+    }
+}
+
+FramePacingStats FramePacer::GetStats() const{
+    FramePacingStats stats = m_stats;
+    stats.jitterMs = stats.intervals > 1 ? std::sqrt(m_intervalM2 / static_cast<double>(stats.intervals - 1)) : 0.0;
+    return stats;
+}
+
+double FramePacer::GetIntervalMs() const{
+    return m_targetIntervalMs > 0.0 ? m_targetIntervalMs : m_presentIntervalMs;
+}
+
+void FramePacer::WaitForFrameStart(){
+    if(m_source == PresentTimingSource::PresentWait){
+        WaitForLastPresent();
+    }else if(m_source == PresentTimingSource::DisplayTiming){
+        CollectPastPresents();
+    }
+
+    Clock::time_point now = Clock::now();
+    m_scheduledPresent = PredictNextPresent(now);
+    Clock::time_point start = m_scheduledPresent - Milliseconds(m_cpuWorkMs + m_marginMs);
+    if(start > now + SPIN_TIME) std::this_thread::sleep_until(start - SPIN_TIME);
+    while(Clock::now() < start) std::this_thread::yield();
+    m_frameStart = Clock::now();
+    m_waitedMs = 0.0;
+}
+
+void FramePacer::WaitForLastPresent(){
+    if(m_presentId == m_lastWaitedPresentId) return;
+    m_lastWaitedPresentId = m_presentId;
+
+    // Long enough for a present a few refreshes late, short enough not to stall on a window system that never reports
+    uint64_t timeout = static_cast<uint64_t>(std::max(4.0 * GetIntervalMs(), 50.0) * 1e6);
+    VkResult result = m_waitForPresent(m_device, m_swapChain, m_presentId, timeout);
+    if(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR){
+        m_presentWaitTimeouts = 0;
+        AddPresent(m_scheduledPresent, Clock::now());
+    }else if(result == VK_TIMEOUT && ++m_presentWaitTimeouts >= MAX_PRESENT_WAIT_TIMEOUTS){
+        m_source = PresentTimingSource::CpuTimer;
+    }
+    // Out of date or lost surfaces are left to the present, which recreates the swap chain
+}
+
+void FramePacer::CollectPastPresents(){
+    uint32_t count = 0;
+    if(m_getPastPresentationTiming(m_device, m_swapChain, &count, nullptr) != VK_SUCCESS || count == 0) return;
+    m_pastTimings.resize(count);
+    VkResult result = m_getPastPresentationTiming(m_device, m_swapChain, &count, m_pastTimings.data());
+    if(result != VK_SUCCESS && result != VK_INCOMPLETE) return;
+
+    for(uint32_t i = 0; i < count; i++){
+        const VkPastPresentationTimingGOOGLE& timing = m_pastTimings[i];
+        Clock::time_point presented(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(timing.actualPresentTime)));
+        // Scheduling on another clock would hold every present back indefinitely or not at all
+        if(std::abs(MillisecondsBetween(presented, Clock::now())) > MAX_CLOCK_DISTANCE_MS){
+            m_source = PresentTimingSource::CpuTimer;
+            return;
+        }
+        Clock::time_point scheduled = presented;
+        if(timing.desiredPresentTime != 0){
+            scheduled = Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(timing.desiredPresentTime)));
+        }
+        AddPresent(scheduled, presented);
+    }
+}
+
+void FramePacer::AddPresent(Clock::time_point scheduled, Clock::time_point presented){
+    if(m_hasLastPresent){
+        double intervalMs = MillisecondsBetween(m_lastPresent, presented);
+        m_stats.intervals++;
+        double delta = intervalMs - m_stats.meanIntervalMs;
+        m_stats.meanIntervalMs += delta / static_cast<double>(m_stats.intervals);
+        m_intervalM2 += delta * (intervalMs - m_stats.meanIntervalMs);
+        m_stats.maxIntervalMs = std::max(m_stats.maxIntervalMs, intervalMs);
+        m_presentIntervalMs += (intervalMs - m_presentIntervalMs) * INTERVAL_SMOOTHING;
+    }
+    m_hasLastPresent = true;
+    m_lastPresent = presented;
+
+    double intervalMs = GetIntervalMs();
+    if(MillisecondsBetween(scheduled, presented) >= intervalMs * 0.5){
+        m_stats.missed++;
+        m_marginMs = std::min(m_marginMs + intervalMs * 0.25, intervalMs);
+    }else{
+        m_marginMs -= (m_marginMs - MIN_MARGIN_MS) * MARGIN_DECAY;
+    }
+}
+
+FramePacer::Clock::time_point FramePacer::PredictNextPresent(Clock::time_point now) const{
+    Clock::duration interval = Milliseconds(GetIntervalMs());
+    Clock::time_point earliestStart = now + Milliseconds(m_cpuWorkMs + m_marginMs);
+    Clock::time_point next = (m_hasLastPresent ? m_lastPresent : now) + interval;
+    // Frames presented but not measured yet hold the refreshes up to the one the last frame was scheduled for
+    while(next < earliestStart || next < m_scheduledPresent + interval / 2) next += interval;
+    return next;
+}
+
+void FramePacer::PreparePresent(VkPresentInfoKHR& presentInfo){
+    m_presentId++;
+    if(m_source == PresentTimingSource::PresentWait){
+        m_presentIdInfo = {};
+        m_presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        m_presentIdInfo.pNext = presentInfo.pNext;
+        m_presentIdInfo.swapchainCount = 1;
+        m_presentIdInfo.pPresentIds = &m_presentId;
+        presentInfo.pNext = &m_presentIdInfo;
+    }else if(m_source == PresentTimingSource::DisplayTiming){
+        // Not shown before the refresh it was scheduled for, so an early frame does not cut the last one short
+        m_presentTime.presentID = static_cast<uint32_t>(m_presentId);
+        m_presentTime.desiredPresentTime = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(m_scheduledPresent.time_since_epoch()).count());
+        m_presentTimesInfo = {};
+        m_presentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+        m_presentTimesInfo.pNext = presentInfo.pNext;
+        m_presentTimesInfo.swapchainCount = 1;
+        m_presentTimesInfo.pTimes = &m_presentTime;
+        presentInfo.pNext = &m_presentTimesInfo;
+    }
+}
+
+void FramePacer::BeginBlockingWait(){
+    m_waitStart = Clock::now();
+}
+
+void FramePacer::EndBlockingWait(){
+    m_waitedMs += MillisecondsBetween(m_waitStart, Clock::now());
+}
+
+void FramePacer::FrameSubmitted(){
+    // Waiting on the GPU or the display is left to the margin, which grows with the presents missed
+    double cpuWorkMs = std::max(0.0, MillisecondsBetween(m_frameStart, Clock::now()) - m_waitedMs);
+    // Rises at once so a slow frame is not followed by a late start, falls slowly
+    if(cpuWorkMs > m_cpuWorkMs){
+        m_cpuWorkMs = cpuWorkMs;
+    }else{
+        m_cpuWorkMs += (cpuWorkMs - m_cpuWorkMs) * CPU_WORK_SMOOTHING;
+    }
+}
+
+void FramePacer::FramePresented(){
+    if(m_source == PresentTimingSource::CpuTimer) AddPresent(m_scheduledPresent, Clock::now());
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <chrono>
+#include <vector>
+
+// How frames are paced
+enum class FramePacingMode{
+    Off,// Every frame starts as soon as the fences allow
+    Auto,// The best present timing the device and window system offer, the CPU timer without any
+    Cpu// The CPU timer even where present times could be measured
+};
+
+// Where the pacer learns when frames reached the display
+enum class PresentTimingSource{
+    PresentWait,// VK_KHR_present_id and VK_KHR_present_wait, blocking until a present was displayed
+    DisplayTiming,// VK_GOOGLE_display_timing, the actual present times reported some frames later
+    CpuTimer// The time vkQueuePresentKHR returned, or the frame was submitted when headless
+};
+
+const char* GetPresentTimingSourceName(PresentTimingSource source);
+
+// Present-to-present intervals measured so far
+struct FramePacingStats{
+    uint64_t intervals = 0;
+    double meanIntervalMs = 0.0;
+    // Standard deviation of the intervals
+    double jitterMs = 0.0;
+    double maxIntervalMs = 0.0;
+    // Presents that reached the display at least half an interval after the one they were scheduled for
+    uint64_t missed = 0;
+};
+
+// Starts every frame just in time for the present it is scheduled for, instead of as early as the fences allow.
+// Each frame is scheduled for the display refresh after the last present seen, or for the target interval after it,
+// and starts as long before it as the CPU took to submit the recent frames, plus a safety margin. A frame that
+// misses its present grows the margin by a quarter interval, frames on time shrink it slowly again, so the GPU time
+// of a frame is learnt without measuring it
+//
+// With present wait the last present is waited on before the next frame starts. Display timing reports its times
+// on the monotonic clock steady_clock reads on the platforms that ship it, a few frames late, and receives the
+// scheduled time with each present. The CPU timer takes the present calls for the presents, which is all there is
+// without a window. Present wait falls back to it when the window system stops reporting presents
+class FramePacer
+{
+public:
+    // Consecutive presents allowed to time out before present wait is given up on
+    static constexpr uint32_t MAX_PRESENT_WAIT_TIMEOUTS = 3;
+
+public:
+    // The best source for @mode that @physicalDevice supports, the CPU timer when @headless
+    static PresentTimingSource SelectSource(VkPhysicalDevice physicalDevice, FramePacingMode mode, bool headless);
+    // Whether the device supports both the present ID and the present wait extension and features
+    static bool IsPresentWaitSupported(VkPhysicalDevice physicalDevice);
+
+    // Pace the frames presented to @swapChain from @source, null when headless. @targetIntervalMs of zero follows
+    // the display refresh, 60 Hz where it is not known
+    void Create(VkDevice device, PresentTimingSource source, VkSwapchainKHR swapChain, double targetIntervalMs);
+    // Present IDs and timings do not carry over to a recreated swap chain
+    void SetSwapChain(VkSwapchainKHR swapChain);
+
+    PresentTimingSource GetSource() const { return m_source; }
+    FramePacingStats GetStats() const;
+
+    // Before anything of the next frame is done: measure the last present and sleep until the frame should start
+    void WaitForFrameStart();
+    // Around the fence waits and image acquire of the frame, which do not count as its CPU work
+    void BeginBlockingWait();
+    void EndBlockingWait();
+    // Once the frame was submitted, ends its CPU work
+    void FrameSubmitted();
+    // Chain the present ID or present time of the frame into @presentInfo, which must be presented right after
+    void PreparePresent(VkPresentInfoKHR& presentInfo);
+    // Once the frame was presented, or submitted when headless
+    void FramePresented();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void WaitForLastPresent();
+    void CollectPastPresents();
+    // A present of the frame scheduled at @scheduled reached the display at @presented
+    void AddPresent(Clock::time_point scheduled, Clock::time_point presented);
+    // The first display refresh or target interval after the last present that a frame starting now can make
+    Clock::time_point PredictNextPresent(Clock::time_point now) const;
+    double GetIntervalMs() const;
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
+    PresentTimingSource m_source = PresentTimingSource::CpuTimer;
+    double m_targetIntervalMs = 0.0;
+    PFN_vkWaitForPresentKHR m_waitForPresent = nullptr;
+    PFN_vkGetRefreshCycleDurationGOOGLE m_getRefreshCycleDuration = nullptr;
+    PFN_vkGetPastPresentationTimingGOOGLE m_getPastPresentationTiming = nullptr;
+
+    // Smoothed interval between the presents measured, seeded with the display refresh where it is reported
+    double m_presentIntervalMs = 1000.0 / 60.0;
+    // CPU time from the start of a frame to its submit without the blocking waits, and the margin on top learnt
+    // from missed presents
+    double m_cpuWorkMs = 0.0;
+    double m_marginMs = 0.0;
+    uint32_t m_presentWaitTimeouts = 0;
+
+    // IDs increase across swap chains, 0 is never presented
+    uint64_t m_presentId = 0;
+    uint64_t m_lastWaitedPresentId = 0;
+    VkPresentIdKHR m_presentIdInfo = {};
+    VkPresentTimeGOOGLE m_presentTime = {};
+    VkPresentTimesInfoGOOGLE m_presentTimesInfo = {};
+
+    Clock::time_point m_frameStart;
+    Clock::time_point m_waitStart;
+    // Blocked in the waits of the frame so far
+    double m_waitedMs = 0.0;
+    Clock::time_point m_scheduledPresent;
+    bool m_hasLastPresent = false;
+    Clock::time_point m_lastPresent;
+    std::vector<VkPastPresentationTimingGOOGLE> m_pastTimings;
+
+    // Welford's running mean and variance of the present intervals
+    FramePacingStats m_stats;
+    double m_intervalM2 = 0.0;
+};
@@ -0,0 +1,310 @@
+#include "FrameReadback.h"
+#include "HostAllocator.h"
+#include "PngWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+std::string MakeFrameFilename(const std::string& directory, uint64_t frameNumber, const char* extension){
+    char name[64];
+    std::snprintf(name, sizeof(name), "frame_%06llu.%s", static_cast<unsigned long long>(frameNumber), extension);
+    return directory.empty() ? std::string(name) : directory + "/" + name;
+}
+
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// Sinks ////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+void RawFileSink::Consume(const ReadbackFrame& frame, std::function<void()> release){
+    std::string filename = MakeFrameFilename(m_directory, frame.frameNumber, "raw");
+    std::ofstream file(filename, std::ios::binary);
+    if(file.is_open()){
+        for(uint32_t y = 0; y < frame.height; y++){
+            file.write(reinterpret_cast<const char*>(frame.pixels + y * frame.rowPitch), static_cast<std::streamsize>(frame.width) * 4);
+        }
+    }else{
+        std::cerr << "Failed to open file: " << filename << std::endl;
+    }
+    release();
+}
+
+void PngFileSink::Consume(const ReadbackFrame& frame, std::function<void()> release){
+    std::string filename = MakeFrameFilename(m_directory, frame.frameNumber, "png");
+    m_pool.Submit([frame, filename, release](){
+        try{
+            WritePng(filename, frame.width, frame.height, frame.pixels, frame.rowPitch, frame.isBgra);
+        }catch(const std::exception& e){
+            std::cerr << e.what() << std::endl;
+        }
+        release();
+    });
+}
+
+void CallbackSink::Consume(const ReadbackFrame& frame, std::function<void()> release){
+    m_callback(frame);
+    release();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// FrameReadback ////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
+FrameReadback::~FrameReadback(){
+    if(m_worker.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+        m_worker.join();
+    }
+}
+
+void FrameReadback::Create(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format,
+    uint32_t ringSize, std::unique_ptr<ReadbackSink> sink)
+{
+    m_physicalDevice = physicalDevice;
+    m_device = device;
+    m_extent = extent;
+    m_format = format;
+    m_sink = std::move(sink);
+    m_slots.resize(ringSize);
+
+    CreateBuffers();
+
+    m_stopping = false;
+    m_worker = std::thread([this](){ WorkerLoop(); });
+}
+
+void FrameReadback::Destroy(){
+    if(!IsEnabled()) return;
+
+    Flush();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    m_worker.join();
+
+    DestroyBuffers();
+    m_slots.clear();
+    m_sink.reset();
+}
+
+void FrameReadback::Resize(VkExtent2D extent, VkFormat format){
+    if(!IsEnabled()) return;
+
+    Flush();
+    DestroyBuffers();
+
+    m_extent = extent;
+    m_format = format;
+    CreateBuffers();
+}
+
+void FrameReadback::CreateBuffers(){
+    switch(m_format){
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        break;
+    default:
+        throw std::runtime_error("Frame readback only supports 8-bit RGBA and BGRA formats!");
+    }
+
+    VkDeviceSize bufferSize = static_cast<VkDeviceSize>(m_extent.width) * m_extent.height * 4;
+
+    for(auto& slot: m_slots){
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = bufferSize;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        ThrowIfFailed(vkCreateBuffer(m_device, &bufferInfo, GetAllocationCallbacks(), &slot.buffer),
+            "Failed to create readback buffer!");
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(m_device, slot.buffer, &memRequirements);
+
+        // Cached memory makes the CPU reads fast, at the price of an explicit invalidate when it is not coherent
+        uint32_t memoryType;
+        try{
+            memoryType = FindMemoryType(m_physicalDevice, memRequirements.memoryTypeBits,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        }catch(const std::runtime_error&){
+            memoryType = FindMemoryType(m_physicalDevice, memRequirements.memoryTypeBits,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        }
+
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+        m_isCoherent = (memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        ThrowIfFailed(AllocateMemory(m_device, allocInfo, slot.memory),
+            "Failed to allocate readback buffer memory!");
+
+        vkBindBufferMemory(m_device, slot.buffer, slot.memory, 0);
+
+        void* data;
+        ThrowIfFailed(vkMapMemory(m_device, slot.memory, 0, VK_WHOLE_SIZE, 0, &data),
+            "Failed to map readback buffer memory!");
+        slot.mapped = static_cast<uint8_t*>(data);
+        slot.state = SlotState::Free;
+    }
+}
+
+void FrameReadback::DestroyBuffers(){
+    for(auto& slot: m_slots){
+        vkUnmapMemory(m_device, slot.memory);
+        vkDestroyBuffer(m_device, slot.buffer, GetAllocationCallbacks());
+        FreeMemory(m_device, slot.memory);
+        slot = Slot();
+    }
+}
+
+uint32_t FrameReadback::AcquireSlot(uint64_t frameNumber){
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while(true){
+        for(uint32_t i = 0; i < m_slots.size(); i++){
+            if(m_slots[i].state == SlotState::Free){
+                m_slots[i].state = SlotState::Recording;
+                m_slots[i].frameNumber = frameNumber;
+                return i;
+            }
+        }
+
+        // The sink can not keep up, wait for it instead of dropping frames
+        m_stallCount++;
+        m_slotReleased.wait(lock);
+    }
+}
+
+void FrameReadback::RecordCopy(VkCommandBuffer commandBuffer, VkImage image, uint32_t slot){
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;// Tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {m_extent.width, m_extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_slots[slot].buffer, 1, &region);
+
+    // Make the copy available to host reads once the frame fence signals
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_slots[slot].buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void FrameReadback::Submitted(uint32_t slot, uint32_t fenceIndex){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots[slot].state = SlotState::Submitted;
+    m_slots[slot].fenceIndex = fenceIndex;
+}
+
+void FrameReadback::Retire(uint32_t fenceIndex){
+    if(!IsEnabled()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        size_t firstNew = m_deliveryQueue.size();
+        for(uint32_t i = 0; i < m_slots.size(); i++){
+            if(m_slots[i].state == SlotState::Submitted && m_slots[i].fenceIndex == fenceIndex){
+                m_slots[i].state = SlotState::Delivering;
+                m_deliveryQueue.push_back(i);
+            }
+        }
+        if(firstNew == m_deliveryQueue.size()) return;
+
+        // Deliver in frame order
+        std::sort(m_deliveryQueue.begin() + firstNew, m_deliveryQueue.end(), [this](uint32_t a, uint32_t b){
+            return m_slots[a].frameNumber < m_slots[b].frameNumber;
+        });
+    }
+    m_workAvailable.notify_one();
+}
+
+void FrameReadback::Flush(){
+    if(!IsEnabled()) return;
+
+    std::vector<uint32_t> fenceIndices;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(const auto& slot: m_slots){
+            if(slot.state == SlotState::Submitted) fenceIndices.push_back(slot.fenceIndex);
+        }
+    }
+    for(uint32_t fenceIndex: fenceIndices) Retire(fenceIndex);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_slotReleased.wait(lock, [this](){
+        return std::all_of(m_slots.begin(), m_slots.end(), [](const Slot& slot){
+            return slot.state == SlotState::Free || slot.state == SlotState::Recording;
+        });
+    });
+}
+
+void FrameReadback::WorkerLoop(){
+    while(true){
+        uint32_t slotIndex;
+        ReadbackFrame frame = {};
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this](){ return m_stopping || !m_deliveryQueue.empty(); });
+            if(m_deliveryQueue.empty()) return;
+
+            slotIndex = m_deliveryQueue.front();
+            m_deliveryQueue.pop_front();
+
+            const Slot& slot = m_slots[slotIndex];
+            frame.frameNumber = slot.frameNumber;
+            frame.width = m_extent.width;
+            frame.height = m_extent.height;
+            frame.rowPitch = static_cast<size_t>(m_extent.width) * 4;
+            frame.isBgra = m_format == VK_FORMAT_B8G8R8A8_UNORM || m_format == VK_FORMAT_B8G8R8A8_SRGB;
+            frame.pixels = slot.mapped;
+        }
+
+        if(!m_isCoherent){
+            VkMappedMemoryRange range = {};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = m_slots[slotIndex].memory;
+            range.offset = 0;
+            range.size = VK_WHOLE_SIZE;
+            vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+        }
+
+        m_sink->Consume(frame, [this, slotIndex](){
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_slots[slotIndex].state = SlotState::Free;
+            }
+            m_slotReleased.notify_all();
+        });
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include "VulkanCommon.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class ReadbackFormat{
+    None,
+    Raw,// Headerless pixel dumps, one file per frame
+    Png
+};
+
+// A finished frame in host memory. The pixels stay valid until the sink releases the frame
+struct ReadbackFrame{
+    uint64_t frameNumber;
+    uint32_t width;
+    uint32_t height;
+    size_t rowPitch;
+    bool isBgra;// Channel order of the 8-bit pixels, RGBA otherwise
+    const uint8_t* pixels;
+};
+
+// Receives frames on the readback worker thread. @release must be called, from any thread, once the pixels
+// are no longer needed; until then the readback buffer can not take a new frame
+class ReadbackSink
+{
+public:
+    virtual ~ReadbackSink() = default;
+    virtual void Consume(const ReadbackFrame& frame, std::function<void()> release) = 0;
+};
+
+// Writes frame_<number>.raw files into a directory
+class RawFileSink : public ReadbackSink
+{
+public:
+    explicit RawFileSink(const std::string& directory) : m_directory(directory) {}
+    void Consume(const ReadbackFrame& frame, std::function<void()> release) override;
+
+private:
+    std::string m_directory;
+};
+
+// Encodes frame_<number>.png files into a directory on a thread pool
+class PngFileSink : public ReadbackSink
+{
+public:
+    explicit PngFileSink(const std::string& directory, uint32_t threadCount = 0) : m_directory(directory), m_pool(threadCount) {}
+    void Consume(const ReadbackFrame& frame, std::function<void()> release) override;
+
+private:
+    std::string m_directory;
+    ThreadPool m_pool;
+};
+
+// Hands every frame to a user function on the readback worker thread
+class CallbackSink : public ReadbackSink
+{
+public:
+    explicit CallbackSink(std::function<void(const ReadbackFrame&)> callback) : m_callback(std::move(callback)) {}
+    void Consume(const ReadbackFrame& frame, std::function<void()> release) override;
+
+private:
+    std::function<void(const ReadbackFrame&)> m_callback;
+};
+
+// Copies finished frames into a ring of persistently mapped, host-visible (preferably host-cached) buffers.
+// Once the frame fence of a copy has been waited on by DrawFrame anyway, the buffer is handed to a worker
+// thread that feeds the sink, so the render thread never waits on the sink unless the whole ring is in use.
+class FrameReadback
+{
+public:
+    ~FrameReadback();
+
+    void Create(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, VkFormat format,
+        uint32_t ringSize, std::unique_ptr<ReadbackSink> sink);
+    // Wait for every pending frame to reach the sink, then free everything
+    void Destroy();
+    // Reallocate the buffers for a new frame size, after delivering the frames still pending
+    void Resize(VkExtent2D extent, VkFormat format);
+
+    bool IsEnabled() const { return m_sink != nullptr; }
+
+    // Reserve a buffer for frame @frameNumber. Only blocks when every buffer is still owned by the sink
+    uint32_t AcquireSlot(uint64_t frameNumber);
+    // Record the copy of @image (in TRANSFER_SRC_OPTIMAL) into buffer @slot
+    void RecordCopy(VkCommandBuffer commandBuffer, VkImage image, uint32_t slot);
+    // The copy into @slot was submitted as part of the frame guarded by in-flight fence @fenceIndex
+    void Submitted(uint32_t slot, uint32_t fenceIndex);
+    // The host has waited on in-flight fence @fenceIndex, so its copies are complete and can be delivered
+    void Retire(uint32_t fenceIndex);
+    // Retire every submitted copy and wait until the sink released all of them. The device must be idle
+    void Flush();
+
+    // Number of times AcquireSlot had to wait for the sink
+    uint64_t GetStallCount() const { return m_stallCount; }
+
+private:
+    enum class SlotState{ Free, Recording, Submitted, Delivering };
+
+    struct Slot{
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        uint8_t* mapped = nullptr;
+        SlotState state = SlotState::Free;
+        uint64_t frameNumber = 0;
+        uint32_t fenceIndex = 0;
+    };
+
+    void CreateBuffers();
+    void DestroyBuffers();
+    void WorkerLoop();
+
+private:
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    VkExtent2D m_extent = {0, 0};
+    VkFormat m_format = VK_FORMAT_UNDEFINED;
+    bool m_isCoherent = false;
+    uint64_t m_stallCount = 0;
+
+    std::vector<Slot> m_slots;
+    std::unique_ptr<ReadbackSink> m_sink;
+
+    std::mutex m_mutex;
+    std::condition_variable m_slotReleased;
+    std::condition_variable m_workAvailable;
+    std::deque<uint32_t> m_deliveryQueue;
+    bool m_stopping = false;
+    std::thread m_worker;
+};
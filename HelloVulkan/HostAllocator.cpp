@@ -0,0 +1,247 @@
+#include "HostAllocator.h"
+
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// In front of every allocation, @offset bytes past the start of its slot or malloc block
+struct AllocationHeader{
+    uint64_t size;
+    uint32_t offset;
+    uint8_t sizeClass;
+    uint8_t scope;
+    uint16_t reserved;
+};
+static_assert(sizeof(AllocationHeader) == 16, "Allocations stay 16 byte aligned behind the header");
+
+// Marks blocks that came from malloc
+constexpr uint8_t LARGE_SIZE_CLASS = 0xff;
+
+AllocationHeader* GetHeader(void* memory){
+    return reinterpret_cast<AllocationHeader*>(static_cast<uint8_t*>(memory) - sizeof(AllocationHeader));
+}
+
+// Bytes from the start of a block to the allocation, enough for the header and @alignment. Blocks are 16 byte aligned
+size_t GetOffset(size_t alignment){
+    return std::max(alignment, sizeof(AllocationHeader));
+}
+
+size_t GetSlotSize(uint32_t sizeClass){
+    return HostAllocator::MIN_POOLED_SIZE << sizeClass;
+}
+
+// The smallest size class holding @size bytes, SIZE_CLASS_COUNT when none does
+uint32_t FindSizeClass(size_t size){
+    uint32_t sizeClass = 0;
+    while(sizeClass < HostAllocator::SIZE_CLASS_COUNT && GetSlotSize(sizeClass) < size) sizeClass++;
+    return sizeClass;
+}
+
+void UpdatePeak(std::atomic<size_t>& peak, size_t value){
+    size_t current = peak.load(std::memory_order_relaxed);
+    while(value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)){}
+}
+
+uint32_t GetScopeIndex(VkSystemAllocationScope scope){
+    return std::min(static_cast<uint32_t>(scope), HOST_ALLOCATION_SCOPE_COUNT - 1);
+}
+
+}
+
+const char* GetAllocationScopeName(VkSystemAllocationScope scope){
+    switch(scope){
+    case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "command";
+    case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "object";
+    case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "cache";
+    case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "device";
+    case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "instance";
+    default: return "unknown";
+    }
+}
+
+uint64_t HostAllocatorStats::GetAllocations() const{
+    uint64_t allocations = 0;
+    for(const HostAllocationScopeStats& scope: scopes) allocations += scope.allocations;
+    return allocations;
+}
+
+HostAllocator& GetHostAllocator(){
+    // Constructed before the first Vulkan call and destroyed after main returns
+    static HostAllocator allocator;
+    return allocator;
+}
+
+HostAllocator::HostAllocator(){
+    m_callbacks.pUserData = this;
+    m_callbacks.pfnAllocation = Allocation;
+    m_callbacks.pfnReallocation = Reallocation;
+    m_callbacks.pfnFree = Free;
+    m_callbacks.pfnInternalAllocation = InternalAllocation;
+    m_callbacks.pfnInternalFree = InternalFree;
+}
+
+HostAllocator::~HostAllocator(){
+    for(SizeClass& sizeClass: m_sizeClasses){
+        for(void* chunk: sizeClass.chunks) std::free(chunk);
+    }
+}
+
+HostAllocatorStats HostAllocator::GetStats() const{
+    HostAllocatorStats stats = {};
+    for(uint32_t i = 0; i < HOST_ALLOCATION_SCOPE_COUNT; i++){
+        const ScopeCounters& counters = m_scopes[i];
+        HostAllocationScopeStats& scope = stats.scopes[i];
+        scope.allocations = counters.allocations.load(std::memory_order_relaxed);
+        scope.frees = counters.frees.load(std::memory_order_relaxed);
+        scope.currentBytes = counters.currentBytes.load(std::memory_order_relaxed);
+        scope.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+        scope.internalAllocations = counters.internalAllocations.load(std::memory_order_relaxed);
+        scope.internalBytes = counters.internalBytes.load(std::memory_order_relaxed);
+    }
+    stats.currentBytes = m_currentBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = m_peakBytes.load(std::memory_order_relaxed);
+    stats.pooledAllocations = m_pooledAllocations.load(std::memory_order_relaxed);
+    stats.pooledBytes = m_pooledBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::Allocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope){
+    return static_cast<HostAllocator*>(userData)->Allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::Reallocation(void* userData, void* original, size_t size, size_t alignment,
+    VkSystemAllocationScope scope)
+{
+    HostAllocator* allocator = static_cast<HostAllocator*>(userData);
+    if(original == nullptr) return allocator->Allocate(size, alignment, scope);
+    if(size == 0){
+        allocator->Release(original);
+        return nullptr;
+    }
+
+    // Grown or shrunk in place while it still fits its slot, the alignment of a reallocation never changes
+    AllocationHeader* header = GetHeader(original);
+    if(header->sizeClass != LARGE_SIZE_CLASS && header->offset + size <= GetSlotSize(header->sizeClass)){
+        VkSystemAllocationScope originalScope = static_cast<VkSystemAllocationScope>(header->scope);
+        allocator->CountFree(originalScope, static_cast<size_t>(header->size));
+        allocator->CountAllocation(scope, size);
+        header->size = size;
+        header->scope = static_cast<uint8_t>(scope);
+        return original;
+    }
+
+    void* memory = allocator->Allocate(size, alignment, scope);
+    if(memory == nullptr) return nullptr;// The original stays valid
+    std::memcpy(memory, original, std::min(size, static_cast<size_t>(header->size)));
+    allocator->Release(original);
+    return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::Free(void* userData, void* memory){
+    if(memory != nullptr) static_cast<HostAllocator*>(userData)->Release(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::InternalAllocation(void* userData, size_t size, VkInternalAllocationType,
+    VkSystemAllocationScope scope)
+{
+    ScopeCounters& counters = static_cast<HostAllocator*>(userData)->m_scopes[GetScopeIndex(scope)];
+    counters.internalAllocations.fetch_add(1, std::memory_order_relaxed);
+    counters.internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::InternalFree(void* userData, size_t size, VkInternalAllocationType,
+    VkSystemAllocationScope scope)
+{
+    ScopeCounters& counters = static_cast<HostAllocator*>(userData)->m_scopes[GetScopeIndex(scope)];
+    counters.internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* HostAllocator::Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope){
+    if(size == 0) return nullptr;
+    size_t offset = GetOffset(alignment);
+    uint32_t sizeClass = FindSizeClass(offset + size);
+
+    uint8_t* block = nullptr;
+    if(sizeClass < SIZE_CLASS_COUNT){
+        block = static_cast<uint8_t*>(AllocateSlot(sizeClass));
+    }else{
+        // malloc aligns to 16 bytes like the slots
+        block = static_cast<uint8_t*>(std::malloc(offset + size));
+    }
+    if(block == nullptr) return nullptr;
+    if(sizeClass < SIZE_CLASS_COUNT) m_pooledAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    // The allocation is aligned for @alignment, the header right in front of it
+    uint8_t* memory = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader) + alignment - 1) &
+        ~static_cast<uintptr_t>(alignment - 1));
+    AllocationHeader* header = GetHeader(memory);
+    header->size = size;
+    header->offset = static_cast<uint32_t>(memory - block);
+    header->sizeClass = sizeClass < SIZE_CLASS_COUNT ? static_cast<uint8_t>(sizeClass) : LARGE_SIZE_CLASS;
+    header->scope = static_cast<uint8_t>(scope);
+    CountAllocation(scope, size);
+    return memory;
+}
+
+void HostAllocator::Release(void* memory){
+    AllocationHeader* header = GetHeader(memory);
+    CountFree(static_cast<VkSystemAllocationScope>(header->scope), static_cast<size_t>(header->size));
+    uint8_t* block = static_cast<uint8_t*>(memory) - header->offset;
+    if(header->sizeClass == LARGE_SIZE_CLASS){
+        std::free(block);
+    }else{
+        FreeSlot(header->sizeClass, block);
+    }
+}
+
+void* HostAllocator::AllocateSlot(uint32_t index){
+    SizeClass& sizeClass = m_sizeClasses[index];
+    size_t slotSize = GetSlotSize(index);
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    if(sizeClass.freeList != nullptr){
+        void* slot = sizeClass.freeList;
+        std::memcpy(&sizeClass.freeList, slot, sizeof(void*));
+        return slot;
+    }
+
+    if(sizeClass.remaining < slotSize){
+        void* chunk = std::malloc(CHUNK_SIZE);
+        if(chunk == nullptr) return nullptr;
+        sizeClass.chunks.push_back(chunk);
+        sizeClass.cursor = static_cast<uint8_t*>(chunk);
+        sizeClass.remaining = CHUNK_SIZE;
+        m_pooledBytes.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+    }
+    void* slot = sizeClass.cursor;
+    sizeClass.cursor += slotSize;
+    sizeClass.remaining -= slotSize;
+    return slot;
+}
+
+void HostAllocator::FreeSlot(uint32_t index, void* slot){
+    SizeClass& sizeClass = m_sizeClasses[index];
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    std::memcpy(slot, &sizeClass.freeList, sizeof(void*));
+    sizeClass.freeList = slot;
+}
+
+void HostAllocator::CountAllocation(VkSystemAllocationScope scope, size_t size){
+    ScopeCounters& counters = m_scopes[GetScopeIndex(scope)];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    UpdatePeak(counters.peakBytes, counters.currentBytes.fetch_add(size, std::memory_order_relaxed) + size);
+    UpdatePeak(m_peakBytes, m_currentBytes.fetch_add(size, std::memory_order_relaxed) + size);
+
+    Telemetry* telemetry = m_telemetry.load(std::memory_order_acquire);
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::HostAllocations);
+}
+
+void HostAllocator::CountFree(VkSystemAllocationScope scope, size_t size){
+    ScopeCounters& counters = m_scopes[GetScopeIndex(scope)];
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+    counters.currentBytes.fetch_sub(size, std::memory_order_relaxed);
+    m_currentBytes.fetch_sub(size, std::memory_order_relaxed);
+}
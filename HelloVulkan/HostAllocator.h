@@ -0,0 +1,118 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class Telemetry;
+
+constexpr uint32_t HOST_ALLOCATION_SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+const char* GetAllocationScopeName(VkSystemAllocationScope scope);
+
+// Host memory the driver allocated with one VkSystemAllocationScope
+struct HostAllocationScopeStats{
+    uint64_t allocations;// Reallocations count as one each
+    uint64_t frees;
+    size_t currentBytes;
+    size_t peakBytes;
+    // Allocated by the driver itself and only reported, such as executable memory
+    uint64_t internalAllocations;
+    size_t internalBytes;
+};
+
+struct HostAllocatorStats{
+    HostAllocationScopeStats scopes[HOST_ALLOCATION_SCOPE_COUNT];
+    // Over every scope, requested sizes without headers and padding
+    size_t currentBytes;
+    size_t peakBytes;
+    // Served from the size classes, the rest went to malloc
+    uint64_t pooledAllocations;
+    // Held by the size classes for their slots, used or not
+    size_t pooledBytes;
+
+    uint64_t GetAllocations() const;
+};
+
+// The VkAllocationCallbacks every Vulkan object of the application is created and destroyed with. Requests of up to
+// MAX_POOLED_SIZE bytes with their header are served from power of two size classes. Each carves its slots from
+// chunks of CHUNK_SIZE and keeps the freed ones on a list behind its own mutex, so threads allocating different
+// sizes do not wait on each other and none of them waits on malloc. Larger requests go to malloc
+//
+// A header in front of every allocation records its size, size class and scope, which frees are not told
+class HostAllocator
+{
+public:
+    static constexpr size_t MIN_POOLED_SIZE = 32;
+    static constexpr size_t MAX_POOLED_SIZE = 4096;
+    static constexpr uint32_t SIZE_CLASS_COUNT = 8;// MIN_POOLED_SIZE doubled up to MAX_POOLED_SIZE
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+public:
+    HostAllocator();
+    ~HostAllocator();
+    HostAllocator(const HostAllocator&) = delete;
+    HostAllocator& operator=(const HostAllocator&) = delete;
+
+    const VkAllocationCallbacks* GetCallbacks() const { return &m_callbacks; }
+    // Count every allocation the driver makes towards TelemetryCounter::HostAllocations of @telemetry, nowhere when null
+    void SetTelemetry(Telemetry* telemetry) { m_telemetry.store(telemetry, std::memory_order_release); }
+    // The counters are read one by one, like those of Telemetry
+    HostAllocatorStats GetStats() const;
+
+private:
+    struct SizeClass{
+        std::mutex mutex;
+        // Freed slots, each holding the next one in its first bytes
+        void* freeList = nullptr;
+        // The part of the newest chunk no slot was carved from yet
+        uint8_t* cursor = nullptr;
+        size_t remaining = 0;
+        std::vector<void*> chunks;
+    };
+
+    struct ScopeCounters{
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> frees{0};
+        std::atomic<size_t> currentBytes{0};
+        std::atomic<size_t> peakBytes{0};
+        std::atomic<uint64_t> internalAllocations{0};
+        std::atomic<size_t> internalBytes{0};
+    };
+
+    static VKAPI_ATTR void* VKAPI_CALL Allocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL Reallocation(void* userData, void* original, size_t size, size_t alignment,
+        VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL Free(void* userData, void* memory);
+    static VKAPI_ATTR void VKAPI_CALL InternalAllocation(void* userData, size_t size, VkInternalAllocationType type,
+        VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL InternalFree(void* userData, size_t size, VkInternalAllocationType type,
+        VkSystemAllocationScope scope);
+
+    void* Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void Release(void* memory);
+    // A slot of size class @index, nullptr when the system is out of memory
+    void* AllocateSlot(uint32_t index);
+    void FreeSlot(uint32_t index, void* slot);
+    void CountAllocation(VkSystemAllocationScope scope, size_t size);
+    void CountFree(VkSystemAllocationScope scope, size_t size);
+
+private:
+    VkAllocationCallbacks m_callbacks = {};
+    SizeClass m_sizeClasses[SIZE_CLASS_COUNT];
+    ScopeCounters m_scopes[HOST_ALLOCATION_SCOPE_COUNT];
+    std::atomic<size_t> m_currentBytes{0};
+    std::atomic<size_t> m_peakBytes{0};
+    std::atomic<uint64_t> m_pooledAllocations{0};
+    std::atomic<size_t> m_pooledBytes{0};
+    std::atomic<Telemetry*> m_telemetry{nullptr};
+};
+
+// The allocator of the process, alive until it exits so objects of any lifetime can be destroyed with it
+HostAllocator& GetHostAllocator();
+// What every vkCreate*, vkDestroy*, vkAllocateMemory and vkFreeMemory call passes as pAllocator
+inline const VkAllocationCallbacks* GetAllocationCallbacks() { return GetHostAllocator().GetCallbacks(); }
@@ -0,0 +1,155 @@
+#include "JobScheduler.h"
+
+#include <algorithm>
+#include <memory>
+
+JobScheduler::JobScheduler(uint32_t threadCount)
+    : m_queues(threadCount == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threadCount)
+{
+    // Queue 0 belongs to the thread calling Run
+    for(uint32_t i = 1; i < m_queues.size(); i++){
+        m_threads.emplace_back([this, i](){ WorkerLoop(i); });
+    }
+}
+
+JobScheduler::~JobScheduler(){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_graphAvailable.notify_all();
+
+    for(auto& thread: m_threads) thread.join();
+}
+
+JobScheduler::JobHandle JobScheduler::AddJob(std::function<void()> job, const std::vector<JobHandle>& dependencies){
+    JobHandle handle = static_cast<JobHandle>(m_jobs.size());
+    m_jobs.emplace_back();
+    Job& added = m_jobs.back();
+    added.function = std::move(job);
+    added.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    for(JobHandle dependency: dependencies) m_jobs[dependency].successors.push_back(handle);
+    return handle;
+}
+
+JobScheduler::JobHandle JobScheduler::AddParallelFor(uint32_t count, uint32_t granularity,
+    std::function<void(uint32_t begin, uint32_t end)> job, const std::vector<JobHandle>& dependencies)
+{
+    granularity = std::max(1u, granularity);
+    auto shared = std::make_shared<std::function<void(uint32_t, uint32_t)>>(std::move(job));
+
+    std::vector<JobHandle> ranges;
+    for(uint32_t begin = 0; begin < count; begin += granularity){
+        uint32_t end = std::min(count, begin + granularity);
+        ranges.push_back(AddJob([shared, begin, end](){ (*shared)(begin, end); }, dependencies));
+    }
+    if(ranges.empty()) return AddJob([](){}, dependencies);
+    if(ranges.size() == 1) return ranges[0];
+    return AddJob([](){}, ranges);
+}
+
+void JobScheduler::Run(){
+    if(m_jobs.empty()) return;
+
+    m_remainingJobs.store(static_cast<uint32_t>(m_jobs.size()), std::memory_order_relaxed);
+    // Jobs without dependencies are dealt out round robin so every thread starts with work of its own
+    uint32_t queue = 0;
+    for(auto& job: m_jobs){
+        job.pendingDependencies.store(job.dependencyCount, std::memory_order_relaxed);
+        if(job.dependencyCount == 0){
+            Push(queue, &job);
+            queue = (queue + 1) % GetThreadCount();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_graphGeneration++;
+    }
+    m_graphAvailable.notify_all();
+
+    RunJobs(0);
+
+    // Workers that are still looking for work must be out before the jobs are cleared
+    while(m_busyWorkers.load(std::memory_order_acquire) != 0) std::this_thread::yield();
+    m_jobs.clear();
+
+    std::exception_ptr exception;
+    std::swap(exception, m_exception);
+    if(exception) std::rethrow_exception(exception);
+}
+
+void JobScheduler::WorkerLoop(uint32_t index){
+    uint64_t generation = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_graphAvailable.wait(lock, [&](){ return m_stopping || m_graphGeneration != generation; });
+            if(m_stopping) return;
+            generation = m_graphGeneration;
+            m_busyWorkers.fetch_add(1, std::memory_order_acq_rel);
+        }
+        RunJobs(index);
+        m_busyWorkers.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void JobScheduler::RunJobs(uint32_t index){
+    uint32_t idleRounds = 0;
+    while(m_remainingJobs.load(std::memory_order_acquire) != 0){
+        Job* job = PopOrSteal(index);
+        if(job == nullptr){
+            // Whatever is left runs elsewhere or waits for a dependency, back off a little
+            if(++idleRounds > 64) std::this_thread::yield();
+            continue;
+        }
+        idleRounds = 0;
+        Execute(index, job);
+    }
+}
+
+JobScheduler::Job* JobScheduler::PopOrSteal(uint32_t index){
+    {
+        WorkQueue& own = m_queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.jobs.empty()){
+            Job* job = own.jobs.back();
+            own.jobs.pop_back();
+            return job;
+        }
+    }
+
+    // Steal the oldest job of another thread, it is the one least likely to be in that thread's cache
+    uint32_t count = GetThreadCount();
+    for(uint32_t offset = 1; offset < count; offset++){
+        WorkQueue& victim = m_queues[(index + offset) % count];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if(!lock.owns_lock() || victim.jobs.empty()) continue;
+        Job* job = victim.jobs.front();
+        victim.jobs.pop_front();
+        return job;
+    }
+    return nullptr;
+}
+
+void JobScheduler::Push(uint32_t index, Job* job){
+    WorkQueue& queue = m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(job);
+}
+
+void JobScheduler::Execute(uint32_t index, Job* job){
+    try{
+        job->function();
+    }catch(...){
+        std::lock_guard<std::mutex> lock(m_exceptionMutex);
+        if(!m_exception) m_exception = std::current_exception();
+    }
+
+    for(JobHandle successor: job->successors){
+        Job& next = m_jobs[successor];
+        if(next.pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) Push(index, &next);
+    }
+    // Last, so the graph is only considered finished once nothing touches it anymore
+    m_remainingJobs.fetch_sub(1, std::memory_order_acq_rel);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a graph of short jobs on all cores. Every thread owns a deque: it pushes the jobs its finished job
+// released onto the back and pops from there, so dependent work stays on a warm cache, and when its deque is empty
+// it steals from the front of the others. The thread calling Run works on the graph too.
+//
+// Unlike ThreadPool, which queues long background work, a graph is built and run to completion within a frame
+class JobScheduler
+{
+public:
+    using JobHandle = uint32_t;
+
+public:
+    // @threadCount includes the thread calling Run, zero picks one per hardware thread
+    explicit JobScheduler(uint32_t threadCount = 0);
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    // Add a job that starts once every job in @dependencies has finished. Dependencies must be added first
+    JobHandle AddJob(std::function<void()> job, const std::vector<JobHandle>& dependencies = {});
+    // Split [0, @count) into ranges of about @granularity items processed by @job in parallel. The returned handle
+    // finishes when all ranges have
+    JobHandle AddParallelFor(uint32_t count, uint32_t granularity, std::function<void(uint32_t begin, uint32_t end)> job,
+        const std::vector<JobHandle>& dependencies = {});
+
+    // Run the graph built since the last Run and clear it. Rethrows the first exception a job threw
+    void Run();
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_queues.size()); }
+    size_t GetJobCount() const { return m_jobs.size(); }
+
+private:
+    struct Job{
+        std::function<void()> function;
+        std::vector<JobHandle> successors;
+        uint32_t dependencyCount = 0;
+        std::atomic<uint32_t> pendingDependencies{0};
+    };
+
+    struct alignas(64) WorkQueue{
+        std::mutex mutex;
+        std::deque<Job*> jobs;
+    };
+
+    void WorkerLoop(uint32_t index);
+    // Work on the current graph until all of its jobs have finished
+    void RunJobs(uint32_t index);
+    Job* PopOrSteal(uint32_t index);
+    void Push(uint32_t index, Job* job);
+    void Execute(uint32_t index, Job* job);
+
+private:
+    std::deque<Job> m_jobs;// Stable addresses while jobs are added
+    std::vector<WorkQueue> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<uint32_t> m_remainingJobs{0};
+    std::atomic<uint32_t> m_busyWorkers{0};
+    std::mutex m_exceptionMutex;
+    std::exception_ptr m_exception;
+
+    // Workers sleep between graphs
+    std::mutex m_mutex;
+    std::condition_variable m_graphAvailable;
+    uint64_t m_graphGeneration = 0;
+    bool m_stopping = false;
+};
@@ -0,0 +1,269 @@
+#include "Ktx2TextureSource.h"
+#include "Compression.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef HELLOVULKAN_HAS_BASISU
+#include <basisu_transcoder.h>
+#endif
+
+namespace {
+
+const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+enum Ktx2Supercompression : uint32_t{
+    KTX2_SUPERCOMPRESSION_NONE = 0,
+    KTX2_SUPERCOMPRESSION_BASISLZ = 1,
+    KTX2_SUPERCOMPRESSION_ZSTD = 2,
+    KTX2_SUPERCOMPRESSION_ZLIB = 3
+};
+
+// The parts of the data format descriptor the loader looks at
+constexpr uint8_t KHR_DF_MODEL_UASTC = 166;
+constexpr uint8_t KHR_DF_TRANSFER_SRGB = 2;
+
+struct Ktx2Header{
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+struct Ktx2LevelIndex{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+static_assert(sizeof(Ktx2LevelIndex) == 24, "KTX2 level index layout");
+
+enum LevelState : int{
+    LEVEL_PENDING,
+    LEVEL_READY,
+    LEVEL_FAILED
+};
+
+// Sampled with linear filtering and copied to and from when the streamer changes residency
+bool IsSampleable(VkPhysicalDevice physicalDevice, VkFormat format){
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+        VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+#ifdef HELLOVULKAN_HAS_BASISU
+basist::transcoder_texture_format GetTranscoderFormat(VkFormat format){
+    switch(format){
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK: return basist::transcoder_texture_format::cTFBC7_RGBA;
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: return basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK: return basist::transcoder_texture_format::cTFETC2_RGBA;
+    // ETC1 is a subset of ETC2 RGB
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK: return basist::transcoder_texture_format::cTFETC1_RGB;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK: return basist::transcoder_texture_format::cTFBC3_RGBA;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK: return basist::transcoder_texture_format::cTFBC1_RGB;
+    default: return basist::transcoder_texture_format::cTFRGBA32;
+    }
+}
+#endif
+
+}
+
+struct Ktx2TextureSource::Data{
+    struct Level{
+        ByteSpan bytes;// What ReadLevel copies, inside @file or @decoded
+        std::vector<uint8_t> decoded;
+        std::atomic<int> state{LEVEL_PENDING};
+    };
+
+    explicit Data(Asset file, uint32_t levelCount) : file(std::move(file)), levels(levelCount) {}
+
+    Asset file;
+    std::vector<Level> levels;// Never resized, the jobs hold on to its elements
+#ifdef HELLOVULKAN_HAS_BASISU
+    basist::ktx2_transcoder transcoder;
+#endif
+};
+
+VkFormat ChooseTranscodeFormat(VkPhysicalDevice physicalDevice, bool hasAlpha, bool srgb){
+    struct Candidate{
+        VkFormat unorm;
+        VkFormat srgb;
+        bool alpha;
+    };
+    // Best quality per bit first, the opaque formats only for textures without alpha
+    const Candidate candidates[] = {
+        {VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK, true},
+        {VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_4x4_SRGB_BLOCK, true},
+        {VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK, false},
+        {VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, true},
+        {VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK, false},
+        {VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, true},
+        {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, true},
+    };
+    for(const auto& candidate: candidates){
+        if(hasAlpha && !candidate.alpha) continue;
+        VkFormat format = srgb ? candidate.srgb : candidate.unorm;
+        if(IsSampleable(physicalDevice, format)) return format;
+    }
+    throw std::runtime_error("Device can not sample any format Basis Universal textures transcode to!");
+}
+
+Ktx2TextureSource::Ktx2TextureSource(Asset file, VkPhysicalDevice physicalDevice, ThreadPool& threadPool){
+    ByteSpan bytes = file.GetBytes();
+    Ktx2Header header;
+    if(bytes.size < sizeof(header) || memcmp(bytes.data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0){
+        throw std::runtime_error("Texture is not a KTX2 file!");
+    }
+    memcpy(&header, bytes.data, sizeof(header));
+
+    if(header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1){
+        throw std::runtime_error("Only single 2D KTX2 textures are supported!");
+    }
+    m_width = header.pixelWidth;
+    m_height = header.pixelHeight;
+    // Zero asks the loader to generate the chain, which the streamer does for single level textures
+    m_levelCount = std::max(1u, header.levelCount);
+    if(m_levelCount > GetFullMipLevelCount(m_width, m_height)){
+        throw std::runtime_error("KTX2 texture has more levels than its size allows!");
+    }
+
+    // Level 0 is listed first, even though the smallest level is stored first
+    ByteSpan indexBytes = bytes.SubSpan(sizeof(header), sizeof(Ktx2LevelIndex) * m_levelCount);
+    std::vector<Ktx2LevelIndex> levelIndex(m_levelCount);
+    memcpy(levelIndex.data(), indexBytes.data, indexBytes.size);
+
+    uint8_t colorModel = 0;
+    uint8_t transferFunction = 0;
+    if(header.dfdByteLength >= 16){
+        // Total size, then the basic descriptor block: vendor and type, version and size, color model, primaries,
+        // transfer function
+        ByteSpan dfd = bytes.SubSpan(header.dfdByteOffset, 16);
+        colorModel = dfd.data[12];
+        transferFunction = dfd.data[14];
+    }
+
+    bool isBasis = header.supercompressionScheme == KTX2_SUPERCOMPRESSION_BASISLZ ||
+        (header.vkFormat == VK_FORMAT_UNDEFINED && colorModel == KHR_DF_MODEL_UASTC);
+    m_data = std::make_shared<Data>(std::move(file), m_levelCount);
+    std::shared_ptr<Data> data = m_data;
+
+    if(isBasis){
+#ifdef HELLOVULKAN_HAS_BASISU
+        static std::once_flag transcoderInitialized;
+        std::call_once(transcoderInitialized, [](){ basist::basisu_transcoder_init(); });
+
+        if(bytes.size > UINT32_MAX || !data->transcoder.init(bytes.data, static_cast<uint32_t>(bytes.size)) ||
+            !data->transcoder.start_transcoding())
+        {
+            throw std::runtime_error("Failed to read Basis Universal data of a KTX2 texture!");
+        }
+        m_format = ChooseTranscodeFormat(physicalDevice, data->transcoder.get_has_alpha(), transferFunction == KHR_DF_TRANSFER_SRGB);
+        m_transcoded = true;
+
+        // Coarsest levels first, they are the ones the streamer loads before any other
+        basist::transcoder_texture_format targetFormat = GetTranscoderFormat(m_format);
+        uint32_t blockWidth, blockHeight, blockSize;
+        GetFormatBlockInfo(m_format, blockWidth, blockHeight, blockSize);
+        for(uint32_t level = m_levelCount; level-- > 0;){
+            VkDeviceSize size = GetLevelSize(level);
+            threadPool.Submit([data, level, size, blockSize, targetFormat](){
+                Data::Level& target = data->levels[level];
+                // Each job needs its own state to transcode concurrently
+                basist::ktx2_transcoder_state state;
+                target.decoded.resize(size);
+                bool transcoded = data->transcoder.transcode_image_level(level, 0, 0, target.decoded.data(),
+                    static_cast<uint32_t>(size / blockSize), targetFormat, 0, 0, 0, -1, -1, &state);
+                target.bytes = {target.decoded.data(), target.decoded.size()};
+                target.state.store(transcoded ? LEVEL_READY : LEVEL_FAILED, std::memory_order_release);
+            });
+        }
+        return;
+#else
+        (void)transferFunction;
+        throw std::runtime_error("KTX2 texture is Basis Universal encoded, HelloVulkan was built without the transcoder!");
+#endif
+    }
+
+    m_format = static_cast<VkFormat>(header.vkFormat);
+    uint32_t blockWidth, blockHeight, blockSize;
+    if(!GetFormatBlockInfo(m_format, blockWidth, blockHeight, blockSize)){
+        throw std::runtime_error("Unsupported KTX2 texture format " + std::to_string(header.vkFormat) + "!");
+    }
+    if(!IsSampleable(physicalDevice, m_format)){
+        throw std::runtime_error("Device can not sample KTX2 texture format " + std::to_string(header.vkFormat) + "!");
+    }
+
+    bool zstd = header.supercompressionScheme == KTX2_SUPERCOMPRESSION_ZSTD;
+    if(header.supercompressionScheme != KTX2_SUPERCOMPRESSION_NONE && !(zstd && IsCompressionSupported(Compression::Zstd))){
+        throw std::runtime_error("Unsupported KTX2 supercompression scheme " + std::to_string(header.supercompressionScheme) + "!");
+    }
+
+    for(uint32_t level = m_levelCount; level-- > 0;){
+        const Ktx2LevelIndex& index = levelIndex[level];
+        VkDeviceSize size = GetLevelSize(level);
+        if((zstd ? index.uncompressedByteLength : index.byteLength) != size){
+            throw std::runtime_error("KTX2 texture level " + std::to_string(level) + " has the wrong size!");
+        }
+        ByteSpan stored = data->file.GetBytes().SubSpan(index.byteOffset, index.byteLength);
+
+        Data::Level& target = data->levels[level];
+        if(!zstd){
+            // Uploaded straight from the file
+            target.bytes = stored;
+            target.state.store(LEVEL_READY, std::memory_order_release);
+            continue;
+        }
+        threadPool.Submit([data, level, stored, size](){
+            Data::Level& target = data->levels[level];
+            target.decoded.resize(size);
+            bool decompressed = Decompress(Compression::Zstd, stored.data, stored.size, target.decoded.data(), size);
+            target.bytes = {target.decoded.data(), target.decoded.size()};
+            target.state.store(decompressed ? LEVEL_READY : LEVEL_FAILED, std::memory_order_release);
+        });
+    }
+}
+
+VkDeviceSize Ktx2TextureSource::GetLevelSize(uint32_t level) const{
+    return GetImageSize(m_format, std::max(1u, m_width >> level), std::max(1u, m_height >> level));
+}
+
+bool Ktx2TextureSource::IsLevelReady(uint32_t level) const{
+    int state = m_data->levels[level].state.load(std::memory_order_acquire);
+    if(state == LEVEL_FAILED){
+        throw std::runtime_error("Failed to decode level " + std::to_string(level) + " of a KTX2 texture!");
+    }
+    return state == LEVEL_READY;
+}
+
+void Ktx2TextureSource::ReadLevel(uint32_t level, uint8_t* destination) const{
+    if(!IsLevelReady(level)){
+        throw std::runtime_error("KTX2 texture level read before it was decoded!");
+    }
+    const ByteSpan& bytes = m_data->levels[level].bytes;
+    memcpy(destination, bytes.data, bytes.size);
+}
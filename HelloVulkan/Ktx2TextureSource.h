@@ -0,0 +1,45 @@
+#pragma once
+
+#include "FileSystem.h"
+#include "TextureSource.h"
+#include "ThreadPool.h"
+
+#include <memory>
+
+// A 2D texture stored in a KTX2 container. Levels in a block-compressed or plain format the device can sample are
+// uploaded straight from the file. Zstd supercompressed levels are decompressed, and Basis Universal ones
+// (ETC1S/BasisLZ and UASTC) are transcoded into the best format the device supports, both on @threadPool with the
+// coarsest levels first. Until a level is decoded IsLevelReady reports it as missing, so the texture streams in
+// as the workers get through it
+class Ktx2TextureSource : public TextureSource
+{
+public:
+    // Throws if the file is malformed, not a single 2D image, or in a format the device can not sample
+    Ktx2TextureSource(Asset file, VkPhysicalDevice physicalDevice, ThreadPool& threadPool);
+
+    uint32_t GetWidth() const override { return m_width; }
+    uint32_t GetHeight() const override { return m_height; }
+    VkFormat GetFormat() const override { return m_format; }
+    uint32_t GetLevelCount() const override { return m_levelCount; }
+    VkDeviceSize GetLevelSize(uint32_t level) const override;
+    bool IsLevelReady(uint32_t level) const override;
+    void ReadLevel(uint32_t level, uint8_t* destination) const override;
+
+    bool IsTranscoded() const { return m_transcoded; }
+
+private:
+    // Shared with the decoding jobs, which may outlive the source
+    struct Data;
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_levelCount = 0;
+    VkFormat m_format = VK_FORMAT_UNDEFINED;
+    bool m_transcoded = false;
+    std::shared_ptr<Data> m_data;
+};
+
+// The format Basis Universal textures are transcoded into on @physicalDevice: BC7, ASTC 4x4 or ETC2 when the device
+// samples them, in that order, otherwise BC3/BC1 and finally uncompressed RGBA8
+VkFormat ChooseTranscodeFormat(VkPhysicalDevice physicalDevice, bool hasAlpha, bool srgb);
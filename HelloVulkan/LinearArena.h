@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// One block of memory handed out front to back and released all at once. Allocating is a pointer bump, so
+// anything rebuilt every frame can live here without touching the heap after Create
+class LinearArena
+{
+public:
+    void Create(size_t capacity){
+        m_memory = std::make_unique<uint8_t[]>(capacity);
+        m_capacity = capacity;
+        m_used = 0;
+    }
+
+    // Room for @count T, uninitialized, or nullptr once the arena is full
+    template<typename T>
+    T* Allocate(size_t count){
+        static_assert(std::is_trivially_destructible<T>::value, "Nothing allocated here is ever destroyed");
+        size_t begin = (m_used + alignof(T) - 1) & ~(alignof(T) - 1);
+        if(begin + sizeof(T) * count > m_capacity) return nullptr;
+        m_used = begin + sizeof(T) * count;
+        return reinterpret_cast<T*>(m_memory.get() + begin);
+    }
+
+    // Everything allocated so far is gone
+    void Reset() { m_used = 0; }
+
+    size_t GetUsed() const { return m_used; }
+    size_t GetCapacity() const { return m_capacity; }
+
+private:
+    // make_unique<uint8_t[]> aligns for any fundamental type
+    std::unique_ptr<uint8_t[]> m_memory;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+};
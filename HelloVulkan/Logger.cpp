@@ -0,0 +1,327 @@
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
+#include <stdexcept>
+
+namespace{
+
+std::atomic<uint64_t> g_nextInstance{1};
+
+// The ring this thread writes into, valid while @instance is the logger's
+struct ThreadRing{
+    uint64_t instance = 0;
+    void* ring = nullptr;
+    uint16_t index = 0;
+};
+thread_local ThreadRing t_ring;
+
+const char* GetSeverityName(LogSeverity severity){
+    switch(severity){
+    case LogSeverity::Verbose: return "Verbose";
+    case LogSeverity::Info: return "Info";
+    case LogSeverity::Warning: return "Warning";
+    case LogSeverity::Error: return "Error";
+    }
+    return "Unknown";
+}
+
+const char* GetCategoryName(LogCategory category){
+    switch(category){
+    case LogCategory::General: return "General";
+    case LogCategory::Validation: return "Validation";
+    case LogCategory::Performance: return "Performance";
+    case LogCategory::Device: return "Device";
+    default: return "Unknown";
+    }
+}
+
+void AppendJsonString(std::string& out, const char* text, size_t length){
+    out += '"';
+    for(size_t i = 0; i < length; i++){
+        char c = text[i];
+        switch(c){
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20){
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            }else{
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+}
+
+Logger::~Logger(){
+    Close();
+}
+
+void Logger::Open(const std::string& path, LogFormat format){
+    Close();
+
+    if(path.empty()){
+        m_file = stderr;
+        m_ownsFile = false;
+    }else{
+        m_file = std::fopen(path.c_str(), format == LogFormat::Binary ? "wb" : "w");
+        if(m_file == nullptr) throw std::runtime_error("Failed to open log file: " + path + "!");
+        m_ownsFile = true;
+    }
+    m_format = format;
+    if(m_format == LogFormat::Binary) std::fwrite(&LOG_BINARY_MAGIC, sizeof(LOG_BINARY_MAGIC), 1, m_file);
+
+    m_startTime = std::chrono::steady_clock::now();
+    m_stopping = false;
+    m_previous.reset();
+    m_previousRepeats = 0;
+    m_reportedDropCount = m_droppedCount.load();
+    m_instance.store(g_nextInstance.fetch_add(1), std::memory_order_release);
+    m_writer = std::thread([this](){ WriterLoop(); });
+}
+
+void Logger::Close(){
+    if(!m_writer.joinable()) return;
+
+    // Threads still logging from here on find the logger closed
+    m_instance.store(0, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        m_stopping = true;
+    }
+    m_writerWake.notify_all();
+    m_writer.join();
+
+    if(m_ownsFile) std::fclose(m_file);
+    else std::fflush(m_file);
+    m_file = nullptr;
+    m_rings.clear();
+}
+
+void Logger::SetCategoryEnabled(LogCategory category, bool enabled){
+    uint32_t bit = 1u << static_cast<uint32_t>(category);
+    if(enabled) m_categoryMask.fetch_or(bit, std::memory_order_relaxed);
+    else m_categoryMask.fetch_and(~bit, std::memory_order_relaxed);
+}
+
+void Logger::Write(LogSeverity severity, LogCategory category, uint32_t messageId, const char* message){
+    if(!IsEnabled(severity, category)) return;
+
+    Record record;
+    if(!Begin(severity, category, messageId, record)) return;
+    size_t length = strlen(message);
+    record.length = static_cast<uint32_t>(std::min<size_t>(length, MAX_MESSAGE_LENGTH));
+    memcpy(record.text, message, record.length);
+    Commit(record);
+}
+
+void Logger::Print(LogSeverity severity, LogCategory category, uint32_t messageId, const char* format, ...){
+    if(!IsEnabled(severity, category)) return;
+
+    Record record;
+    if(!Begin(severity, category, messageId, record)) return;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(record.text, MAX_MESSAGE_LENGTH, format, args);
+    va_end(args);
+    // vsnprintf leaves room for a terminator the record does not need
+    record.length = static_cast<uint32_t>(std::max(0, std::min<int>(length, MAX_MESSAGE_LENGTH - 1)));
+    Commit(record);
+}
+
+bool Logger::Begin(LogSeverity severity, LogCategory category, uint32_t messageId, Record& record){
+    if(m_instance.load(std::memory_order_acquire) == 0) return false;
+
+    record.timeNs = GetTime();
+    if(messageId != 0 && !PassesRateLimit(messageId, record.timeNs)) return false;
+
+    record.messageId = messageId;
+    record.severity = severity;
+    record.category = category;
+    record.length = 0;
+    return true;
+}
+
+void Logger::Commit(Record& record){
+    Ring* ring = GetThreadRing(record.thread);
+    if(!ring->TryPush(record)) m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+Logger::Ring* Logger::GetThreadRing(uint16_t& threadIndex){
+    uint64_t instance = m_instance.load(std::memory_order_relaxed);
+    if(t_ring.instance != instance){
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        m_rings.push_back(std::make_unique<Ring>());
+        t_ring.instance = instance;
+        t_ring.ring = m_rings.back().get();
+        t_ring.index = static_cast<uint16_t>(m_rings.size() - 1);
+    }
+    threadIndex = t_ring.index;
+    return static_cast<Ring*>(t_ring.ring);
+}
+
+bool Logger::PassesRateLimit(uint32_t messageId, uint64_t timeNs){
+    uint32_t limit = m_rateLimit.load(std::memory_order_relaxed);
+    if(limit == 0) return true;
+
+    RateLimitEntry& entry = m_rateLimits[(messageId * 2654435761u) % RATE_LIMIT_ENTRY_COUNT];
+    uint64_t second = timeNs / 1000000000;
+    uint64_t window = entry.window.load(std::memory_order_relaxed);
+    while(true){
+        uint64_t next;
+        if((window >> 32) != second){
+            next = (second << 32) | 1;
+        }else if((window & 0xFFFFFFFF) < limit){
+            next = window + 1;
+        }else{
+            entry.lastMessageId.store(messageId, std::memory_order_relaxed);
+            entry.suppressed.fetch_add(1, std::memory_order_relaxed);
+            m_suppressedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if(entry.window.compare_exchange_weak(window, next, std::memory_order_relaxed)) return true;
+    }
+}
+
+uint64_t Logger::GetTime() const{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_startTime).count());
+}
+
+void Logger::WriterLoop(){
+    while(true){
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(m_writerMutex);
+            // Producers never signal, that would cost them a syscall. A few milliseconds of delay is fine for logs
+            m_writerWake.wait_for(lock, std::chrono::milliseconds(10), [this](){ return m_stopping; });
+            stopping = m_stopping;
+        }
+
+        bool wroteAny = Drain();
+        // A run of repeats ends when something else is logged or the producers go quiet
+        if((!wroteAny || stopping) && m_previous && m_previousRepeats > 0){
+            Emit(*m_previous, m_previousRepeats);
+            m_previousRepeats = 0;
+        }
+        EmitLostMessages();
+        std::fflush(m_file);
+
+        if(stopping) return;
+    }
+}
+
+bool Logger::Drain(){
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        for(auto& ring: m_rings) rings.push_back(ring.get());
+    }
+
+    m_pending.clear();
+    Record record;
+    for(Ring* ring: rings){
+        while(ring->TryPop(record)) m_pending.push_back(record);
+    }
+    if(m_pending.empty()) return false;
+
+    // Each ring is in order already, merge them by time
+    std::vector<uint32_t> order(m_pending.size());
+    for(uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b){ return m_pending[a].timeNs < m_pending[b].timeNs; });
+
+    for(uint32_t index: order){
+        const Record& next = m_pending[index];
+        bool isRepeat = next.messageId != 0 && m_previous && m_previous->messageId == next.messageId &&
+            m_previous->length == next.length && memcmp(m_previous->text, next.text, next.length) == 0;
+        if(isRepeat){
+            m_previousRepeats++;
+            continue;
+        }
+
+        if(m_previous && m_previousRepeats > 0) Emit(*m_previous, m_previousRepeats);
+        Emit(next, 0);
+        if(!m_previous) m_previous = std::make_unique<Record>();
+        *m_previous = next;
+        m_previousRepeats = 0;
+    }
+    return true;
+}
+
+void Logger::EmitLostMessages(){
+    Record record = {};
+    record.severity = LogSeverity::Warning;
+    record.category = LogCategory::General;
+
+    uint64_t dropped = m_droppedCount.load(std::memory_order_relaxed);
+    if(dropped != m_reportedDropCount){
+        record.timeNs = GetTime();
+        int length = snprintf(record.text, MAX_MESSAGE_LENGTH, "Dropped %llu messages, the log rings were full",
+            static_cast<unsigned long long>(dropped - m_reportedDropCount));
+        record.length = static_cast<uint32_t>(std::max(0, std::min<int>(length, MAX_MESSAGE_LENGTH - 1)));
+        Emit(record, 0);
+        m_reportedDropCount = dropped;
+    }
+
+    for(auto& entry: m_rateLimits){
+        uint32_t suppressed = entry.suppressed.exchange(0, std::memory_order_relaxed);
+        if(suppressed == 0) continue;
+
+        record.timeNs = GetTime();
+        int length = snprintf(record.text, MAX_MESSAGE_LENGTH, "Rate limit suppressed %u messages, the last with ID 0x%08x",
+            suppressed, entry.lastMessageId.load(std::memory_order_relaxed));
+        record.length = static_cast<uint32_t>(std::max(0, std::min<int>(length, MAX_MESSAGE_LENGTH - 1)));
+        Emit(record, 0);
+    }
+}
+
+void Logger::Emit(const Record& record, uint32_t repeatCount){
+    if(m_format == LogFormat::Binary){
+        LogBinaryRecord header = {};
+        header.timeNs = record.timeNs;
+        header.messageId = record.messageId;
+        header.repeatCount = repeatCount;
+        header.thread = record.thread;
+        header.severity = static_cast<uint8_t>(record.severity);
+        header.category = static_cast<uint8_t>(record.category);
+        header.length = repeatCount == 0 ? record.length : 0;
+        std::fwrite(&header, sizeof(header), 1, m_file);
+        std::fwrite(record.text, 1, header.length, m_file);
+        return;
+    }
+
+    double seconds = record.timeNs / 1e9;
+    if(m_format == LogFormat::Json){
+        std::string line;
+        char fields[160];
+        snprintf(fields, sizeof(fields), "{\"time\":%.6f,\"thread\":%u,\"severity\":\"%s\",\"category\":\"%s\",\"id\":%u,",
+            seconds, record.thread, GetSeverityName(record.severity), GetCategoryName(record.category), record.messageId);
+        line = fields;
+        if(repeatCount == 0){
+            line += "\"message\":";
+            AppendJsonString(line, record.text, record.length);
+        }else{
+            line += "\"repeated\":" + std::to_string(repeatCount);
+        }
+        line += "}\n";
+        std::fwrite(line.data(), 1, line.size(), m_file);
+        return;
+    }
+
+    if(repeatCount == 0){
+        std::fprintf(m_file, "[%10.6f] [ %s ] %s: %.*s\n", seconds, GetSeverityName(record.severity), GetCategoryName(record.category),
+            static_cast<int>(record.length), record.text);
+    }else{
+        std::fprintf(m_file, "[%10.6f] [ %s ] %s: Last message repeated %u times\n", seconds, GetSeverityName(record.severity),
+            GetCategoryName(record.category), repeatCount);
+    }
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class LogSeverity : uint8_t{
+    Verbose,
+    Info,
+    Warning,
+    Error
+};
+
+enum class LogCategory : uint8_t{
+    General,
+    Validation,
+    Performance,
+    Device,
+    Count
+};
+
+enum class LogFormat{
+    Text,// One line per message
+    Json,// One object per line
+    Binary// LOG_BINARY_MAGIC, then a LogBinaryRecord followed by its text per message
+};
+
+constexpr uint32_t LOG_BINARY_MAGIC = 0x474C5648;// "HVLG"
+
+#pragma pack(push, 1)
+struct LogBinaryRecord{
+    uint64_t timeNs;// Since the logger was opened
+    uint32_t messageId;
+    // When non-zero the record has no text, it reports the message before repeated this many more times
+    uint32_t repeatCount;
+    uint16_t thread;// In the order threads first logged
+    uint8_t severity;
+    uint8_t category;
+    uint32_t length;
+};
+#pragma pack(pop)
+
+// Logging that is cheap enough for the render thread. Every thread writes into a lock-free ring of its own and never
+// waits: when the ring is full the message is dropped and counted. A background thread merges the rings in time
+// order and does all formatting of the output and the I/O.
+//
+// Messages below the minimum severity or of a disabled category are rejected before anything is formatted. Messages
+// with a non-zero ID are rate limited per ID, and a message repeating the one before it is folded into a count
+class Logger
+{
+public:
+    static constexpr uint32_t MAX_MESSAGE_LENGTH = 1000;
+
+public:
+    ~Logger();
+
+    // Start writing to @path, or to stderr when it is empty. Messages logged before are ignored
+    void Open(const std::string& path, LogFormat format);
+    // Write whatever is still queued and stop the writer thread. Other threads must be done logging
+    void Close();
+
+    void SetMinimumSeverity(LogSeverity severity) { m_minimumSeverity.store(static_cast<uint8_t>(severity), std::memory_order_relaxed); }
+    void SetCategoryEnabled(LogCategory category, bool enabled);
+    // Messages of one ID accepted per second, zero disables the limit
+    void SetRateLimit(uint32_t messagesPerSecond) { m_rateLimit.store(messagesPerSecond, std::memory_order_relaxed); }
+
+    bool IsEnabled(LogSeverity severity, LogCategory category) const {
+        return static_cast<uint8_t>(severity) >= m_minimumSeverity.load(std::memory_order_relaxed) &&
+            (m_categoryMask.load(std::memory_order_relaxed) & (1u << static_cast<uint32_t>(category))) != 0;
+    }
+
+    // Queue @message, truncated to MAX_MESSAGE_LENGTH. @messageId groups repeats of one message, zero for none
+    void Write(LogSeverity severity, LogCategory category, uint32_t messageId, const char* message);
+    // printf-style, formatted only when the message passes the filters
+    void Print(LogSeverity severity, LogCategory category, uint32_t messageId, const char* format, ...)
+#if defined(__GNUC__)
+        __attribute__((format(printf, 5, 6)))
+#endif
+        ;
+
+    // Messages lost to full rings and to the rate limit
+    uint64_t GetDroppedCount() const { return m_droppedCount.load(std::memory_order_relaxed); }
+    uint64_t GetSuppressedCount() const { return m_suppressedCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Record{
+        uint64_t timeNs;
+        uint32_t messageId;
+        uint32_t length;
+        uint16_t thread;
+        LogSeverity severity;
+        LogCategory category;
+        char text[MAX_MESSAGE_LENGTH];
+    };
+
+    using Ring = SpscQueue<Record, 128>;
+
+    // Shared by every ID hashing to it. Packs the second a window started with the messages accepted in it
+    struct alignas(64) RateLimitEntry{
+        std::atomic<uint64_t> window{0};
+        std::atomic<uint32_t> lastMessageId{0};
+        std::atomic<uint32_t> suppressed{0};
+    };
+    static constexpr uint32_t RATE_LIMIT_ENTRY_COUNT = 64;
+
+    // The ring of the calling thread, registered on its first message
+    Ring* GetThreadRing(uint16_t& threadIndex);
+    bool PassesRateLimit(uint32_t messageId, uint64_t timeNs);
+    uint64_t GetTime() const;
+    // Record is filled up to its text, the caller writes that
+    bool Begin(LogSeverity severity, LogCategory category, uint32_t messageId, Record& record);
+    void Commit(Record& record);
+
+    void WriterLoop();
+    // Move everything queued into the output, returns whether there was anything
+    bool Drain();
+    void Emit(const Record& record, uint32_t repeatCount);
+    // Report messages dropped or suppressed by the rate limit since the last call
+    void EmitLostMessages();
+
+private:
+    std::atomic<uint8_t> m_minimumSeverity{static_cast<uint8_t>(LogSeverity::Info)};
+    std::atomic<uint32_t> m_categoryMask{~0u};
+    std::atomic<uint32_t> m_rateLimit{20};
+    std::atomic<uint64_t> m_droppedCount{0};
+    std::atomic<uint64_t> m_suppressedCount{0};
+    RateLimitEntry m_rateLimits[RATE_LIMIT_ENTRY_COUNT];
+
+    // Told apart by the thread-local ring cache, so a new logger at an old address gets new rings
+    std::atomic<uint64_t> m_instance{0};
+    std::chrono::steady_clock::time_point m_startTime;
+
+    // Rings are only added, under the mutex, and live until the logger is closed
+    std::mutex m_ringsMutex;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+
+    // Owned by the writer thread
+    std::FILE* m_file = nullptr;
+    bool m_ownsFile = false;
+    LogFormat m_format = LogFormat::Text;
+    std::vector<Record> m_pending;
+    std::unique_ptr<Record> m_previous;
+    uint32_t m_previousRepeats = 0;
+    uint64_t m_reportedDropCount = 0;
+
+    std::thread m_writer;
+    std::mutex m_writerMutex;
+    std::condition_variable m_writerWake;
+    bool m_stopping = false;
+};
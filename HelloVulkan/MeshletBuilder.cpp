@@ -0,0 +1,127 @@
+#include "MeshletBuilder.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace{
+    // Cones whose normals spread this close to a half sphere hardly ever cull, they are left out
+    constexpr float MIN_CONE_SPREAD = 0.1f;
+
+    glm::vec3 GetPosition(const float* positions, size_t stride, uint32_t index){
+        glm::vec3 position;
+        std::memcpy(&position, reinterpret_cast<const uint8_t*>(positions) + stride * index, sizeof(position));
+        return position;
+    }
+
+    MeshletBounds ComputeBounds(const MeshletMesh& mesh, const Meshlet& meshlet, const float* positions, size_t stride){
+        // The center of the box around the vertices is close enough to the smallest sphere for culling
+        glm::vec3 low(FLT_MAX);
+        glm::vec3 high(-FLT_MAX);
+        for(uint32_t i = 0; i < meshlet.vertexCount; i++){
+            glm::vec3 position = GetPosition(positions, stride, mesh.vertices[meshlet.vertexOffset + i]);
+            low = glm::min(low, position);
+            high = glm::max(high, position);
+        }
+        glm::vec3 center = (low + high) * 0.5f;
+        float radius = 0.0f;
+        for(uint32_t i = 0; i < meshlet.vertexCount; i++){
+            radius = std::max(radius, glm::length(GetPosition(positions, stride, mesh.vertices[meshlet.vertexOffset + i]) - center));
+        }
+
+        // The cone axis is the mean of the unit normals, its cutoff comes from the normal furthest from it.
+        // Degenerate triangles have no normal and are skipped
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.triangleCount);
+        glm::vec3 axis(0.0f);
+        for(uint32_t i = 0; i < meshlet.triangleCount; i++){
+            const uint8_t* triangle = &mesh.triangles[(meshlet.triangleOffset + i) * 3];
+            glm::vec3 a = GetPosition(positions, stride, mesh.vertices[meshlet.vertexOffset + triangle[0]]);
+            glm::vec3 b = GetPosition(positions, stride, mesh.vertices[meshlet.vertexOffset + triangle[1]]);
+            glm::vec3 c = GetPosition(positions, stride, mesh.vertices[meshlet.vertexOffset + triangle[2]]);
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            if(length == 0.0f) continue;
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+        float axisLength = glm::length(axis);
+        float minimumDot = 1.0f;
+        if(axisLength > 0.0f){
+            axis /= axisLength;
+            for(const glm::vec3& normal: normals) minimumDot = std::min(minimumDot, glm::dot(normal, axis));
+        }
+
+        MeshletBounds bounds = {};
+        std::memcpy(bounds.center, &center, sizeof(bounds.center));
+        bounds.radius = radius;
+        std::memcpy(bounds.coneAxis, &axis, sizeof(bounds.coneAxis));
+        // The sine of the widest angle between a normal and the axis
+        bounds.coneCutoff = axisLength == 0.0f || minimumDot < MIN_CONE_SPREAD ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+        return bounds;
+    }
+}
+
+std::vector<uint32_t> MeshletMesh::GetIndices() const{
+    std::vector<uint32_t> indices;
+    indices.reserve(triangles.size());
+    for(const Meshlet& meshlet: meshlets){
+        for(uint32_t i = 0; i < meshlet.triangleCount * 3; i++){
+            indices.push_back(vertices[meshlet.vertexOffset + triangles[meshlet.triangleOffset * 3 + i]]);
+        }
+    }
+    return indices;
+}
+
+MeshletMesh BuildMeshlets(const float* positions, size_t positionStride, size_t vertexCount, const uint32_t* indices,
+    size_t indexCount)
+{
+    if(indexCount % 3 != 0) throw std::runtime_error("Meshlets need a triangle list!");
+
+    MeshletMesh mesh;
+    // Where each source vertex sits in the meshlet being filled, or -1
+    std::vector<int32_t> localIndex(vertexCount, -1);
+    Meshlet meshlet = {};
+
+    auto closeMeshlet = [&](){
+        if(meshlet.triangleCount == 0) return;
+        for(uint32_t i = 0; i < meshlet.vertexCount; i++) localIndex[mesh.vertices[meshlet.vertexOffset + i]] = -1;
+        mesh.meshlets.push_back(meshlet);
+        meshlet.vertexOffset += meshlet.vertexCount;
+        meshlet.triangleOffset += meshlet.triangleCount;
+        meshlet.vertexCount = 0;
+        meshlet.triangleCount = 0;
+    };
+
+    for(size_t triangle = 0; triangle < indexCount; triangle += 3){
+        const uint32_t* corners = indices + triangle;
+        uint32_t newVertices = 0;
+        for(uint32_t i = 0; i < 3; i++){
+            if(corners[i] >= vertexCount) throw std::runtime_error("Meshlet index out of range!");
+            // A corner repeated within the triangle is only added once
+            bool repeated = (i > 0 && corners[i] == corners[0]) || (i > 1 && corners[i] == corners[1]);
+            if(localIndex[corners[i]] < 0 && !repeated) newVertices++;
+        }
+        if(meshlet.vertexCount + newVertices > MAX_MESHLET_VERTICES || meshlet.triangleCount + 1 > MAX_MESHLET_TRIANGLES){
+            closeMeshlet();
+        }
+
+        for(uint32_t i = 0; i < 3; i++){
+            if(localIndex[corners[i]] < 0){
+                localIndex[corners[i]] = static_cast<int32_t>(meshlet.vertexCount++);
+                mesh.vertices.push_back(corners[i]);
+            }
+            mesh.triangles.push_back(static_cast<uint8_t>(localIndex[corners[i]]));
+        }
+        meshlet.triangleCount++;
+    }
+    closeMeshlet();
+
+    mesh.bounds.reserve(mesh.meshlets.size());
+    for(const Meshlet& closed: mesh.meshlets) mesh.bounds.push_back(ComputeBounds(mesh, closed, positions, positionStride));
+    return mesh;
+}
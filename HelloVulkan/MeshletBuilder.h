@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Up to this many vertices and triangles make one meshlet, sized to what one mesh shader workgroup outputs well on
+// most hardware
+constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+struct Meshlet{
+    // Into MeshletMesh::vertices
+    uint32_t vertexOffset;
+    // Into MeshletMesh::triangles, in triangles
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+// In the space of the mesh. The cone holds the normals of all triangles, by the right-hand rule of their winding:
+// seen from a camera at c, the meshlet only has back faces when
+//
+//   dot(center - c, coneAxis) >= coneCutoff * length(center - c) + radius
+//
+// A cutoff of one never culls, it is used when the normals spread too far for a cone to help
+struct MeshletBounds{
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+struct MeshletMesh{
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> bounds;// One per meshlet
+    // Indices into the vertices of the source mesh, a range per meshlet
+    std::vector<uint32_t> vertices;
+    // Three indices into the meshlet's range of vertices per triangle
+    std::vector<uint8_t> triangles;
+
+    // The triangles as indices into the source vertices, meshlet after meshlet. Meshlet i covers
+    // [triangleOffset * 3, (triangleOffset + triangleCount) * 3)
+    std::vector<uint32_t> GetIndices() const;
+};
+
+// Split a triangle list into meshlets. Triangles are taken in index order and a meshlet is closed once the next
+// one would not fit, so meshes whose index order is already cache friendly give compact meshlets. Positions are
+// three floats every @positionStride bytes
+MeshletMesh BuildMeshlets(const float* positions, size_t positionStride, size_t vertexCount, const uint32_t* indices,
+    size_t indexCount);
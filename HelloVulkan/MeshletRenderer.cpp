@@ -0,0 +1,474 @@
+#include "MeshletRenderer.h"
+
+#include "HostAllocator.h"
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+// Matches the CullParams push constants of meshlet_cull.comp, meshlet.task and meshlet.mesh
+struct CullParams{
+    glm::vec4 planes[6];
+    glm::vec3 cameraPosition;
+    uint32_t meshletCount;
+    uint32_t instanceCount;
+    uint32_t compact;
+    uint32_t drawCapacity;
+    uint32_t vertexStride;
+};
+
+static_assert(sizeof(CullParams) == 128, "Cull parameters must fit the guaranteed push constant space");
+
+// Matches Meshlet in the meshlet shaders
+struct GpuMeshlet{
+    MeshletBounds bounds;
+    Meshlet meshlet;
+};
+
+// Leads the draw buffer, the draws follow at this offset
+constexpr VkDeviceSize DRAW_COUNT_SIZE = 16;
+
+CullParams MakeCullParams(const MeshletRenderer::View& view){
+    CullParams params = {};
+    const glm::mat4& m = view.viewProjection;
+    glm::vec4 rows[4];
+    for(int i = 0; i < 4; i++) rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    params.planes[0] = rows[3] + rows[0];
+    params.planes[1] = rows[3] - rows[0];
+    params.planes[2] = rows[3] + rows[1];
+    params.planes[3] = rows[3] - rows[1];
+    params.planes[4] = rows[2];
+    params.planes[5] = rows[3] - rows[2];
+    for(auto& plane: params.planes) plane /= glm::length(glm::vec3(plane));
+    params.cameraPosition = view.cameraPosition;
+    return params;
+}
+
+// Spread @count workgroups over x and y, so no dimension passes @maxPerDimension
+VkExtent2D SplitWorkgroups(uint32_t count, uint32_t maxPerDimension){
+    uint32_t x = std::min(count, maxPerDimension);
+    return {x, x == 0 ? 0 : (count + x - 1) / x};
+}
+
+}
+
+bool MeshletRenderer::IsSupported(VkPhysicalDevice physicalDevice, Path path){
+    if(path == Path::Compute){
+        // One draw per meshlet from a single call, each starting at the instance the meshlet belongs to
+        VkPhysicalDeviceFeatures features;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+        return features.multiDrawIndirect && features.drawIndirectFirstInstance;
+    }
+
+    // The mesh shading SPIR-V needs version 1.4, which Vulkan 1.2 accepts without further extensions
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if(properties.apiVersion < VK_API_VERSION_1_2) return false;
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+    bool hasExtension = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension){
+        return strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0;
+    });
+    if(!hasExtension) return false;
+
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &meshShaderFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
+
+bool MeshletRenderer::IsDrawIndirectCountSupported(VkPhysicalDevice physicalDevice){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if(properties.apiVersion < VK_API_VERSION_1_2) return false;
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    return vulkan12Features.drawIndirectCount;
+}
+
+void MeshletRenderer::Create(VkPhysicalDevice physicalDevice, VkDevice device, Path path, bool drawIndirectCount,
+    const MeshletMesh& mesh, VkBuffer vertexBuffer, uint32_t vertexStride, VkDescriptorSetLayout sceneSetLayout,
+    uint32_t maxInstances, uint32_t framesInFlight, VkFrontFace frontFace, const VirtualFileSystem& fileSystem,
+    VkPipelineCache pipelineCache, const UploadFunction& upload)
+{
+    m_physicalDevice = physicalDevice;
+    m_device = device;
+    m_path = path;
+    m_drawIndirectCount = drawIndirectCount && path == Path::Compute;
+    m_meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+    m_vertexStride = vertexStride;
+    m_frameCount = framesInFlight;
+    m_fileSystem = &fileSystem;
+    m_pipelineCache = pipelineCache;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint64_t maxDraws = static_cast<uint64_t>(std::max(maxInstances, 1u)) * m_meshletCount;
+    m_maxDraws = static_cast<uint32_t>(std::min<uint64_t>(maxDraws, properties.limits.maxDrawIndirectCount));
+
+    if(path == Path::MeshShader){
+        VkPhysicalDeviceMeshShaderPropertiesEXT meshShaderProperties = {};
+        meshShaderProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &meshShaderProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        m_maxTaskWorkGroupCount = std::min(meshShaderProperties.maxTaskWorkGroupCount[0], meshShaderProperties.maxTaskWorkGroupCount[1]);
+        m_maxTaskWorkGroupTotalCount = meshShaderProperties.maxTaskWorkGroupTotalCount;
+        m_cmdDrawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT"));
+        if(m_cmdDrawMeshTasks == nullptr) throw std::runtime_error("Failed to load vkCmdDrawMeshTasksEXT!");
+    }
+    if(m_drawIndirectCount){
+        m_cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(
+            vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCount"));
+        if(m_cmdDrawIndexedIndirectCount == nullptr) throw std::runtime_error("Failed to load vkCmdDrawIndexedIndirectCount!");
+    }
+
+    // The projection flips Y, so a triangle wound counter-clockwise around its right-hand normal still looks
+    // counter-clockwise in the framebuffer when seen from that side. With clockwise front faces the visible side
+    // is the other one, and so is the cone
+    MeshletMesh oriented = mesh;
+    if(frontFace == VK_FRONT_FACE_CLOCKWISE){
+        for(MeshletBounds& bounds: oriented.bounds){
+            for(float& component: bounds.coneAxis) component = -component;
+        }
+    }
+
+    CreateBuffers(oriented, vertexBuffer, upload);
+    CreateDescriptorSets(vertexBuffer);
+    CreatePipelineLayout(sceneSetLayout);
+    if(path == Path::Compute) CreateCullPipeline();
+}
+
+void MeshletRenderer::Destroy(){
+    DestroyGraphicsPipeline();
+
+    vkDestroyPipeline(m_device, m_cullPipeline, GetAllocationCallbacks());
+    vkDestroyPipelineLayout(m_device, m_pipelineLayout, GetAllocationCallbacks());
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, GetAllocationCallbacks());
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, GetAllocationCallbacks());
+    for(size_t i = 0; i < m_drawBuffers.size(); i++){
+        vkDestroyBuffer(m_device, m_drawBuffers[i], GetAllocationCallbacks());
+        FreeMemory(m_device, m_drawBuffersMemory[i]);
+    }
+    vkDestroyBuffer(m_device, m_meshletBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_meshletBufferMemory);
+    vkDestroyBuffer(m_device, m_meshletVertexBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_meshletVertexBufferMemory);
+    vkDestroyBuffer(m_device, m_meshletTriangleBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_meshletTriangleBufferMemory);
+
+    m_cullPipeline = VK_NULL_HANDLE;
+    m_pipelineLayout = VK_NULL_HANDLE;
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSetLayout = VK_NULL_HANDLE;
+    m_descriptorSets.clear();
+    m_drawBuffers.clear();
+    m_drawBuffersMemory.clear();
+}
+
+void MeshletRenderer::CreateBuffers(const MeshletMesh& mesh, VkBuffer vertexBuffer, const UploadFunction& upload){
+    std::vector<GpuMeshlet> meshlets(mesh.meshlets.size());
+    for(size_t i = 0; i < meshlets.size(); i++) meshlets[i] = {mesh.bounds[i], mesh.meshlets[i]};
+    // Four triangle indices to a word, the last word padded
+    std::vector<uint8_t> triangles = mesh.triangles;
+    triangles.resize((triangles.size() + 3) & ~size_t(3));
+
+    auto createStatic = [&](const void* data, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory){
+        CreateBuffer(m_physicalDevice, m_device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+        upload(data, size, buffer);
+    };
+    createStatic(meshlets.data(), sizeof(GpuMeshlet) * meshlets.size(), m_meshletBuffer, m_meshletBufferMemory);
+    createStatic(mesh.vertices.data(), sizeof(uint32_t) * mesh.vertices.size(), m_meshletVertexBuffer, m_meshletVertexBufferMemory);
+    createStatic(triangles.data(), triangles.size(), m_meshletTriangleBuffer, m_meshletTriangleBufferMemory);
+
+    if(m_path != Path::Compute) return;
+    m_drawBuffers.resize(m_frameCount);
+    m_drawBuffersMemory.resize(m_frameCount);
+    for(uint32_t i = 0; i < m_frameCount; i++){
+        CreateBuffer(m_physicalDevice, m_device, DRAW_COUNT_SIZE + sizeof(VkDrawIndexedIndirectCommand) * m_maxDraws,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_drawBuffers[i], m_drawBuffersMemory[i]);
+    }
+}
+
+void MeshletRenderer::CreateDescriptorSets(VkBuffer vertexBuffer){
+    // 0: meshlets, 1: meshlet vertices, 2: meshlet triangles, then 3: the draws of the compute path or
+    // 4: the vertices the mesh shader reads
+    VkShaderStageFlags stages = m_path == Path::Compute ? VK_SHADER_STAGE_COMPUTE_BIT :
+        VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    std::vector<VkDescriptorSetLayoutBinding> bindings(4);
+    for(uint32_t i = 0; i < bindings.size(); i++){
+        bindings[i].binding = i < 3 || m_path == Path::Compute ? i : 4;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = stages;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &layoutInfo, GetAllocationCallbacks(), &m_descriptorSetLayout),
+        "Failed to create meshlet descriptor set layout!");
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = static_cast<uint32_t>(bindings.size()) * m_frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = m_frameCount;
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_descriptorPool),
+        "Failed to create meshlet descriptor pool!");
+
+    std::vector<VkDescriptorSetLayout> layouts(m_frameCount, m_descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = m_frameCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_descriptorSets.resize(m_frameCount);
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()),
+        "Failed to allocate meshlet descriptor sets!");
+
+    for(uint32_t i = 0; i < m_frameCount; i++){
+        std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+        bufferInfos[0].buffer = m_meshletBuffer;
+        bufferInfos[1].buffer = m_meshletVertexBuffer;
+        bufferInfos[2].buffer = m_meshletTriangleBuffer;
+        bufferInfos[3].buffer = m_path == Path::Compute ? m_drawBuffers[i] : vertexBuffer;
+        for(auto& bufferInfo: bufferInfos){
+            bufferInfo.offset = 0;
+            bufferInfo.range = VK_WHOLE_SIZE;
+        }
+
+        std::array<VkWriteDescriptorSet, 4> writes = {};
+        for(uint32_t j = 0; j < writes.size(); j++){
+            writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[j].dstSet = m_descriptorSets[i];
+            writes[j].dstBinding = bindings[j].binding;
+            writes[j].dstArrayElement = 0;
+            writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[j].descriptorCount = 1;
+            writes[j].pBufferInfo = &bufferInfos[j];
+        }
+
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void MeshletRenderer::CreatePipelineLayout(VkDescriptorSetLayout sceneSetLayout){
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = m_path == Path::Compute ? VK_SHADER_STAGE_COMPUTE_BIT :
+        VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullParams);
+
+    VkDescriptorSetLayout setLayouts[] = {sceneSetLayout, m_descriptorSetLayout};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, GetAllocationCallbacks(), &m_pipelineLayout),
+        "Failed to create meshlet pipeline layout!");
+}
+
+void MeshletRenderer::CreateCullPipeline(){
+    Asset compShaderCode = m_fileSystem->Open("shaders/meshlet_cull_comp.spv");
+    VkShaderModule compShaderModule = CreateShaderModule(m_device, compShaderCode.GetBytes());
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipelineLayout;
+
+    ThrowIfFailed(vkCreateComputePipelines(m_device, m_pipelineCache, 1, &pipelineInfo, GetAllocationCallbacks(), &m_cullPipeline),
+        "Failed to create meshlet cull pipeline!");
+
+    vkDestroyShaderModule(m_device, compShaderModule, GetAllocationCallbacks());
+}
+
+void MeshletRenderer::CreateGraphicsPipeline(const RenderTarget& target,
+    const VkPipelineRasterizationStateCreateInfo& rasterizer, const VkPipelineDepthStencilStateCreateInfo& depthStencil,
+    ByteSpan fragmentShaderCode)
+{
+    if(m_path != Path::MeshShader) return;
+
+    Asset taskShaderCode = m_fileSystem->Open("shaders/meshlet_task.spv");
+    Asset meshShaderCode = m_fileSystem->Open("shaders/meshlet_mesh.spv");
+    VkShaderModule taskShaderModule = CreateShaderModule(m_device, taskShaderCode.GetBytes());
+    VkShaderModule meshShaderModule = CreateShaderModule(m_device, meshShaderCode.GetBytes());
+    VkShaderModule fragShaderModule = CreateShaderModule(m_device, fragmentShaderCode);
+
+    VkPipelineShaderStageCreateInfo shaderStages[3] = {};
+    VkShaderStageFlagBits stages[3] = {VK_SHADER_STAGE_TASK_BIT_EXT, VK_SHADER_STAGE_MESH_BIT_EXT, VK_SHADER_STAGE_FRAGMENT_BIT};
+    VkShaderModule modules[3] = {taskShaderModule, meshShaderModule, fragShaderModule};
+    for(uint32_t i = 0; i < 3; i++){
+        shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[i].stage = stages[i];
+        shaderStages[i].module = modules[i];
+        shaderStages[i].pName = "main";
+    }
+
+    // Set when the main pass begins, at the size it draws at
+    VkPipelineViewportStateCreateInfo viewportInfo = {};
+    viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportInfo.viewportCount = 1;
+    viewportInfo.scissorCount = 1;
+
+    VkPipelineMultisampleStateCreateInfo multisamplingInfo = {};
+    multisamplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisamplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisamplingInfo.minSampleShading = 1.0f;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT |
+        VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT |
+        VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {};
+    colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendInfo.logicOpEnable = VK_FALSE;
+    colorBlendInfo.attachmentCount = 1;
+    colorBlendInfo.pAttachments = &colorBlendAttachment;
+
+    // Mesh pipelines have no vertex input or input assembly, the mesh shader outputs triangles directly
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 3;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pViewportState = &viewportInfo;
+    pipelineInfo.pDynamicState = &GetViewportDynamicState();
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisamplingInfo;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlendInfo;
+    pipelineInfo.layout = m_pipelineLayout;
+    VkPipelineRenderingCreateInfo renderingInfo;
+    SetPipelineTarget(pipelineInfo, target, renderingInfo);
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, GetAllocationCallbacks(), &m_meshPipeline),
+        "Failed to create meshlet graphics pipeline!");
+
+    for(VkShaderModule shaderModule: modules) vkDestroyShaderModule(m_device, shaderModule, GetAllocationCallbacks());
+}
+
+void MeshletRenderer::DestroyGraphicsPipeline(){
+    vkDestroyPipeline(m_device, m_meshPipeline, GetAllocationCallbacks());
+    m_meshPipeline = VK_NULL_HANDLE;
+}
+
+void MeshletRenderer::RecordCull(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet,
+    const uint32_t* sceneDynamicOffsets, uint32_t sceneDynamicOffsetCount, const View& view, uint32_t instanceCount,
+    Telemetry* telemetry) const
+{
+    if(m_path != Path::Compute) return;
+
+    // Appended draws count up from zero. The fence of this frame was waited on, nothing reads the count anymore
+    if(m_drawIndirectCount){
+        vkCmdFillBuffer(commandBuffer, m_drawBuffers[frame], 0, sizeof(uint32_t), 0);
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_drawBuffers[frame];
+        barrier.offset = 0;
+        barrier.size = sizeof(uint32_t);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout,
+        0, 1, &sceneSet, sceneDynamicOffsetCount, sceneDynamicOffsets);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout,
+        1, 1, &m_descriptorSets[frame], 0, nullptr);
+
+    CullParams params = MakeCullParams(view);
+    params.meshletCount = m_meshletCount;
+    params.instanceCount = instanceCount;
+    params.compact = m_drawIndirectCount ? 1 : 0;
+    params.drawCapacity = m_maxDraws;
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+    // 65535 workgroups a dimension is the least every device takes
+    uint32_t invocations = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(instanceCount) * m_meshletCount, m_maxDraws));
+    VkExtent2D workgroups = SplitWorkgroups((invocations + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 65535);
+    if(workgroups.width > 0) vkCmdDispatch(commandBuffer, workgroups.width, workgroups.height, 1);
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::PipelineBinds);
+}
+
+void MeshletRenderer::RecordDraw(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet,
+    const uint32_t* sceneDynamicOffsets, uint32_t sceneDynamicOffsetCount, const View& view, uint32_t instanceCount,
+    Telemetry* telemetry) const
+{
+    if(m_path == Path::Compute){
+        // Without a count buffer every meshlet keeps its slot, the culled ones draw no instances
+        uint32_t maxDraws = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(instanceCount) * m_meshletCount, m_maxDraws));
+        if(m_drawIndirectCount){
+            m_cmdDrawIndexedIndirectCount(commandBuffer, m_drawBuffers[frame], DRAW_COUNT_SIZE, m_drawBuffers[frame], 0,
+                maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+        }else if(maxDraws > 0){
+            vkCmdDrawIndexedIndirect(commandBuffer, m_drawBuffers[frame], DRAW_COUNT_SIZE, maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        if(telemetry != nullptr) telemetry->Count(TelemetryCounter::DrawCalls);
+        return;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_meshPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout,
+        0, 1, &sceneSet, sceneDynamicOffsetCount, sceneDynamicOffsets);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout,
+        1, 1, &m_descriptorSets[frame], 0, nullptr);
+
+    CullParams params = MakeCullParams(view);
+    params.meshletCount = m_meshletCount;
+    params.instanceCount = instanceCount;
+    params.vertexStride = m_vertexStride / sizeof(float);
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+        0, sizeof(params), &params);
+
+    // Instances past what one call may launch are left out rather than drawn wrong
+    uint32_t groupsPerInstance = (m_meshletCount + TASK_WORKGROUP_SIZE - 1) / TASK_WORKGROUP_SIZE;
+    uint32_t groups = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(instanceCount) * groupsPerInstance,
+        m_maxTaskWorkGroupTotalCount / groupsPerInstance * groupsPerInstance));
+    VkExtent2D workgroups = SplitWorkgroups(groups, m_maxTaskWorkGroupCount);
+    if(workgroups.width > 0) m_cmdDrawMeshTasks(commandBuffer, workgroups.width, workgroups.height, 1);
+    if(telemetry != nullptr){
+        telemetry->Count(TelemetryCounter::PipelineBinds);
+        telemetry->Count(TelemetryCounter::DrawCalls);
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "MeshletBuilder.h"
+#include "VulkanCommon.h"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+class Telemetry;
+
+// Draws every visible instance of one mesh meshlet by meshlet, culling each meshlet against the frustum and by its
+// normal cone first. With VK_EXT_mesh_shader a task shader culls and the mesh shader emits the survivors directly.
+// Otherwise a compute pass culls into a list of indexed indirect draws, one per visible meshlet, drawn with the
+// regular vertex pipeline from an index buffer in meshlet order (MeshletMesh::GetIndices).
+//
+// Instances are the entries of the scene draw list. Both paths read the object matrices and the draw list through
+// set 0, the scene set of the caller, and the meshlets through set 1
+class MeshletRenderer
+{
+public:
+    enum class Path{
+        Compute,// Cull into indirect draws
+        MeshShader// Cull in task shaders, VK_EXT_mesh_shader
+    };
+
+    // What the instances are culled against, in world space
+    struct View{
+        glm::mat4 viewProjection;
+        glm::vec3 cameraPosition;
+    };
+
+    // Records a copy of @size bytes from @data into @buffer ahead of the first frame
+    using UploadFunction = std::function<void(const void* data, VkDeviceSize size, VkBuffer buffer)>;
+
+    static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;// meshlet_cull.comp
+    static constexpr uint32_t TASK_WORKGROUP_SIZE = 32;// meshlet.task, meshlets per task workgroup
+
+public:
+    // Whether @physicalDevice can take @path, and the device features and extensions to enable for it
+    static bool IsSupported(VkPhysicalDevice physicalDevice, Path path);
+    // Draws culled on the GPU skip the empty slots when the device can take their count from a buffer
+    static bool IsDrawIndirectCountSupported(VkPhysicalDevice physicalDevice);
+
+    // @mesh is drawn from @vertexBuffer holding @vertexStride bytes per vertex, positions first as two floats.
+    // @sceneSetLayout must make the object matrices (binding 2) and draw list (binding 3) visible to the culling
+    // stages. Room is made for @maxInstances instances a frame. @frontFace is the winding the scene pipeline treats as
+    // front facing in the framebuffer. Shaders are loaded from @fileSystem, which must outlive the renderer
+    void Create(VkPhysicalDevice physicalDevice, VkDevice device, Path path, bool drawIndirectCount, const MeshletMesh& mesh,
+        VkBuffer vertexBuffer, uint32_t vertexStride, VkDescriptorSetLayout sceneSetLayout, uint32_t maxInstances,
+        uint32_t framesInFlight, VkFrontFace frontFace, const VirtualFileSystem& fileSystem, VkPipelineCache pipelineCache,
+        const UploadFunction& upload);
+    void Destroy();
+
+    // The mesh shader pipeline follows the swap chain like the scene pipeline and rasterizes, depth tests and takes
+    // its viewport the same, the compute path has none
+    void CreateGraphicsPipeline(const RenderTarget& target, const VkPipelineRasterizationStateCreateInfo& rasterizer,
+        const VkPipelineDepthStencilStateCreateInfo& depthStencil, ByteSpan fragmentShaderCode);
+    void DestroyGraphicsPipeline();
+
+    Path GetPath() const { return m_path; }
+    uint32_t GetMeshletCount() const { return m_meshletCount; }
+    // The indirect draws of @frame, written by RecordCull and read by RecordDraw on the compute path
+    VkBuffer GetDrawBuffer(uint32_t frame) const { return m_drawBuffers[frame]; }
+
+    // Compute path, outside a render pass: cull @instanceCount instances into the draws of @frame. @sceneSet is bound
+    // with @sceneDynamicOffsets
+    void RecordCull(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet, const uint32_t* sceneDynamicOffsets,
+        uint32_t sceneDynamicOffsetCount, const View& view, uint32_t instanceCount, Telemetry* telemetry = nullptr) const;
+    // Inside the render pass. On the compute path the scene pipeline, its sets, the vertex buffer and the meshlet
+    // ordered index buffer must be bound already; the mesh shader path binds everything it needs
+    void RecordDraw(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet, const uint32_t* sceneDynamicOffsets,
+        uint32_t sceneDynamicOffsetCount, const View& view, uint32_t instanceCount, Telemetry* telemetry = nullptr) const;
+
+private:
+    void CreateBuffers(const MeshletMesh& mesh, VkBuffer vertexBuffer, const UploadFunction& upload);
+    void CreateDescriptorSets(VkBuffer vertexBuffer);
+    void CreatePipelineLayout(VkDescriptorSetLayout sceneSetLayout);
+    void CreateCullPipeline();
+
+private:
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    Path m_path = Path::Compute;
+    bool m_drawIndirectCount = false;
+    uint32_t m_meshletCount = 0;
+    uint32_t m_vertexStride = 0;
+    uint32_t m_maxDraws = 0;
+    uint32_t m_frameCount = 0;
+    const VirtualFileSystem* m_fileSystem = nullptr;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+
+    // Meshlets with their bounds, their vertex indices and their packed triangles
+    VkBuffer m_meshletBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_meshletBufferMemory = VK_NULL_HANDLE;
+    VkBuffer m_meshletVertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_meshletVertexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer m_meshletTriangleBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_meshletTriangleBufferMemory = VK_NULL_HANDLE;
+    // Compute path: a draw count followed by the draws, per frame in flight
+    std::vector<VkBuffer> m_drawBuffers;
+    std::vector<VkDeviceMemory> m_drawBuffersMemory;
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_descriptorSets;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+    VkPipeline m_meshPipeline = VK_NULL_HANDLE;
+
+    PFN_vkCmdDrawIndexedIndirectCount m_cmdDrawIndexedIndirectCount = nullptr;
+    PFN_vkCmdDrawMeshTasksEXT m_cmdDrawMeshTasks = nullptr;
+    // Per dimension and in total
+    uint32_t m_maxTaskWorkGroupCount = 0;
+    uint32_t m_maxTaskWorkGroupTotalCount = 0;
+};
@@ -0,0 +1,125 @@
+#include "Multiview.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Directions and up vectors of the cube faces in layer order, as a cube map samples them
+const glm::vec3 g_faceDirections[] = {
+    {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}
+};
+const glm::vec3 g_faceUps[] = {
+    {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}
+};
+
+}
+
+uint32_t Multiview::GetViewCount(MultiviewMode mode){
+    switch(mode){
+    case MultiviewMode::Stereo: return 2;
+    case MultiviewMode::Cubemap: return 6;
+    default: return 1;
+    }
+}
+
+bool Multiview::IsSupported(VkPhysicalDevice physicalDevice, uint32_t viewCount){
+    // Core in Vulkan 1.1, which every device this runs on has
+    VkPhysicalDeviceMultiviewFeatures multiviewFeatures = {};
+    multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &multiviewFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    VkPhysicalDeviceMultiviewProperties multiviewProperties = {};
+    multiviewProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &multiviewProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    return multiviewFeatures.multiview && multiviewProperties.maxMultiviewViewCount >= viewCount;
+}
+
+void Multiview::Create(MultiviewMode mode){
+    m_mode = mode;
+    m_columns = mode == MultiviewMode::Off ? 1 : (mode == MultiviewMode::Stereo ? 2 : 3);
+    m_rows = mode == MultiviewMode::Cubemap ? 2 : 1;
+}
+
+VkExtent2D Multiview::GetViewExtent(VkExtent2D windowExtent) const{
+    uint32_t width = std::max(windowExtent.width / m_columns, 1u);
+    uint32_t height = std::max(windowExtent.height / m_rows, 1u);
+    if(m_mode == MultiviewMode::Cubemap) width = height = std::min(width, height);
+    return {width, height};
+}
+
+float Multiview::GetFieldOfView(float fovY) const{
+    return m_mode == MultiviewMode::Cubemap ? glm::radians(90.0f) : fovY;
+}
+
+void Multiview::GetViewMatrices(const glm::mat4& view, glm::mat4 views[MAX_VIEW_COUNT]) const{
+    switch(m_mode){
+    case MultiviewMode::Stereo:
+        // The left eye sees the scene shifted right
+        views[0] = glm::translate(glm::mat4(1.0f), glm::vec3(EYE_SEPARATION / 2.0f, 0.0f, 0.0f)) * view;
+        views[1] = glm::translate(glm::mat4(1.0f), glm::vec3(-EYE_SEPARATION / 2.0f, 0.0f, 0.0f)) * view;
+        break;
+    case MultiviewMode::Cubemap:{
+        glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+        for(uint32_t face = 0; face < 6; face++) views[face] = glm::lookAt(eye, eye + g_faceDirections[face], g_faceUps[face]);
+        break;
+    }
+    default:
+        views[0] = view;
+        break;
+    }
+}
+
+void Multiview::SetCullingView(const glm::mat4& view, const glm::mat4& projection, DrawListBuilder::View& drawListView) const{
+    if(m_mode == MultiviewMode::Stereo){
+        // The outer planes of both eyes meet behind the camera, as far as half the separation over the tangent of half
+        // the horizontal field of view. Its far plane moves in by as much, which the scene never reaches
+        float pullBack = EYE_SEPARATION / 2.0f * std::abs(projection[0][0]);
+        drawListView.viewProjection = projection * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -pullBack)) * view;
+    }else if(m_mode == MultiviewMode::Cubemap){
+        drawListView.omnidirectional = true;
+        drawListView.eye = glm::vec3(glm::inverse(view)[3]);
+    }
+}
+
+void Multiview::RecordComposite(VkCommandBuffer commandBuffer, VkImage views, VkExtent2D viewExtent, VkImage destination,
+    VkExtent2D destinationExtent) const
+{
+    // The tiles are centered, with the gaps around them cleared before they are copied over
+    uint32_t tilesWidth = std::min(m_columns * viewExtent.width, destinationExtent.width);
+    uint32_t tilesHeight = std::min(m_rows * viewExtent.height, destinationExtent.height);
+    if(tilesWidth != destinationExtent.width || tilesHeight != destinationExtent.height){
+        VkClearColorValue black = {};
+        VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdClearColorImage(commandBuffer, destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &range);
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    int32_t left = static_cast<int32_t>(destinationExtent.width - tilesWidth) / 2;
+    int32_t top = static_cast<int32_t>(destinationExtent.height - tilesHeight) / 2;
+    VkImageCopy regions[MAX_VIEW_COUNT] = {};
+    uint32_t viewCount = GetViewCount();
+    for(uint32_t view = 0; view < viewCount; view++){
+        VkImageCopy& region = regions[view];
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, view, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.dstOffset = {left + static_cast<int32_t>(view % m_columns * viewExtent.width),
+            top + static_cast<int32_t>(view / m_columns * viewExtent.height), 0};
+        region.extent = {viewExtent.width, viewExtent.height, 1};
+    }
+    vkCmdCopyImage(commandBuffer, views, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        viewCount, regions);
+}
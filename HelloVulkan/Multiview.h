@@ -0,0 +1,61 @@
+#pragma once
+
+#include "DrawListBuilder.h"
+#include "VulkanCommon.h"
+
+#include <glm/glm.hpp>
+
+// The views the main pass draws at once
+enum class MultiviewMode{
+    Off,// The camera alone, straight into the window
+    Stereo,// A left and a right eye, side by side
+    Cubemap// The six faces of a cube map around the camera in layer order, +X, -X, +Y, -Y, +Z and -Z, three by two
+};
+
+// Draws the scene from several views in one pass with VK_KHR_multiview. The render pass broadcasts every draw to
+// all views and the vertex shader picks the matrices of its view with gl_ViewIndex, so the draw list is built,
+// recorded and its vertices fetched once for every view instead of once per view. Each view is drawn into its own
+// layer of the scene color and depth targets, of the size of its tile in the window, and copied into the tile
+// once the pass ended
+//
+// Stereo eyes are parallel cameras EYE_SEPARATION apart, culled together by pulling the camera back until its
+// frustum holds both. Cube faces look along the world axes from the camera and are never frustum culled
+class Multiview
+{
+public:
+    static constexpr uint32_t MAX_VIEW_COUNT = 6;
+    // In scene units
+    static constexpr float EYE_SEPARATION = 0.065f;
+
+public:
+    static uint32_t GetViewCount(MultiviewMode mode);
+    // The multiview feature with @viewCount views
+    static bool IsSupported(VkPhysicalDevice physicalDevice, uint32_t viewCount);
+
+    void Create(MultiviewMode mode);
+
+    MultiviewMode GetMode() const { return m_mode; }
+    uint32_t GetViewCount() const { return GetViewCount(m_mode); }
+    // Bit N broadcasts to view N
+    uint32_t GetViewMask() const { return (1u << GetViewCount()) - 1; }
+    // Of each view's tile in a window of @windowExtent, square for cube faces
+    VkExtent2D GetViewExtent(VkExtent2D windowExtent) const;
+    // @fovY for stereo, the quarter turn a cube face covers for cube maps
+    float GetFieldOfView(float fovY) const;
+
+    // The view matrix of each view, from the camera's @view
+    void GetViewMatrices(const glm::mat4& view, glm::mat4 views[MAX_VIEW_COUNT]) const;
+    // Widen @drawListView, set up for the camera's @view and @projection, so it culls nothing any view sees
+    void SetCullingView(const glm::mat4& view, const glm::mat4& projection, DrawListBuilder::View& drawListView) const;
+
+    // Copy each layer of @views, in the transfer source layout and @viewExtent large, into its tile of
+    // @destination, in the transfer destination layout. Whatever no tile covers is cleared
+    void RecordComposite(VkCommandBuffer commandBuffer, VkImage views, VkExtent2D viewExtent, VkImage destination,
+        VkExtent2D destinationExtent) const;
+
+private:
+    MultiviewMode m_mode = MultiviewMode::Off;
+    // Tiles per row and column of the window
+    uint32_t m_columns = 1;
+    uint32_t m_rows = 1;
+};
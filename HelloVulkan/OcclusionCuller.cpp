@@ -0,0 +1,528 @@
+#include "OcclusionCuller.h"
+
+#include "HostAllocator.h"
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+// Matches the CullParams push constants of occlusion_cull.comp
+struct CullParams{
+    glm::mat4 viewProjection;
+    uint32_t depthSize[2];
+    uint32_t levelCount;
+    uint32_t instanceCount;
+    uint32_t listStride;
+    uint32_t late;
+};
+
+static_assert(sizeof(CullParams) <= 128, "Cull parameters must fit the guaranteed push constant space");
+
+// Matches ReduceParams of hiz_reduce.comp
+struct ReduceParams{
+    uint32_t sourceSize[2];
+    uint32_t destinationSize[2];
+};
+
+// Matches Draws of occlusion_cull.comp. The culling passes count the instances up from zero
+struct OcclusionDraws{
+    VkDrawIndexedIndirectCommand early;
+    VkDrawIndexedIndirectCommand late;
+    uint32_t occluded;
+};
+
+// 65535 workgroups a dimension is the least every device takes
+VkExtent2D SplitWorkgroups(uint32_t count){
+    uint32_t x = std::min(count, 65535u);
+    return {x, x == 0 ? 0 : (count + x - 1) / x};
+}
+
+}
+
+bool OcclusionCuller::IsSupported(VkPhysicalDevice physicalDevice){
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    return features.drawIndirectFirstInstance;
+}
+
+VkExtent2D OcclusionCuller::GetPyramidExtent(VkExtent2D depthExtent){
+    return {std::max(depthExtent.width / 2, 1u), std::max(depthExtent.height / 2, 1u)};
+}
+
+uint32_t OcclusionCuller::GetPyramidLevelCount(VkExtent2D depthExtent){
+    VkExtent2D extent = GetPyramidExtent(depthExtent);
+    uint32_t levelCount = 1;
+    for(uint32_t size = std::max(extent.width, extent.height); size > 1; size /= 2) levelCount++;
+    return levelCount;
+}
+
+void OcclusionCuller::Create(VkPhysicalDevice physicalDevice, VkDevice device, VkDescriptorSetLayout sceneSetLayout,
+    const float* boundingRadii, uint32_t objectCount, uint32_t indexCount, uint32_t framesInFlight,
+    const VirtualFileSystem& fileSystem, VkPipelineCache pipelineCache, const UploadFunction& upload)
+{
+    m_physicalDevice = physicalDevice;
+    m_device = device;
+    m_objectCount = objectCount;
+    m_frameCount = framesInFlight;
+    m_fileSystem = &fileSystem;
+    m_pipelineCache = pipelineCache;
+
+    // Texels are fetched by index, the sampler only has to exist
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    ThrowIfFailed(vkCreateSampler(m_device, &samplerInfo, GetAllocationCallbacks(), &m_sampler),
+        "Failed to create occlusion sampler!");
+
+    CreateBuffers(boundingRadii, indexCount, upload);
+    CreateCullDescriptorSets();
+    CreatePipelines(sceneSetLayout);
+}
+
+void OcclusionCuller::Destroy(){
+    ReleasePyramid();
+
+    vkDestroyPipeline(m_device, m_cullPipeline, GetAllocationCallbacks());
+    vkDestroyPipeline(m_device, m_reducePipeline, GetAllocationCallbacks());
+    vkDestroyPipelineLayout(m_device, m_cullPipelineLayout, GetAllocationCallbacks());
+    vkDestroyPipelineLayout(m_device, m_reducePipelineLayout, GetAllocationCallbacks());
+    vkDestroyDescriptorPool(m_device, m_cullDescriptorPool, GetAllocationCallbacks());
+    vkDestroyDescriptorSetLayout(m_device, m_cullSetLayout, GetAllocationCallbacks());
+    vkDestroyDescriptorSetLayout(m_device, m_reduceSetLayout, GetAllocationCallbacks());
+    vkDestroySampler(m_device, m_sampler, GetAllocationCallbacks());
+    for(size_t i = 0; i < m_drawBuffers.size(); i++){
+        vkDestroyBuffer(m_device, m_drawBuffers[i], GetAllocationCallbacks());
+        FreeMemory(m_device, m_drawBuffersMemory[i]);
+    }
+    vkDestroyBuffer(m_device, m_visibilityBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_visibilityBufferMemory);
+    vkDestroyBuffer(m_device, m_radiusBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_radiusBufferMemory);
+
+    m_cullPipeline = VK_NULL_HANDLE;
+    m_reducePipeline = VK_NULL_HANDLE;
+    m_cullPipelineLayout = VK_NULL_HANDLE;
+    m_reducePipelineLayout = VK_NULL_HANDLE;
+    m_cullDescriptorPool = VK_NULL_HANDLE;
+    m_cullSetLayout = VK_NULL_HANDLE;
+    m_reduceSetLayout = VK_NULL_HANDLE;
+    m_sampler = VK_NULL_HANDLE;
+    m_cullDescriptorSets.clear();
+    m_drawBuffers.clear();
+    m_drawBuffersMemory.clear();
+    m_drawBuffersMapped.clear();
+}
+
+void OcclusionCuller::CreateBuffers(const float* boundingRadii, uint32_t indexCount, const UploadFunction& upload){
+    VkDeviceSize size = sizeof(float) * std::max(m_objectCount, 1u);
+    CreateBuffer(m_physicalDevice, m_device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_radiusBuffer, m_radiusBufferMemory);
+    if(m_objectCount > 0) upload(boundingRadii, sizeof(float) * m_objectCount, m_radiusBuffer);
+
+    // Nothing was visible before the first frame, it draws everything in the late phase
+    std::vector<uint32_t> visibility(std::max(m_objectCount, 1u), 0);
+    CreateBuffer(m_physicalDevice, m_device, sizeof(uint32_t) * visibility.size(),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_visibilityBuffer, m_visibilityBufferMemory);
+    upload(visibility.data(), sizeof(uint32_t) * visibility.size(), m_visibilityBuffer);
+
+    // The early list starts one stride into the draw list region, the late list two
+    OcclusionDraws draws = {};
+    draws.early.indexCount = indexCount;
+    draws.early.firstInstance = m_objectCount;
+    draws.late.indexCount = indexCount;
+    draws.late.firstInstance = 2 * m_objectCount;
+
+    m_drawBuffers.resize(m_frameCount);
+    m_drawBuffersMemory.resize(m_frameCount);
+    m_drawBuffersMapped.resize(m_frameCount);
+    for(uint32_t i = 0; i < m_frameCount; i++){
+        CreateBuffer(m_physicalDevice, m_device, sizeof(OcclusionDraws),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_drawBuffers[i], m_drawBuffersMemory[i]);
+        ThrowIfFailed(vkMapMemory(m_device, m_drawBuffersMemory[i], 0, VK_WHOLE_SIZE, 0, &m_drawBuffersMapped[i]),
+            "Failed to map occlusion draw buffer!");
+        memcpy(m_drawBuffersMapped[i], &draws, sizeof(draws));
+    }
+}
+
+void OcclusionCuller::CreateCullDescriptorSets(){
+    // 0: bounding radii, 1: visibility, 2: draws, 3: the pyramid
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
+    for(uint32_t i = 0; i < bindings.size(); i++){
+        bindings[i].binding = i;
+        bindings[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &layoutInfo, GetAllocationCallbacks(), &m_cullSetLayout),
+        "Failed to create occlusion descriptor set layout!");
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 3 * m_frameCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = m_frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = m_frameCount;
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_cullDescriptorPool),
+        "Failed to create occlusion descriptor pool!");
+
+    std::vector<VkDescriptorSetLayout> layouts(m_frameCount, m_cullSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_cullDescriptorPool;
+    allocInfo.descriptorSetCount = m_frameCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_cullDescriptorSets.resize(m_frameCount);
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, m_cullDescriptorSets.data()),
+        "Failed to allocate occlusion descriptor sets!");
+
+    // The pyramid is written by SetPyramid
+    for(uint32_t i = 0; i < m_frameCount; i++){
+        std::array<VkDescriptorBufferInfo, 3> bufferInfos = {};
+        bufferInfos[0].buffer = m_radiusBuffer;
+        bufferInfos[1].buffer = m_visibilityBuffer;
+        bufferInfos[2].buffer = m_drawBuffers[i];
+        for(auto& bufferInfo: bufferInfos){
+            bufferInfo.offset = 0;
+            bufferInfo.range = VK_WHOLE_SIZE;
+        }
+
+        std::array<VkWriteDescriptorSet, 3> writes = {};
+        for(uint32_t j = 0; j < writes.size(); j++){
+            writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[j].dstSet = m_cullDescriptorSets[i];
+            writes[j].dstBinding = j;
+            writes[j].dstArrayElement = 0;
+            writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[j].descriptorCount = 1;
+            writes[j].pBufferInfo = &bufferInfos[j];
+        }
+
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void OcclusionCuller::CreatePipelines(VkDescriptorSetLayout sceneSetLayout){
+    // 0: the level read, 1: the level written
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1] = bindings[0];
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &layoutInfo, GetAllocationCallbacks(), &m_reduceSetLayout),
+        "Failed to create depth pyramid descriptor set layout!");
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ReduceParams);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_reduceSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, GetAllocationCallbacks(), &m_reducePipelineLayout),
+        "Failed to create depth pyramid pipeline layout!");
+
+    VkDescriptorSetLayout setLayouts[] = {sceneSetLayout, m_cullSetLayout};
+    pushConstantRange.size = sizeof(CullParams);
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, GetAllocationCallbacks(), &m_cullPipelineLayout),
+        "Failed to create occlusion pipeline layout!");
+
+    Asset reduceShaderCode = m_fileSystem->Open("shaders/hiz_reduce_comp.spv");
+    Asset cullShaderCode = m_fileSystem->Open("shaders/occlusion_cull_comp.spv");
+    VkShaderModule reduceShaderModule = CreateShaderModule(m_device, reduceShaderCode.GetBytes());
+    VkShaderModule cullShaderModule = CreateShaderModule(m_device, cullShaderCode.GetBytes());
+
+    std::array<VkComputePipelineCreateInfo, 2> pipelineInfos = {};
+    VkShaderModule modules[2] = {reduceShaderModule, cullShaderModule};
+    VkPipelineLayout pipelineLayouts[2] = {m_reducePipelineLayout, m_cullPipelineLayout};
+    for(uint32_t i = 0; i < pipelineInfos.size(); i++){
+        pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfos[i].stage.module = modules[i];
+        pipelineInfos[i].stage.pName = "main";
+        pipelineInfos[i].layout = pipelineLayouts[i];
+    }
+
+    VkPipeline pipelines[2];
+    ThrowIfFailed(vkCreateComputePipelines(m_device, m_pipelineCache, static_cast<uint32_t>(pipelineInfos.size()),
+        pipelineInfos.data(), GetAllocationCallbacks(), pipelines), "Failed to create occlusion pipelines!");
+    m_reducePipeline = pipelines[0];
+    m_cullPipeline = pipelines[1];
+
+    for(VkShaderModule shaderModule: modules) vkDestroyShaderModule(m_device, shaderModule, GetAllocationCallbacks());
+}
+
+void OcclusionCuller::SetPyramid(VkImage pyramid, VkImageView pyramidView, VkExtent2D depthExtent,
+    const std::vector<VkImageView>& depthViews)
+{
+    ReleasePyramid();
+    m_pyramid = pyramid;
+    m_depthExtent = depthExtent;
+    m_depthViewCount = static_cast<uint32_t>(depthViews.size());
+    uint32_t levelCount = GetPyramidLevelCount(depthExtent);
+
+    // A view per level, each read by the next reduction and written by its own
+    m_pyramidLevelViews.resize(levelCount);
+    for(uint32_t level = 0; level < levelCount; level++){
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = pyramid;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = PYRAMID_FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        ThrowIfFailed(vkCreateImageView(m_device, &viewInfo, GetAllocationCallbacks(), &m_pyramidLevelViews[level]),
+            "Failed to create depth pyramid level view!");
+    }
+
+    uint32_t setCount = m_depthViewCount + levelCount - 1;
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_reduceDescriptorPool),
+        "Failed to create depth pyramid descriptor pool!");
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, m_reduceSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_reduceDescriptorPool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_reduceDescriptorSets.resize(setCount);
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, m_reduceDescriptorSets.data()),
+        "Failed to allocate depth pyramid descriptor sets!");
+
+    // Levels already reduced are read in the general layout they were written in
+    for(uint32_t i = 0; i < setCount; i++){
+        bool fromDepth = i < m_depthViewCount;
+        uint32_t level = fromDepth ? 0 : i - m_depthViewCount + 1;
+
+        VkDescriptorImageInfo sourceInfo = {};
+        sourceInfo.sampler = m_sampler;
+        sourceInfo.imageView = fromDepth ? depthViews[i] : m_pyramidLevelViews[level - 1];
+        sourceInfo.imageLayout = fromDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        VkDescriptorImageInfo destinationInfo = {};
+        destinationInfo.imageView = m_pyramidLevelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> writes = {};
+        for(uint32_t j = 0; j < writes.size(); j++){
+            writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[j].dstSet = m_reduceDescriptorSets[i];
+            writes[j].dstBinding = j;
+            writes[j].dstArrayElement = 0;
+            writes[j].descriptorCount = 1;
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &sourceInfo;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &destinationInfo;
+
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    VkDescriptorImageInfo pyramidInfo = {};
+    pyramidInfo.sampler = m_sampler;
+    pyramidInfo.imageView = pyramidView;
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    for(VkDescriptorSet descriptorSet: m_cullDescriptorSets){
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSet;
+        write.dstBinding = 3;
+        write.dstArrayElement = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.descriptorCount = 1;
+        write.pImageInfo = &pyramidInfo;
+        vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+    }
+}
+
+void OcclusionCuller::ReleasePyramid(){
+    if(m_device == VK_NULL_HANDLE) return;
+    vkDestroyDescriptorPool(m_device, m_reduceDescriptorPool, GetAllocationCallbacks());
+    for(VkImageView view: m_pyramidLevelViews) vkDestroyImageView(m_device, view, GetAllocationCallbacks());
+    m_reduceDescriptorPool = VK_NULL_HANDLE;
+    m_reduceDescriptorSets.clear();
+    m_pyramidLevelViews.clear();
+    m_pyramid = VK_NULL_HANDLE;
+    m_depthViewCount = 0;
+}
+
+OcclusionStats OcclusionCuller::BeginFrame(uint32_t frame){
+    OcclusionDraws draws;
+    memcpy(&draws, m_drawBuffersMapped[frame], sizeof(draws));
+    OcclusionStats stats = {draws.early.instanceCount + draws.late.instanceCount, draws.occluded};
+
+    draws.early.instanceCount = 0;
+    draws.late.instanceCount = 0;
+    draws.occluded = 0;
+    memcpy(m_drawBuffersMapped[frame], &draws, sizeof(draws));
+    return stats;
+}
+
+void OcclusionCuller::RecordEarlyCull(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet,
+    const uint32_t* sceneDynamicOffsets, uint32_t sceneDynamicOffsetCount, uint32_t instanceCount, Telemetry* telemetry) const
+{
+    // The late phase of the frame before wrote the visibility read here
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_visibilityBuffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    RecordCull(commandBuffer, frame, sceneSet, sceneDynamicOffsets, sceneDynamicOffsetCount, glm::mat4(1.0f), instanceCount, false);
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::PipelineBinds);
+}
+
+void OcclusionCuller::RecordLateCull(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet,
+    const uint32_t* sceneDynamicOffsets, uint32_t sceneDynamicOffsetCount, const glm::mat4& viewProjection, uint32_t instanceCount,
+    Telemetry* telemetry) const
+{
+    RecordCull(commandBuffer, frame, sceneSet, sceneDynamicOffsets, sceneDynamicOffsetCount, viewProjection, instanceCount, true);
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::PipelineBinds);
+
+    // The fence alone does not make the counts visible to BeginFrame
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_drawBuffers[frame];
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void OcclusionCuller::RecordCull(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet,
+    const uint32_t* sceneDynamicOffsets, uint32_t sceneDynamicOffsetCount, const glm::mat4& viewProjection, uint32_t instanceCount,
+    bool late) const
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout,
+        0, 1, &sceneSet, sceneDynamicOffsetCount, sceneDynamicOffsets);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout,
+        1, 1, &m_cullDescriptorSets[frame], 0, nullptr);
+
+    CullParams params = {};
+    params.viewProjection = viewProjection;
+    params.depthSize[0] = m_depthExtent.width;
+    params.depthSize[1] = m_depthExtent.height;
+    params.levelCount = static_cast<uint32_t>(m_pyramidLevelViews.size());
+    params.instanceCount = std::min(instanceCount, m_objectCount);
+    params.listStride = m_objectCount;
+    params.late = late ? 1 : 0;
+    vkCmdPushConstants(commandBuffer, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+    VkExtent2D workgroups = SplitWorkgroups((params.instanceCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE);
+    if(workgroups.width > 0) vkCmdDispatch(commandBuffer, workgroups.width, workgroups.height, 1);
+}
+
+void OcclusionCuller::RecordPyramid(VkCommandBuffer commandBuffer, uint32_t depthIndex, Telemetry* telemetry) const{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reducePipeline);
+
+    VkExtent2D source = m_depthExtent;
+    VkExtent2D destination = GetPyramidExtent(m_depthExtent);
+    for(uint32_t level = 0; level < m_pyramidLevelViews.size(); level++){
+        // Each level reads the one reduced before it
+        if(level > 0){
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = m_pyramid;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 1, 0, 1};
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        VkDescriptorSet descriptorSet = level == 0 ? m_reduceDescriptorSets[depthIndex] : m_reduceDescriptorSets[m_depthViewCount + level - 1];
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reducePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+        ReduceParams params = {{source.width, source.height}, {destination.width, destination.height}};
+        vkCmdPushConstants(commandBuffer, m_reducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(commandBuffer, (destination.width + REDUCE_WORKGROUP_SIZE - 1) / REDUCE_WORKGROUP_SIZE,
+            (destination.height + REDUCE_WORKGROUP_SIZE - 1) / REDUCE_WORKGROUP_SIZE, 1);
+
+        source = destination;
+        destination = {std::max(destination.width / 2, 1u), std::max(destination.height / 2, 1u)};
+    }
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::PipelineBinds);
+}
+
+void OcclusionCuller::RecordEarlyDraw(VkCommandBuffer commandBuffer, uint32_t frame, Telemetry* telemetry) const{
+    vkCmdDrawIndexedIndirect(commandBuffer, m_drawBuffers[frame], offsetof(OcclusionDraws, early), 1, sizeof(VkDrawIndexedIndirectCommand));
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::DrawCalls);
+}
+
+void OcclusionCuller::RecordLateDraw(VkCommandBuffer commandBuffer, uint32_t frame, Telemetry* telemetry) const{
+    vkCmdDrawIndexedIndirect(commandBuffer, m_drawBuffers[frame], offsetof(OcclusionDraws, late), 1, sizeof(VkDrawIndexedIndirectCommand));
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::DrawCalls);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+class Telemetry;
+
+// Two-phase occlusion culling against a hierarchical depth buffer. The early phase draws the objects that were
+// visible last frame, the depth they leave is reduced into a pyramid where every texel holds the farthest depth of
+// the pixels under it, and the late phase tests every object against that pyramid. Objects that turn out visible
+// and were not drawn early are drawn in the late phase, and the visibility is kept for the next frame.
+//
+// Both phases read the object matrices (binding 2) and the draw list (binding 3) through set 0, the scene set of the
+// caller. The draw list region of a frame holds three lists of listStride entries: the objects that passed the
+// frustum test, written by the host, then the early and the late objects written by the culling passes. Each phase
+// is drawn with one indexed indirect draw of the scene mesh, starting at the instance its list starts at
+struct OcclusionStats{
+    uint32_t drawn;
+    uint32_t occluded;
+};
+
+class OcclusionCuller
+{
+public:
+    // Records a copy of @size bytes from @data into @buffer ahead of the first frame
+    using UploadFunction = std::function<void(const void* data, VkDeviceSize size, VkBuffer buffer)>;
+
+    static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;// occlusion_cull.comp
+    static constexpr uint32_t REDUCE_WORKGROUP_SIZE = 8;// hiz_reduce.comp, in both dimensions
+    static constexpr VkFormat PYRAMID_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+public:
+    // The late draw starts past the frustum and early lists, which needs indirect draws with a first instance
+    static bool IsSupported(VkPhysicalDevice physicalDevice);
+    // Level 0 of the pyramid has half the size of a depth buffer of @depthExtent, rounded down
+    static VkExtent2D GetPyramidExtent(VkExtent2D depthExtent);
+    static uint32_t GetPyramidLevelCount(VkExtent2D depthExtent);
+
+    // Culls up to @objectCount objects, each bounded by a sphere of @boundingRadii around its origin before scaling,
+    // and draws them as @indexCount indices of the scene mesh. @sceneSetLayout must make the object matrices and the
+    // draw list visible to compute shaders. Shaders are loaded from @fileSystem
+    void Create(VkPhysicalDevice physicalDevice, VkDevice device, VkDescriptorSetLayout sceneSetLayout, const float* boundingRadii,
+        uint32_t objectCount, uint32_t indexCount, uint32_t framesInFlight, const VirtualFileSystem& fileSystem,
+        VkPipelineCache pipelineCache, const UploadFunction& upload);
+    void Destroy();
+
+    // Build the pyramid into @pyramid, an image of PYRAMID_FORMAT with every level of GetPyramidLevelCount, from
+    // the depth images behind @depthViews. Both follow the swap chain, call again once they were recreated
+    void SetPyramid(VkImage pyramid, VkImageView pyramidView, VkExtent2D depthExtent, const std::vector<VkImageView>& depthViews);
+    void ReleasePyramid();
+
+    // Entries of each list in the draw list region
+    uint32_t GetListStride() const { return m_objectCount; }
+    VkBuffer GetVisibilityBuffer() const { return m_visibilityBuffer; }
+    // The indirect draws of both phases of @frame with the count of occluded objects, written by the culling passes
+    VkBuffer GetDrawBuffer(uint32_t frame) const { return m_drawBuffers[frame]; }
+    // Once the fence of the last frame in slot @frame was waited on: what it drew and culled, then its counts are
+    // cleared for the next frame in that slot
+    OcclusionStats BeginFrame(uint32_t frame);
+
+    // Outside a render pass: the early phase of @instanceCount objects of the frustum list of @frame. @sceneSet is
+    // bound with @sceneDynamicOffsets
+    void RecordEarlyCull(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet, const uint32_t* sceneDynamicOffsets,
+        uint32_t sceneDynamicOffsetCount, uint32_t instanceCount, Telemetry* telemetry = nullptr) const;
+    // Reduce the depth image behind depth view @depthIndex level by level. Level 0 reads it in the depth stencil
+    // read-only layout, the pyramid must be in the general layout
+    void RecordPyramid(VkCommandBuffer commandBuffer, uint32_t depthIndex, Telemetry* telemetry = nullptr) const;
+    // The late phase against the pyramid, which must be in the shader read-only layout
+    void RecordLateCull(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet, const uint32_t* sceneDynamicOffsets,
+        uint32_t sceneDynamicOffsetCount, const glm::mat4& viewProjection, uint32_t instanceCount, Telemetry* telemetry = nullptr) const;
+    // Inside the render pass, with the scene pipeline, its set, the vertex and the index buffer bound
+    void RecordEarlyDraw(VkCommandBuffer commandBuffer, uint32_t frame, Telemetry* telemetry = nullptr) const;
+    void RecordLateDraw(VkCommandBuffer commandBuffer, uint32_t frame, Telemetry* telemetry = nullptr) const;
+
+private:
+    void CreateBuffers(const float* boundingRadii, uint32_t indexCount, const UploadFunction& upload);
+    void CreateCullDescriptorSets();
+    void CreatePipelines(VkDescriptorSetLayout sceneSetLayout);
+    void RecordCull(VkCommandBuffer commandBuffer, uint32_t frame, VkDescriptorSet sceneSet, const uint32_t* sceneDynamicOffsets,
+        uint32_t sceneDynamicOffsetCount, const glm::mat4& viewProjection, uint32_t instanceCount, bool late) const;
+
+private:
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_objectCount = 0;
+    uint32_t m_frameCount = 0;
+    const VirtualFileSystem* m_fileSystem = nullptr;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+
+    // Scaled by the world matrix in the shader like DrawListBuilder does on the host
+    VkBuffer m_radiusBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_radiusBufferMemory = VK_NULL_HANDLE;
+    // One word per object, nonzero when the object passed the late phase of the last frame
+    VkBuffer m_visibilityBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_visibilityBufferMemory = VK_NULL_HANDLE;
+    // Persistently mapped per frame in flight, the counts are read and cleared by the host
+    std::vector<VkBuffer> m_drawBuffers;
+    std::vector<VkDeviceMemory> m_drawBuffersMemory;
+    std::vector<void*> m_drawBuffersMapped;
+
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    // Set 1 of the culling passes, one per frame in flight
+    VkDescriptorSetLayout m_cullSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_cullDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_cullDescriptorSets;
+    VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+
+    // A source and a destination level per reduction: level 0 from each depth view, then level i from level i - 1
+    VkDescriptorSetLayout m_reduceSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_reducePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_reducePipeline = VK_NULL_HANDLE;
+
+    // Follow the swap chain
+    VkImage m_pyramid = VK_NULL_HANDLE;
+    VkExtent2D m_depthExtent = {0, 0};
+    std::vector<VkImageView> m_pyramidLevelViews;
+    VkDescriptorPool m_reduceDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_reduceDescriptorSets;// Level 0 of every depth view first
+    uint32_t m_depthViewCount = 0;
+};
@@ -0,0 +1,407 @@
+#include "ParticleSystem.h"
+
+#include "HostAllocator.h"
+#include "Telemetry.h"
+
+#include <array>
+#include <cstddef>
+
+namespace {
+
+// Matches the push constant block in particle.comp
+struct SimulationParams{
+    float deltaTime;
+    uint32_t particleCount;
+    uint32_t reset;
+};
+
+constexpr uint32_t WORKGROUP_SIZE = 256;
+
+}
+
+void ParticleSystem::Create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsFamily, uint32_t computeFamily,
+    VkQueue computeQueue, uint32_t framesInFlight, const VirtualFileSystem& fileSystem, VkPipelineCache pipelineCache)
+{
+    m_physicalDevice = physicalDevice;
+    m_device = device;
+    m_graphicsFamily = graphicsFamily;
+    m_computeFamily = computeFamily;
+    m_computeQueue = computeQueue;
+    m_slotCount = framesInFlight + 1;
+    m_fileSystem = &fileSystem;
+    m_pipelineCache = pipelineCache;
+
+    CreateBuffers();
+    CreateDescriptorSets();
+    CreateComputePipeline();
+    CreateCommandBuffers();
+    CreateSyncObjects();
+}
+
+void ParticleSystem::Destroy(){
+    DestroyGraphicsPipeline();
+
+    for(auto& semaphore: m_simulationFinishedSemaphores) vkDestroySemaphore(m_device, semaphore, GetAllocationCallbacks());
+    vkDestroyCommandPool(m_device, m_commandPool, GetAllocationCallbacks());
+    vkDestroyPipeline(m_device, m_computePipeline, GetAllocationCallbacks());
+    vkDestroyPipelineLayout(m_device, m_computePipelineLayout, GetAllocationCallbacks());
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, GetAllocationCallbacks());
+    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, GetAllocationCallbacks());
+    for(uint32_t i = 0; i < m_slotCount; i++){
+        vkDestroyBuffer(m_device, m_particleBuffers[i], GetAllocationCallbacks());
+        FreeMemory(m_device, m_particleBuffersMemory[i]);
+    }
+
+    m_simulationFinishedSemaphores.clear();
+    m_commandBuffers.clear();
+    m_descriptorSets.clear();
+    m_particleBuffers.clear();
+    m_particleBuffersMemory.clear();
+}
+
+void ParticleSystem::CreateBuffers(){
+    VkDeviceSize bufferSize = sizeof(Particle) * PARTICLE_COUNT;
+
+    m_particleBuffers.resize(m_slotCount);
+    m_particleBuffersMemory.resize(m_slotCount);
+
+    // Written by the compute queue and read as vertices by the graphics queue. Sharing them concurrently
+    // avoids queue family ownership transfers when the two families differ
+    for(uint32_t i = 0; i < m_slotCount; i++){
+        CreateBuffer(m_physicalDevice, m_device, bufferSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_particleBuffers[i], m_particleBuffersMemory[i],
+            {m_graphicsFamily, m_computeFamily});
+    }
+}
+
+void ParticleSystem::CreateDescriptorSets(){
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+    for(uint32_t i = 0; i < bindings.size(); i++){
+        bindings[i].binding = i;// 0: particles of the previous step, 1: particles of this step
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    ThrowIfFailed(vkCreateDescriptorSetLayout(m_device, &layoutInfo, GetAllocationCallbacks(), &m_descriptorSetLayout),
+        "Failed to create particle descriptor set layout!");
+
+    VkDescriptorPoolSize poolSize = {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 2 * m_slotCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = m_slotCount;
+
+    ThrowIfFailed(vkCreateDescriptorPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_descriptorPool),
+        "Failed to create particle descriptor pool!");
+
+    std::vector<VkDescriptorSetLayout> layouts(m_slotCount, m_descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = m_slotCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_descriptorSets.resize(m_slotCount);
+    ThrowIfFailed(vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()),
+        "Failed to allocate particle descriptor sets!");
+
+    // The step of slot i advances the particles of the slot before it
+    for(uint32_t i = 0; i < m_slotCount; i++){
+        std::array<VkDescriptorBufferInfo, 2> bufferInfos = {};
+        bufferInfos[0].buffer = m_particleBuffers[(i + m_slotCount - 1) % m_slotCount];
+        bufferInfos[0].offset = 0;
+        bufferInfos[0].range = VK_WHOLE_SIZE;
+        bufferInfos[1].buffer = m_particleBuffers[i];
+        bufferInfos[1].offset = 0;
+        bufferInfos[1].range = VK_WHOLE_SIZE;
+
+        std::array<VkWriteDescriptorSet, 2> writes = {};
+        for(uint32_t j = 0; j < writes.size(); j++){
+            writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[j].dstSet = m_descriptorSets[i];
+            writes[j].dstBinding = j;
+            writes[j].dstArrayElement = 0;
+            writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[j].descriptorCount = 1;
+            writes[j].pBufferInfo = &bufferInfos[j];
+        }
+
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void ParticleSystem::CreateComputePipeline(){
+    Asset compShaderCode = m_fileSystem->Open("shaders/particle_comp.spv");
+    VkShaderModule compShaderModule = CreateShaderModule(m_device, compShaderCode.GetBytes());
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(SimulationParams);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, GetAllocationCallbacks(), &m_computePipelineLayout),
+        "Failed to create particle compute pipeline layout!");
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_computePipelineLayout;
+
+    ThrowIfFailed(vkCreateComputePipelines(m_device, m_pipelineCache, 1, &pipelineInfo, GetAllocationCallbacks(), &m_computePipeline),
+        "Failed to create particle compute pipeline!");
+
+    vkDestroyShaderModule(m_device, compShaderModule, GetAllocationCallbacks());
+}
+
+void ParticleSystem::CreateCommandBuffers(){
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = m_computeFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;// Re-recorded every step for the new delta time
+
+    ThrowIfFailed(vkCreateCommandPool(m_device, &poolInfo, GetAllocationCallbacks(), &m_commandPool),
+        "Failed to create particle command pool!");
+
+    m_commandBuffers.resize(m_slotCount);
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = m_slotCount;
+
+    ThrowIfFailed(vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data()),
+        "Failed to allocate particle command buffers!");
+}
+
+void ParticleSystem::CreateSyncObjects(){
+    m_simulationFinishedSemaphores.resize(m_slotCount);
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for(uint32_t i = 0; i < m_slotCount; i++){
+        ThrowIfFailed(vkCreateSemaphore(m_device, &semaphoreInfo, GetAllocationCallbacks(), &m_simulationFinishedSemaphores[i]),
+            "Failed to create particle semaphore!");
+    }
+}
+
+void ParticleSystem::CreateGraphicsPipeline(const RenderTarget& target){
+    Asset vertShaderCode = m_fileSystem->Open("shaders/particle_vert.spv");
+    Asset fragShaderCode = m_fileSystem->Open("shaders/particle_frag.spv");
+
+    VkShaderModule vertShaderModule = CreateShaderModule(m_device, vertShaderCode.GetBytes());
+    VkShaderModule fragShaderModule = CreateShaderModule(m_device, fragShaderCode.GetBytes());
+
+    VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    // The storage buffer written by the simulation is consumed directly as the vertex buffer
+    VkVertexInputBindingDescription bindingDesc = {};
+    bindingDesc.binding = 0;
+    bindingDesc.stride = sizeof(Particle);
+    bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    std::array<VkVertexInputAttributeDescription, 2> attributeDescs = {};
+    attributeDescs[0].binding = 0;
+    attributeDescs[0].location = 0;
+    attributeDescs[0].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescs[0].offset = offsetof(Particle, position);
+    attributeDescs[1].binding = 0;
+    attributeDescs[1].location = 1;
+    attributeDescs[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescs[1].offset = offsetof(Particle, color);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescs.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescs.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
+    inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+    // Set when the main pass begins, at the size it draws at
+    VkPipelineViewportStateCreateInfo viewportInfo = {};
+    viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportInfo.viewportCount = 1;
+    viewportInfo.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizerInfo = {};
+    rasterizerInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizerInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizerInfo.lineWidth = 1.0f;
+    rasterizerInfo.cullMode = VK_CULL_MODE_NONE;
+    rasterizerInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisamplingInfo = {};
+    multisamplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisamplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisamplingInfo.minSampleShading = 1.0f;
+
+    // Particles lie in screen space over the scene, the depth attachment of the render pass is left alone
+    VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {};
+    depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilInfo.depthTestEnable = VK_FALSE;
+    depthStencilInfo.depthWriteEnable = VK_FALSE;
+    depthStencilInfo.maxDepthBounds = 1.0f;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT |
+        VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT |
+        VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {};
+    colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendInfo.logicOpEnable = VK_FALSE;
+    colorBlendInfo.attachmentCount = 1;
+    colorBlendInfo.pAttachments = &colorBlendAttachment;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+    ThrowIfFailed(vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, GetAllocationCallbacks(), &m_graphicsPipelineLayout),
+        "Failed to create particle pipeline layout!");
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
+    pipelineInfo.pViewportState = &viewportInfo;
+    pipelineInfo.pDynamicState = &GetViewportDynamicState();
+    pipelineInfo.pRasterizationState = &rasterizerInfo;
+    pipelineInfo.pMultisampleState = &multisamplingInfo;
+    pipelineInfo.pDepthStencilState = &depthStencilInfo;
+    pipelineInfo.pColorBlendState = &colorBlendInfo;
+    pipelineInfo.layout = m_graphicsPipelineLayout;
+    VkPipelineRenderingCreateInfo renderingInfo;
+    SetPipelineTarget(pipelineInfo, target, renderingInfo);
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    ThrowIfFailed(vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, GetAllocationCallbacks(), &m_graphicsPipeline),
+        "Failed to create particle graphics pipeline!");
+
+    vkDestroyShaderModule(m_device, fragShaderModule, GetAllocationCallbacks());
+    vkDestroyShaderModule(m_device, vertShaderModule, GetAllocationCallbacks());
+}
+
+void ParticleSystem::DestroyGraphicsPipeline(){
+    vkDestroyPipeline(m_device, m_graphicsPipeline, GetAllocationCallbacks());
+    vkDestroyPipelineLayout(m_device, m_graphicsPipelineLayout, GetAllocationCallbacks());
+    m_graphicsPipeline = VK_NULL_HANDLE;
+    m_graphicsPipelineLayout = VK_NULL_HANDLE;
+}
+
+void ParticleSystem::SubmitSimulation(uint64_t frameNumber, float deltaTime, bool reset, Telemetry* telemetry){
+    // Slot reuse is safe without a fence of our own: the step of frame N+1 is submitted after the host
+    // waited for graphics frame N+1-framesInFlight, which itself waited on the last step using this slot
+    uint32_t slot = SlotOf(frameNumber);
+    VkCommandBuffer commandBuffer = m_commandBuffers[slot];
+
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    ThrowIfFailed(vkBeginCommandBuffer(commandBuffer, &beginInfo),
+        "Failed to begin recording particle command buffer!");
+
+    // The previous step was submitted to this same queue, so a barrier is enough to see its writes
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_particleBuffers[(slot + m_slotCount - 1) % m_slotCount];
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout,
+        0, 1, &m_descriptorSets[slot], 0, nullptr);
+
+    // A reset seeds the particles instead of reading the previous buffer, uninitialized before the very first step
+    SimulationParams params = {};
+    params.deltaTime = deltaTime;
+    params.particleCount = PARTICLE_COUNT;
+    params.reset = reset ? 1 : 0;
+    vkCmdPushConstants(commandBuffer, m_computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+    vkCmdDispatch(commandBuffer, (PARTICLE_COUNT + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    ThrowIfFailed(vkEndCommandBuffer(commandBuffer),
+        "Failed to record particle command buffer!");
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_simulationFinishedSemaphores[slot];
+
+    ThrowIfFailed(vkQueueSubmit(m_computeQueue, 1, &submitInfo, VK_NULL_HANDLE),
+        "Failed to submit particle command buffer!");
+    if(telemetry != nullptr){
+        telemetry->Count(TelemetryCounter::PipelineBinds);
+        telemetry->Count(TelemetryCounter::QueueSubmits);
+    }
+}
+
+VkSemaphore ParticleSystem::GetSimulationFinishedSemaphore(uint64_t frameNumber) const{
+    return m_simulationFinishedSemaphores[SlotOf(frameNumber)];
+}
+
+void ParticleSystem::RecordDraw(VkCommandBuffer commandBuffer, uint64_t frameNumber, Telemetry* telemetry) const{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+
+    VkBuffer vertexBuffers[] = {m_particleBuffers[SlotOf(frameNumber)]};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+    vkCmdDraw(commandBuffer, PARTICLE_COUNT, 1, 0, 0);
+    if(telemetry != nullptr){
+        telemetry->Count(TelemetryCounter::PipelineBinds);
+        telemetry->Count(TelemetryCounter::DrawCalls);
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <vector>
+
+class Telemetry;
+
+// A GPU particle simulation running on the async compute queue. The step producing the particles of
+// frame N+1 is submitted right after the graphics work of frame N, so on hardware with a dedicated
+// compute queue the two overlap. Graphics frame N waits on the simulation semaphore of frame N at the
+// vertex input stage and draws the particles straight from the storage buffer the step wrote.
+class ParticleSystem
+{
+public:
+    // Matches the std430 layout of the Particle struct in particle.comp
+    struct Particle{
+        float position[2];
+        float velocity[2];
+        float color[4];
+    };
+
+    static constexpr uint32_t PARTICLE_COUNT = 8192;
+
+public:
+    // @framesInFlight is the number of frames the graphics side may have queued. One more buffer than
+    // that is kept so a step never overwrites particles a queued frame still draws. Shaders are loaded
+    // from @fileSystem, which must outlive the particle system
+    void Create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsFamily, uint32_t computeFamily,
+        VkQueue computeQueue, uint32_t framesInFlight, const VirtualFileSystem& fileSystem, VkPipelineCache pipelineCache);
+    void Destroy();
+
+    // The draw pipeline depends on the formats of the render target, so it follows the swap chain. Viewport and
+    // scissor are dynamic
+    void CreateGraphicsPipeline(const RenderTarget& target);
+    void DestroyGraphicsPipeline();
+
+    // Record and submit the simulation step producing the particles drawn by frame @frameNumber. With @reset the step
+    // seeds the particles instead of advancing the previous ones, the first step must. Its calls are counted in
+    // @telemetry when given, likewise for RecordDraw
+    void SubmitSimulation(uint64_t frameNumber, float deltaTime, bool reset, Telemetry* telemetry = nullptr);
+    // Semaphore signaled once the particles of frame @frameNumber are ready to be drawn
+    VkSemaphore GetSimulationFinishedSemaphore(uint64_t frameNumber) const;
+    // Storage buffer holding the particles of frame @frameNumber
+    VkBuffer GetParticleBuffer(uint64_t frameNumber) const { return m_particleBuffers[SlotOf(frameNumber)]; }
+    // Draw the particles of frame @frameNumber as points inside the current render pass
+    void RecordDraw(VkCommandBuffer commandBuffer, uint64_t frameNumber, Telemetry* telemetry = nullptr) const;
+
+private:
+    void CreateBuffers();
+    void CreateDescriptorSets();
+    void CreateComputePipeline();
+    void CreateCommandBuffers();
+    void CreateSyncObjects();
+
+    uint32_t SlotOf(uint64_t frameNumber) const { return static_cast<uint32_t>(frameNumber % m_slotCount); }
+
+private:
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_graphicsFamily = 0;
+    uint32_t m_computeFamily = 0;
+    VkQueue m_computeQueue = VK_NULL_HANDLE;
+    uint32_t m_slotCount = 0;
+    const VirtualFileSystem* m_fileSystem = nullptr;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+
+    // One particle buffer, descriptor set, command buffer and semaphore per slot
+    std::vector<VkBuffer> m_particleBuffers;
+    std::vector<VkDeviceMemory> m_particleBuffersMemory;
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_descriptorSets;
+    VkPipelineLayout m_computePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_computePipeline = VK_NULL_HANDLE;
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> m_commandBuffers;
+    std::vector<VkSemaphore> m_simulationFinishedSemaphores;
+
+    VkPipelineLayout m_graphicsPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
+};
@@ -0,0 +1,345 @@
+// Compares the results HelloVulkan writes with --benchmark against a stored baseline, failing on regressions. The
+// baseline is a JSON object like
+//
+//   {"scene": {...}, "tolerance": 0.15, "tolerances": {"frameTime.p95Ms": 0.3}, "metrics": {"frameTime.meanMs": 1.2, ...}}
+//
+// where every metric is a dotted path into the results and lower is better. A metric regresses when it grows by more
+// than its tolerance, a fraction of the baseline, plus "minimumDelta" to keep tiny timings from flapping. --tolerance
+// replaces the baseline's "tolerance" for one run, per metric tolerances still apply
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+static const char* USAGE =
+    "Usage: PerfCompare [--tolerance <fraction>] <results.json> <baseline.json>\n"
+    "       PerfCompare --update <results.json> <baseline.json>";
+
+namespace
+{
+    constexpr double DEFAULT_TOLERANCE = 0.15;
+    constexpr double DEFAULT_MINIMUM_DELTA = 0.05;
+
+    // A JSON document flattened to its leaves, keyed by the dotted path to each. Array elements use their index
+    struct FlatJson
+    {
+        std::map<std::string, double> numbers;
+        std::map<std::string, std::string> strings;
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const std::string& text, const std::string& path) : m_text(text), m_path(path) {}
+
+        FlatJson Parse()
+        {
+            FlatJson json;
+            ParseValue(json, "");
+            SkipSpace();
+            if (m_offset != m_text.size()) Fail();
+            return json;
+        }
+
+    private:
+        void ParseValue(FlatJson& json, const std::string& key)
+        {
+            SkipSpace();
+            if (m_offset == m_text.size()) Fail();
+            char c = m_text[m_offset];
+            if (c == '{')
+            {
+                m_offset++;
+                if (Consume('}')) return;
+                do
+                {
+                    SkipSpace();
+                    std::string name = ParseString();
+                    SkipSpace();
+                    if (!Consume(':')) Fail();
+                    ParseValue(json, key.empty() ? name : key + "." + name);
+                    SkipSpace();
+                } while (Consume(','));
+                if (!Consume('}')) Fail();
+            }
+            else if (c == '[')
+            {
+                m_offset++;
+                if (Consume(']')) return;
+                size_t index = 0;
+                do
+                {
+                    std::string name = std::to_string(index++);
+                    ParseValue(json, key.empty() ? name : key + "." + name);
+                    SkipSpace();
+                } while (Consume(','));
+                if (!Consume(']')) Fail();
+            }
+            else if (c == '"')
+            {
+                json.strings[key] = ParseString();
+            }
+            else if (m_text.compare(m_offset, 4, "true") == 0 || m_text.compare(m_offset, 4, "null") == 0)
+            {
+                m_offset += 4;
+            }
+            else if (m_text.compare(m_offset, 5, "false") == 0)
+            {
+                m_offset += 5;
+            }
+            else
+            {
+                size_t end = 0;
+                try
+                {
+                    json.numbers[key] = std::stod(m_text.substr(m_offset, 32), &end);
+                }
+                catch (const std::exception&)
+                {
+                    Fail();
+                }
+                m_offset += end;
+            }
+        }
+
+        std::string ParseString()
+        {
+            if (!Consume('"')) Fail();
+            std::string value;
+            while (m_offset < m_text.size() && m_text[m_offset] != '"')
+            {
+                // Escapes are kept as the character they escape, nothing compared here needs more
+                if (m_text[m_offset] == '\\') m_offset++;
+                if (m_offset < m_text.size()) value += m_text[m_offset++];
+            }
+            if (!Consume('"')) Fail();
+            return value;
+        }
+
+        void SkipSpace()
+        {
+            while (m_offset < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_offset]))) m_offset++;
+        }
+
+        bool Consume(char c)
+        {
+            if (m_offset < m_text.size() && m_text[m_offset] == c)
+            {
+                m_offset++;
+                return true;
+            }
+            return false;
+        }
+
+        [[noreturn]] void Fail()
+        {
+            throw std::runtime_error("Invalid JSON at offset " + std::to_string(m_offset) + ": " + m_path);
+        }
+
+    private:
+        const std::string& m_text;
+        const std::string& m_path;
+        size_t m_offset = 0;
+    };
+
+    bool ReadJson(const std::string& path, FlatJson& json)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        std::stringstream text;
+        text << file.rdbuf();
+        json = JsonParser(text.str(), path).Parse();
+        return true;
+    }
+
+    bool StartsWith(const std::string& value, const std::string& prefix)
+    {
+        return value.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    // The keys of @values below @prefix, with the prefix removed
+    std::map<std::string, double> Select(const std::map<std::string, double>& values, const std::string& prefix)
+    {
+        std::map<std::string, double> selected;
+        for (const auto& entry : values)
+        {
+            if (StartsWith(entry.first, prefix)) selected[entry.first.substr(prefix.size())] = entry.second;
+        }
+        return selected;
+    }
+
+    std::string FormatNumber(double value)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.6g", value);
+        return buffer;
+    }
+
+    // Everything the results measure becomes a metric, the scene describes what was measured and has to match
+    void WriteBaseline(const std::string& path, const FlatJson& results, const FlatJson* previous)
+    {
+        std::string json = "{\n  \"scene\": {";
+        bool first = true;
+        for (const auto& entry : Select(results.numbers, "scene."))
+        {
+            json += (first ? "\"" : ", \"") + entry.first + "\": " + FormatNumber(entry.second);
+            first = false;
+        }
+        json += "},\n";
+
+        // Tolerances someone tuned by hand survive an update
+        double tolerance = DEFAULT_TOLERANCE;
+        double minimumDelta = DEFAULT_MINIMUM_DELTA;
+        std::map<std::string, double> tolerances;
+        if (previous != nullptr)
+        {
+            auto found = previous->numbers.find("tolerance");
+            if (found != previous->numbers.end()) tolerance = found->second;
+            found = previous->numbers.find("minimumDelta");
+            if (found != previous->numbers.end()) minimumDelta = found->second;
+            tolerances = Select(previous->numbers, "tolerances.");
+        }
+        json += "  \"tolerance\": " + FormatNumber(tolerance) + ",\n  \"minimumDelta\": " + FormatNumber(minimumDelta) +
+            ",\n  \"tolerances\": {";
+        first = true;
+        for (const auto& entry : tolerances)
+        {
+            json += (first ? "\n    \"" : ",\n    \"") + entry.first + "\": " + FormatNumber(entry.second);
+            first = false;
+        }
+        json += first ? "},\n" : "\n  },\n";
+
+        json += "  \"metrics\": {";
+        first = true;
+        for (const auto& entry : results.numbers)
+        {
+            if (StartsWith(entry.first, "scene.") || entry.first == "frames" || entry.first == "measuredFrames") continue;
+            json += (first ? "\n    \"" : ",\n    \"") + entry.first + "\": " + FormatNumber(entry.second);
+            first = false;
+        }
+        json += first ? "}\n}\n" : "\n  }\n}\n";
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(json.data(), static_cast<std::streamsize>(json.size()));
+        if (!file) throw std::runtime_error("Failed to write baseline: " + path);
+    }
+
+    // Returns the number of regressed metrics
+    int Compare(const FlatJson& results, const FlatJson& baseline, double toleranceOverride)
+    {
+        // Numbers of different scenes say nothing about each other
+        for (const auto& entry : Select(baseline.numbers, "scene."))
+        {
+            auto found = results.numbers.find("scene." + entry.first);
+            if (found == results.numbers.end() || found->second != entry.second)
+            {
+                throw std::runtime_error("Results were measured on a different scene than the baseline, scene." + entry.first +
+                    " differs");
+            }
+        }
+
+        auto get = [&](const std::string& key, double fallback)
+        {
+            auto found = baseline.numbers.find(key);
+            return found == baseline.numbers.end() ? fallback : found->second;
+        };
+        const double tolerance = toleranceOverride >= 0.0 ? toleranceOverride : get("tolerance", DEFAULT_TOLERANCE);
+        const double minimumDelta = get("minimumDelta", DEFAULT_MINIMUM_DELTA);
+
+        int regressions = 0;
+        for (const auto& entry : Select(baseline.numbers, "metrics."))
+        {
+            const std::string& name = entry.first;
+            auto found = results.numbers.find(name);
+            if (found == results.numbers.end())
+            {
+                // A renamed zone or a profiler built out, worth a look but nothing got slower
+                std::cout << "MISSING   " << name << std::endl;
+                continue;
+            }
+            double limit = entry.second * (1.0 + get("tolerances." + name, tolerance)) + minimumDelta;
+            double change = entry.second != 0.0 ? (found->second / entry.second - 1.0) * 100.0 : 0.0;
+            const char* status = "ok";
+            if (found->second > limit)
+            {
+                status = "REGRESSED";
+                regressions++;
+            }
+            else if (found->second < entry.second * (1.0 - tolerance) - minimumDelta)
+            {
+                status = "improved";
+            }
+            char line[256];
+            snprintf(line, sizeof(line), "%-9s %s: %s (baseline %s, %+.1f%%)", status, name.c_str(),
+                FormatNumber(found->second).c_str(), FormatNumber(entry.second).c_str(), change);
+            std::cout << line << std::endl;
+        }
+        return regressions;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        bool update = argc == 4 && std::string(argv[1]) == "--update";
+        double toleranceOverride = -1.0;
+        int first = update ? 2 : 1;
+        if (argc == 5 && std::string(argv[1]) == "--tolerance")
+        {
+            char* end = nullptr;
+            toleranceOverride = std::strtod(argv[2], &end);
+            if (end == argv[2] || *end != '\0' || toleranceOverride < 0.0)
+            {
+                throw std::runtime_error("Invalid tolerance: " + std::string(argv[2]));
+            }
+            first = 3;
+        }
+        if (argc - first != 2)
+        {
+            throw std::runtime_error(USAGE);
+        }
+        std::string resultsFile = argv[first];
+        std::string baselineFile = argv[first + 1];
+
+        FlatJson results;
+        if (!ReadJson(resultsFile, results))
+        {
+            throw std::runtime_error("Failed to open results: " + resultsFile);
+        }
+        FlatJson baseline;
+        bool hasBaseline = ReadJson(baselineFile, baseline);
+
+        if (update)
+        {
+            WriteBaseline(baselineFile, results, hasBaseline ? &baseline : nullptr);
+            std::cout << "Wrote baseline " << baselineFile << std::endl;
+            return EXIT_SUCCESS;
+        }
+        // A scene without a baseline yet is not a failure, it has nothing to regress from
+        if (!hasBaseline)
+        {
+            std::cout << "No baseline at " << baselineFile << ", record one with --update" << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        int regressions = Compare(results, baseline, toleranceOverride);
+        if (regressions > 0)
+        {
+            std::cerr << regressions << " metrics regressed against " << baselineFile << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
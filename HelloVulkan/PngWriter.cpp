@@ -0,0 +1,103 @@
+#include "PngWriter.h"
+#include "Checksum.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+void PutBigEndian(std::vector<uint8_t>& out, uint32_t value){
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Append a chunk of @type holding @data, including length and CRC
+void PutChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size){
+    PutBigEndian(out, static_cast<uint32_t>(size));
+    size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    PutBigEndian(out, Crc32(out.data() + typeOffset, size + 4));
+}
+
+}
+
+void WritePng(const std::string& filename, uint32_t width, uint32_t height, const uint8_t* pixels, size_t rowPitch, bool isBgra){
+    // Raw scanlines: a filter type byte (0 = none) followed by the pixels of the row
+    size_t scanlineSize = 1 + static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> scanlines(scanlineSize * height);
+    for(uint32_t y = 0; y < height; y++){
+        uint8_t* dst = scanlines.data() + y * scanlineSize;
+        const uint8_t* src = pixels + y * rowPitch;
+        dst[0] = 0;
+        if(isBgra){
+            for(uint32_t x = 0; x < width; x++){
+                dst[1 + x * 4 + 0] = src[x * 4 + 2];
+                dst[1 + x * 4 + 1] = src[x * 4 + 1];
+                dst[1 + x * 4 + 2] = src[x * 4 + 0];
+                dst[1 + x * 4 + 3] = src[x * 4 + 3];
+            }
+        }else{
+            std::copy(src, src + width * 4, dst + 1);
+        }
+    }
+
+    // zlib stream made of stored deflate blocks of at most 65535 bytes
+    constexpr size_t MAX_STORED_BLOCK = 65535;
+    size_t blockCount = std::max<size_t>(1, (scanlines.size() + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK);
+    std::vector<uint8_t> zlib;
+    zlib.reserve(2 + scanlines.size() + blockCount * 5 + 4);
+    zlib.push_back(0x78);// Deflate, 32K window
+    zlib.push_back(0x01);// No compression preset, header checksum
+    uint32_t adlerA = 1, adlerB = 0;
+    for(size_t offset = 0, block = 0; block < blockCount; block++){
+        size_t size = std::min(MAX_STORED_BLOCK, scanlines.size() - offset);
+        bool isLast = block + 1 == blockCount;
+        zlib.push_back(isLast ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(size));
+        zlib.push_back(static_cast<uint8_t>(size >> 8));
+        zlib.push_back(static_cast<uint8_t>(~size));
+        zlib.push_back(static_cast<uint8_t>(~size >> 8));
+        zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + size);
+
+        // Adler-32, reducing often enough that the sums never overflow
+        for(size_t i = 0; i < size;){
+            size_t end = std::min(size, i + 5552);
+            for(; i < end; i++){
+                adlerA += scanlines[offset + i];
+                adlerB += adlerA;
+            }
+            adlerA %= 65521;
+            adlerB %= 65521;
+        }
+        offset += size;
+    }
+    PutBigEndian(zlib, (adlerB << 16) | adlerA);
+
+    std::vector<uint8_t> png;
+    png.reserve(zlib.size() + 64);
+    const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    png.insert(png.end(), signature, signature + sizeof(signature));
+
+    std::vector<uint8_t> header;
+    PutBigEndian(header, width);
+    PutBigEndian(header, height);
+    header.push_back(8);// Bit depth
+    header.push_back(6);// Color type RGBA
+    header.push_back(0);// Compression method
+    header.push_back(0);// Filter method
+    header.push_back(0);// No interlace
+    PutChunk(png, "IHDR", header.data(), header.size());
+    PutChunk(png, "IDAT", zlib.data(), zlib.size());
+    PutChunk(png, "IEND", nullptr, 0);
+
+    std::ofstream file(filename, std::ios::binary);
+    if(!file.is_open()){
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Write 8-bit RGBA pixels as a PNG file. Rows start every @rowPitch bytes; with @isBgra the red and blue
+// channels are swapped while writing. The image data is stored without deflate compression: encoding then
+// runs at memory bandwidth, which is what keeps up with full frame rate capture
+void WritePng(const std::string& filename, uint32_t width, uint32_t height, const uint8_t* pixels, size_t rowPitch, bool isBgra);
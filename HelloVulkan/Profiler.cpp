@@ -0,0 +1,322 @@
+#include "Profiler.h"
+
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+namespace{
+
+std::atomic<uint64_t> g_nextInstance{1};
+
+// The buffer this thread records into, valid while @instance is the profiler's
+struct ThreadSlot{
+    uint64_t instance = 0;
+    void* buffer = nullptr;
+};
+thread_local ThreadSlot t_slot;
+
+constexpr uint32_t NO_GPU_ZONE = UINT32_MAX;
+
+void AppendJsonString(std::string& out, const char* text){
+    out += '"';
+    for(const char* c = text; *c != '\0'; c++){
+        if(*c == '"' || *c == '\\') out += '\\';
+        if(static_cast<unsigned char>(*c) >= 0x20) out += *c;
+    }
+    out += '"';
+}
+
+void AppendCompleteEvent(std::string& out, const char* name, const char* category, uint64_t begin, uint64_t end,
+    uint32_t pid, uint32_t tid)
+{
+    char fields[160];
+    out += "{\"name\":";
+    AppendJsonString(out, name);
+    snprintf(fields, sizeof(fields), ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u},\n",
+        category, begin / 1000.0, (end - begin) / 1000.0, pid, tid);
+    out += fields;
+}
+
+void AppendNameEvent(std::string& out, const char* kind, const char* name, uint32_t pid, uint32_t tid){
+    char fields[96];
+    snprintf(fields, sizeof(fields), "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":", kind, pid, tid);
+    out += fields;
+    AppendJsonString(out, name);
+    out += "}},\n";
+}
+
+}
+
+Profiler::Profiler()
+    : m_instance(g_nextInstance.fetch_add(1))
+{
+}
+
+Profiler::~Profiler(){
+    for(auto& thread: m_threads){
+        Chunk* chunk = thread->head->next.load();
+        while(chunk != nullptr){
+            Chunk* next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+}
+
+uint64_t Profiler::Now() const{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_startTime).count());
+}
+
+void Profiler::RecordZone(const char* name, uint64_t begin, uint64_t end){
+    ThreadBuffer& buffer = GetThreadBuffer();
+    if(buffer.eventCount == MAX_THREAD_EVENTS){
+        m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Chunk* chunk = buffer.tail;
+    uint32_t count = chunk->count.load(std::memory_order_relaxed);
+    if(count == Chunk::SIZE){
+        Chunk* next = new Chunk();
+        chunk->next.store(next, std::memory_order_release);
+        buffer.tail = chunk = next;
+        count = 0;
+    }
+    chunk->events[count] = {name, begin, end};
+    chunk->count.store(count + 1, std::memory_order_release);
+    buffer.eventCount++;
+}
+
+void Profiler::SetThreadName(const char* name){
+    GetThreadBuffer().name.store(name, std::memory_order_release);
+}
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer(){
+    if(t_slot.instance != m_instance){
+        std::lock_guard<std::mutex> lock(m_threadsMutex);
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->index = static_cast<uint32_t>(m_threads.size());
+        buffer->head = std::make_unique<Chunk>();
+        buffer->tail = buffer->head.get();
+        t_slot.instance = m_instance;
+        t_slot.buffer = buffer.get();
+        m_threads.push_back(std::move(buffer));
+    }
+    return *static_cast<ThreadBuffer*>(t_slot.buffer);
+}
+
+void Profiler::CreateGpu(VkInstance instance, bool debugUtils, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+    VkQueue queue, VkCommandPool commandPool, uint32_t framesInFlight)
+{
+    m_device = device;
+    // The loader may hand out these pointers even when the extension is off, calling them then is invalid
+    if(debugUtils){
+        m_cmdBeginLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT"));
+        m_cmdEndLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT"));
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    m_hasTimestamps = validBits != 0 && properties.limits.timestampPeriod > 0.0f;
+    if(!m_hasTimestamps) return;
+    m_timestampPeriod = properties.limits.timestampPeriod;
+    m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    m_gpuFrames.resize(framesInFlight);
+    for(auto& frame: m_gpuFrames){
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = MAX_GPU_ZONES * 2;
+        ThrowIfFailed(vkCreateQueryPool(device, &poolInfo, GetAllocationCallbacks(), &frame.queryPool),
+            "Failed to create timestamp query pool!");
+    }
+
+    // Write one timestamp and take the middle of the CPU time around the submission as the moment it was written.
+    // Off by at most half the round trip, which is well below the zones worth looking at
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    ThrowIfFailed(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer),
+        "Failed to allocate command buffer!");
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    vkCmdResetQueryPool(commandBuffer, m_gpuFrames[0].queryPool, 0, 1);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_gpuFrames[0].queryPool, 0);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    uint64_t before = Now();
+    ThrowIfFailed(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE), "Failed to submit timestamp calibration!");
+    vkQueueWaitIdle(queue);
+    uint64_t after = Now();
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+
+    uint64_t ticks = 0;
+    ThrowIfFailed(vkGetQueryPoolResults(device, m_gpuFrames[0].queryPool, 0, 1, sizeof(ticks), &ticks, sizeof(ticks),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT), "Failed to read timestamp calibration!");
+    m_gpuTimeOffset = static_cast<int64_t>((before + after) / 2) - static_cast<int64_t>((ticks & m_timestampMask) * m_timestampPeriod);
+}
+
+void Profiler::DestroyGpu(){
+    for(auto& frame: m_gpuFrames) vkDestroyQueryPool(m_device, frame.queryPool, GetAllocationCallbacks());
+    m_gpuFrames.clear();
+    m_hasTimestamps = false;
+    m_cmdBeginLabel = nullptr;
+    m_cmdEndLabel = nullptr;
+}
+
+void Profiler::CollectGpuFrame(uint32_t frameIndex){
+    if(frameIndex >= m_gpuFrames.size()) return;
+    GpuFrame& frame = m_gpuFrames[frameIndex];
+    uint32_t zoneCount = static_cast<uint32_t>(frame.zoneNames.size());
+    if(zoneCount == 0) return;
+
+    // The fence was waited on, the results are there without waiting
+    std::vector<uint64_t> ticks(zoneCount * 2);
+    VkResult result = vkGetQueryPoolResults(m_device, frame.queryPool, 0, zoneCount * 2, ticks.size() * sizeof(uint64_t),
+        ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if(result == VK_SUCCESS && frame.endedZoneCount == zoneCount){
+        for(uint32_t zone = 0; zone < zoneCount; zone++){
+            int64_t begin = m_gpuTimeOffset + static_cast<int64_t>((ticks[zone * 2] & m_timestampMask) * m_timestampPeriod);
+            int64_t end = m_gpuTimeOffset + static_cast<int64_t>((ticks[zone * 2 + 1] & m_timestampMask) * m_timestampPeriod);
+            if(begin < 0 || end < begin) continue;
+            m_gpuEvents.push_back({frame.zoneNames[zone], static_cast<uint64_t>(begin), static_cast<uint64_t>(end)});
+        }
+    }
+    frame.zoneNames.clear();
+    frame.endedZoneCount = 0;
+}
+
+void Profiler::BeginGpuFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex){
+    m_currentGpuFrame = frameIndex;
+    m_openGpuZones.clear();
+    if(!IsEnabled() || !m_hasTimestamps) return;
+    vkCmdResetQueryPool(commandBuffer, m_gpuFrames[frameIndex].queryPool, 0, MAX_GPU_ZONES * 2);
+}
+
+void Profiler::BeginGpuZone(VkCommandBuffer commandBuffer, const char* name){
+    if(m_cmdBeginLabel != nullptr){
+        VkDebugUtilsLabelEXT label = {};
+        label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+        label.pLabelName = name;
+        m_cmdBeginLabel(commandBuffer, &label);
+    }
+
+    // Zones beyond the capacity still nest, they are just not timed
+    uint32_t zone = NO_GPU_ZONE;
+    if(IsEnabled() && m_hasTimestamps){
+        GpuFrame& frame = m_gpuFrames[m_currentGpuFrame];
+        if(frame.zoneNames.size() < MAX_GPU_ZONES){
+            zone = static_cast<uint32_t>(frame.zoneNames.size());
+            frame.zoneNames.push_back(InternName(name));
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, zone * 2);
+        }else{
+            m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    m_openGpuZones.push_back(zone);
+}
+
+void Profiler::EndGpuZone(VkCommandBuffer commandBuffer){
+    if(m_openGpuZones.empty()) return;
+    uint32_t zone = m_openGpuZones.back();
+    m_openGpuZones.pop_back();
+
+    if(zone != NO_GPU_ZONE){
+        GpuFrame& frame = m_gpuFrames[m_currentGpuFrame];
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, zone * 2 + 1);
+        frame.endedZoneCount++;
+    }
+    if(m_cmdEndLabel != nullptr) m_cmdEndLabel(commandBuffer);
+}
+
+const char* Profiler::InternName(const char* name){
+    return m_names.emplace(name).first->c_str();
+}
+
+void Profiler::WriteChromeTrace(const std::string& path){
+    std::vector<ThreadBuffer*> threads;
+    {
+        std::lock_guard<std::mutex> lock(m_threadsMutex);
+        for(auto& thread: m_threads) threads.push_back(thread.get());
+    }
+
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    AppendNameEvent(json, "process_name", "CPU", 0, 0);
+    for(ThreadBuffer* thread: threads){
+        const char* name = thread->name.load(std::memory_order_acquire);
+        std::string fallback = "Thread " + std::to_string(thread->index);
+        AppendNameEvent(json, "thread_name", name != nullptr ? name : fallback.c_str(), 0, thread->index);
+
+        for(const Chunk* chunk = thread->head.get(); chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)){
+            uint32_t count = chunk->count.load(std::memory_order_acquire);
+            for(uint32_t i = 0; i < count; i++){
+                const Event& event = chunk->events[i];
+                AppendCompleteEvent(json, event.name, "cpu", event.begin, event.end, 0, thread->index);
+            }
+        }
+    }
+
+    AppendNameEvent(json, "process_name", "GPU", 1, 0);
+    AppendNameEvent(json, "thread_name", "Graphics queue", 1, 0);
+    for(const Event& event: m_gpuEvents) AppendCompleteEvent(json, event.name, "gpu", event.begin, event.end, 1, 0);
+
+    // Drop the separator after the last event
+    json.resize(json.size() - 2);
+    json += "\n]}\n";
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+    if(!file) throw std::runtime_error("Failed to write profile: " + path + "!");
+}
+
+std::vector<ProfileZoneStats> Profiler::GetZoneStats(uint64_t since){
+    std::vector<ThreadBuffer*> threads;
+    {
+        std::lock_guard<std::mutex> lock(m_threadsMutex);
+        for(auto& thread: m_threads) threads.push_back(thread.get());
+    }
+
+    // Names may be the same literal at different addresses, so they are compared as strings
+    std::map<std::pair<bool, std::string>, ProfileZoneStats> stats;
+    auto add = [&](const Event& event, bool gpu){
+        if(event.begin < since) return;
+        ProfileZoneStats& zone = stats[{gpu, event.name}];
+        zone.count++;
+        zone.totalMs += (event.end - event.begin) / 1e6;
+    };
+    for(ThreadBuffer* thread: threads){
+        for(const Chunk* chunk = thread->head.get(); chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)){
+            uint32_t count = chunk->count.load(std::memory_order_acquire);
+            for(uint32_t i = 0; i < count; i++) add(chunk->events[i], false);
+        }
+    }
+    for(const Event& event: m_gpuEvents) add(event, true);
+
+    std::vector<ProfileZoneStats> result;
+    for(auto& entry: stats){
+        entry.second.name = entry.first.second;
+        entry.second.gpu = entry.first.first;
+        result.push_back(entry.second);
+    }
+    return result;
+}
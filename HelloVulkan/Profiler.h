@@ -0,0 +1,175 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Time spent in all zones of one name
+struct ProfileZoneStats{
+    std::string name;
+    bool gpu;
+    uint64_t count;
+    double totalMs;
+};
+
+// Scoped CPU zones and GPU timestamp ranges on one timeline, exported as a Chrome trace (chrome://tracing or
+// ui.perfetto.dev). Every thread records complete zones into buffers of its own without locking; the GPU side writes
+// timestamps around command ranges, labels them through VK_EXT_debug_utils when the extension is enabled, and reads
+// them back once the frame's fence was waited on.
+//
+// While disabled a zone costs one relaxed load. Building without HELLOVULKAN_PROFILING removes the zones altogether
+class Profiler
+{
+public:
+    // Events kept per thread, later ones are dropped and counted
+    static constexpr uint32_t MAX_THREAD_EVENTS = 1u << 20;
+    // Timestamp pairs per frame
+    static constexpr uint32_t MAX_GPU_ZONES = 64;
+
+public:
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // Nanoseconds since the profiler was created
+    uint64_t Now() const;
+    // @name must outlive the profiler, zones are meant to be named by string literals
+    void RecordZone(const char* name, uint64_t begin, uint64_t end);
+    // Name the calling thread in the trace
+    void SetThreadName(const char* name);
+
+    // Timestamps are written on @queue, which must be of @queueFamily and is used once here to align the GPU clock
+    // with Now(). Without timestamp support on that family only the labels remain, and those only when @debugUtils
+    // says VK_EXT_debug_utils was enabled on @instance
+    void CreateGpu(VkInstance instance, bool debugUtils, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+        VkQueue queue, VkCommandPool commandPool, uint32_t framesInFlight);
+    void DestroyGpu();
+    // Read back the zones of frame @frameIndex, call once its fence was waited on
+    void CollectGpuFrame(uint32_t frameIndex);
+    // Reset the queries of frame @frameIndex, first thing in its command buffer and outside any render pass
+    void BeginGpuFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void BeginGpuZone(VkCommandBuffer commandBuffer, const char* name);
+    void EndGpuZone(VkCommandBuffer commandBuffer);
+
+    // Write everything recorded so far. Threads may keep recording meanwhile, their newest zones are left out
+    void WriteChromeTrace(const std::string& path);
+    // Sum up the zones that began at or after @since, a Now() value, CPU and GPU ones apart and sorted by name
+    std::vector<ProfileZoneStats> GetZoneStats(uint64_t since = 0);
+
+    uint64_t GetDroppedCount() const { return m_droppedCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Event{
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // Chunks are only appended, by the owning thread, and published through @count and @next
+    struct Chunk{
+        static constexpr uint32_t SIZE = 4096;
+        Event events[SIZE];
+        std::atomic<uint32_t> count{0};
+        std::atomic<Chunk*> next{nullptr};
+    };
+
+    struct ThreadBuffer{
+        uint32_t index;
+        std::atomic<const char*> name{nullptr};
+        std::unique_ptr<Chunk> head;
+        Chunk* tail;
+        uint32_t eventCount = 0;
+    };
+
+    struct GpuFrame{
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        // Name of each zone recorded into the frame and whether its end was written
+        std::vector<const char*> zoneNames;
+        uint32_t endedZoneCount = 0;
+    };
+
+    ThreadBuffer& GetThreadBuffer();
+    // Interned, so GPU zone names may come from strings that go away before the frame is collected
+    const char* InternName(const char* name);
+
+private:
+    std::atomic<bool> m_enabled{false};
+    // Told apart by the thread-local buffer cache, so a new profiler at an old address gets new buffers
+    uint64_t m_instance;
+    std::chrono::steady_clock::time_point m_startTime = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> m_droppedCount{0};
+
+    std::mutex m_threadsMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+
+    // GPU side, used by the render thread only
+    VkDevice m_device = VK_NULL_HANDLE;
+    PFN_vkCmdBeginDebugUtilsLabelEXT m_cmdBeginLabel = nullptr;
+    PFN_vkCmdEndDebugUtilsLabelEXT m_cmdEndLabel = nullptr;
+    bool m_hasTimestamps = false;
+    double m_timestampPeriod = 1.0;// Nanoseconds per tick
+    uint64_t m_timestampMask = ~0ull;
+    // Now() at GPU tick zero
+    int64_t m_gpuTimeOffset = 0;
+    std::vector<GpuFrame> m_gpuFrames;
+    uint32_t m_currentGpuFrame = 0;
+    std::vector<uint32_t> m_openGpuZones;
+    std::vector<Event> m_gpuEvents;
+    std::unordered_set<std::string> m_names;
+};
+
+// Records the time from its construction to its destruction as a zone
+class ProfileZone
+{
+public:
+    ProfileZone(Profiler& profiler, const char* name)
+        : m_profiler(profiler.IsEnabled() ? &profiler : nullptr), m_name(name), m_begin(m_profiler ? profiler.Now() : 0) {}
+    ~ProfileZone() { if(m_profiler) m_profiler->RecordZone(m_name, m_begin, m_profiler->Now()); }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    Profiler* m_profiler;
+    const char* m_name;
+    uint64_t m_begin;
+};
+
+// Times a range of the command buffer on the GPU
+class GpuProfileZone
+{
+public:
+    GpuProfileZone(Profiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+        : m_profiler(profiler), m_commandBuffer(commandBuffer) { m_profiler.BeginGpuZone(m_commandBuffer, name); }
+    ~GpuProfileZone() { m_profiler.EndGpuZone(m_commandBuffer); }
+
+    GpuProfileZone(const GpuProfileZone&) = delete;
+    GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+
+private:
+    Profiler& m_profiler;
+    VkCommandBuffer m_commandBuffer;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#ifdef HELLOVULKAN_PROFILING
+// Profile the rest of the enclosing scope as @name, a string literal
+#define PROFILE_ZONE(profiler, name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)((profiler), (name))
+#define PROFILE_GPU_ZONE(profiler, commandBuffer, name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)((profiler), (commandBuffer), (name))
+#else
+#define PROFILE_ZONE(profiler, name) ((void)0)
+#define PROFILE_GPU_ZONE(profiler, commandBuffer, name) ((void)0)
+#endif
@@ -0,0 +1,585 @@
+#include "RenderGraph.h"
+
+#include "HostAllocator.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <set>
+
+RenderGraph::UsageInfo RenderGraph::GetUsageInfo(ResourceUsage usage){
+    switch(usage){
+    case ResourceUsage::ColorAttachment:
+        return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+    case ResourceUsage::DepthStencilAttachment:
+        return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true};
+    case ResourceUsage::DepthStencilRead:
+        return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false};
+    case ResourceUsage::SampledFragment:
+        return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+    case ResourceUsage::SampledCompute:
+        return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+    case ResourceUsage::StorageReadCompute:
+        return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, false};
+    case ResourceUsage::StorageWriteCompute:
+        return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, true};
+    case ResourceUsage::TransferSrc:
+        return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+    case ResourceUsage::TransferDst:
+        return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+    case ResourceUsage::VertexBuffer:
+        return {VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::IndexBuffer:
+        return {VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::IndirectBuffer:
+        return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::UniformVertex:
+        return {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::StorageReadVertex:
+        return {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case ResourceUsage::Present:
+        return {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false};
+    }
+
+    throw std::runtime_error("Unknown render graph resource usage!");
+}
+
+void RenderGraph::Init(VkPhysicalDevice physicalDevice, VkDevice device){
+    m_physicalDevice = physicalDevice;
+    m_device = device;
+
+    // Core since Vulkan 1.3, the KHR entry point covers older devices exposing the extension
+    m_cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2>(vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2"));
+    if(m_cmdPipelineBarrier2 == nullptr){
+        m_cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2>(vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR"));
+    }
+    if(m_cmdPipelineBarrier2 == nullptr){
+        throw std::runtime_error("Render graph requires synchronization2!");
+    }
+}
+
+void RenderGraph::Reset(){
+    for(auto& resource: m_resources){
+        if(resource.isImage && !resource.isImported){
+            vkDestroyImageView(m_device, resource.view, GetAllocationCallbacks());
+            vkDestroyImage(m_device, resource.image, GetAllocationCallbacks());
+        }
+    }
+    for(auto& block: m_memoryBlocks){
+        FreeMemory(m_device, block.memory);
+    }
+
+    m_resources.clear();
+    m_passes.clear();
+    m_order.clear();
+    m_memoryBlocks.clear();
+    m_unaliasedTransientSize = 0;
+    m_finalImageBarriers.clear();
+    m_finalImageBarrierResources.clear();
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportImage(const std::string& name, VkImageAspectFlags aspect, VkImageLayout initialLayout,
+    bool waitedBySemaphore, const ResourceUsage* finalUsage)
+{
+    Resource resource;
+    resource.name = name;
+    resource.isImage = true;
+    resource.isImported = true;
+    resource.desc.aspect = aspect;
+    resource.initialLayout = initialLayout;
+    resource.waitedBySemaphore = waitedBySemaphore;
+    if(finalUsage != nullptr){
+        resource.hasFinalUsage = true;
+        resource.finalUsage = *finalUsage;
+    }
+
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::ImportBuffer(const std::string& name){
+    Resource resource;
+    resource.name = name;
+    resource.isImported = true;
+
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTransientImage(const std::string& name, const ImageDesc& desc){
+    Resource resource;
+    resource.name = name;
+    resource.isImage = true;
+    resource.desc = desc;
+
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+void RenderGraph::SetImportedImage(ResourceHandle handle, VkImage image, VkImageView view){
+    m_resources[handle].image = image;
+    m_resources[handle].view = view;
+}
+
+void RenderGraph::SetImportedBuffer(ResourceHandle handle, VkBuffer buffer){
+    m_resources[handle].buffer = buffer;
+}
+
+uint32_t RenderGraph::AddPass(const std::string& name, ExecuteCallback execute, bool hasSideEffects){
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    pass.hasSideEffects = hasSideEffects;
+
+    m_passes.push_back(std::move(pass));
+    return static_cast<uint32_t>(m_passes.size() - 1);
+}
+
+void RenderGraph::Read(uint32_t pass, ResourceHandle resource, ResourceUsage usage){
+    if(GetUsageInfo(usage).isWrite){
+        throw std::runtime_error("Render graph pass " + m_passes[pass].name + " reads " + m_resources[resource].name + " with a write usage!");
+    }
+    AddAccess(pass, resource, usage);
+}
+
+void RenderGraph::Write(uint32_t pass, ResourceHandle resource, ResourceUsage usage){
+    if(!GetUsageInfo(usage).isWrite){
+        throw std::runtime_error("Render graph pass " + m_passes[pass].name + " writes " + m_resources[resource].name + " with a read-only usage!");
+    }
+    AddAccess(pass, resource, usage);
+}
+
+void RenderGraph::AddAccess(uint32_t pass, ResourceHandle resource, ResourceUsage usage){
+    UsageInfo info = GetUsageInfo(usage);
+
+    // Several usages of one resource in a pass are merged into a single access
+    for(auto& access: m_passes[pass].accesses){
+        if(access.resource != resource) continue;
+
+        if(m_resources[resource].isImage && access.info.layout != info.layout){
+            throw std::runtime_error("Render graph pass " + m_passes[pass].name + " uses " + m_resources[resource].name + " in conflicting layouts!");
+        }
+        access.info.stages |= info.stages;
+        access.info.access |= info.access;
+        access.info.isWrite = access.info.isWrite || info.isWrite;
+        return;
+    }
+
+    m_passes[pass].accesses.push_back({resource, info});
+}
+
+void RenderGraph::CullPasses(std::vector<bool>& isAlive) const{
+    // Walk backwards from the passes with visible results: writes to imported resources or side effects
+    std::vector<bool> isNeeded(m_resources.size(), false);
+    for(size_t i = 0; i < m_resources.size(); i++){
+        isNeeded[i] = m_resources[i].isImported;
+    }
+
+    isAlive.assign(m_passes.size(), false);
+    for(size_t i = m_passes.size(); i-- > 0;){
+        const Pass& pass = m_passes[i];
+
+        bool isAliveHere = pass.hasSideEffects;
+        for(const auto& access: pass.accesses){
+            if(access.info.isWrite && isNeeded[access.resource]) isAliveHere = true;
+        }
+        if(!isAliveHere) continue;
+
+        isAlive[i] = true;
+        for(const auto& access: pass.accesses){
+            isNeeded[access.resource] = true;
+        }
+    }
+}
+
+void RenderGraph::SortPasses(const std::vector<bool>& isAlive){
+    // Derive dependencies from the declaration order of accesses: read after write, write after write and
+    // write after read. All of them point forward, so declaration order is always a valid fallback
+    std::vector<std::set<uint32_t>> predecessors(m_passes.size());
+    for(ResourceHandle r = 0; r < m_resources.size(); r++){
+        int lastWriter = -1;
+        std::vector<uint32_t> readersSinceWrite;
+
+        for(uint32_t p = 0; p < m_passes.size(); p++){
+            if(!isAlive[p]) continue;
+            for(const auto& access: m_passes[p].accesses){
+                if(access.resource != r) continue;
+
+                if(lastWriter >= 0) predecessors[p].insert(static_cast<uint32_t>(lastWriter));
+                if(access.info.isWrite){
+                    for(uint32_t reader: readersSinceWrite) predecessors[p].insert(reader);
+                    readersSinceWrite.clear();
+                    lastWriter = static_cast<int>(p);
+                }else{
+                    readersSinceWrite.push_back(p);
+                }
+            }
+        }
+    }
+    for(uint32_t p = 0; p < m_passes.size(); p++){
+        predecessors[p].erase(p);
+    }
+
+    // Kahn's algorithm. Among the ready passes, prefer one that does not depend on the pass just scheduled:
+    // putting independent work between a producer and its consumer gives the barrier between them room to
+    // overlap. Ties go to declaration order
+    std::vector<uint32_t> remaining(m_passes.size(), 0);
+    std::vector<std::vector<uint32_t>> successors(m_passes.size());
+    for(uint32_t p = 0; p < m_passes.size(); p++){
+        remaining[p] = static_cast<uint32_t>(predecessors[p].size());
+        for(uint32_t pred: predecessors[p]) successors[pred].push_back(p);
+    }
+
+    std::vector<uint32_t> ready;
+    for(uint32_t p = 0; p < m_passes.size(); p++){
+        if(isAlive[p] && remaining[p] == 0) ready.push_back(p);
+    }
+
+    m_order.clear();
+    while(!ready.empty()){
+        size_t chosen = 0;
+        if(!m_order.empty()){
+            uint32_t last = m_order.back();
+            for(size_t i = 0; i < ready.size(); i++){
+                if(predecessors[ready[i]].count(last) == 0){
+                    chosen = i;
+                    break;
+                }
+            }
+        }
+
+        uint32_t pass = ready[chosen];
+        ready.erase(ready.begin() + chosen);
+        m_order.push_back(pass);
+
+        for(uint32_t next: successors[pass]){
+            if(--remaining[next] == 0){
+                ready.insert(std::upper_bound(ready.begin(), ready.end(), next), next);
+            }
+        }
+    }
+}
+
+void RenderGraph::AllocateTransientImages(){
+    std::vector<ResourceHandle> transients;
+    for(ResourceHandle r = 0; r < m_resources.size(); r++){
+        Resource& resource = m_resources[r];
+        if(!resource.isImage || resource.isImported || resource.firstPass < 0) continue;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = resource.desc.format;
+        imageInfo.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+        imageInfo.mipLevels = resource.desc.mipLevels;
+        imageInfo.arrayLayers = resource.desc.arrayLayers;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = resource.desc.usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        ThrowIfFailed(vkCreateImage(m_device, &imageInfo, GetAllocationCallbacks(), &resource.image),
+            "Failed to create transient image " + resource.name + "!");
+
+        vkGetImageMemoryRequirements(m_device, resource.image, &resource.memoryRequirements);
+        m_unaliasedTransientSize += resource.memoryRequirements.size;
+        transients.push_back(r);
+    }
+
+    // Greedy placement, largest first: an image joins the first block whose residents are all dead before it
+    // starts or born after it ends. Every resident sits at offset 0, so the block is as big as its largest one
+    std::sort(transients.begin(), transients.end(), [this](ResourceHandle a, ResourceHandle b){
+        return m_resources[a].memoryRequirements.size > m_resources[b].memoryRequirements.size;
+    });
+
+    for(ResourceHandle r: transients){
+        Resource& resource = m_resources[r];
+
+        int chosenBlock = -1;
+        for(size_t b = 0; b < m_memoryBlocks.size() && chosenBlock < 0; b++){
+            const MemoryBlock& block = m_memoryBlocks[b];
+            if((block.memoryTypeBits & resource.memoryRequirements.memoryTypeBits) == 0) continue;
+
+            bool overlaps = false;
+            for(ResourceHandle other: block.residents){
+                const Resource& resident = m_resources[other];
+                if(resident.firstPass <= resource.lastPass && resource.firstPass <= resident.lastPass){
+                    overlaps = true;
+                    break;
+                }
+            }
+            if(!overlaps) chosenBlock = static_cast<int>(b);
+        }
+
+        if(chosenBlock < 0){
+            m_memoryBlocks.emplace_back();
+            chosenBlock = static_cast<int>(m_memoryBlocks.size() - 1);
+        }
+
+        MemoryBlock& block = m_memoryBlocks[chosenBlock];
+        block.size = std::max(block.size, resource.memoryRequirements.size);
+        block.memoryTypeBits &= resource.memoryRequirements.memoryTypeBits;
+        block.residents.push_back(r);
+        resource.memoryBlock = chosenBlock;
+    }
+
+    for(auto& block: m_memoryBlocks){
+        std::sort(block.residents.begin(), block.residents.end(), [this](ResourceHandle a, ResourceHandle b){
+            return m_resources[a].firstPass < m_resources[b].firstPass;
+        });
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = block.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(m_physicalDevice, block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        ThrowIfFailed(AllocateMemory(m_device, allocInfo, block.memory),
+            "Failed to allocate transient image memory!");
+
+        for(ResourceHandle r: block.residents){
+            Resource& resource = m_resources[r];
+            vkBindImageMemory(m_device, resource.image, block.memory, 0);
+
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = resource.image;
+            viewInfo.viewType = resource.desc.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource.desc.format;
+            viewInfo.subresourceRange.aspectMask = resource.desc.aspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = resource.desc.mipLevels;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = resource.desc.arrayLayers;
+
+            ThrowIfFailed(vkCreateImageView(m_device, &viewInfo, GetAllocationCallbacks(), &resource.view),
+                "Failed to create transient image view " + resource.name + "!");
+        }
+    }
+}
+
+void RenderGraph::BuildBarriers(){
+    // What is known about a resource at some point of the frame
+    struct State{
+        VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;// Last write, or layout transition
+        VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+        VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;// Reads since then
+        VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE;// Where the last write is already visible
+        VkAccessFlags2 visibleAccess = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    // Last access of every resource in the frame, needed for memory shared between transient images
+    std::vector<UsageInfo> lastUsage(m_resources.size(), UsageInfo{VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, false});
+    for(uint32_t p: m_order){
+        for(const auto& access: m_passes[p].accesses) lastUsage[access.resource] = access.info;
+    }
+
+    std::vector<State> states(m_resources.size());
+    for(ResourceHandle r = 0; r < m_resources.size(); r++){
+        Resource& resource = m_resources[r];
+        State& state = states[r];
+
+        if(resource.isImported){
+            state.layout = resource.initialLayout;
+            resource.semaphoreWaitStage = VK_PIPELINE_STAGE_2_NONE;
+            if(resource.waitedBySemaphore){
+                // The semaphore wait blocks the first stage touching the image; chaining the first barrier to
+                // that stage orders it after the wait
+                for(uint32_t p: m_order){
+                    for(const auto& access: m_passes[p].accesses){
+                        if(access.resource == r && resource.semaphoreWaitStage == VK_PIPELINE_STAGE_2_NONE){
+                            resource.semaphoreWaitStage = access.info.stages;
+                        }
+                    }
+                }
+                state.writeStages = resource.semaphoreWaitStage;
+            }
+        }else if(resource.memoryBlock >= 0){
+            // The first use of a transient image has to wait for whoever used its memory last: the previous
+            // resident of its block in this frame, or the last resident in the previous frame on this queue
+            const auto& residents = m_memoryBlocks[resource.memoryBlock].residents;
+            size_t index = std::find(residents.begin(), residents.end(), r) - residents.begin();
+            ResourceHandle previous = residents[(index + residents.size() - 1) % residents.size()];
+            state.writeStages = lastUsage[previous].stages;
+            state.writeAccess = lastUsage[previous].isWrite ? lastUsage[previous].access : VK_ACCESS_2_NONE;
+        }
+    }
+
+    auto makeImageBarrier = [this](ResourceHandle r, const State& state, const UsageInfo& info){
+        const Resource& resource = m_resources[r];
+        VkImageMemoryBarrier2 barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = state.writeStages | state.readStages;
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.dstStageMask = info.stages;
+        barrier.dstAccessMask = info.access;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = info.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = resource.desc.aspect;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        return barrier;
+    };
+
+    for(uint32_t p: m_order){
+        Pass& pass = m_passes[p];
+        pass.imageBarriers.clear();
+        pass.imageBarrierResources.clear();
+        pass.bufferBarriers.clear();
+        pass.bufferBarrierResources.clear();
+
+        for(const auto& access: pass.accesses){
+            const Resource& resource = m_resources[access.resource];
+            State& state = states[access.resource];
+            const UsageInfo& info = access.info;
+
+            bool layoutChange = resource.isImage && state.layout != info.layout;
+            bool hasPendingWrite = state.writeStages != VK_PIPELINE_STAGE_2_NONE || state.writeAccess != VK_ACCESS_2_NONE;
+            bool needsVisibility = (info.stages & ~state.visibleStages) != 0 || (info.access & ~state.visibleAccess) != 0;
+
+            bool needsBarrier = false;
+            State barrierState = state;
+            if(info.isWrite || layoutChange){
+                // Write after write/read, or a transition: wait for everything that happened before
+                needsBarrier = layoutChange || hasPendingWrite || state.readStages != VK_PIPELINE_STAGE_2_NONE;
+            }else if(hasPendingWrite && needsVisibility){
+                // Read after write from a stage the write is not visible to yet. Earlier reads need no waiting
+                needsBarrier = true;
+                barrierState.readStages = VK_PIPELINE_STAGE_2_NONE;
+            }
+
+            if(needsBarrier){
+                if(resource.isImage){
+                    pass.imageBarriers.push_back(makeImageBarrier(access.resource, barrierState, info));
+                    pass.imageBarrierResources.push_back(access.resource);
+                }else{
+                    VkBufferMemoryBarrier2 barrier = {};
+                    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+                    barrier.srcStageMask = barrierState.writeStages | barrierState.readStages;
+                    barrier.srcAccessMask = barrierState.writeAccess;
+                    barrier.dstStageMask = info.stages;
+                    barrier.dstAccessMask = info.access;
+                    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barrier.offset = 0;
+                    barrier.size = VK_WHOLE_SIZE;
+                    pass.bufferBarriers.push_back(barrier);
+                    pass.bufferBarrierResources.push_back(access.resource);
+                }
+            }
+
+            if(info.isWrite || layoutChange){
+                // A layout transition behaves like a write the following accesses have to be ordered after
+                state.writeStages = info.stages;
+                state.writeAccess = info.isWrite ? info.access : VK_ACCESS_2_NONE;
+                state.readStages = info.isWrite ? VK_PIPELINE_STAGE_2_NONE : info.stages;
+                state.visibleStages = info.stages;
+                state.visibleAccess = info.access;
+                state.layout = resource.isImage ? info.layout : state.layout;
+            }else{
+                if(needsBarrier){
+                    state.visibleStages |= info.stages;
+                    state.visibleAccess |= info.access;
+                }
+                state.readStages |= info.stages;
+            }
+        }
+    }
+
+    m_finalImageBarriers.clear();
+    m_finalImageBarrierResources.clear();
+    for(ResourceHandle r = 0; r < m_resources.size(); r++){
+        const Resource& resource = m_resources[r];
+        if(!resource.isImported || !resource.hasFinalUsage) continue;
+
+        m_finalImageBarriers.push_back(makeImageBarrier(r, states[r], GetUsageInfo(resource.finalUsage)));
+        m_finalImageBarrierResources.push_back(r);
+    }
+}
+
+void RenderGraph::Compile(){
+    std::vector<bool> isAlive;
+    CullPasses(isAlive);
+    SortPasses(isAlive);
+
+    // Lifetimes are positions in the execution order
+    for(auto& resource: m_resources){
+        resource.firstPass = -1;
+        resource.lastPass = -1;
+    }
+    for(size_t i = 0; i < m_order.size(); i++){
+        for(const auto& access: m_passes[m_order[i]].accesses){
+            Resource& resource = m_resources[access.resource];
+            if(resource.firstPass < 0) resource.firstPass = static_cast<int>(i);
+            resource.lastPass = static_cast<int>(i);
+        }
+    }
+
+    AllocateTransientImages();
+    BuildBarriers();
+}
+
+void RenderGraph::PatchAndRecordBarriers(VkCommandBuffer commandBuffer, std::vector<VkImageMemoryBarrier2>& imageBarriers,
+    const std::vector<ResourceHandle>& imageResources, std::vector<VkBufferMemoryBarrier2>& bufferBarriers,
+    const std::vector<ResourceHandle>& bufferResources)
+{
+    if(imageBarriers.empty() && bufferBarriers.empty()) return;
+
+    for(size_t i = 0; i < imageBarriers.size(); i++){
+        imageBarriers[i].image = m_resources[imageResources[i]].image;
+    }
+    for(size_t i = 0; i < bufferBarriers.size(); i++){
+        bufferBarriers[i].buffer = m_resources[bufferResources[i]].buffer;
+    }
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+    dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+    dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+    dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+
+    m_cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer, Profiler* profiler){
+    for(uint32_t p: m_order){
+        Pass& pass = m_passes[p];
+        if(profiler != nullptr) profiler->BeginGpuZone(commandBuffer, pass.name.c_str());
+        PatchAndRecordBarriers(commandBuffer, pass.imageBarriers, pass.imageBarrierResources,
+            pass.bufferBarriers, pass.bufferBarrierResources);
+        pass.execute(commandBuffer);
+        if(profiler != nullptr) profiler->EndGpuZone(commandBuffer);
+    }
+
+    std::vector<VkBufferMemoryBarrier2> noBufferBarriers;
+    PatchAndRecordBarriers(commandBuffer, m_finalImageBarriers, m_finalImageBarrierResources, noBufferBarriers, {});
+}
+
+VkDeviceSize RenderGraph::GetTransientMemorySize() const{
+    VkDeviceSize size = 0;
+    for(const auto& block: m_memoryBlocks) size += block.size;
+    return size;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class Profiler;
+
+// How a pass touches a resource. Each usage maps to the pipeline stages, access flags and (for images) the
+// layout the graph derives barriers from
+enum class ResourceUsage{
+    ColorAttachment,        // Color attachment read/write
+    DepthStencilAttachment, // Depth test and write
+    DepthStencilRead,       // Depth test only, or sampled as depth
+    SampledFragment,        // Sampled in the fragment shader
+    SampledCompute,         // Sampled in a compute shader
+    StorageReadCompute,     // Storage image/buffer read in a compute shader
+    StorageWriteCompute,    // Storage image/buffer written in a compute shader
+    TransferSrc,
+    TransferDst,
+    VertexBuffer,
+    IndexBuffer,
+    IndirectBuffer,
+    UniformVertex,          // Uniform buffer read in the vertex shader
+    StorageReadVertex,      // Storage buffer read in the vertex shader
+    Present                 // Handed to the presentation engine
+};
+
+// A frame described as passes that declare the images and buffers they read and write. Compile() culls
+// passes nothing depends on, orders the rest, aliases the memory of transient images whose lifetimes do
+// not overlap and precomputes the minimal set of vkCmdPipelineBarrier2 calls between the passes.
+// The graph is compiled once and executed every frame; imported resources such as the swap chain image
+// are rebound per frame with SetImportedImage/SetImportedBuffer.
+class RenderGraph
+{
+public:
+    using ResourceHandle = uint32_t;
+    using ExecuteCallback = std::function<void(VkCommandBuffer)>;
+
+    struct ImageDesc{
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {0, 0};
+        VkImageUsageFlags usage = 0;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        uint32_t mipLevels = 1;
+        uint32_t arrayLayers = 1;
+    };
+
+public:
+    // Needs synchronization2, either from Vulkan 1.3 or VK_KHR_synchronization2
+    void Init(VkPhysicalDevice physicalDevice, VkDevice device);
+    // Drop all passes and resources, including the memory of transient images
+    void Reset();
+
+    // Use an image owned elsewhere. When @waitedBySemaphore is set the image arrives through a semaphore wait
+    // (e.g. a swap chain image) and GetSemaphoreWaitStage() tells which stage that wait has to block.
+    // Otherwise the image is assumed to be in @initialLayout with no pending writes.
+    // With @finalUsage set, the image is transitioned for that usage once the last pass is done.
+    ResourceHandle ImportImage(const std::string& name, VkImageAspectFlags aspect, VkImageLayout initialLayout,
+        bool waitedBySemaphore, const ResourceUsage* finalUsage = nullptr);
+    ResourceHandle ImportBuffer(const std::string& name);
+    // An image that only lives within the frame. Its memory may be shared with other transient images
+    ResourceHandle CreateTransientImage(const std::string& name, const ImageDesc& desc);
+
+    void SetImportedImage(ResourceHandle handle, VkImage image, VkImageView view);
+    void SetImportedBuffer(ResourceHandle handle, VkBuffer buffer);
+
+    // Passes are recorded in an order compatible with the declaration order of their accesses. A pass with
+    // @hasSideEffects is never culled even if nothing reads what it writes
+    uint32_t AddPass(const std::string& name, ExecuteCallback execute, bool hasSideEffects = false);
+    void Read(uint32_t pass, ResourceHandle resource, ResourceUsage usage);
+    void Write(uint32_t pass, ResourceHandle resource, ResourceUsage usage);
+
+    void Compile();
+    // Each pass is labelled and timed as a GPU zone of @profiler when given
+    void Execute(VkCommandBuffer commandBuffer, Profiler* profiler = nullptr);
+
+    VkImage GetImage(ResourceHandle handle) const { return m_resources[handle].image; }
+    VkImageView GetImageView(ResourceHandle handle) const { return m_resources[handle].view; }
+    VkBuffer GetBuffer(ResourceHandle handle) const { return m_resources[handle].buffer; }
+    // Stage the semaphore wait of an image imported with @waitedBySemaphore must block
+    VkPipelineStageFlags2 GetSemaphoreWaitStage(ResourceHandle handle) const { return m_resources[handle].semaphoreWaitStage; }
+    // Bytes of device memory backing transient images, and what they would take without aliasing
+    VkDeviceSize GetTransientMemorySize() const;
+    VkDeviceSize GetUnaliasedTransientMemorySize() const { return m_unaliasedTransientSize; }
+
+    // What Compile() derived: the passes that run in execution order, the barriers recorded before each of them
+    // and the transitions to the final usages after the last one
+    const std::vector<uint32_t>& GetPassOrder() const { return m_order; }
+    const std::vector<VkImageMemoryBarrier2>& GetImageBarriers(uint32_t pass) const { return m_passes[pass].imageBarriers; }
+    const std::vector<VkBufferMemoryBarrier2>& GetBufferBarriers(uint32_t pass) const { return m_passes[pass].bufferBarriers; }
+    const std::vector<VkImageMemoryBarrier2>& GetFinalImageBarriers() const { return m_finalImageBarriers; }
+
+private:
+    struct UsageInfo{
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        bool isWrite;
+    };
+
+    struct Resource{
+        std::string name;
+        bool isImage = false;
+        bool isImported = false;
+        ImageDesc desc;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+
+        // Imported images
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool waitedBySemaphore = false;
+        bool hasFinalUsage = false;
+        ResourceUsage finalUsage = ResourceUsage::Present;
+        VkPipelineStageFlags2 semaphoreWaitStage = VK_PIPELINE_STAGE_2_NONE;
+
+        // Transient images
+        int firstPass = -1;
+        int lastPass = -1;
+        int memoryBlock = -1;
+        VkMemoryRequirements memoryRequirements = {};
+    };
+
+    struct Access{
+        ResourceHandle resource;
+        UsageInfo info;
+    };
+
+    struct Pass{
+        std::string name;
+        ExecuteCallback execute;
+        bool hasSideEffects = false;
+        std::vector<Access> accesses;
+
+        // Barriers recorded before the pass, with the resource each one refers to so image and buffer
+        // handles of imported resources can be patched in right before execution
+        std::vector<VkImageMemoryBarrier2> imageBarriers;
+        std::vector<ResourceHandle> imageBarrierResources;
+        std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+        std::vector<ResourceHandle> bufferBarrierResources;
+    };
+
+    struct MemoryBlock{
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeBits = ~0u;
+        std::vector<ResourceHandle> residents;// Sorted by first use
+    };
+
+    static UsageInfo GetUsageInfo(ResourceUsage usage);
+
+    void AddAccess(uint32_t pass, ResourceHandle resource, ResourceUsage usage);
+    void CullPasses(std::vector<bool>& isAlive) const;
+    void SortPasses(const std::vector<bool>& isAlive);
+    void AllocateTransientImages();
+    void BuildBarriers();
+    void PatchAndRecordBarriers(VkCommandBuffer commandBuffer, std::vector<VkImageMemoryBarrier2>& imageBarriers,
+        const std::vector<ResourceHandle>& imageResources, std::vector<VkBufferMemoryBarrier2>& bufferBarriers,
+        const std::vector<ResourceHandle>& bufferResources);
+
+private:
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    PFN_vkCmdPipelineBarrier2 m_cmdPipelineBarrier2 = nullptr;
+
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<uint32_t> m_order;// Indices into m_passes of the passes to run, in execution order
+    std::vector<MemoryBlock> m_memoryBlocks;
+    VkDeviceSize m_unaliasedTransientSize = 0;
+
+    // Transitions of imported images to their final usage after the last pass
+    std::vector<VkImageMemoryBarrier2> m_finalImageBarriers;
+    std::vector<ResourceHandle> m_finalImageBarrierResources;
+};
@@ -0,0 +1,290 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCENE_HAS_SSE2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// One lane per object. The widest instruction set the compiler targets is used, see HELLOVULKAN_AVX
+#if defined(__AVX__)
+constexpr uint32_t SIMD_WIDTH = 8;
+using SimdFloat = __m256;
+inline SimdFloat SimdLoad(const float* p){ return _mm256_loadu_ps(p); }
+inline void SimdStore(float* p, SimdFloat v){ _mm256_storeu_ps(p, v); }
+inline SimdFloat SimdSet(float v){ return _mm256_set1_ps(v); }
+inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b){ return _mm256_add_ps(a, b); }
+inline SimdFloat SimdSub(SimdFloat a, SimdFloat b){ return _mm256_sub_ps(a, b); }
+inline SimdFloat SimdMul(SimdFloat a, SimdFloat b){ return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+inline SimdFloat SimdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c){ return _mm256_fmadd_ps(a, b, c); }
+#else
+inline SimdFloat SimdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c){ return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+const char* SIMD_NAME = "AVX";
+#elif defined(SCENE_HAS_SSE2)
+constexpr uint32_t SIMD_WIDTH = 4;
+using SimdFloat = __m128;
+inline SimdFloat SimdLoad(const float* p){ return _mm_loadu_ps(p); }
+inline void SimdStore(float* p, SimdFloat v){ _mm_storeu_ps(p, v); }
+inline SimdFloat SimdSet(float v){ return _mm_set1_ps(v); }
+inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b){ return _mm_add_ps(a, b); }
+inline SimdFloat SimdSub(SimdFloat a, SimdFloat b){ return _mm_sub_ps(a, b); }
+inline SimdFloat SimdMul(SimdFloat a, SimdFloat b){ return _mm_mul_ps(a, b); }
+inline SimdFloat SimdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c){ return _mm_add_ps(_mm_mul_ps(a, b), c); }
+const char* SIMD_NAME = "SSE2";
+#else
+constexpr uint32_t SIMD_WIDTH = 1;
+using SimdFloat = float;
+inline SimdFloat SimdLoad(const float* p){ return *p; }
+inline void SimdStore(float* p, SimdFloat v){ *p = v; }
+inline SimdFloat SimdSet(float v){ return v; }
+inline SimdFloat SimdAdd(SimdFloat a, SimdFloat b){ return a + b; }
+inline SimdFloat SimdSub(SimdFloat a, SimdFloat b){ return a - b; }
+inline SimdFloat SimdMul(SimdFloat a, SimdFloat b){ return a * b; }
+inline SimdFloat SimdMulAdd(SimdFloat a, SimdFloat b, SimdFloat c){ return a * b + c; }
+const char* SIMD_NAME = "scalar";
+#endif
+
+const float IDENTITY[12] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+
+// @result = @parent * @local for affine matrices stored as rows of 3x4, the last row being 0 0 0 1
+template<typename T, typename MulAdd, typename Mul, typename Add>
+void MultiplyAffine(const T* parent, const T* local, T* result, MulAdd mulAdd, Mul mul, Add add){
+    for(int row = 0; row < 3; row++){
+        const T* p = parent + row * 4;
+        for(int column = 0; column < 4; column++){
+            T value = mulAdd(p[2], local[8 + column], mulAdd(p[1], local[4 + column], mul(p[0], local[column])));
+            result[row * 4 + column] = column == 3 ? add(value, p[3]) : value;
+        }
+    }
+}
+
+uint32_t RoundUpToBatch(uint32_t count){
+    return (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+}
+
+Scene::ObjectHandle Scene::AddObject(ObjectHandle parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale){
+    if(parent != NO_PARENT && parent >= m_count){
+        throw std::runtime_error("Scene objects must be added after their parent!");
+    }
+
+    ObjectHandle object = m_count++;
+    Resize(RoundUpToBatch(m_count));
+    m_chunkDependenciesDirty = true;
+    m_parents[object] = parent;
+    SetPosition(object, position);
+    SetRotation(object, rotation);
+    SetScale(object, scale);
+    return object;
+}
+
+void Scene::Reserve(uint32_t count){
+    uint32_t paddedCount = RoundUpToBatch(count);
+    for(auto& component: m_positions) component.reserve(paddedCount);
+    for(auto& component: m_rotations) component.reserve(paddedCount);
+    for(auto& component: m_scales) component.reserve(paddedCount);
+    for(auto& element: m_world) element.reserve(paddedCount);
+    m_parents.reserve(paddedCount);
+    m_boundingRadii.reserve(paddedCount);
+}
+
+void Scene::Clear(){
+    m_count = 0;
+    Resize(0);
+    m_chunkDependenciesDirty = true;
+}
+
+void Scene::Resize(uint32_t paddedCount){
+    // New slots are identity transforms without a parent
+    for(auto& component: m_positions) component.resize(paddedCount, 0.0f);
+    for(int i = 0; i < 4; i++) m_rotations[i].resize(paddedCount, i == 3 ? 1.0f : 0.0f);
+    for(auto& component: m_scales) component.resize(paddedCount, 1.0f);
+    for(int i = 0; i < 12; i++) m_world[i].resize(paddedCount, IDENTITY[i]);
+    m_parents.resize(paddedCount, NO_PARENT);
+    m_boundingRadii.resize(paddedCount, 1.0f);
+}
+
+void Scene::SetPosition(ObjectHandle object, const glm::vec3& position){
+    for(int i = 0; i < 3; i++) m_positions[i][object] = position[i];
+}
+
+void Scene::SetRotation(ObjectHandle object, const glm::quat& rotation){
+    m_rotations[0][object] = rotation.x;
+    m_rotations[1][object] = rotation.y;
+    m_rotations[2][object] = rotation.z;
+    m_rotations[3][object] = rotation.w;
+}
+
+void Scene::SetScale(ObjectHandle object, const glm::vec3& scale){
+    for(int i = 0; i < 3; i++) m_scales[i][object] = scale[i];
+}
+
+void Scene::SetBoundingRadius(ObjectHandle object, float radius){
+    m_boundingRadii[object] = radius;
+}
+
+glm::mat4 Scene::GetWorldMatrix(ObjectHandle object) const{
+    glm::mat4 matrix(1.0f);
+    for(int row = 0; row < 3; row++){
+        for(int column = 0; column < 4; column++) matrix[column][row] = m_world[row * 4 + column][object];
+    }
+    return matrix;
+}
+
+const char* Scene::GetSimdName(){
+    return SIMD_NAME;
+}
+
+void Scene::UpdateTransforms(void* destination){
+    for(uint32_t chunk = 0; chunk < GetTransformChunkCount(); chunk++) UpdateTransformChunk(chunk, destination);
+}
+
+const std::vector<uint32_t>& Scene::GetTransformChunkDependencies(uint32_t chunk){
+    if(m_chunkDependenciesDirty){
+        m_chunkDependencies.assign(GetTransformChunkCount(), {});
+        for(uint32_t object = 0; object < m_count; object++){
+            uint32_t parent = m_parents[object];
+            if(parent == NO_PARENT) continue;
+            uint32_t objectChunk = object / TRANSFORM_CHUNK_SIZE;
+            uint32_t parentChunk = parent / TRANSFORM_CHUNK_SIZE;
+            auto& dependencies = m_chunkDependencies[objectChunk];
+            // Children of one parent are usually added together, so most repeats are caught here
+            if(parentChunk != objectChunk && (dependencies.empty() || dependencies.back() != parentChunk)){
+                dependencies.push_back(parentChunk);
+            }
+        }
+        for(auto& dependencies: m_chunkDependencies){
+            std::sort(dependencies.begin(), dependencies.end());
+            dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+        }
+        m_chunkDependenciesDirty = false;
+    }
+    return m_chunkDependencies[chunk];
+}
+
+void Scene::UpdateTransformChunk(uint32_t chunk, void* destination){
+    float* matrices = static_cast<float*>(destination);
+    uint32_t end = std::min(m_count, (chunk + 1) * TRANSFORM_CHUNK_SIZE);
+    for(uint32_t first = chunk * TRANSFORM_CHUNK_SIZE; first < end; first += SIMD_WIDTH){
+        UpdateBatch(first);
+        WriteMatrices(first, std::min(SIMD_WIDTH, end - first), matrices);
+    }
+#ifdef SCENE_HAS_SSE2
+    // Non-temporal stores are weakly ordered, they have to land before the frame is submitted. Each thread has to
+    // fence its own
+    _mm_sfence();
+#endif
+}
+
+void Scene::UpdateBatch(uint32_t first){
+    SimdFloat qx = SimdLoad(&m_rotations[0][first]);
+    SimdFloat qy = SimdLoad(&m_rotations[1][first]);
+    SimdFloat qz = SimdLoad(&m_rotations[2][first]);
+    SimdFloat qw = SimdLoad(&m_rotations[3][first]);
+    SimdFloat sx = SimdLoad(&m_scales[0][first]);
+    SimdFloat sy = SimdLoad(&m_scales[1][first]);
+    SimdFloat sz = SimdLoad(&m_scales[2][first]);
+
+    // Rotation matrix of a unit quaternion, columns scaled, translation in the last column
+    SimdFloat x2 = SimdAdd(qx, qx), y2 = SimdAdd(qy, qy), z2 = SimdAdd(qz, qz);
+    SimdFloat xx = SimdMul(qx, x2), yy = SimdMul(qy, y2), zz = SimdMul(qz, z2);
+    SimdFloat xy = SimdMul(qx, y2), xz = SimdMul(qx, z2), yz = SimdMul(qy, z2);
+    SimdFloat wx = SimdMul(qw, x2), wy = SimdMul(qw, y2), wz = SimdMul(qw, z2);
+    SimdFloat one = SimdSet(1.0f);
+
+    SimdFloat local[12];
+    local[0] = SimdMul(SimdSub(one, SimdAdd(yy, zz)), sx);
+    local[1] = SimdMul(SimdSub(xy, wz), sy);
+    local[2] = SimdMul(SimdAdd(xz, wy), sz);
+    local[3] = SimdLoad(&m_positions[0][first]);
+    local[4] = SimdMul(SimdAdd(xy, wz), sx);
+    local[5] = SimdMul(SimdSub(one, SimdAdd(xx, zz)), sy);
+    local[6] = SimdMul(SimdSub(yz, wx), sz);
+    local[7] = SimdLoad(&m_positions[1][first]);
+    local[8] = SimdMul(SimdSub(xz, wy), sx);
+    local[9] = SimdMul(SimdAdd(yz, wx), sy);
+    local[10] = SimdMul(SimdSub(one, SimdAdd(xx, yy)), sz);
+    local[11] = SimdLoad(&m_positions[2][first]);
+
+    bool anyParent = false;
+    bool parentsInBatch = false;
+    for(uint32_t lane = 0; lane < SIMD_WIDTH; lane++){
+        uint32_t parent = m_parents[first + lane];
+        anyParent = anyParent || parent != NO_PARENT;
+        parentsInBatch = parentsInBatch || (parent != NO_PARENT && parent >= first);
+    }
+
+    if(!anyParent){
+        for(int i = 0; i < 12; i++) SimdStore(&m_world[i][first], local[i]);
+        return;
+    }
+
+    if(!parentsInBatch){
+        // Every parent is final already, gather their matrices into lanes and multiply all objects at once
+        alignas(32) float parentLanes[12][SIMD_WIDTH];
+        for(uint32_t lane = 0; lane < SIMD_WIDTH; lane++){
+            uint32_t parent = m_parents[first + lane];
+            for(int i = 0; i < 12; i++) parentLanes[i][lane] = parent == NO_PARENT ? IDENTITY[i] : m_world[i][parent];
+        }
+        SimdFloat parentMatrix[12];
+        for(int i = 0; i < 12; i++) parentMatrix[i] = SimdLoad(parentLanes[i]);
+
+        SimdFloat world[12];
+        MultiplyAffine(parentMatrix, local, world, SimdMulAdd, SimdMul, SimdAdd);
+        for(int i = 0; i < 12; i++) SimdStore(&m_world[i][first], world[i]);
+        return;
+    }
+
+    // Some parent is in this batch, finish the objects one after another
+    alignas(32) float localLanes[12][SIMD_WIDTH];
+    for(int i = 0; i < 12; i++) SimdStore(localLanes[i], local[i]);
+    auto mulAdd = [](float a, float b, float c){ return a * b + c; };
+    auto mul = [](float a, float b){ return a * b; };
+    auto add = [](float a, float b){ return a + b; };
+    for(uint32_t lane = 0; lane < SIMD_WIDTH; lane++){
+        uint32_t object = first + lane;
+        uint32_t parent = m_parents[object];
+        float localMatrix[12], parentMatrix[12], world[12];
+        for(int i = 0; i < 12; i++){
+            localMatrix[i] = localLanes[i][lane];
+            parentMatrix[i] = parent == NO_PARENT ? IDENTITY[i] : m_world[i][parent];
+        }
+        MultiplyAffine(parentMatrix, localMatrix, world, mulAdd, mul, add);
+        for(int i = 0; i < 12; i++) m_world[i][object] = world[i];
+    }
+}
+
+void Scene::WriteMatrices(uint32_t first, uint32_t count, float* destination) const{
+    uint32_t object = first;
+#ifdef SCENE_HAS_SSE2
+    // Four objects at a time: transposing one column of the rows of four objects gives that column of each object
+    for(; object + 4 <= first + count; object += 4){
+        float* out = destination + static_cast<size_t>(object) * 16;
+        for(int column = 0; column < 4; column++){
+            __m128 c0 = _mm_loadu_ps(&m_world[column][object]);
+            __m128 c1 = _mm_loadu_ps(&m_world[4 + column][object]);
+            __m128 c2 = _mm_loadu_ps(&m_world[8 + column][object]);
+            __m128 c3 = _mm_set1_ps(column == 3 ? 1.0f : 0.0f);
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+            _mm_stream_ps(out + column * 4, c0);
+            _mm_stream_ps(out + 16 + column * 4, c1);
+            _mm_stream_ps(out + 32 + column * 4, c2);
+            _mm_stream_ps(out + 48 + column * 4, c3);
+        }
+    }
+#endif
+    for(; object < first + count; object++){
+        float* out = destination + static_cast<size_t>(object) * 16;
+        for(int column = 0; column < 4; column++){
+            for(int row = 0; row < 3; row++) out[column * 4 + row] = m_world[row * 4 + column][object];
+            out[column * 4 + 3] = column == 3 ? 1.0f : 0.0f;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Objects with a position, rotation and scale relative to their parent. Each component is kept in its own array,
+// so the transforms of a batch of objects are computed together with SIMD. A parent is always added before its
+// children, which lets all world matrices be computed in a single pass in index order
+class Scene
+{
+public:
+    using ObjectHandle = uint32_t;
+    static constexpr ObjectHandle NO_PARENT = UINT32_MAX;
+    // Objects per chunk of UpdateTransformChunk, a multiple of any SIMD width
+    static constexpr uint32_t TRANSFORM_CHUNK_SIZE = 1024;
+
+public:
+    // @parent must be NO_PARENT or an object that was added before
+    ObjectHandle AddObject(ObjectHandle parent, const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+        const glm::vec3& scale = glm::vec3(1.0f));
+    void Reserve(uint32_t count);
+    void Clear();
+
+    void SetPosition(ObjectHandle object, const glm::vec3& position);
+    void SetRotation(ObjectHandle object, const glm::quat& rotation);
+    void SetScale(ObjectHandle object, const glm::vec3& scale);
+    // Radius of a sphere around the object's origin holding its geometry before scaling, 1 unless set
+    void SetBoundingRadius(ObjectHandle object, float radius);
+
+    // Recompute every world matrix and write them to @destination as glm::mat4, one per object in index order.
+    // @destination is meant to be mapped device memory: it is 16-byte aligned, only written, and written with
+    // non-temporal stores
+    void UpdateTransforms(void* destination);
+
+    // The same update split into chunks that can run in parallel, each once the chunks listed by
+    // GetTransformChunkDependencies are done
+    uint32_t GetTransformChunkCount() const { return (m_count + TRANSFORM_CHUNK_SIZE - 1) / TRANSFORM_CHUNK_SIZE; }
+    // Earlier chunks holding parents of objects in @chunk. Recomputed after objects were added, so call it
+    // before starting any chunk
+    const std::vector<uint32_t>& GetTransformChunkDependencies(uint32_t chunk);
+    void UpdateTransformChunk(uint32_t chunk, void* destination);
+
+    uint32_t GetObjectCount() const { return m_count; }
+    ObjectHandle GetParent(ObjectHandle object) const { return m_parents[object]; }
+    // As computed by the last UpdateTransforms
+    glm::mat4 GetWorldMatrix(ObjectHandle object) const;
+    // Element [row * 4 + column] of the affine world matrix of every object, for batch processing
+    const float* GetWorldElements(uint32_t element) const { return m_world[element].data(); }
+    const float* GetBoundingRadii() const { return m_boundingRadii.data(); }
+
+    // Instruction set the transform kernels were built for
+    static const char* GetSimdName();
+
+private:
+    void Resize(uint32_t paddedCount);
+    // Compute the world matrices of objects [@first, @first + SIMD width)
+    void UpdateBatch(uint32_t first);
+    void WriteMatrices(uint32_t first, uint32_t count, float* destination) const;
+
+private:
+    uint32_t m_count = 0;
+    // Padded to a multiple of the SIMD width with identity transforms, so batches never read past the end
+    std::vector<float> m_positions[3];
+    std::vector<float> m_rotations[4];// x, y, z, w
+    std::vector<float> m_scales[3];
+    std::vector<uint32_t> m_parents;
+    std::vector<float> m_boundingRadii;
+    // Rows of the affine world matrices, m_world[row * 4 + column][object]
+    std::vector<float> m_world[12];
+
+    std::vector<std::vector<uint32_t>> m_chunkDependencies;
+    bool m_chunkDependenciesDirty = true;
+};
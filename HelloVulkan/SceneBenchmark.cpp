@@ -0,0 +1,172 @@
+// Measures Scene::UpdateTransforms against computing the same hierarchy one object at a time with glm, then how
+// the whole per-frame scene work (transforms, culling, LOD selection, draw list) scales across threads
+#include "DrawListBuilder.h"
+#include "JobScheduler.h"
+#include "Scene.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What the scene looked like before, every object a struct and its world matrix a chain of glm calls
+struct ReferenceObject{
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+    uint32_t parent;
+};
+
+static void UpdateReference(const std::vector<ReferenceObject>& objects, std::vector<glm::mat4>& world, glm::mat4* destination)
+{
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        const ReferenceObject& object = objects[i];
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), object.position) * glm::mat4_cast(object.rotation) *
+            glm::scale(glm::mat4(1.0f), object.scale);
+        world[i] = object.parent == Scene::NO_PARENT ? local : world[object.parent] * local;
+        destination[i] = world[i];
+    }
+}
+
+// Seconds per call of @update, repeated for at least a quarter of a second
+template<typename F>
+static double Measure(F update)
+{
+    update();// Warm up caches and page in the destination
+    uint32_t iterations = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed{};
+    do
+    {
+        update();
+        iterations++;
+        elapsed = std::chrono::high_resolution_clock::now() - start;
+    } while (elapsed.count() < 0.25);
+    return elapsed.count() / iterations;
+}
+
+// Random transforms, each object parented to one added before it so most are several levels deep
+static void BuildScene(uint32_t count, uint32_t branching, Scene& scene, std::vector<ReferenceObject>& reference)
+{
+    std::mt19937 random(count);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    scene.Reserve(count);
+    reference.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ReferenceObject& object = reference[i];
+        object.position = glm::vec3(unit(random), unit(random), unit(random));
+        object.rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+        object.scale = glm::vec3(1.0f + 0.1f * unit(random));
+        object.parent = i == 0 ? Scene::NO_PARENT : (i - 1) / branching;
+        scene.AddObject(object.parent, object.position, object.rotation, object.scale);
+    }
+}
+
+// Room for @size bytes, 64-byte aligned like mapped device memory
+static void* AlignedStorage(std::vector<uint8_t>& storage, size_t size)
+{
+    storage.resize(size + 64);
+    return storage.data() + (64 - reinterpret_cast<uintptr_t>(storage.data()) % 64) % 64;
+}
+
+static void MeasureScaling(uint32_t count, uint32_t branching)
+{
+    Scene scene;
+    std::vector<ReferenceObject> reference;
+    BuildScene(count, branching, scene, reference);
+
+    std::vector<uint8_t> matrixStorage;
+    void* matrices = AlignedStorage(matrixStorage, sizeof(glm::mat4) * count);
+    std::vector<uint32_t> drawList(count);
+
+    // Looking at the scene from far enough away that part of it is culled and the rest spans several LODs
+    DrawListBuilder::View view = {};
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    view.viewProjection = projection * glm::translate(glm::mat4(1.0f), glm::vec3(-2.0f, 0.0f, -12.0f));
+    view.projectionScale = projection[1][1] * 1080.0f / 2.0f;
+
+    std::cout << std::endl << "Frame scene work for " << count << " objects in " << scene.GetTransformChunkCount()
+        << " chunks" << std::endl;
+    std::cout << std::setw(10) << "threads" << std::setw(12) << "ms/frame" << std::setw(10) << "speedup"
+        << std::setw(12) << "drawn" << std::endl;
+
+    double singleThreaded = 0.0;
+    uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t threads = 1; ; threads = std::min(threads * 2, hardwareThreads))
+    {
+        JobScheduler scheduler(threads);
+        DrawListBuilder builder;
+        double time = Measure([&](){
+            builder.AddJobs(scheduler, scene, view, matrices, drawList.data());
+            scheduler.Run();
+        });
+        if (threads == 1) singleThreaded = time;
+
+        const DrawListBuilder::Result& result = builder.GetResult();
+        uint32_t drawn = 0;
+        for (uint32_t lod = 0; lod < DrawListBuilder::MAX_LOD_COUNT; lod++) drawn += result.lodCount[lod];
+        std::cout << std::setw(10) << threads << std::fixed << std::setprecision(3) << std::setw(12) << time * 1e3
+            << std::setprecision(2) << std::setw(9) << singleThreaded / time << "x" << std::setw(12) << drawn
+            << std::defaultfloat << std::endl;
+
+        if (threads == hardwareThreads) break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // Each object is parented to one added before it, most of them several levels deep
+    const uint32_t branching = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 8;
+    const uint32_t counts[] = {10000, 100000, 1000000};
+
+    std::cout << "Transform kernels: " << Scene::GetSimdName() << ", branching factor " << branching << std::endl;
+    std::cout << std::setw(10) << "objects" << std::setw(16) << "glm ns/object" << std::setw(16) << "SoA ns/object"
+        << std::setw(10) << "speedup" << std::setw(14) << "max error" << std::endl;
+
+    for (uint32_t count : counts)
+    {
+        Scene scene;
+        std::vector<ReferenceObject> reference;
+        BuildScene(count, branching, scene, reference);
+
+        std::unique_ptr<glm::mat4[]> referenceMatrices(new glm::mat4[count]);
+        std::vector<glm::mat4> referenceWorld(count);
+        std::vector<uint8_t> sceneStorage;
+        void* sceneMatrices = AlignedStorage(sceneStorage, sizeof(glm::mat4) * count);
+
+        double referenceTime = Measure([&](){ UpdateReference(reference, referenceWorld, referenceMatrices.get()); });
+        double sceneTime = Measure([&](){ scene.UpdateTransforms(sceneMatrices); });
+
+        float maxError = 0.0f;
+        const float* expected = &referenceMatrices[0][0][0];
+        const float* actual = static_cast<const float*>(sceneMatrices);
+        for (size_t i = 0; i < static_cast<size_t>(count) * 16; i++)
+        {
+            maxError = std::max(maxError, std::abs(expected[i] - actual[i]));
+        }
+
+        std::cout << std::setw(10) << count << std::fixed << std::setprecision(2)
+            << std::setw(16) << referenceTime * 1e9 / count << std::setw(16) << sceneTime * 1e9 / count
+            << std::setw(9) << referenceTime / sceneTime << "x" << std::scientific << std::setprecision(1)
+            << std::setw(14) << maxError << std::defaultfloat << std::endl;
+    }
+
+    for (uint32_t count : counts)
+    {
+        MeasureScaling(count, branching);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+#include "Telemetry.h"
+
+#include <stdexcept>
+
+const char* GetTelemetryCounterName(TelemetryCounter counter){
+    switch(counter){
+    case TelemetryCounter::MemoryAllocations: return "memoryAllocations";
+    case TelemetryCounter::MemoryFrees: return "memoryFrees";
+    case TelemetryCounter::CommandBufferAllocations: return "commandBufferAllocations";
+    case TelemetryCounter::QueueSubmits: return "queueSubmits";
+    case TelemetryCounter::DescriptorWrites: return "descriptorWrites";
+    case TelemetryCounter::PipelineBinds: return "pipelineBinds";
+    case TelemetryCounter::DrawCalls: return "drawCalls";
+    case TelemetryCounter::ObjectsDrawn: return "objectsDrawn";
+    case TelemetryCounter::ObjectsOccluded: return "objectsOccluded";
+    case TelemetryCounter::HostAllocations: return "hostAllocations";
+    default: return "unknown";
+    }
+}
+
+Telemetry::~Telemetry(){
+    // Without the physical device at this point, only the counters make it into the last report
+    m_physicalDevice = VK_NULL_HANDLE;
+    Close();
+}
+
+void Telemetry::Create(VkPhysicalDevice physicalDevice, bool memoryBudget){
+    m_physicalDevice = physicalDevice;
+    m_hasBudget = memoryBudget;
+}
+
+void Telemetry::Open(const std::string& path, TelemetryFormat format, uint32_t intervalFrames){
+    Close();
+
+    m_file = std::fopen(path.c_str(), "w");
+    if(m_file == nullptr) throw std::runtime_error("Failed to open telemetry file: " + path + "!");
+    m_format = format;
+    m_interval = intervalFrames == 0 ? 1 : intervalFrames;
+    m_wroteHeader = false;
+}
+
+void Telemetry::Close(){
+    if(m_file == nullptr) return;
+
+    Write(GetSnapshot());
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void Telemetry::EndFrame(){
+    for(uint32_t i = 0; i < TELEMETRY_COUNTER_COUNT; i++){
+        uint64_t total = m_totals[i].load(std::memory_order_relaxed);
+        m_lastFrame[i].store(total - m_frameBegin[i], std::memory_order_relaxed);
+        m_frameBegin[i] = total;
+    }
+    uint64_t frame = m_frame.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    if(m_file != nullptr && frame % m_interval == 0) Write(GetSnapshot());
+}
+
+TelemetrySnapshot Telemetry::GetSnapshot() const{
+    TelemetrySnapshot snapshot = {};
+    snapshot.frame = m_frame.load(std::memory_order_relaxed);
+    for(uint32_t i = 0; i < TELEMETRY_COUNTER_COUNT; i++){
+        snapshot.totals[i] = m_totals[i].load(std::memory_order_relaxed);
+        snapshot.lastFrame[i] = m_lastFrame[i].load(std::memory_order_relaxed);
+    }
+    if(m_physicalDevice == VK_NULL_HANDLE) return snapshot;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = m_hasBudget ? &budget : nullptr;
+    vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &properties);
+
+    snapshot.hasBudget = m_hasBudget;
+    snapshot.heaps.resize(properties.memoryProperties.memoryHeapCount);
+    for(uint32_t i = 0; i < properties.memoryProperties.memoryHeapCount; i++){
+        const VkMemoryHeap& heap = properties.memoryProperties.memoryHeaps[i];
+        snapshot.heaps[i].size = heap.size;
+        snapshot.heaps[i].budget = m_hasBudget ? budget.heapBudget[i] : 0;
+        snapshot.heaps[i].usage = m_hasBudget ? budget.heapUsage[i] : 0;
+        snapshot.heaps[i].deviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+    return snapshot;
+}
+
+void Telemetry::Write(const TelemetrySnapshot& snapshot){
+    auto toULL = [](uint64_t value){ return static_cast<unsigned long long>(value); };
+
+    if(m_format == TelemetryFormat::Json){
+        std::fprintf(m_file, "{\"frame\":%llu,\"liveAllocations\":%llu", toULL(snapshot.frame), toULL(snapshot.GetLiveAllocations()));
+        for(uint32_t i = 0; i < TELEMETRY_COUNTER_COUNT; i++){
+            std::fprintf(m_file, ",\"%s\":{\"total\":%llu,\"lastFrame\":%llu}", GetTelemetryCounterName(static_cast<TelemetryCounter>(i)),
+                toULL(snapshot.totals[i]), toULL(snapshot.lastFrame[i]));
+        }
+        std::fprintf(m_file, ",\"heaps\":[");
+        for(size_t i = 0; i < snapshot.heaps.size(); i++){
+            const TelemetryHeap& heap = snapshot.heaps[i];
+            std::fprintf(m_file, "%s{\"size\":%llu,\"deviceLocal\":%s", i == 0 ? "" : ",", toULL(heap.size), heap.deviceLocal ? "true" : "false");
+            if(snapshot.hasBudget) std::fprintf(m_file, ",\"budget\":%llu,\"usage\":%llu", toULL(heap.budget), toULL(heap.usage));
+            std::fprintf(m_file, "}");
+        }
+        std::fprintf(m_file, "]}\n");
+        return;
+    }
+
+    // The heap columns follow the first report. Later ones have the same heaps, or none once the device is gone
+    if(!m_wroteHeader){
+        std::fprintf(m_file, "frame,liveAllocations");
+        for(uint32_t i = 0; i < TELEMETRY_COUNTER_COUNT; i++){
+            const char* name = GetTelemetryCounterName(static_cast<TelemetryCounter>(i));
+            std::fprintf(m_file, ",%s,%sLastFrame", name, name);
+        }
+        m_heapColumns = snapshot.heaps.size();
+        for(size_t i = 0; i < m_heapColumns; i++) std::fprintf(m_file, ",heap%zuBudget,heap%zuUsage", i, i);
+        std::fprintf(m_file, "\n");
+        m_wroteHeader = true;
+    }
+    std::fprintf(m_file, "%llu,%llu", toULL(snapshot.frame), toULL(snapshot.GetLiveAllocations()));
+    for(uint32_t i = 0; i < TELEMETRY_COUNTER_COUNT; i++){
+        std::fprintf(m_file, ",%llu,%llu", toULL(snapshot.totals[i]), toULL(snapshot.lastFrame[i]));
+    }
+    for(size_t i = 0; i < m_heapColumns; i++){
+        if(i < snapshot.heaps.size()) std::fprintf(m_file, ",%llu,%llu", toULL(snapshot.heaps[i].budget), toULL(snapshot.heaps[i].usage));
+        else std::fprintf(m_file, ",,");
+    }
+    std::fprintf(m_file, "\n");
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class TelemetryCounter : uint32_t{
+    MemoryAllocations,// vkAllocateMemory
+    MemoryFrees,// vkFreeMemory
+    CommandBufferAllocations,// Command buffers, not calls
+    QueueSubmits,
+    DescriptorWrites,// Descriptors written through vkUpdateDescriptorSets, not calls
+    PipelineBinds,
+    DrawCalls,
+    ObjectsDrawn,// Objects the GPU drew after occlusion culling, counted when the frame's fence was waited on
+    ObjectsOccluded,// Objects in the view frustum culled by occlusion, counted like ObjectsDrawn
+    HostAllocations,// Host memory the driver allocated through the allocation callbacks, reallocations included
+    Count
+};
+
+constexpr uint32_t TELEMETRY_COUNTER_COUNT = static_cast<uint32_t>(TelemetryCounter::Count);
+
+enum class TelemetryFormat{
+    Csv,// A header, then one row per report
+    Json// One object per line
+};
+
+struct TelemetryHeap{
+    VkDeviceSize size;
+    // How much this process should stay below and how much it uses, zero without VK_EXT_memory_budget
+    VkDeviceSize budget;
+    VkDeviceSize usage;
+    bool deviceLocal;
+};
+
+struct TelemetrySnapshot{
+    uint64_t frame;// Frames ended so far
+    uint64_t totals[TELEMETRY_COUNTER_COUNT];
+    uint64_t lastFrame[TELEMETRY_COUNTER_COUNT];// Counted during the last frame that ended
+    bool hasBudget;
+    std::vector<TelemetryHeap> heaps;
+
+    uint64_t Get(TelemetryCounter counter) const { return totals[static_cast<uint32_t>(counter)]; }
+    uint64_t GetLastFrame(TelemetryCounter counter) const { return lastFrame[static_cast<uint32_t>(counter)]; }
+    // Allocations that were not freed yet, a steady climb is a leak
+    uint64_t GetLiveAllocations() const { return Get(TelemetryCounter::MemoryAllocations) - Get(TelemetryCounter::MemoryFrees); }
+};
+
+const char* GetTelemetryCounterName(TelemetryCounter counter);
+
+// Counts the Vulkan calls made per frame and in total, and reads the budget and usage of every memory heap.
+// Counting is a relaxed atomic add and safe from any thread. Snapshots are pulled with GetSnapshot, or written to a
+// file every few frames by the render thread
+class Telemetry
+{
+public:
+    ~Telemetry();
+
+    // Heaps are read from @physicalDevice, with their budget and usage when @memoryBudget says VK_EXT_memory_budget
+    // was enabled on the device
+    void Create(VkPhysicalDevice physicalDevice, bool memoryBudget);
+    // Write a snapshot to @path every @intervalFrames frames, and a last one on Close
+    void Open(const std::string& path, TelemetryFormat format, uint32_t intervalFrames);
+    // Call while the physical device is still around
+    void Close();
+
+    void Count(TelemetryCounter counter, uint64_t amount = 1){
+        m_totals[static_cast<uint32_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    // Close the current frame, the render thread calls this once per frame it submitted
+    void EndFrame();
+
+    // The counters are read one by one, so counts made meanwhile may show in some of them only
+    TelemetrySnapshot GetSnapshot() const;
+
+private:
+    void Write(const TelemetrySnapshot& snapshot);
+
+private:
+    std::atomic<uint64_t> m_totals[TELEMETRY_COUNTER_COUNT] = {};
+    std::atomic<uint64_t> m_lastFrame[TELEMETRY_COUNTER_COUNT] = {};
+    std::atomic<uint64_t> m_frame{0};
+    // The totals when the current frame began, render thread only
+    uint64_t m_frameBegin[TELEMETRY_COUNTER_COUNT] = {};
+
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    bool m_hasBudget = false;
+
+    std::FILE* m_file = nullptr;
+    TelemetryFormat m_format = TelemetryFormat::Csv;
+    uint32_t m_interval = 1;
+    bool m_wroteHeader = false;
+    size_t m_heapColumns = 0;
+};
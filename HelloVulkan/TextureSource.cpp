@@ -0,0 +1,136 @@
+#include "TextureSource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+uint32_t GetFullMipLevelCount(uint32_t width, uint32_t height){
+    uint32_t levels = 1;
+    for(uint32_t size = std::max(width, height); size > 1; size >>= 1) levels++;
+    return levels;
+}
+
+bool GetFormatBlockInfo(VkFormat format, uint32_t& blockWidth, uint32_t& blockHeight, uint32_t& blockSize){
+    blockWidth = 4;
+    blockHeight = 4;
+    switch(format){
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_SRGB:
+        blockWidth = blockHeight = 1; blockSize = 1; return true;
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R8G8_SRGB:
+        blockWidth = blockHeight = 1; blockSize = 2; return true;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        blockWidth = blockHeight = 1; blockSize = 4; return true;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        blockWidth = blockHeight = 1; blockSize = 8; return true;
+
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+        blockSize = 8; return true;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+        blockSize = 16; return true;
+
+    // Every ASTC block is 16 bytes, only its footprint varies
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK: case VK_FORMAT_ASTC_4x4_SRGB_BLOCK: blockWidth = 4; blockHeight = 4; break;
+    case VK_FORMAT_ASTC_5x4_UNORM_BLOCK: case VK_FORMAT_ASTC_5x4_SRGB_BLOCK: blockWidth = 5; blockHeight = 4; break;
+    case VK_FORMAT_ASTC_5x5_UNORM_BLOCK: case VK_FORMAT_ASTC_5x5_SRGB_BLOCK: blockWidth = 5; blockHeight = 5; break;
+    case VK_FORMAT_ASTC_6x5_UNORM_BLOCK: case VK_FORMAT_ASTC_6x5_SRGB_BLOCK: blockWidth = 6; blockHeight = 5; break;
+    case VK_FORMAT_ASTC_6x6_UNORM_BLOCK: case VK_FORMAT_ASTC_6x6_SRGB_BLOCK: blockWidth = 6; blockHeight = 6; break;
+    case VK_FORMAT_ASTC_8x5_UNORM_BLOCK: case VK_FORMAT_ASTC_8x5_SRGB_BLOCK: blockWidth = 8; blockHeight = 5; break;
+    case VK_FORMAT_ASTC_8x6_UNORM_BLOCK: case VK_FORMAT_ASTC_8x6_SRGB_BLOCK: blockWidth = 8; blockHeight = 6; break;
+    case VK_FORMAT_ASTC_8x8_UNORM_BLOCK: case VK_FORMAT_ASTC_8x8_SRGB_BLOCK: blockWidth = 8; blockHeight = 8; break;
+    case VK_FORMAT_ASTC_10x5_UNORM_BLOCK: case VK_FORMAT_ASTC_10x5_SRGB_BLOCK: blockWidth = 10; blockHeight = 5; break;
+    case VK_FORMAT_ASTC_10x6_UNORM_BLOCK: case VK_FORMAT_ASTC_10x6_SRGB_BLOCK: blockWidth = 10; blockHeight = 6; break;
+    case VK_FORMAT_ASTC_10x8_UNORM_BLOCK: case VK_FORMAT_ASTC_10x8_SRGB_BLOCK: blockWidth = 10; blockHeight = 8; break;
+    case VK_FORMAT_ASTC_10x10_UNORM_BLOCK: case VK_FORMAT_ASTC_10x10_SRGB_BLOCK: blockWidth = 10; blockHeight = 10; break;
+    case VK_FORMAT_ASTC_12x10_UNORM_BLOCK: case VK_FORMAT_ASTC_12x10_SRGB_BLOCK: blockWidth = 12; blockHeight = 10; break;
+    case VK_FORMAT_ASTC_12x12_UNORM_BLOCK: case VK_FORMAT_ASTC_12x12_SRGB_BLOCK: blockWidth = 12; blockHeight = 12; break;
+    default:
+        return false;
+    }
+    blockSize = 16;
+    return true;
+}
+
+VkDeviceSize GetImageSize(VkFormat format, uint32_t width, uint32_t height){
+    uint32_t blockWidth, blockHeight, blockSize;
+    if(!GetFormatBlockInfo(format, blockWidth, blockHeight, blockSize)){
+        throw std::runtime_error("Unsupported texture format!");
+    }
+    VkDeviceSize blocksX = (width + blockWidth - 1) / blockWidth;
+    VkDeviceSize blocksY = (height + blockHeight - 1) / blockHeight;
+    return blocksX * blocksY * blockSize;
+}
+
+void SolidColorTextureSource::ReadLevel(uint32_t /*level*/, uint8_t* destination) const{
+    memcpy(destination, m_color, sizeof(m_color));
+}
+
+CheckerboardTextureSource::CheckerboardTextureSource(uint32_t size, uint32_t squares)
+    : m_size(size), m_squares(squares)
+{
+    if(size == 0 || (size & (size - 1)) != 0 || squares == 0 || squares > size){
+        throw std::runtime_error("Checkerboard size must be a power of two of at least one texel per square!");
+    }
+}
+
+VkDeviceSize CheckerboardTextureSource::GetLevelSize(uint32_t level) const{
+    VkDeviceSize size = std::max(1u, m_size >> level);
+    return size * size * 4;
+}
+
+void CheckerboardTextureSource::ReadLevel(uint32_t level, uint8_t* destination) const{
+    uint32_t size = std::max(1u, m_size >> level);
+    const uint8_t light[4] = {230, 230, 230, 255};
+    const uint8_t dark[4] = {40, 40, 40, 255};
+
+    // Once a square is smaller than a texel the box filtered result is the average of both colors
+    if(size < m_squares * 2){
+        for(uint32_t i = 0; i < size * size; i++){
+            for(int c = 0; c < 4; c++) destination[i * 4 + c] = static_cast<uint8_t>((light[c] + dark[c]) / 2);
+        }
+        return;
+    }
+
+    // Tint each level differently, which makes the level being sampled visible
+    uint32_t squareSize = size / m_squares;
+    uint8_t tint = static_cast<uint8_t>(std::min(255u, level * 40));
+    for(uint32_t y = 0; y < size; y++){
+        for(uint32_t x = 0; x < size; x++){
+            bool isLight = ((x / squareSize) + (y / squareSize)) % 2 == 0;
+            uint8_t* texel = destination + (static_cast<size_t>(y) * size + x) * 4;
+            const uint8_t* color = isLight ? light : dark;
+            texel[0] = color[0];
+            texel[1] = static_cast<uint8_t>(std::max(0, color[1] - tint / 2));
+            texel[2] = static_cast<uint8_t>(std::max(0, color[2] - tint));
+            texel[3] = color[3];
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "VulkanCommon.h"
+
+#include <cstdint>
+
+// Where the texel data of a texture comes from. Levels are tightly packed, level 0 is the full resolution
+class TextureSource
+{
+public:
+    virtual ~TextureSource() = default;
+
+    virtual uint32_t GetWidth() const = 0;
+    virtual uint32_t GetHeight() const = 0;
+    virtual VkFormat GetFormat() const = 0;
+    // Number of levels the source can provide. A source with a single level gets its mip chain generated on the
+    // GPU, which needs that level resident, so such textures are loaded completely and never streamed
+    virtual uint32_t GetLevelCount() const = 0;
+    virtual VkDeviceSize GetLevelSize(uint32_t level) const = 0;
+    // Sources decoding in the background report levels that can not be read yet, the streamer skips them until
+    // they can. Throws if decoding the level failed
+    virtual bool IsLevelReady(uint32_t /*level*/) const { return true; }
+    // Write level @level into @destination, which holds GetLevelSize bytes of mapped staging memory
+    virtual void ReadLevel(uint32_t level, uint8_t* destination) const = 0;
+};
+
+// Number of levels of a full mip chain down to 1x1
+uint32_t GetFullMipLevelCount(uint32_t width, uint32_t height);
+
+// Texel block dimensions and size of the color formats textures can be loaded in, false for any other format
+bool GetFormatBlockInfo(VkFormat format, uint32_t& blockWidth, uint32_t& blockHeight, uint32_t& blockSize);
+// Bytes of a tightly packed @width x @height image in @format, which GetFormatBlockInfo must know
+VkDeviceSize GetImageSize(VkFormat format, uint32_t width, uint32_t height);
+
+// A single RGBA8 texel of one color
+class SolidColorTextureSource : public TextureSource
+{
+public:
+    SolidColorTextureSource(uint8_t r, uint8_t g, uint8_t b, uint8_t a) : m_color{r, g, b, a} {}
+
+    uint32_t GetWidth() const override { return 1; }
+    uint32_t GetHeight() const override { return 1; }
+    VkFormat GetFormat() const override { return VK_FORMAT_R8G8B8A8_UNORM; }
+    uint32_t GetLevelCount() const override { return 1; }
+    VkDeviceSize GetLevelSize(uint32_t /*level*/) const override { return 4; }
+    void ReadLevel(uint32_t /*level*/, uint8_t* destination) const override;
+
+private:
+    uint8_t m_color[4];
+};
+
+// An RGBA8 checkerboard of @size x @size texels (a power of two) with @squares squares per side. Every level is
+// computed at its own resolution, so it can be streamed like a texture with a stored mip chain
+class CheckerboardTextureSource : public TextureSource
+{
+public:
+    CheckerboardTextureSource(uint32_t size, uint32_t squares);
+
+    uint32_t GetWidth() const override { return m_size; }
+    uint32_t GetHeight() const override { return m_size; }
+    VkFormat GetFormat() const override { return VK_FORMAT_R8G8B8A8_SRGB; }
+    uint32_t GetLevelCount() const override { return GetFullMipLevelCount(m_size, m_size); }
+    VkDeviceSize GetLevelSize(uint32_t level) const override;
+    void ReadLevel(uint32_t level, uint8_t* destination) const override;
+
+private:
+    uint32_t m_size;
+    uint32_t m_squares;
+};
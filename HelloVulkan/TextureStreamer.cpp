@@ -0,0 +1,432 @@
+#include "TextureStreamer.h"
+
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Levels no larger than this are always resident, so every texture can be sampled at some quality
+constexpr uint32_t MINIMUM_RESIDENT_SIZE = 128;
+// Satisfies the buffer offset alignment of copies for every format, block-compressed ones included
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+VkDeviceSize AlignStaging(VkDeviceSize size){
+    return (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+}
+
+VkExtent3D GetLevelExtent(const TextureSource& source, uint32_t level){
+    return {std::max(1u, source.GetWidth() >> level), std::max(1u, source.GetHeight() >> level), 1};
+}
+
+void TransitionImage(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount,
+    VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+    VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+}
+
+void TextureStreamer::Create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t framesInFlight, VkDeviceSize budget,
+    VkDeviceSize stagingSize)
+{
+    m_physicalDevice = physicalDevice;
+    m_device = device;
+    m_framesInFlight = framesInFlight;
+    m_budget = budget;
+    m_stagingSize = stagingSize;
+
+    CreateBuffer(m_physicalDevice, m_device, m_stagingSize * m_framesInFlight, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_stagingBuffer, m_stagingBufferMemory);
+    void* mapped;
+    ThrowIfFailed(vkMapMemory(m_device, m_stagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &mapped),
+        "Failed to map texture staging memory!");
+    m_stagingMapped = static_cast<uint8_t*>(mapped);
+
+    // Anisotropic filtering is enabled on the device whenever it is supported
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &features);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.anisotropyEnable = features.samplerAnisotropy;
+    samplerInfo.maxAnisotropy = features.samplerAnisotropy ? std::min(16.0f, properties.limits.maxSamplerAnisotropy) : 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    // Views only cover the resident levels, so the LOD never has to be clamped here
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    ThrowIfFailed(vkCreateSampler(m_device, &samplerInfo, GetAllocationCallbacks(), &m_sampler),
+        "Failed to create texture sampler!");
+
+    m_fallbackTexture = AddTexture(std::make_shared<SolidColorTextureSource>(255, 255, 255, 255));
+}
+
+void TextureStreamer::Destroy(){
+    for(auto& retired: m_retiredImages){
+        vkDestroyImageView(m_device, retired.view, GetAllocationCallbacks());
+        vkDestroyImage(m_device, retired.image, GetAllocationCallbacks());
+        FreeMemory(m_device, retired.memory);
+    }
+    m_retiredImages.clear();
+
+    for(auto& texture: m_textures){
+        vkDestroyImageView(m_device, texture.view, GetAllocationCallbacks());
+        vkDestroyImage(m_device, texture.image, GetAllocationCallbacks());
+        FreeMemory(m_device, texture.memory);
+    }
+    m_textures.clear();
+    m_residentBytes = 0;
+
+    vkDestroySampler(m_device, m_sampler, GetAllocationCallbacks());
+    vkDestroyBuffer(m_device, m_stagingBuffer, GetAllocationCallbacks());
+    FreeMemory(m_device, m_stagingBufferMemory);
+    m_sampler = VK_NULL_HANDLE;
+    m_stagingBuffer = VK_NULL_HANDLE;
+    m_stagingBufferMemory = VK_NULL_HANDLE;
+    m_stagingMapped = nullptr;
+}
+
+TextureStreamer::TextureHandle TextureStreamer::AddTexture(std::shared_ptr<TextureSource> source){
+    Texture texture;
+    texture.source = std::move(source);
+    texture.levelCount = texture.source->GetLevelCount();
+
+    // A lone base level gets its mip chain blitted, if the format can be filtered linearly
+    if(texture.levelCount == 1){
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, texture.source->GetFormat(), &formatProperties);
+        VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if((formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures){
+            texture.generateMips = true;
+            texture.levelCount = GetFullMipLevelCount(texture.source->GetWidth(), texture.source->GetHeight());
+        }
+    }
+
+    if(texture.generateMips){
+        texture.minimumLevel = 0;
+    }else{
+        texture.minimumLevel = texture.levelCount - 1;
+        while(texture.minimumLevel > 0){
+            VkExtent3D extent = GetLevelExtent(*texture.source, texture.minimumLevel - 1);
+            if(std::max(extent.width, extent.height) > MINIMUM_RESIDENT_SIZE) break;
+            texture.minimumLevel--;
+        }
+    }
+    texture.residentLevel = texture.levelCount;
+    texture.desiredLevel = texture.minimumLevel;
+
+    // The first load has to fit into one frame of staging memory
+    VkDeviceSize firstLoad = 0;
+    uint32_t lastSourceLevel = texture.generateMips ? 1 : texture.levelCount;
+    for(uint32_t level = texture.minimumLevel; level < lastSourceLevel; level++){
+        firstLoad += AlignStaging(texture.source->GetLevelSize(level));
+    }
+    if(firstLoad > m_stagingSize){
+        throw std::runtime_error("Texture does not fit into the staging memory of a frame!");
+    }
+
+    m_textures.push_back(std::move(texture));
+    return static_cast<TextureHandle>(m_textures.size() - 1);
+}
+
+VkImageView TextureStreamer::GetImageView(TextureHandle texture) const{
+    VkImageView view = m_textures[texture].view;
+    return view != VK_NULL_HANDLE ? view : m_textures[m_fallbackTexture].view;
+}
+
+void TextureStreamer::RequestCoverage(TextureHandle texture, float pixelWidth, float pixelHeight){
+    Texture& t = m_textures[texture];
+    t.lastUsedFrame = m_frameNumber;
+    if(t.generateMips) return;
+
+    // The level at which one texel lands on about one pixel
+    float ratio = std::max(t.source->GetWidth() / std::max(pixelWidth, 1.0f), t.source->GetHeight() / std::max(pixelHeight, 1.0f));
+    uint32_t level = ratio <= 1.0f ? 0 : static_cast<uint32_t>(std::floor(std::log2(ratio)));
+    t.desiredLevel = std::min(level, t.minimumLevel);
+}
+
+void TextureStreamer::RequestAllLevels(TextureHandle texture){
+    Texture& t = m_textures[texture];
+    t.lastUsedFrame = m_frameNumber;
+    if(!t.generateMips) t.desiredLevel = 0;
+}
+
+bool TextureStreamer::IsSettled() const{
+    for(const auto& texture: m_textures){
+        if(texture.image == VK_NULL_HANDLE) return false;
+        if(texture.generateMips || texture.desiredLevel >= texture.residentLevel) continue;
+
+        uint32_t newLevel = texture.residentLevel - 1;
+        bool fitsStaging = AlignStaging(texture.source->GetLevelSize(newLevel)) <= m_stagingSize;
+        bool fitsBudget = m_residentBytes - texture.memorySize + GetLevelsSize(texture, newLevel) <= m_budget;
+        if(fitsStaging && fitsBudget) return false;
+    }
+    return true;
+}
+
+void TextureStreamer::BeginFrame(uint64_t frameNumber, uint32_t frameIndex){
+    m_frameNumber = frameNumber;
+    m_stagingBase = m_stagingSize * frameIndex;
+    m_stagingUsed = 0;
+
+    // Frame @frameNumber - framesInFlight and everything before it has finished
+    auto finished = std::remove_if(m_retiredImages.begin(), m_retiredImages.end(), [this](const RetiredImage& retired){
+        if(retired.frameNumber + m_framesInFlight > m_frameNumber) return false;
+        vkDestroyImageView(m_device, retired.view, GetAllocationCallbacks());
+        vkDestroyImage(m_device, retired.image, GetAllocationCallbacks());
+        FreeMemory(m_device, retired.memory);
+        return true;
+    });
+    m_retiredImages.erase(finished, m_retiredImages.end());
+}
+
+VkDeviceSize TextureStreamer::GetLevelsSize(const Texture& texture, uint32_t firstLevel) const{
+    VkDeviceSize size = 0;
+    if(texture.generateMips){
+        // Generated levels are not known to the source, assume the format size of the base level
+        VkDeviceSize baseSize = texture.source->GetLevelSize(0);
+        VkExtent3D base = GetLevelExtent(*texture.source, 0);
+        for(uint32_t level = firstLevel; level < texture.levelCount; level++){
+            VkExtent3D extent = GetLevelExtent(*texture.source, level);
+            size += std::max<VkDeviceSize>(1, baseSize * extent.width * extent.height / (base.width * base.height));
+        }
+        return size;
+    }
+    for(uint32_t level = firstLevel; level < texture.levelCount; level++) size += texture.source->GetLevelSize(level);
+    return size;
+}
+
+bool TextureStreamer::StageLevel(const Texture& texture, uint32_t level, VkDeviceSize& stagingOffset){
+    VkDeviceSize size = texture.source->GetLevelSize(level);
+    VkDeviceSize alignedSize = AlignStaging(size);
+    if(m_stagingUsed + alignedSize > m_stagingSize) return false;
+
+    stagingOffset = m_stagingBase + m_stagingUsed;
+    texture.source->ReadLevel(level, m_stagingMapped + stagingOffset);
+    m_stagingUsed += alignedSize;
+    return true;
+}
+
+void TextureStreamer::RecordUploads(VkCommandBuffer commandBuffer){
+    // Textures without anything resident come first, they can not be sampled at all yet
+    for(auto& texture: m_textures){
+        if(texture.image != VK_NULL_HANDLE) continue;
+
+        VkDeviceSize stagingSize = 0;
+        bool ready = true;
+        uint32_t lastSourceLevel = texture.generateMips ? 1 : texture.levelCount;
+        for(uint32_t level = texture.minimumLevel; level < lastSourceLevel; level++){
+            stagingSize += AlignStaging(texture.source->GetLevelSize(level));
+            ready = ready && texture.source->IsLevelReady(level);
+        }
+        if(!ready || m_stagingUsed + stagingSize > m_stagingSize) continue;
+
+        Reallocate(commandBuffer, texture, texture.minimumLevel);
+    }
+
+    // Then one more level for each texture that needs it, the ones furthest from what they need first
+    std::vector<Texture*> candidates;
+    for(auto& texture: m_textures){
+        if(texture.image == VK_NULL_HANDLE || texture.generateMips) continue;
+        if(texture.lastUsedFrame == m_frameNumber && texture.desiredLevel < texture.residentLevel) candidates.push_back(&texture);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Texture* a, const Texture* b){
+        return a->residentLevel - a->desiredLevel > b->residentLevel - b->desiredLevel;
+    });
+
+    for(Texture* texture: candidates){
+        uint32_t newLevel = texture->residentLevel - 1;
+        if(!texture->source->IsLevelReady(newLevel)) continue;
+
+        VkDeviceSize levelSize = AlignStaging(texture->source->GetLevelSize(newLevel));
+        if(m_stagingUsed + levelSize > m_stagingSize) break;
+
+        VkDeviceSize newSize = GetLevelsSize(*texture, newLevel);
+        while(m_residentBytes - texture->memorySize + newSize > m_budget){
+            if(!EvictOne(commandBuffer, texture)) break;
+        }
+        if(m_residentBytes - texture->memorySize + newSize > m_budget) continue;
+
+        Reallocate(commandBuffer, *texture, newLevel);
+    }
+}
+
+bool TextureStreamer::EvictOne(VkCommandBuffer commandBuffer, const Texture* keep){
+    // Least recently used first. Textures drawn this frame only give up levels finer than they need
+    Texture* victim = nullptr;
+    for(auto& texture: m_textures){
+        if(&texture == keep || texture.image == VK_NULL_HANDLE || texture.generateMips) continue;
+        if(texture.residentLevel >= texture.minimumLevel) continue;
+        if(texture.lastUsedFrame == m_frameNumber && texture.desiredLevel <= texture.residentLevel) continue;
+        if(victim == nullptr || texture.lastUsedFrame < victim->lastUsedFrame) victim = &texture;
+    }
+    if(victim == nullptr) return false;
+
+    Reallocate(commandBuffer, *victim, victim->residentLevel + 1);
+    return true;
+}
+
+void TextureStreamer::RetireImage(Texture& texture){
+    if(texture.image == VK_NULL_HANDLE) return;
+
+    m_retiredImages.push_back({m_frameNumber, texture.image, texture.memory, texture.view});
+    m_residentBytes -= texture.memorySize;
+    texture.image = VK_NULL_HANDLE;
+    texture.memory = VK_NULL_HANDLE;
+    texture.view = VK_NULL_HANDLE;
+    texture.memorySize = 0;
+}
+
+void TextureStreamer::Reallocate(VkCommandBuffer commandBuffer, Texture& texture, uint32_t newResidentLevel){
+    const TextureSource& source = *texture.source;
+    uint32_t oldResidentLevel = texture.residentLevel;
+    uint32_t levelCount = texture.levelCount - newResidentLevel;
+    VkFormat format = source.GetFormat();
+
+    // Stage the levels the old image does not have before creating anything
+    std::vector<std::pair<uint32_t, VkDeviceSize>> uploads;
+    uint32_t lastUpload = texture.generateMips ? std::min(1u, oldResidentLevel) : oldResidentLevel;
+    for(uint32_t level = newResidentLevel; level < lastUpload; level++){
+        VkDeviceSize stagingOffset;
+        if(!StageLevel(texture, level, stagingOffset)){
+            throw std::runtime_error("Out of texture staging memory!");
+        }
+        uploads.push_back({level, stagingOffset});
+    }
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = GetLevelExtent(source, newResidentLevel);
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImage image;
+    ThrowIfFailed(vkCreateImage(m_device, &imageInfo, GetAllocationCallbacks(), &image),
+        "Failed to create texture image!");
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = FindMemoryType(m_physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkDeviceMemory memory;
+    ThrowIfFailed(AllocateMemory(m_device, allocInfo, memory),
+        "Failed to allocate texture memory!");
+    vkBindImageMemory(m_device, image, memory, 0);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+
+    VkImageView view;
+    ThrowIfFailed(vkCreateImageView(m_device, &viewInfo, GetAllocationCallbacks(), &view),
+        "Failed to create texture image view!");
+
+    TransitionImage(commandBuffer, image, 0, levelCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    // Levels both images have are copied on the GPU. Earlier frames may still sample the old image, the
+    // transition waits for them
+    if(texture.image != VK_NULL_HANDLE){
+        uint32_t firstShared = std::max(oldResidentLevel, newResidentLevel);
+        TransitionImage(commandBuffer, texture.image, firstShared - oldResidentLevel, texture.levelCount - firstShared,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        std::vector<VkImageCopy> regions;
+        for(uint32_t level = firstShared; level < texture.levelCount; level++){
+            VkImageCopy region = {};
+            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - oldResidentLevel, 0, 1};
+            region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - newResidentLevel, 0, 1};
+            region.extent = GetLevelExtent(source, level);
+            regions.push_back(region);
+        }
+        vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+    }
+
+    for(const auto& upload: uploads){
+        VkBufferImageCopy region = {};
+        region.bufferOffset = upload.second;
+        region.bufferRowLength = 0;// Tightly packed
+        region.bufferImageHeight = 0;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, upload.first - newResidentLevel, 0, 1};
+        region.imageExtent = GetLevelExtent(source, upload.first);
+        vkCmdCopyBufferToImage(commandBuffer, m_stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+
+    if(texture.generateMips){
+        // Each level is a linear downscale of the one before it
+        for(uint32_t level = 1; level < levelCount; level++){
+            TransitionImage(commandBuffer, image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+            VkExtent3D srcExtent = GetLevelExtent(source, level - 1);
+            VkExtent3D dstExtent = GetLevelExtent(source, level);
+            VkImageBlit blit = {};
+            blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+            blit.srcOffsets[1] = {static_cast<int32_t>(srcExtent.width), static_cast<int32_t>(srcExtent.height), 1};
+            blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+            blit.dstOffsets[1] = {static_cast<int32_t>(dstExtent.width), static_cast<int32_t>(dstExtent.height), 1};
+            vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1, &blit, VK_FILTER_LINEAR);
+        }
+        if(levelCount > 1){
+            TransitionImage(commandBuffer, image, 0, levelCount - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+        TransitionImage(commandBuffer, image, levelCount - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }else{
+        TransitionImage(commandBuffer, image, 0, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    RetireImage(texture);
+    texture.image = image;
+    texture.memory = memory;
+    texture.view = view;
+    texture.memorySize = memRequirements.size;
+    texture.residentLevel = newResidentLevel;
+    m_residentBytes += memRequirements.size;
+    m_generation++;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "TextureSource.h"
+#include "VulkanCommon.h"
+
+#include <memory>
+#include <vector>
+
+// Keeps textures in device memory under a budget. Each texture owns an image holding only its resident levels,
+// from the finest one it needs down to 1x1. Once per frame the streamer adds the next finer level to the textures
+// that cover enough of the screen to need it, the coarsest ones first, and drops the finest levels of the least
+// recently used textures when the budget would be exceeded. Changing residency reallocates the image and copies the
+// levels it keeps on the GPU, so the texel data is only uploaded once per level.
+//
+// All commands are recorded into the frame command buffer before any pass samples the textures. Images that were
+// replaced are destroyed once the frames that may still sample them have finished.
+class TextureStreamer
+{
+public:
+    using TextureHandle = uint32_t;
+
+public:
+    // @stagingSize bytes of upload memory are available per frame in flight, a single level must fit into it
+    void Create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t framesInFlight, VkDeviceSize budget,
+        VkDeviceSize stagingSize = 32ull * 1024 * 1024);
+    // The device must be idle
+    void Destroy();
+
+    // The texture becomes available with its coarsest levels after the next RecordUploads
+    TextureHandle AddTexture(std::shared_ptr<TextureSource> source);
+
+    // The texture is drawn this frame covering @pixelWidth x @pixelHeight pixels, which decides the finest level
+    // it needs. Textures that are not requested for a while are the first to lose levels
+    void RequestCoverage(TextureHandle texture, float pixelWidth, float pixelHeight);
+    // Like RequestCoverage, but the texture needs every level however little of the screen it covers
+    void RequestAllLevels(TextureHandle texture);
+
+    // Call once the fence of frame slot @frameIndex was waited on
+    void BeginFrame(uint64_t frameNumber, uint32_t frameIndex);
+    // Decide this frame's residency changes and record them
+    void RecordUploads(VkCommandBuffer commandBuffer);
+
+    // A white texel until the first load was recorded, which is the next RecordUploads unless several textures
+    // were added at once or the source is still decoding. The view changes whenever residency does
+    VkImageView GetImageView(TextureHandle texture) const;
+    VkSampler GetSampler() const { return m_sampler; }
+    // Increases whenever any image view changed, descriptors written for an older generation must be rewritten
+    uint64_t GetGeneration() const { return m_generation; }
+
+    // Every texture has an image and none still gets a finer level it was requested at. A level that does not fit
+    // the staging memory or the budget left free counts as never coming, evicting other textures is not considered
+    bool IsSettled() const;
+
+    uint32_t GetResidentLevel(TextureHandle texture) const { return m_textures[texture].residentLevel; }
+    VkDeviceSize GetResidentBytes() const { return m_residentBytes; }
+    VkDeviceSize GetBudget() const { return m_budget; }
+
+private:
+    struct Texture{
+        std::shared_ptr<TextureSource> source;
+        uint32_t levelCount = 0;// Of the full chain
+        // Finest level of the current image, levelCount while nothing is resident
+        uint32_t residentLevel = 0;
+        // Coarsest level the texture is allowed to be reduced to
+        uint32_t minimumLevel = 0;
+        uint32_t desiredLevel = 0;
+        bool generateMips = false;
+        uint64_t lastUsedFrame = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDeviceSize memorySize = 0;
+    };
+
+    struct RetiredImage{
+        uint64_t frameNumber;
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView view;
+    };
+
+    VkDeviceSize GetLevelsSize(const Texture& texture, uint32_t firstLevel) const;
+    // Copy level @level of @texture into this frame's staging memory, false when it does not fit anymore
+    bool StageLevel(const Texture& texture, uint32_t level, VkDeviceSize& stagingOffset);
+    // Replace the image of @texture by one holding levels @newResidentLevel and coarser
+    void Reallocate(VkCommandBuffer commandBuffer, Texture& texture, uint32_t newResidentLevel);
+    // Drop the finest level of the least recently used texture that can lose one, false if none can
+    bool EvictOne(VkCommandBuffer commandBuffer, const Texture* keep);
+    void RetireImage(Texture& texture);
+
+private:
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    uint32_t m_framesInFlight = 0;
+    VkDeviceSize m_budget = 0;
+    VkDeviceSize m_residentBytes = 0;
+    VkSampler m_sampler = VK_NULL_HANDLE;
+
+    // One segment of @m_stagingSize bytes per frame in flight, persistently mapped
+    VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_stagingBufferMemory = VK_NULL_HANDLE;
+    uint8_t* m_stagingMapped = nullptr;
+    VkDeviceSize m_stagingSize = 0;
+    VkDeviceSize m_stagingBase = 0;
+    VkDeviceSize m_stagingUsed = 0;
+
+    std::vector<Texture> m_textures;
+    std::vector<RetiredImage> m_retiredImages;
+    uint64_t m_frameNumber = 0;
+    uint64_t m_generation = 0;
+    // Stands in for textures that have nothing resident yet, loaded with the first RecordUploads
+    TextureHandle m_fallbackTexture = 0;
+};
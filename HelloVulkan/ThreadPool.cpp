@@ -0,0 +1,61 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount){
+    if(threadCount == 0){
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for(uint32_t i = 0; i < threadCount; i++){
+        m_threads.emplace_back([this](){ WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_taskAvailable.notify_all();
+
+    for(auto& thread: m_threads) thread.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_taskAvailable.notify_one();
+}
+
+void ThreadPool::WaitIdle(){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this](){ return m_tasks.empty() && m_activeTasks == 0; });
+}
+
+void ThreadPool::WorkerLoop(){
+    while(true){
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskAvailable.wait(lock, [this](){ return m_stopping || !m_tasks.empty(); });
+
+            // Finish the queued work before shutting down
+            if(m_tasks.empty()) return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            m_activeTasks++;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_activeTasks--;
+            if(m_tasks.empty() && m_activeTasks == 0) m_idle.notify_all();
+        }
+    }
+}
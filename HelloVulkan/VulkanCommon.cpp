@@ -0,0 +1,134 @@
+#include "VulkanCommon.h"
+
+#include "HostAllocator.h"
+#include "Telemetry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace {
+    std::atomic<Telemetry*> g_memoryTelemetry{nullptr};
+}
+
+uint32_t FindMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties){
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    // typeFilter is a bitfield of which a bit represents a MemoryType that is supported by this resource
+    for(uint32_t i = 0; i < memProperties.memoryTypeCount; i++){
+        if((typeFilter & (1 << i)) && // So we first check if the MemoryType is supported
+            (memProperties.memoryTypes[i].propertyFlags & properties) == properties){// And then check there are our wanted properties
+            return i;
+        }
+    }
+
+    throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+void SetMemoryTelemetry(Telemetry* telemetry){
+    g_memoryTelemetry.store(telemetry, std::memory_order_release);
+}
+
+VkResult AllocateMemory(VkDevice device, const VkMemoryAllocateInfo& allocInfo, VkDeviceMemory& memory){
+    VkResult result = vkAllocateMemory(device, &allocInfo, GetAllocationCallbacks(), &memory);
+    Telemetry* telemetry = g_memoryTelemetry.load(std::memory_order_acquire);
+    if(result == VK_SUCCESS && telemetry != nullptr) telemetry->Count(TelemetryCounter::MemoryAllocations);
+    return result;
+}
+
+void FreeMemory(VkDevice device, VkDeviceMemory memory){
+    if(memory == VK_NULL_HANDLE) return;
+    vkFreeMemory(device, memory, GetAllocationCallbacks());
+    Telemetry* telemetry = g_memoryTelemetry.load(std::memory_order_acquire);
+    if(telemetry != nullptr) telemetry->Count(TelemetryCounter::MemoryFrees);
+}
+
+void CreateBuffer(void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+    const std::vector<uint32_t>& queueFamilies)
+{
+    std::vector<uint32_t> uniqueFamilies = queueFamilies;
+    std::sort(uniqueFamilies.begin(), uniqueFamilies.end());
+    uniqueFamilies.erase(std::unique(uniqueFamilies.begin(), uniqueFamilies.end()), uniqueFamilies.end());
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    if(uniqueFamilies.size() > 1){
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(uniqueFamilies.size());
+        bufferInfo.pQueueFamilyIndices = uniqueFamilies.data();
+    }else{
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    ThrowIfFailed(vkCreateBuffer(device, &bufferInfo, GetAllocationCallbacks(), &buffer),
+        "Failed to create buffer!");
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = FindMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+
+    ThrowIfFailed(AllocateMemory(device, allocInfo, bufferMemory),
+        "Failed to allocate buffer memory!");
+
+    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+}
+
+VkShaderModule CreateShaderModule(VkDevice device, ByteSpan code){
+    if(code.Empty() || code.size % sizeof(uint32_t) != 0){
+        throw std::runtime_error("SPIR-V code size is not a multiple of 4!");
+    }
+
+    // pCode must point at 4-byte aligned words. Mapped files always are, only views into the middle of
+    // some other buffer may need a copy
+    std::vector<uint32_t> alignedCode;
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(code.data);
+    if(reinterpret_cast<uintptr_t>(code.data) % alignof(uint32_t) != 0){
+        alignedCode.resize(code.size / sizeof(uint32_t));
+        memcpy(alignedCode.data(), code.data, code.size);
+        words = alignedCode.data();
+    }
+
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size;
+    createInfo.pCode = words;
+
+    VkShaderModule shaderModule;
+    ThrowIfFailed(vkCreateShaderModule(device, &createInfo, GetAllocationCallbacks(), &shaderModule),
+        "Failed to create shader module!");
+
+    return shaderModule;
+}
+
+const VkPipelineDynamicStateCreateInfo& GetViewportDynamicState(){
+    static const VkDynamicState states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    static const VkPipelineDynamicStateCreateInfo dynamicStateInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO, nullptr, 0, 2, states
+    };
+    return dynamicStateInfo;
+}
+
+void SetPipelineTarget(VkGraphicsPipelineCreateInfo& pipelineInfo, const RenderTarget& target,
+    VkPipelineRenderingCreateInfo& renderingInfo)
+{
+    pipelineInfo.renderPass = target.renderPass;
+    pipelineInfo.subpass = 0;
+    if(target.renderPass != VK_NULL_HANDLE) return;
+
+    renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.pNext = pipelineInfo.pNext;
+    renderingInfo.viewMask = target.viewMask;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &target.colorFormat;
+    renderingInfo.depthAttachmentFormat = target.depthFormat;
+    pipelineInfo.pNext = &renderingInfo;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "FileSystem.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class Telemetry;
+
+// If @result is not VK_SUCCESS, throw a std::runtime_error with description @text
+#define ThrowIfFailed(result, text) if(result != VK_SUCCESS){throw std::runtime_error(text);}
+
+template<typename T>
+T Clamp(T value, T minValue, T maxValue){
+    if(value > maxValue){
+        return maxValue;
+    }else if(value < minValue){
+        return minValue;
+    }else{
+        return value;
+    }
+}
+
+// Find a memory type of @physicalDevice allowed by @typeFilter that has all of @properties
+uint32_t FindMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+// Count the device memory AllocateMemory and FreeMemory hand out and take back towards @telemetry, nowhere when null
+void SetMemoryTelemetry(Telemetry* telemetry);
+
+// vkAllocateMemory, counted as TelemetryCounter::MemoryAllocations when it succeeds
+VkResult AllocateMemory(VkDevice device, const VkMemoryAllocateInfo& allocInfo, VkDeviceMemory& memory);
+
+// vkFreeMemory, counted as TelemetryCounter::MemoryFrees unless @memory is VK_NULL_HANDLE
+void FreeMemory(VkDevice device, VkDeviceMemory memory);
+
+// Create @buffer and bind it to a dedicated allocation @bufferMemory. When @queueFamilies names more than one
+// distinct family the buffer is shared concurrently between them, so no ownership transfers are needed
+void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+    const std::vector<uint32_t>& queueFamilies = {});
+
+// Wrap SPIR-V @code in a shader module. The words are passed to the driver in place when they are aligned
+VkShaderModule CreateShaderModule(VkDevice device, ByteSpan code);
+
+// Dynamic viewport and scissor, set with vkCmdSetViewport and vkCmdSetScissor. Pipelines using it do not depend on
+// the size they draw at
+const VkPipelineDynamicStateCreateInfo& GetViewportDynamicState();
+
+// The attachments a graphics pipeline draws into. With a render pass they are those of its first subpass, without
+// one (dynamic rendering) they are described by their formats and begun with vkCmdBeginRendering
+struct RenderTarget{
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    // Views every draw is broadcast to with multiview, zero without. Render passes carry their own
+    uint32_t viewMask = 0;
+};
+
+// Point @pipelineInfo at @target. @renderingInfo receives the formats for dynamic rendering, both must stay alive
+// until the pipeline is created
+void SetPipelineTarget(VkGraphicsPipelineCreateInfo& pipelineInfo, const RenderTarget& target,
+    VkPipelineRenderingCreateInfo& renderingInfo);
@@ -2,13 +2,296 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <string>
 
-int main()
+static const char* USAGE =
+    "Usage: HelloVulkan [--device <name substring | UUID>] [--headless] [--frames <count>] [--size <width>x<height>]\n"
+    "                   [--readback raw|png] [--output <directory>] [--readback-ring <buffers>]\n"
+    "                   [--mount <directory | archive.pak>]... [--pipeline-cache <file | \"\">]\n"
+    "                   [--texture <file.ktx2>] [--texture-budget <MiB>]\n"
+    "                   [--job-threads <count>]\n"
+    "                   [--log-file <file>] [--log-format text|json|binary] [--log-level verbose|info|warning|error]\n"
+    "                   [--log-rate-limit <messages per second>] [--profile <trace.json>]\n"
+    "                   [--telemetry <file>] [--telemetry-format csv|json] [--telemetry-interval <frames>]\n"
+    "                   [--capture <file>] [--replay <file>] [--replay-iterations <count>]\n"
+    "                   [--stress-objects <count>] [--stress-triangles <per object>] [--stress-pipelines <count>]\n"
+    "                   [--stress-upload-kb <KiB per frame>] [--benchmark <results.json>]\n"
+    "                   [--meshlets off|auto|compute|mesh] [--occlusion-culling] [--render-passes]\n"
+    "                   [--resolution-budget <GPU ms>] [--resolution-scale <min %>-<max %>] [--upscale bilinear|sharpen]\n"
+    "                   [--frame-pacing off|auto|cpu] [--target-fps <frames per second>]\n"
+    "                   [--multiview off|stereo|cubemap]";
+
+static uint64_t ParseNumber(const std::string& arg, const std::string& value)
+{
+    size_t end = 0;
+    unsigned long long number = 0;
+    try
+    {
+        number = std::stoull(value, &end);
+    }
+    catch (const std::exception&)
+    {
+        end = 0;
+    }
+    if (end == 0 || end != value.size())
+    {
+        throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+    }
+    return number;
+}
+
+// A positive decimal number such as a duration in milliseconds
+static float ParseDecimal(const std::string& arg, const std::string& value)
+{
+    size_t end = 0;
+    float number = 0.0f;
+    try
+    {
+        number = std::stof(value, &end);
+    }
+    catch (const std::exception&)
+    {
+        end = 0;
+    }
+    if (end == 0 || end != value.size() || !(number > 0.0f))
+    {
+        throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+    }
+    return number;
+}
+
+// Fill @options from the command line, throwing on unknown or incomplete arguments
+static ApplicationOptions ParseCommandLine(int argc, char** argv)
 {
-    Application app;
+    ApplicationOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--device" && i + 1 < argc)
+        {
+            options.preferredDevice = argv[++i];
+        }
+        else if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            options.frameCount = ParseNumber(arg, argv[++i]);
+        }
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('x');
+            if (separator == std::string::npos)
+            {
+                throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+            }
+            options.width = static_cast<uint32_t>(ParseNumber(arg, value.substr(0, separator)));
+            options.height = static_cast<uint32_t>(ParseNumber(arg, value.substr(separator + 1)));
+            if (options.width == 0 || options.height == 0)
+            {
+                throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+            }
+        }
+        else if (arg == "--readback" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "raw") options.readbackFormat = ReadbackFormat::Raw;
+            else if (value == "png") options.readbackFormat = ReadbackFormat::Png;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            options.readbackDirectory = argv[++i];
+        }
+        else if (arg == "--readback-ring" && i + 1 < argc)
+        {
+            options.readbackRingSize = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+            if (options.readbackRingSize == 0)
+            {
+                throw std::runtime_error("Invalid value for " + arg + ": 0\n" + USAGE);
+            }
+        }
+        else if (arg == "--mount" && i + 1 < argc)
+        {
+            options.assetMounts.push_back(argv[++i]);
+        }
+        else if (arg == "--pipeline-cache" && i + 1 < argc)
+        {
+            options.pipelineCacheFile = argv[++i];
+        }
+        else if (arg == "--job-threads" && i + 1 < argc)
+        {
+            options.jobThreads = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--texture" && i + 1 < argc)
+        {
+            options.texture = argv[++i];
+        }
+        else if (arg == "--texture-budget" && i + 1 < argc)
+        {
+            options.textureBudgetMB = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--log-file" && i + 1 < argc)
+        {
+            options.logFile = argv[++i];
+        }
+        else if (arg == "--log-format" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "text") options.logFormat = LogFormat::Text;
+            else if (value == "json") options.logFormat = LogFormat::Json;
+            else if (value == "binary") options.logFormat = LogFormat::Binary;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+        }
+        else if (arg == "--log-level" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "verbose") options.logSeverity = LogSeverity::Verbose;
+            else if (value == "info") options.logSeverity = LogSeverity::Info;
+            else if (value == "warning") options.logSeverity = LogSeverity::Warning;
+            else if (value == "error") options.logSeverity = LogSeverity::Error;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+        }
+        else if (arg == "--log-rate-limit" && i + 1 < argc)
+        {
+            options.logRateLimit = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--profile" && i + 1 < argc)
+        {
+            options.profileFile = argv[++i];
+        }
+        else if (arg == "--telemetry" && i + 1 < argc)
+        {
+            options.telemetryFile = argv[++i];
+        }
+        else if (arg == "--telemetry-format" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "csv") options.telemetryFormat = TelemetryFormat::Csv;
+            else if (value == "json") options.telemetryFormat = TelemetryFormat::Json;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+        }
+        else if (arg == "--telemetry-interval" && i + 1 < argc)
+        {
+            options.telemetryInterval = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--capture" && i + 1 < argc)
+        {
+            options.captureFile = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            options.replayFile = argv[++i];
+        }
+        else if (arg == "--replay-iterations" && i + 1 < argc)
+        {
+            options.replayIterations = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+            if (options.replayIterations == 0)
+            {
+                throw std::runtime_error("Invalid value for " + arg + ": 0\n" + USAGE);
+            }
+        }
+        else if (arg == "--stress-objects" && i + 1 < argc)
+        {
+            options.stress.objectCount = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--stress-triangles" && i + 1 < argc)
+        {
+            options.stress.trianglesPerObject = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--stress-pipelines" && i + 1 < argc)
+        {
+            options.stress.pipelineCount = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--stress-upload-kb" && i + 1 < argc)
+        {
+            options.stress.uploadKB = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--benchmark" && i + 1 < argc)
+        {
+            options.benchmarkFile = argv[++i];
+        }
+        else if (arg == "--meshlets" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "off") options.meshlets = MeshletMode::Off;
+            else if (value == "auto") options.meshlets = MeshletMode::Auto;
+            else if (value == "compute") options.meshlets = MeshletMode::Compute;
+            else if (value == "mesh") options.meshlets = MeshletMode::MeshShader;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+        }
+        else if (arg == "--occlusion-culling")
+        {
+            options.occlusionCulling = true;
+        }
+        else if (arg == "--render-passes")
+        {
+            options.dynamicRendering = false;
+        }
+        else if (arg == "--resolution-budget" && i + 1 < argc)
+        {
+            options.gpuBudgetMs = ParseDecimal(arg, argv[++i]);
+        }
+        else if (arg == "--resolution-scale" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t separator = value.find('-');
+            if (separator == std::string::npos)
+            {
+                throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+            }
+            options.minResolutionPercent = static_cast<uint32_t>(ParseNumber(arg, value.substr(0, separator)));
+            options.maxResolutionPercent = static_cast<uint32_t>(ParseNumber(arg, value.substr(separator + 1)));
+            if (options.minResolutionPercent == 0 || options.minResolutionPercent > options.maxResolutionPercent ||
+                options.maxResolutionPercent > 100)
+            {
+                throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+            }
+        }
+        else if (arg == "--upscale" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "bilinear") options.upscaleFilter = UpscaleFilter::Bilinear;
+            else if (value == "sharpen") options.upscaleFilter = UpscaleFilter::Sharpen;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+        }
+        else if (arg == "--frame-pacing" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "off") options.framePacing = FramePacingMode::Off;
+            else if (value == "auto") options.framePacing = FramePacingMode::Auto;
+            else if (value == "cpu") options.framePacing = FramePacingMode::Cpu;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+        }
+        else if (arg == "--target-fps" && i + 1 < argc)
+        {
+            options.targetFrameRate = static_cast<uint32_t>(ParseNumber(arg, argv[++i]));
+        }
+        else if (arg == "--multiview" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (value == "off") options.multiview = MultiviewMode::Off;
+            else if (value == "stereo") options.multiview = MultiviewMode::Stereo;
+            else if (value == "cubemap") options.multiview = MultiviewMode::Cubemap;
+            else throw std::runtime_error("Invalid value for " + arg + ": " + value + "\n" + USAGE);
+        }
+        else
+        {
+            throw std::runtime_error("Unknown or incomplete argument: " + arg + "\n" + USAGE);
+        }
+    }
+
+    return options;
+}
 
+int main(int argc, char** argv)
+{
     try
     {
+        Application app(ParseCommandLine(argc, argv));
         app.Run();
     }
     catch (const std::exception &e)
@@ -18,4 +301,4 @@ int main()
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,23 @@
+# Run by CTest for every perf scene: benchmarks the scene with HelloVulkan, then checks the results against its
+# baseline with PerfCompare. Expects HELLOVULKAN, PERF_COMPARE, RESULTS and BASELINE, ARGS holds the HelloVulkan
+# arguments separated by spaces and TOLERANCE, when not empty, replaces the baseline's
+separate_arguments(SCENE_ARGS UNIX_COMMAND "${ARGS}")
+get_filename_component(RESULTS_DIR ${RESULTS} DIRECTORY)
+file(MAKE_DIRECTORY ${RESULTS_DIR})
+
+execute_process(COMMAND ${HELLOVULKAN} ${SCENE_ARGS} --benchmark ${RESULTS} RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "HelloVulkan failed: ${RESULT}")
+endif()
+
+if(NOT EXISTS ${BASELINE})
+    message(FATAL_ERROR "No baseline at ${BASELINE}, record one with the perf_baselines target")
+endif()
+set(COMPARE_ARGS ${RESULTS} ${BASELINE})
+if(NOT "${TOLERANCE}" STREQUAL "")
+    list(PREPEND COMPARE_ARGS --tolerance ${TOLERANCE})
+endif()
+execute_process(COMMAND ${PERF_COMPARE} ${COMPARE_ARGS} RESULT_VARIABLE RESULT)
+if(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "${BASELINE} regressed")
+endif()
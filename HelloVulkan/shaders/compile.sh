@@ -1,2 +1,12 @@
 /usr/local/bin/glslc shader.vert -o vert.spv
-/usr/local/bin/glslc shader.frag -o frag.spv
\ No newline at end of file
+/usr/local/bin/glslc shader.frag -o frag.spv
+/usr/local/bin/glslc particle.comp -o particle_comp.spv
+/usr/local/bin/glslc particle.vert -o particle_vert.spv
+/usr/local/bin/glslc particle.frag -o particle_frag.spv
+/usr/local/bin/glslc meshlet_cull.comp -o meshlet_cull_comp.spv
+/usr/local/bin/glslc --target-env=vulkan1.2 meshlet.task -o meshlet_task.spv
+/usr/local/bin/glslc --target-env=vulkan1.2 meshlet.mesh -o meshlet_mesh.spv
+/usr/local/bin/glslc hiz_reduce.comp -o hiz_reduce_comp.spv
+/usr/local/bin/glslc occlusion_cull.comp -o occlusion_cull_comp.spv
+/usr/local/bin/glslc upscale.comp -o upscale_comp.spv
+/usr/local/bin/glslc -DMULTIVIEW shader.vert -o vert_multiview.spv
\ No newline at end of file
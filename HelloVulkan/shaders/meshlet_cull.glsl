@@ -0,0 +1,27 @@
+// Meshlet culling shared by meshlet_cull.comp and meshlet.task, which declare the CullParams push constants
+
+// Whether any of a meshlet with bounds @sphere and normal cone @cone may show when its instance is drawn with @world
+bool IsMeshletVisible(vec4 sphere, vec4 cone, mat4 world){
+    vec3 center = (world * vec4(sphere.xyz, 1.0)).xyz;
+    vec3 scale = vec3(length(world[0].xyz), length(world[1].xyz), length(world[2].xyz));
+    float radius = sphere.w * max(scale.x, max(scale.y, scale.z));
+
+    for(int i = 0; i < 6; i++){
+        if(dot(params.planes[i].xyz, center) + params.planes[i].w < -radius){
+            return false;
+        }
+    }
+
+    // Scaling unevenly bends the normals away from the cone, so such instances keep all their meshlets. A mirroring
+    // matrix turns the winding around, and with it the side the cone faces
+    bool uniformScale = max(scale.x, max(scale.y, scale.z)) <= 1.01 * min(scale.x, min(scale.y, scale.z));
+    if(cone.w < 1.0 && uniformScale){
+        mat3 rotation = mat3(world);
+        vec3 axis = normalize(rotation * cone.xyz) * sign(determinant(rotation));
+        vec3 toCenter = center - params.cameraPosition;
+        if(dot(toCenter, axis) >= cone.w * length(toCenter) + radius){
+            return false;
+        }
+    }
+    return true;
+}
@@ -1,18 +1,46 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform UniformBufferObject{
-    mat4 model;
+// Built a second time with MULTIVIEW defined into vert_multiview.spv, drawing every view of the pass at once
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+#define VIEW_INDEX gl_ViewIndex
+#else
+#define VIEW_INDEX 0
+#endif
+
+// Matches Multiview::MAX_VIEW_COUNT
+#define MAX_VIEW_COUNT 6
+
+struct ViewUniforms{
     mat4 view;
     mat4 proj;
+};
+
+layout(binding = 0) uniform UniformBufferObject{
+    ViewUniforms views[MAX_VIEW_COUNT];
 }ubo;
 
+// World matrix of every scene object
+layout(std430, binding = 2) readonly buffer ObjectBuffer{
+    mat4 world[];
+}objects;
+
+// Indices of the objects drawn this frame, grouped by LOD
+layout(std430, binding = 3) readonly buffer DrawList{
+    uint objectIndices[];
+}drawList;
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
 
 void main(){
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+    ViewUniforms view = ubo.views[VIEW_INDEX];
+    gl_Position = view.proj * view.view * objects.world[drawList.objectIndices[gl_InstanceIndex]] * vec4(inPosition, 0.0, 1.0);
     fragColor = inColor;
+    fragTexCoord = inTexCoord;
 }
\ No newline at end of file
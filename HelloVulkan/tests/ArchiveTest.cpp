@@ -0,0 +1,86 @@
+// Packs a few files stored and with LZ4, mounts each archive with and without a thread pool and checks that every
+// file comes back byte for byte, through Open as well as ReadInto. One file spans several chunks, one does not
+// shrink when compressed and one is empty
+#include "Check.h"
+
+#include "Archive.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace {
+
+struct TestFile{
+    std::string path;
+    std::vector<uint8_t> bytes;
+};
+
+void CheckMount(const ArchiveMount& mount, const std::vector<TestFile>& files){
+    for(const TestFile& file: files){
+        CHECK(mount.Exists(file.path));
+
+        size_t size = 0;
+        CHECK(mount.GetSize(file.path, size));
+        CHECK(size == file.bytes.size());
+
+        Asset asset;
+        CHECK(mount.Open(file.path, asset));
+        CHECK(std::vector<uint8_t>(asset.GetBytes().begin(), asset.GetBytes().end()) == file.bytes);
+
+        std::vector<uint8_t> read(file.bytes.size() + 1, 0xcd);
+        CHECK(mount.ReadInto(file.path, read.data()));
+        CHECK(std::equal(file.bytes.begin(), file.bytes.end(), read.begin()));
+        CHECK(read.back() == 0xcd);
+    }
+
+    size_t size = 0;
+    Asset asset;
+    CHECK(!mount.Exists("missing.bin"));
+    CHECK(!mount.GetSize("missing.bin", size));
+    CHECK(!mount.Open("missing.bin", asset));
+}
+
+}
+
+int main(){
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "HelloVulkanArchiveTest";
+    std::filesystem::create_directories(directory);
+
+    std::vector<TestFile> files(4);
+    files[0].path = "meshes/repeating.bin";
+    files[0].bytes.resize(3 * ARCHIVE_CHUNK_SIZE + 123);
+    for(size_t i = 0; i < files[0].bytes.size(); i++) files[0].bytes[i] = static_cast<uint8_t>(i % 251 < 200 ? i % 7 : i % 251);
+    files[1].path = "textures/noise.bin";
+    files[1].bytes.resize(5000);
+    std::mt19937 random(42);
+    for(uint8_t& byte: files[1].bytes) byte = static_cast<uint8_t>(random());
+    files[2].path = "shaders/empty.spv";
+    files[3].path = "readme.txt";
+    const std::string text = "Packed by the archive test";
+    files[3].bytes.assign(text.begin(), text.end());
+
+    std::vector<ArchiveInput> inputs;
+    for(size_t i = 0; i < files.size(); i++){
+        std::string filename = (directory / ("input" + std::to_string(i) + ".bin")).string();
+        std::ofstream(filename, std::ios::binary).write(reinterpret_cast<const char*>(files[i].bytes.data()),
+            static_cast<std::streamsize>(files[i].bytes.size()));
+        inputs.push_back({files[i].path, filename});
+    }
+
+    ThreadPool threadPool(4);
+    std::string stored = (directory / "stored.pak").string();
+    std::string compressed = (directory / "compressed.pak").string();
+    WriteArchive(stored, inputs, Compression::None, 0, threadPool);
+    WriteArchive(compressed, inputs, Compression::Lz4, 1, threadPool);
+    CHECK(std::filesystem::file_size(compressed) < std::filesystem::file_size(stored));
+
+    for(const std::string& archive: {stored, compressed}){
+        CheckMount(ArchiveMount(archive), files);
+        CheckMount(ArchiveMount(archive, &threadPool), files);
+    }
+
+    std::filesystem::remove_all(directory);
+    return g_checkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <iostream>
+
+// Failed checks so far, what the main of a test returns
+inline int g_checkFailures = 0;
+
+// Reports a condition that does not hold along with where it was checked, the test goes on with the next check
+#define CHECK(condition) \
+    do{ \
+        if(!(condition)){ \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" << #condition << ") failed" << std::endl; \
+            g_checkFailures++; \
+        } \
+    }while(false)
@@ -0,0 +1,92 @@
+// Checks that sort keys order by pass, pipeline, material, mesh and depth in that priority, and that sorting the
+// queue on one thread and on the job scheduler both give the order of a stable sort by key
+#include "Check.h"
+
+#include "DrawQueue.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+// Push @count packets whose keys repeat often, each remembering its push index in firstInstance
+void PushPackets(DrawQueue& queue, uint32_t count, std::mt19937& random){
+    for(uint32_t i = 0; i < count; i++){
+        DrawPacket packet = {};
+        packet.key = DrawQueue::MakeSortKey(random() % 3, random() % 5, random() % 40, random() % 3, (random() % 4) / 4.0f);
+        packet.vertexCount = 3;
+        packet.instanceCount = 1;
+        packet.firstInstance = i;
+        CHECK(queue.Push(packet));
+    }
+}
+
+void CheckSorted(const DrawQueue& queue){
+    std::vector<DrawPacket> expected(queue.GetPackets(), queue.GetPackets() + queue.GetPacketCount());
+    std::stable_sort(expected.begin(), expected.end(), [](const DrawPacket& a, const DrawPacket& b){ return a.key < b.key; });
+
+    uint32_t mismatches = 0;
+    for(uint32_t i = 0; i < queue.GetPacketCount(); i++){
+        const DrawPacket& packet = queue.GetSortedPacket(i);
+        if(packet.key != expected[i].key || packet.firstInstance != expected[i].firstInstance) mismatches++;
+    }
+    CHECK(mismatches == 0);
+}
+
+}
+
+int main(){
+    // Each field outranks everything after it, even at their largest
+    const uint32_t maxPipeline = (1u << DrawQueue::PIPELINE_BITS) - 1;
+    const uint32_t maxMaterial = (1u << DrawQueue::MATERIAL_BITS) - 1;
+    const uint32_t maxMesh = (1u << DrawQueue::MESH_BITS) - 1;
+    CHECK(DrawQueue::MakeSortKey(0, maxPipeline, maxMaterial, maxMesh, 1.0f) < DrawQueue::MakeSortKey(1, 0, 0, 0, 0.0f));
+    CHECK(DrawQueue::MakeSortKey(2, 3, maxMaterial, maxMesh, 1.0f) < DrawQueue::MakeSortKey(2, 4, 0, 0, 0.0f));
+    CHECK(DrawQueue::MakeSortKey(2, 3, 7, maxMesh, 1.0f) < DrawQueue::MakeSortKey(2, 3, 8, 0, 0.0f));
+    CHECK(DrawQueue::MakeSortKey(2, 3, 7, 5, 1.0f) < DrawQueue::MakeSortKey(2, 3, 7, 6, 0.0f));
+    // Front to back, out of range depths are clamped
+    CHECK(DrawQueue::MakeSortKey(2, 3, 7, 5, 0.25f) < DrawQueue::MakeSortKey(2, 3, 7, 5, 0.5f));
+    CHECK(DrawQueue::MakeSortKey(2, 3, 7, 5, -1.0f) == DrawQueue::MakeSortKey(2, 3, 7, 5, 0.0f));
+    CHECK(DrawQueue::MakeSortKey(2, 3, 7, 5, 2.0f) == DrawQueue::MakeSortKey(2, 3, 7, 5, 1.0f));
+
+    bool threw = false;
+    try{
+        DrawQueue::MakeSortKey(1u << DrawQueue::PASS_BITS, 0, 0, 0, 0.0f);
+    }catch(const std::runtime_error&){
+        threw = true;
+    }
+    CHECK(threw);
+
+    std::mt19937 random(7);
+    DrawQueue queue;
+
+    // Below the threshold the sort stays on one thread even with a scheduler
+    queue.Create(1000);
+    PushPackets(queue, 1000, random);
+    DrawPacket overflow = {};
+    CHECK(!queue.Push(overflow));
+    CHECK(queue.GetDroppedCount() == 1);
+    queue.Sort(nullptr);
+    CheckSorted(queue);
+
+    // Packets that all share one key keep their push order
+    queue.Reset();
+    for(uint32_t i = 0; i < 100; i++){
+        DrawPacket packet = {};
+        packet.key = DrawQueue::MakeSortKey(1, 2, 3, 4, 0.5f);
+        packet.firstInstance = i;
+        queue.Push(packet);
+    }
+    queue.Sort(nullptr);
+    CheckSorted(queue);
+
+    JobScheduler scheduler(4);
+    const uint32_t parallelCount = 8 * DrawQueue::PARALLEL_SORT_THRESHOLD + 17;
+    queue.Create(parallelCount);
+    PushPackets(queue, parallelCount, random);
+    queue.Sort(&scheduler);
+    CheckSorted(queue);
+
+    return g_checkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+// Drives the allocation callbacks the way a driver would and checks the accounting: allocations, frees and bytes per
+// scope, what was pooled, reallocations in place, into a bigger slot and out to malloc, and that threads allocating
+// at once leave nothing behind
+#include "Check.h"
+
+#include "HostAllocator.h"
+
+#include <cstring>
+#include <thread>
+
+namespace {
+
+bool IsAligned(const void* memory, size_t alignment){
+    return reinterpret_cast<uintptr_t>(memory) % alignment == 0;
+}
+
+bool IsFilled(const void* memory, size_t size, uint8_t value){
+    const uint8_t* bytes = static_cast<const uint8_t*>(memory);
+    for(size_t i = 0; i < size; i++){
+        if(bytes[i] != value) return false;
+    }
+    return true;
+}
+
+}
+
+int main(){
+    HostAllocator allocator;
+    const VkAllocationCallbacks& callbacks = *allocator.GetCallbacks();
+    void* userData = callbacks.pUserData;
+    const VkSystemAllocationScope object = VK_SYSTEM_ALLOCATION_SCOPE_OBJECT;
+    const VkSystemAllocationScope command = VK_SYSTEM_ALLOCATION_SCOPE_COMMAND;
+
+    CHECK(callbacks.pfnAllocation(userData, 0, 8, object) == nullptr);
+    CHECK(allocator.GetStats().GetAllocations() == 0);
+
+    void* memory = callbacks.pfnAllocation(userData, 100, 8, object);
+    CHECK(memory != nullptr && IsAligned(memory, 8));
+    std::memset(memory, 0x5a, 100);
+    HostAllocatorStats stats = allocator.GetStats();
+    CHECK(stats.currentBytes == 100);
+    CHECK(stats.scopes[object].allocations == 1);
+    CHECK(stats.scopes[object].currentBytes == 100);
+    CHECK(stats.pooledAllocations == 1);
+    CHECK(stats.pooledBytes == HostAllocator::CHUNK_SIZE);
+
+    // Still fits the slot: same memory, the bytes move to the scope of the reallocation
+    CHECK(callbacks.pfnReallocation(userData, memory, 110, 8, command) == memory);
+    stats = allocator.GetStats();
+    CHECK(stats.currentBytes == 110);
+    CHECK(stats.scopes[object].frees == 1);
+    CHECK(stats.scopes[object].currentBytes == 0);
+    CHECK(stats.scopes[command].allocations == 1);
+    CHECK(stats.scopes[command].currentBytes == 110);
+    CHECK(stats.pooledAllocations == 1);
+
+    // Into a bigger size class, then out of the pool altogether, keeping the contents each time
+    void* moved = callbacks.pfnReallocation(userData, memory, 1000, 8, command);
+    CHECK(moved != nullptr && moved != memory);
+    CHECK(IsFilled(moved, 100, 0x5a));
+    std::memset(moved, 0x3c, 1000);
+    void* large = callbacks.pfnReallocation(userData, moved, 2 * HostAllocator::MAX_POOLED_SIZE, 16, command);
+    CHECK(large != nullptr && IsAligned(large, 16));
+    CHECK(IsFilled(large, 1000, 0x3c));
+    stats = allocator.GetStats();
+    CHECK(stats.currentBytes == 2 * HostAllocator::MAX_POOLED_SIZE);
+    CHECK(stats.scopes[command].allocations == 3);
+    CHECK(stats.scopes[command].frees == 2);
+    CHECK(stats.pooledAllocations == 2);
+    // The original is only freed once the move is done
+    CHECK(stats.peakBytes == 2 * HostAllocator::MAX_POOLED_SIZE + 1000);
+
+    // A reallocation to zero bytes frees
+    CHECK(callbacks.pfnReallocation(userData, large, 0, 16, command) == nullptr);
+    callbacks.pfnFree(userData, nullptr);
+    stats = allocator.GetStats();
+    CHECK(stats.currentBytes == 0);
+    CHECK(stats.scopes[command].frees == 3);
+
+    // A freed slot is handed out again without growing the pool, alignments beyond the header are honoured
+    void* first = callbacks.pfnAllocation(userData, 40, 64, object);
+    CHECK(first != nullptr && IsAligned(first, 64));
+    callbacks.pfnFree(userData, first);
+    const size_t pooledBytes = allocator.GetStats().pooledBytes;
+    void* second = callbacks.pfnAllocation(userData, 40, 64, object);
+    CHECK(second == first);
+    CHECK(allocator.GetStats().pooledBytes == pooledBytes);
+    callbacks.pfnFree(userData, second);
+
+    // Reported only, these never pass through the allocator
+    callbacks.pfnInternalAllocation(userData, 4096, VK_INTERNAL_ALLOCATION_TYPE_EXECUTABLE, object);
+    stats = allocator.GetStats();
+    CHECK(stats.scopes[object].internalAllocations == 1);
+    CHECK(stats.scopes[object].internalBytes == 4096);
+    CHECK(stats.currentBytes == 0);
+    callbacks.pfnInternalFree(userData, 4096, VK_INTERNAL_ALLOCATION_TYPE_EXECUTABLE, object);
+    CHECK(allocator.GetStats().scopes[object].internalBytes == 0);
+
+    std::vector<std::thread> threads;
+    for(uint32_t t = 0; t < 4; t++){
+        threads.emplace_back([&callbacks, userData, t](){
+            std::vector<void*> live;
+            for(uint32_t i = 0; i < 10000; i++){
+                size_t size = 1 + (i * 37 + t * 101) % (2 * HostAllocator::MAX_POOLED_SIZE);
+                void* allocation = callbacks.pfnAllocation(userData, size, 8, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+                std::memset(allocation, static_cast<int>(t), size);
+                live.push_back(allocation);
+                if(i % 3 == 2){
+                    live[i % live.size()] = callbacks.pfnReallocation(userData, live[i % live.size()], size / 2 + 1, 8,
+                        VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+                }
+                if(live.size() > 64){
+                    callbacks.pfnFree(userData, live.front());
+                    live.erase(live.begin());
+                }
+            }
+            for(void* allocation: live) callbacks.pfnFree(userData, allocation);
+        });
+    }
+    for(std::thread& thread: threads) thread.join();
+
+    stats = allocator.GetStats();
+    CHECK(stats.currentBytes == 0);
+    uint64_t frees = 0;
+    for(const HostAllocationScopeStats& scope: stats.scopes){
+        CHECK(scope.currentBytes == 0);
+        frees += scope.frees;
+    }
+    CHECK(stats.GetAllocations() == frees);
+
+    return g_checkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Builds meshlets for a flat grid, a cube and a fan that reuses a few vertices for many triangles, and checks the
+// vertex and triangle limits, that the meshlets reproduce the source triangles, and their bounding spheres and cones
+#include "Check.h"
+
+#include "MeshletBuilder.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Positions are followed by a texture coordinate, so the stride is not the size of a position
+constexpr size_t VERTEX_FLOATS = 5;
+
+struct TestMesh{
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+
+    void AddVertex(float x, float y, float z){
+        vertices.insert(vertices.end(), {x, y, z, 0.0f, 0.0f});
+    }
+    size_t GetVertexCount() const { return vertices.size() / VERTEX_FLOATS; }
+};
+
+// @size by @size quads in the z = 0 plane, wound counter-clockwise seen from +z
+TestMesh MakeGrid(uint32_t size){
+    TestMesh mesh;
+    for(uint32_t y = 0; y <= size; y++){
+        for(uint32_t x = 0; x <= size; x++) mesh.AddVertex(static_cast<float>(x), static_cast<float>(y), 0.0f);
+    }
+    for(uint32_t y = 0; y < size; y++){
+        for(uint32_t x = 0; x < size; x++){
+            uint32_t corner = y * (size + 1) + x;
+            mesh.indices.insert(mesh.indices.end(), {corner, corner + 1, corner + size + 2, corner, corner + size + 2, corner + size + 1});
+        }
+    }
+    return mesh;
+}
+
+// The unit cube, every face wound counter-clockwise seen from outside
+TestMesh MakeCube(){
+    TestMesh mesh;
+    for(uint32_t i = 0; i < 8; i++) mesh.AddVertex(static_cast<float>(i & 1), static_cast<float>((i >> 1) & 1), static_cast<float>(i >> 2));
+    mesh.indices = {0, 2, 3, 0, 3, 1,  4, 5, 7, 4, 7, 6,  0, 1, 5, 0, 5, 4,  2, 6, 7, 2, 7, 3,  0, 4, 6, 0, 6, 2,  1, 3, 7, 1, 7, 5};
+    return mesh;
+}
+
+MeshletMesh Build(const TestMesh& mesh){
+    return BuildMeshlets(mesh.vertices.data(), VERTEX_FLOATS * sizeof(float), mesh.GetVertexCount(), mesh.indices.data(),
+        mesh.indices.size());
+}
+
+// The limits hold, the meshlets tile the vertex and triangle arrays in order and give back the source triangles
+void CheckMeshlets(const TestMesh& source, const MeshletMesh& mesh){
+    CHECK(mesh.bounds.size() == mesh.meshlets.size());
+    uint32_t vertexOffset = 0;
+    uint32_t triangleOffset = 0;
+    for(const Meshlet& meshlet: mesh.meshlets){
+        CHECK(meshlet.vertexCount > 0 && meshlet.vertexCount <= MAX_MESHLET_VERTICES);
+        CHECK(meshlet.triangleCount > 0 && meshlet.triangleCount <= MAX_MESHLET_TRIANGLES);
+        CHECK(meshlet.vertexOffset == vertexOffset);
+        CHECK(meshlet.triangleOffset == triangleOffset);
+        for(uint32_t i = 0; i < meshlet.triangleCount * 3; i++){
+            CHECK(mesh.triangles[meshlet.triangleOffset * 3 + i] < meshlet.vertexCount);
+        }
+        vertexOffset += meshlet.vertexCount;
+        triangleOffset += meshlet.triangleCount;
+    }
+    CHECK(vertexOffset == mesh.vertices.size());
+    CHECK(triangleOffset * 3 == mesh.triangles.size());
+    CHECK(mesh.GetIndices() == source.indices);
+
+    // Every vertex lies in the sphere of its meshlet
+    for(size_t m = 0; m < mesh.meshlets.size(); m++){
+        const Meshlet& meshlet = mesh.meshlets[m];
+        const MeshletBounds& bounds = mesh.bounds[m];
+        CHECK(bounds.coneCutoff <= 1.0f);
+        for(uint32_t i = 0; i < meshlet.vertexCount; i++){
+            const float* position = &source.vertices[mesh.vertices[meshlet.vertexOffset + i] * VERTEX_FLOATS];
+            float dx = position[0] - bounds.center[0];
+            float dy = position[1] - bounds.center[1];
+            float dz = position[2] - bounds.center[2];
+            CHECK(std::sqrt(dx * dx + dy * dy + dz * dz) <= bounds.radius * 1.0001f + 1e-5f);
+        }
+    }
+}
+
+}
+
+int main(){
+    // The vertex limit closes the meshlets of the grid. Flat, every cone points along +z and is as narrow as it gets
+    TestMesh grid = MakeGrid(40);
+    MeshletMesh gridMeshlets = Build(grid);
+    CheckMeshlets(grid, gridMeshlets);
+    CHECK(gridMeshlets.meshlets.size() > 1);
+    for(const MeshletBounds& bounds: gridMeshlets.bounds){
+        CHECK(std::fabs(bounds.coneAxis[0]) < 1e-5f && std::fabs(bounds.coneAxis[1]) < 1e-5f);
+        CHECK(std::fabs(bounds.coneAxis[2] - 1.0f) < 1e-5f);
+        CHECK(bounds.coneCutoff < 1e-3f);
+        CHECK(std::fabs(bounds.center[2]) < 1e-5f);
+    }
+
+    // The normals of a closed cube cancel out, its cone must never cull
+    TestMesh cube = MakeCube();
+    MeshletMesh cubeMeshlets = Build(cube);
+    CheckMeshlets(cube, cubeMeshlets);
+    CHECK(cubeMeshlets.meshlets.size() == 1);
+    if(cubeMeshlets.meshlets.size() == 1){
+        CHECK(cubeMeshlets.meshlets[0].vertexCount == 8);
+        CHECK(cubeMeshlets.bounds[0].coneCutoff == 1.0f);
+        CHECK(std::fabs(cubeMeshlets.bounds[0].radius - std::sqrt(0.75f)) < 1e-5f);
+    }
+
+    // Triangles over the same few vertices only ever hit the triangle limit
+    TestMesh fan;
+    for(uint32_t i = 0; i < 10; i++) fan.AddVertex(std::cos(i * 0.6f), std::sin(i * 0.6f), 0.0f);
+    for(uint32_t i = 0; i < 2 * MAX_MESHLET_TRIANGLES + 5; i++){
+        fan.indices.insert(fan.indices.end(), {0, 1 + i % 8, 2 + i % 8});
+    }
+    MeshletMesh fanMeshlets = Build(fan);
+    CheckMeshlets(fan, fanMeshlets);
+    CHECK(fanMeshlets.meshlets.size() == 3);
+    if(fanMeshlets.meshlets.size() == 3){
+        CHECK(fanMeshlets.meshlets[0].triangleCount == MAX_MESHLET_TRIANGLES);
+        CHECK(fanMeshlets.meshlets[1].triangleCount == MAX_MESHLET_TRIANGLES);
+        CHECK(fanMeshlets.meshlets[2].triangleCount == 5);
+    }
+
+    bool threw = false;
+    try{
+        BuildMeshlets(grid.vertices.data(), VERTEX_FLOATS * sizeof(float), grid.GetVertexCount(), grid.indices.data(), 4);
+    }catch(const std::runtime_error&){
+        threw = true;
+    }
+    CHECK(threw);
+
+    return g_checkFailures == 0 ? 0 : 1;
+}
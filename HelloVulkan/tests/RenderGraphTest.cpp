@@ -0,0 +1,83 @@
+// Compiles a small graph without a device and checks the barriers derived for it: a compute pass writes a buffer two
+// draws read, both drawing into an imported image that is presented afterwards. A pass writing an image nobody reads
+// is culled before any transient image is created
+#include "Check.h"
+
+#include "RenderGraph.h"
+
+int main(){
+    RenderGraph graph;
+    const ResourceUsage present = ResourceUsage::Present;
+    RenderGraph::ResourceHandle particles = graph.ImportBuffer("particles");
+    RenderGraph::ResourceHandle color = graph.ImportImage("color", VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, &present);
+    RenderGraph::ImageDesc scratchDesc;
+    scratchDesc.format = VK_FORMAT_R8G8B8A8_UNORM;
+    scratchDesc.extent = {64, 64};
+    scratchDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+    RenderGraph::ResourceHandle scratch = graph.CreateTransientImage("scratch", scratchDesc);
+
+    uint32_t simulate = graph.AddPass("simulate", [](VkCommandBuffer){});
+    graph.Write(simulate, particles, ResourceUsage::StorageWriteCompute);
+    uint32_t unused = graph.AddPass("unused", [](VkCommandBuffer){});
+    graph.Write(unused, scratch, ResourceUsage::StorageWriteCompute);
+    uint32_t draw = graph.AddPass("draw", [](VkCommandBuffer){});
+    graph.Read(draw, particles, ResourceUsage::StorageReadVertex);
+    graph.Write(draw, color, ResourceUsage::ColorAttachment);
+    uint32_t drawAgain = graph.AddPass("draw again", [](VkCommandBuffer){});
+    graph.Read(drawAgain, particles, ResourceUsage::StorageReadVertex);
+    graph.Write(drawAgain, color, ResourceUsage::ColorAttachment);
+
+    graph.Compile();
+
+    const std::vector<uint32_t>& order = graph.GetPassOrder();
+    CHECK((order == std::vector<uint32_t>{simulate, draw, drawAgain}));
+    CHECK(graph.GetTransientMemorySize() == 0);
+    CHECK(graph.GetUnaliasedTransientMemorySize() == 0);
+
+    // Nothing happened to the buffer before the frame
+    CHECK(graph.GetBufferBarriers(simulate).empty());
+    CHECK(graph.GetImageBarriers(simulate).empty());
+
+    // The vertex shader reads what the compute shader wrote, the image leaves its undefined layout
+    const std::vector<VkBufferMemoryBarrier2>& drawBuffers = graph.GetBufferBarriers(draw);
+    CHECK(drawBuffers.size() == 1);
+    if(drawBuffers.size() == 1){
+        CHECK(drawBuffers[0].srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+        CHECK(drawBuffers[0].srcAccessMask == (VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT));
+        CHECK(drawBuffers[0].dstStageMask == VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT);
+        CHECK(drawBuffers[0].dstAccessMask == VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+        CHECK(drawBuffers[0].size == VK_WHOLE_SIZE);
+    }
+    const std::vector<VkImageMemoryBarrier2>& drawImages = graph.GetImageBarriers(draw);
+    CHECK(drawImages.size() == 1);
+    if(drawImages.size() == 1){
+        CHECK(drawImages[0].srcStageMask == VK_PIPELINE_STAGE_2_NONE);
+        CHECK(drawImages[0].srcAccessMask == VK_ACCESS_2_NONE);
+        CHECK(drawImages[0].dstStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+        CHECK(drawImages[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+        CHECK(drawImages[0].newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        CHECK(drawImages[0].subresourceRange.aspectMask == VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    // The write is already visible to the vertex shader, only the second draw into the image waits for the first
+    CHECK(graph.GetBufferBarriers(drawAgain).empty());
+    const std::vector<VkImageMemoryBarrier2>& drawAgainImages = graph.GetImageBarriers(drawAgain);
+    CHECK(drawAgainImages.size() == 1);
+    if(drawAgainImages.size() == 1){
+        CHECK(drawAgainImages[0].srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+        CHECK(drawAgainImages[0].srcAccessMask == (VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT));
+        CHECK(drawAgainImages[0].dstStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+        CHECK(drawAgainImages[0].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        CHECK(drawAgainImages[0].newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+
+    const std::vector<VkImageMemoryBarrier2>& finalImages = graph.GetFinalImageBarriers();
+    CHECK(finalImages.size() == 1);
+    if(finalImages.size() == 1){
+        CHECK(finalImages[0].srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+        CHECK(finalImages[0].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        CHECK(finalImages[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
+
+    return g_checkFailures == 0 ? 0 : 1;
+}